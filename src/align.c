@@ -13,6 +13,7 @@
 #include "math_utils.h"
 #include "align.h"
 #include "kmer.h"
+#include "kalloc.h"
 
 extern int LONGCALLD_VERBOSE;
 
@@ -328,26 +329,81 @@ int wfa_collect_pretty_alignment(cigar_t* const cigar,
     return alg_pos;
 }
 
-// return alignment score
-int wfa_heuristic_aln(uint8_t *pattern, int plen, uint8_t *text, int tlen, 
-                      int a, int b, int q, int e, int q2, int e2, int *n_eq, int *n_xid) {
+wfa_pool_t *wfa_pool_init(const call_var_opt_t *opt) {
+    wfa_pool_t *pool = (wfa_pool_t*)_err_calloc(1, sizeof(wfa_pool_t));
+    pool->b = opt->mismatch; pool->q = opt->gap_open1; pool->e = opt->gap_ext1; pool->q2 = opt->gap_open2; pool->e2 = opt->gap_ext2;
+    pool->ultralow_len = opt->wfa_ultralow_len;
+    return pool;
+}
+
+void wfa_pool_destroy(wfa_pool_t *pool) {
+    if (pool == NULL) return;
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < LONGCALLD_WFA_N_HEURISTICS; ++j) {
+            for (int k = 0; k < 2; ++k) {
+                if (pool->aligners[i][j][k] != NULL) wavefront_aligner_delete(pool->aligners[i][j][k]);
+            }
+        }
+    }
+    if (pool->rev_seq != NULL) free(pool->rev_seq);
+    free(pool);
+}
+
+// zdrop/xdrop values depend on the sequence lengths, they are set for each alignment
+static wavefront_aligner_t *wfa_pool_get(wfa_pool_t *pool, int affine_gap, int heuristic, int ultralow) {
+    wavefront_aligner_t **wf = &pool->aligners[affine_gap][heuristic][ultralow];
+    if (*wf != NULL) return *wf;
     wavefront_aligner_attr_t attributes = wavefront_aligner_attr_default;
-    attributes.memory_mode = wavefront_memory_ultralow;
-    attributes.distance_metric = gap_affine_2p;
-    attributes.affine2p_penalties.match = 0;
-    attributes.affine2p_penalties.mismatch = b;
-    attributes.affine2p_penalties.gap_opening1 = q;
-    attributes.affine2p_penalties.gap_extension1 = e;
-    attributes.affine2p_penalties.gap_opening2 = q2;
-    attributes.affine2p_penalties.gap_extension2 = e2;
+    if (ultralow) attributes.memory_mode = wavefront_memory_ultralow;
+    if (affine_gap == LONGCALLD_WFA_AFFINE_2P) {
+        attributes.distance_metric = gap_affine_2p;
+        attributes.affine2p_penalties.match = 0; // -a;
+        attributes.affine2p_penalties.mismatch = pool->b;
+        attributes.affine2p_penalties.gap_opening1 = pool->q;
+        attributes.affine2p_penalties.gap_extension1 = pool->e;
+        attributes.affine2p_penalties.gap_opening2 = pool->q2;
+        attributes.affine2p_penalties.gap_extension2 = pool->e2;
+    } else {
+        attributes.distance_metric = gap_affine;
+        attributes.affine_penalties.match = 0; // -a;
+        attributes.affine_penalties.mismatch = pool->b;
+        attributes.affine_penalties.gap_opening = pool->q;
+        attributes.affine_penalties.gap_extension = pool->e;
+    }
     attributes.alignment_scope = compute_alignment;
     attributes.alignment_form.span = alignment_end2end;
+    if (heuristic == LONGCALLD_WFA_NO_HEURISTIC) 
+        attributes.heuristic.strategy = wf_heuristic_none;
+    else if (heuristic == LONGCALLD_WFA_ADAPTIVE) // default heuristic
+        attributes.heuristic.strategy = wf_heuristic_wfadaptive;
+    else if (heuristic == LONGCALLD_WFA_ZDROP) { // Zdrop
+        attributes.heuristic.strategy = wf_heuristic_zdrop;
+        attributes.heuristic.zdrop = 500;
+        attributes.heuristic.steps_between_cutoffs = 100;
+    } else { // Xdrop
+        attributes.heuristic.strategy = wf_heuristic_xdrop;
+        attributes.heuristic.xdrop = 100;
+        attributes.heuristic.steps_between_cutoffs = 100;
+    }
+    *wf = wavefront_aligner_new(&attributes);
+    return *wf;
+}
+
+// the aligner keeps its wavefront memory between alignments, drop it after a very long region
+static void wfa_pool_put(wfa_pool_t *pool, int affine_gap, int heuristic, int ultralow, uint64_t *peak_bytes) {
+    wavefront_aligner_t **wf = &pool->aligners[affine_gap][heuristic][ultralow];
+    uint64_t bytes = wavefront_aligner_get_size(*wf);
+    if (peak_bytes != NULL && bytes > *peak_bytes) *peak_bytes = bytes;
+    if (bytes > LONGCALLD_WFA_POOL_MAX_BYTES) {
+        wavefront_aligner_delete(*wf); *wf = NULL;
+    }
+}
+
+// return alignment score
+int wfa_heuristic_aln(wfa_pool_t *pool, uint8_t *pattern, int plen, uint8_t *text, int tlen, int *n_eq, int *n_xid) {
+    wavefront_aligner_t *wf_aligner = wfa_pool_get(pool, LONGCALLD_WFA_AFFINE_2P, LONGCALLD_WFA_XDROP, 1);
     // xdrops
-    attributes.heuristic.strategy = wf_heuristic_xdrop;
-    attributes.heuristic.xdrop = MAX_OF_TWO(100, (int)((plen + tlen) * 0.1)); 
-    attributes.heuristic.steps_between_cutoffs = 100;
-    // Initialize Wavefront Aligner
-    wavefront_aligner_t* const wf_aligner = wavefront_aligner_new(&attributes);
+    wavefront_aligner_set_heuristic_xdrop(wf_aligner, MAX_OF_TWO(100, (int)((plen + tlen) * 0.1)), 100);
     // Align
     wavefront_align(wf_aligner, (const char*)pattern, plen, (const char*)text, tlen);
     // collect score
@@ -363,52 +419,30 @@ int wfa_heuristic_aln(uint8_t *pattern, int plen, uint8_t *text, int tlen,
             else if (op == BAM_CDIFF || op == BAM_CINS || op == BAM_CDEL) *n_xid += len;
         }
     }
-    // Free
-    wavefront_aligner_delete(wf_aligner); 
+    wfa_pool_put(pool, LONGCALLD_WFA_AFFINE_2P, LONGCALLD_WFA_XDROP, 1, NULL);
     return score;
 }
 
 // cons vs ref: ultra-low mem + dual-gap + no heuristic to ensure accurate alignment
 // full read/cons vs full read: ultra-low mem + affine-gap + wf-adaptive to ensure accurate alignment and speed up
 // full read/cons vs partial read: high mem (default) + affine-gap + heuristic (xdrop/zdrop) to speed up
-int wfa_end2end_aln(uint8_t *pattern, int plen, uint8_t *text, int tlen,
-                    int gap_aln, int b, int q, int e, int q2, int e2, int heuristic, int affine_gap, // heuristic: 0: no, 1: default, 2: zdrop
-                    uint32_t **cigar_buf, int *cigar_length, uint8_t **pattern_alg, uint8_t **text_alg, int *alg_length) {
+// high mem is switched to ultralow for sequences >= pool->ultralow_len
+int wfa_end2end_aln(wfa_pool_t *pool, uint8_t *pattern, int plen, uint8_t *text, int tlen,
+                    int gap_aln, int heuristic, int affine_gap, // heuristic: 0: no, 1: default, 2: zdrop
+                    uint32_t **cigar_buf, int *cigar_length, uint8_t **pattern_alg, uint8_t **text_alg, int *alg_length, uint64_t *peak_bytes) {
     // double realtime0 = realtime();
     // fprintf(stderr, "WFA-end2end %d vs %d\n", plen, tlen);
-    wavefront_aligner_attr_t attributes = wavefront_aligner_attr_default;
-    // if (heuristic != LONGCALLD_WFA_ZDROP) attributes.memory_mode = wavefront_memory_ultralow;
-    if (affine_gap == LONGCALLD_WFA_AFFINE_2P) {
-        attributes.distance_metric = gap_affine_2p;
-        attributes.affine2p_penalties.match = 0; // -a;
-        attributes.affine2p_penalties.mismatch = b;
-        attributes.affine2p_penalties.gap_opening1 = q;
-        attributes.affine2p_penalties.gap_extension1 = e;
-        attributes.affine2p_penalties.gap_opening2 = q2;
-        attributes.affine2p_penalties.gap_extension2 = e2;
-    } else {
-        attributes.distance_metric = gap_affine;
-        attributes.affine_penalties.match = 0; // -a;
-        attributes.affine_penalties.mismatch = b;
-        attributes.affine_penalties.gap_opening = q;
-        attributes.affine_penalties.gap_extension = e;
-    }
-    attributes.alignment_scope = compute_alignment;
-    attributes.alignment_form.span = alignment_end2end;
-    if (heuristic == LONGCALLD_WFA_NO_HEURISTIC) 
-        attributes.heuristic.strategy = wf_heuristic_none;
-    if (heuristic == LONGCALLD_WFA_ADAPTIVE) // default heuristic
-        attributes.heuristic.strategy = wf_heuristic_wfadaptive;
-    else if (heuristic == LONGCALLD_WFA_ZDROP) { // Zdrop
-        attributes.heuristic.strategy = wf_heuristic_zdrop;
-        attributes.heuristic.zdrop = MIN_OF_TWO(500, (int)(MIN_OF_TWO(plen, tlen) * 0.1));
-        attributes.heuristic.steps_between_cutoffs = 100;
-    }
-    // Initialize Wavefront Aligner
-    wavefront_aligner_t* const wf_aligner = wavefront_aligner_new(&attributes);
+    int ultralow = pool->ultralow_len > 0 && MAX_OF_TWO(plen, tlen) >= pool->ultralow_len;
+    wavefront_aligner_t *wf_aligner = wfa_pool_get(pool, affine_gap, heuristic, ultralow);
+    if (heuristic == LONGCALLD_WFA_ZDROP)
+        wavefront_aligner_set_heuristic_zdrop(wf_aligner, MIN_OF_TWO(500, (int)(MIN_OF_TWO(plen, tlen) * 0.1)), 100);
     uint8_t *p = pattern, *t = text;
     if (gap_aln == LONGCALLD_GAP_LEFT_ALN) { // reverse pattern and text
-        p = (uint8_t*)malloc(plen); t = (uint8_t*)malloc(tlen);
+        if (plen + tlen > pool->m_rev_seq) {
+            pool->m_rev_seq = plen + tlen;
+            pool->rev_seq = (uint8_t*)_err_realloc(pool->rev_seq, pool->m_rev_seq);
+        }
+        p = pool->rev_seq; t = pool->rev_seq + plen;
         for (int i = 0; i < plen; ++i) p[i] = pattern[plen-i-1];
         for (int i = 0; i < tlen; ++i) t[i] = text[tlen-i-1];
     }
@@ -452,20 +486,18 @@ int wfa_end2end_aln(uint8_t *pattern, int plen, uint8_t *text, int tlen,
             }
         }
     }
-    // Free
     // fprintf(stderr, "%d vs %d Real time: %.3f sec. Score: %d\n", plen, tlen, realtime() - realtime0, cigar_score_gap_affine2p(cigar, &attributes.affine2p_penalties));
-    wavefront_aligner_delete(wf_aligner); 
-    if (gap_aln == LONGCALLD_GAP_LEFT_ALN) { free(p); free(t); }
+    wfa_pool_put(pool, affine_gap, heuristic, ultralow, peak_bytes);
     return 0;
 }
 
 
-int wfa_collect_diff_ins_seq(const call_var_opt_t *opt, uint8_t* large_seq, int large_len, uint8_t *small_seq, int small_len, uint8_t **diff_seq) {
+int wfa_collect_diff_ins_seq(const call_var_opt_t *opt, wfa_pool_t *pool, uint8_t* large_seq, int large_len, uint8_t *small_seq, int small_len, uint8_t **diff_seq) {
     int diff_ins_len = 0;
     uint8_t *large_aln_seq = NULL, *small_aln_seq = NULL; int aln_len;
-    wfa_end2end_aln(large_seq, large_len, small_seq, small_len,
-                    opt->gap_aln, opt->mismatch, opt->gap_open1, opt->gap_ext1, opt->gap_open2, opt->gap_ext2, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, // no heuristic, affine-2p
-                    NULL, NULL, &large_aln_seq, &small_aln_seq, &aln_len);
+    wfa_end2end_aln(pool, large_seq, large_len, small_seq, small_len,
+                    opt->gap_aln, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, // no heuristic, affine-2p
+                    NULL, NULL, &large_aln_seq, &small_aln_seq, &aln_len, NULL);
     // collect the largest insertion sequence
     int largest_ins_len = 0, largest_ins_pos = -1;
     for (int i = 0; i < aln_len; ++i) {
@@ -562,13 +594,14 @@ void wfa_trim_aln_str(int full_cover, aln_str_t *aln_str) {
 }
 
 // for read with full_cover as 1 or 2, collect beg/end positions of read mapped to target
-int wfa_collect_aln_str(const call_var_opt_t *opt, uint8_t *target, int tlen, uint8_t *query, int qlen, int full_cover, int heuristic, int affine_gap, aln_str_t *aln_str) {
+// peak_bytes: if not NULL, updated with the memory used by WFA
+int wfa_collect_aln_str(const call_var_opt_t *opt, wfa_pool_t *pool, uint8_t *target, int tlen, uint8_t *query, int qlen, int full_cover, int heuristic, int affine_gap, aln_str_t *aln_str, uint64_t *peak_bytes) {
     if (LONGCALLD_NOISY_IS_NOT_COVER(full_cover)) return 0;
     aln_str->target_aln = 0; aln_str->query_aln = 0; aln_str->aln_len = 0;
-    int gap_aln = opt->gap_aln, b = opt->mismatch, q = opt->gap_open1, e = opt->gap_ext1, q2 = opt->gap_open2, e2 = opt->gap_ext2;
+    int gap_aln = opt->gap_aln;
     if (LONGCALLD_NOISY_IS_BOTH_COVER(full_cover)) {
-        wfa_end2end_aln(target, tlen, query, qlen, gap_aln, b, q, e, q2, e2, heuristic, affine_gap,
-                        NULL, NULL, &aln_str->target_aln, &aln_str->query_aln, &aln_str->aln_len);
+        wfa_end2end_aln(pool, target, tlen, query, qlen, gap_aln, heuristic, affine_gap,
+                        NULL, NULL, &aln_str->target_aln, &aln_str->query_aln, &aln_str->aln_len, peak_bytes);
         aln_str->target_beg = 0; aln_str->target_end = aln_str->aln_len-1;
         aln_str->query_beg = 0; aln_str->query_end = aln_str->aln_len-1;
     } else { // trim aln_str if query is longer than target; 
@@ -589,9 +622,9 @@ int wfa_collect_aln_str(const call_var_opt_t *opt, uint8_t *target, int tlen, ui
             gap_aln = (gap_aln == LONGCALLD_GAP_LEFT_ALN) ? LONGCALLD_GAP_RIGHT_ALN : LONGCALLD_GAP_LEFT_ALN;
         }
         // partial alignment
-        wfa_end2end_aln(target+_t_start, _tlen, query+_q_start, _qlen, 
-                        gap_aln, b, q, e, q2, e2, LONGCALLD_WFA_ZDROP, LONGCALLD_WFA_AFFINE_2P,
-                        NULL, NULL, &aln_str->target_aln, &aln_str->query_aln, &aln_str->aln_len);
+        wfa_end2end_aln(pool, target+_t_start, _tlen, query+_q_start, _qlen, 
+                        gap_aln, LONGCALLD_WFA_ZDROP, LONGCALLD_WFA_AFFINE_2P,
+                        NULL, NULL, &aln_str->target_aln, &aln_str->query_aln, &aln_str->aln_len, peak_bytes);
         // do not trim for end-gaps
         wfa_trim_aln_str(full_cover, aln_str);
         aln_str->target_beg += _t_start; aln_str->target_end += _t_start;
@@ -607,7 +640,7 @@ int wfa_collect_aln_str(const call_var_opt_t *opt, uint8_t *target, int tlen, ui
     return 0;
 }
 
-int end2end_aln(const call_var_opt_t *opt, char *tseq, int tlen, uint8_t *qseq, int qlen, uint32_t **cigar_buf) {
+int end2end_aln(const call_var_opt_t *opt, wfa_pool_t *pool, char *tseq, int tlen, uint8_t *qseq, int qlen, uint32_t **cigar_buf) {
     if (qlen <= 0 || tlen <= 0) return 0;
     // int min_len = MIN_OF_TWO(tlen, qlen)
     int max_len = MAX_OF_TWO(tlen, qlen);
@@ -618,8 +651,8 @@ int end2end_aln(const call_var_opt_t *opt, char *tseq, int tlen, uint8_t *qseq,
     // use wfa if the length difference is small
     // if (max_len * delta_len + delta_len * delta_len < max_len * min_len) {
     int cigar_len = 0;
-    wfa_end2end_aln(tseq2, tlen, qseq, qlen, opt->gap_aln, opt->mismatch, opt->gap_open1, opt->gap_ext1, opt->gap_open2, opt->gap_ext2, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P,
-                    cigar_buf, &cigar_len, NULL, NULL, NULL);
+    wfa_end2end_aln(pool, tseq2, tlen, qseq, qlen, opt->gap_aln, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P,
+                    cigar_buf, &cigar_len, NULL, NULL, NULL, NULL);
     // } else { // if (max_len - min_len > 1000) { // use ksw2 if the length difference is large
         // cigar_len = ksw2_aln(opt->gap_aln, tseq2, tlen, qseq, qlen, opt->match, opt->mismatch, opt->gap_open1, opt->gap_ext1, opt->gap_open2, opt->gap_ext2, cigar_buf);
     // }
@@ -664,8 +697,8 @@ void collect_aln_beg_end(uint32_t *cigar_buf, int cigar_len, int ext_direction,
 
 // calculate the beg/end positions of query mapped to target using WFA
 // limit to (partial_aln_ratio*short_len vs short_len)
-int cal_wfa_partial_aln_beg_end(int ext_direction, const call_var_opt_t *opt, uint8_t *_target, int _tlen, uint8_t *_query, int _qlen, int *target_beg, int *target_end, int *query_beg, int *query_end) {
-    int gap_aln = opt->gap_aln, b = opt->mismatch, q = opt->gap_open1, e = opt->gap_ext1, q2 = opt->gap_open2, e2 = opt->gap_ext2;
+int cal_wfa_partial_aln_beg_end(int ext_direction, const call_var_opt_t *opt, wfa_pool_t *pool, uint8_t *_target, int _tlen, uint8_t *_query, int _qlen, int *target_beg, int *target_end, int *query_beg, int *query_end) {
+    int gap_aln = opt->gap_aln;
     double ratio = opt->partial_aln_ratio;
     int tlen = _tlen, qlen = _qlen;
     uint8_t *target = _target, *query = _query;
@@ -699,14 +732,14 @@ int cal_wfa_partial_aln_beg_end(int ext_direction, const call_var_opt_t *opt, ui
         if (x_gaps > min_len * 0.10) { return 0;
         }
     }
-    wfa_end2end_aln(target, tlen, query, qlen, gap_aln, b, q, e, q2, e2, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, &cigar_buf, &cigar_len, NULL, NULL, NULL);
+    wfa_end2end_aln(pool, target, tlen, query, qlen, gap_aln, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, &cigar_buf, &cigar_len, NULL, NULL, NULL, NULL);
     if (cigar_len == 0) ret = 0;
     else collect_aln_beg_end(cigar_buf, cigar_len, ext_direction, _tlen, target_beg, target_end, _qlen, query_beg, query_end);
     if (cigar_buf != NULL) free(cigar_buf);
     return ret;
 }
 
-int collect_partial_aln_beg_end(const call_var_opt_t *opt, int sampling_reads,
+int collect_partial_aln_beg_end(const call_var_opt_t *opt, wfa_pool_t *pool, int sampling_reads,
                                 uint8_t *target, int tlen, int target_full_cover, uint8_t *query, int qlen, int query_full_cover, 
                                 int *target_beg, int *target_end, int *query_beg, int *query_end) {
     *target_beg = 1, *target_end = tlen, *query_beg = 1, *query_end = qlen;
@@ -729,26 +762,26 @@ int collect_partial_aln_beg_end(const call_var_opt_t *opt, int sampling_reads,
             return 1;
         } else {
             if (LONGCALLD_NOISY_IS_LEFT_COVER(query_full_cover)) {
-                ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_LEFT_TO_RIGHT, opt, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
+                ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_LEFT_TO_RIGHT, opt, pool, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
             } else if (LONGCALLD_NOISY_IS_RIGHT_COVER(query_full_cover)) {
-                ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_RIGHT_TO_LEFT, opt, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
+                ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_RIGHT_TO_LEFT, opt, pool, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
             }
         }
     } else if (LONGCALLD_NOISY_IS_LEFT_COVER(target_full_cover)) { // ref is left-cover
         if (LONGCALLD_NOISY_IS_LEFT_COVER(query_full_cover) == 0) _err_error_exit("Target is left-cover but read is not left-cover\n");
-        ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_LEFT_TO_RIGHT, opt, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
+        ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_LEFT_TO_RIGHT, opt, pool, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
     } else if (LONGCALLD_NOISY_IS_RIGHT_COVER(target_full_cover)) { // ref is right-cover
         if (LONGCALLD_NOISY_IS_RIGHT_COVER(query_full_cover) == 0) _err_error_exit("Ref is right-cover but read is not right-cover\n");
-        ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_RIGHT_TO_LEFT, opt, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
+        ret = cal_wfa_partial_aln_beg_end(LONGCALLD_EXT_ALN_RIGHT_TO_LEFT, opt, pool, target, tlen, query, qlen, target_beg, target_end, query_beg, query_end);
     } else _err_error_exit("Target is not left or right-cover\n");
     return ret;
 }
 
-int collect_exc_beg_end(const call_var_opt_t *opt, abpoa_t *ab, abpoa_para_t *abpt, int sampling_reads, int n_reads, char **names, uint8_t **read_seqs, 
+int collect_exc_beg_end(const call_var_opt_t *opt, wfa_pool_t *pool, abpoa_t *ab, abpoa_para_t *abpt, int sampling_reads, int n_reads, char **names, uint8_t **read_seqs, 
                         int *read_lens, int *read_full_cover, int *exc_begs, int *exc_ends, int *seq_beg_cuts, int *seq_end_cuts) {
     for (int read_i = 1; read_i < n_reads; ++read_i) {
         int ref_beg, ref_end, read_beg, read_end, beg_id, end_id;
-        if (collect_partial_aln_beg_end(opt, sampling_reads, read_seqs[0], read_lens[0], read_full_cover[0], read_seqs[read_i], read_lens[read_i], read_full_cover[read_i], &ref_beg, &ref_end, &read_beg, &read_end) == 0) {
+        if (collect_partial_aln_beg_end(opt, pool, sampling_reads, read_seqs[0], read_lens[0], read_full_cover[0], read_seqs[read_i], read_lens[read_i], read_full_cover[read_i], &ref_beg, &ref_end, &read_beg, &read_end) == 0) {
             exc_begs[read_i] = -1, exc_ends[read_i] = -1;
             continue;
         }
@@ -759,50 +792,144 @@ int collect_exc_beg_end(const call_var_opt_t *opt, abpoa_t *ab, abpoa_para_t *ab
     return 0;
 }
 
-int abpoa_partial_aln_msa_cons(const call_var_opt_t *opt, abpoa_t *ab, int sampling_reads, int n_reads, int *read_ids, uint8_t **read_seqs, uint8_t **read_quals, int *read_lens, int *read_full_cover, char **names,
-                               int max_n_cons, int *cons_lens, uint8_t **cons_seqs, int *clu_n_seqs, int **clu_read_ids, int *msa_seq_lens, uint8_t **msa_seqs) {
-    // abpoa_t *ab = abpoa_init();
-    int needs_free_ab = 0;
-    if (ab == NULL) {
-        ab = abpoa_init(); needs_free_ab = 1;
-    }
-    abpoa_para_t *abpt = abpoa_init_para();
-    // if (opt->out_somatic) abpt->wf = 0.01; // more accurate for somatic variant calling
-    // else abpt->wf = 0.001; // limit memory usage for long sequences
-    abpt->cons_algrm = ABPOA_MF;
-    abpt->sub_aln = 1;
-    abpt->inc_path_score = 1;
-    if (cons_lens != NULL && cons_seqs != NULL) abpt->out_cons = 1; else abpt->out_cons = 0;
-    if (msa_seq_lens != NULL && msa_seqs != NULL) abpt->out_msa = 1; else abpt->out_msa = 0;
-    abpt->max_n_cons = max_n_cons; abpt->min_freq = opt->min_af;
-    abpt->match = opt->match; abpt->mismatch = opt->mismatch;
-    abpt->gap_open1 = opt->gap_open1; abpt->gap_ext1 = opt->gap_ext1;
-    abpt->gap_open2 = opt->gap_open2; abpt->gap_ext2 = opt->gap_ext2;
-
-    if (LONGCALLD_VERBOSE >= 2) abpt->out_msa = 1;
-    abpoa_post_set_para(abpt);
-    ab->abs->n_seq = n_reads;
+struct abpoa_pool_t {
+    abpoa_t *ab;
+    abpoa_para_t *abpt[2][2][LONGCALLD_POA_MAX_N_CONS]; // [sub_aln][out_msa][max_n_cons-1], NULL: not used yet
+};
+
+abpoa_pool_t *abpoa_pool_init(void) {
+    abpoa_pool_t *pool = (abpoa_pool_t*)_err_calloc(1, sizeof(abpoa_pool_t));
+    pool->ab = abpoa_init();
+    return pool;
+}
+
+void abpoa_pool_destroy(abpoa_pool_t *pool) {
+    if (pool == NULL) return;
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            for (int k = 0; k < LONGCALLD_POA_MAX_N_CONS; ++k) {
+                if (pool->abpt[i][j][k] != NULL) abpoa_free_para(pool->abpt[i][j][k]);
+            }
+        }
+    }
+    abpoa_free(pool->ab); free(pool);
+}
+
+// sub_aln: 1 for abpoa_partial_aln_msa_cons(), 0 for abpoa_aln_msa_cons()
+static abpoa_para_t *abpoa_pool_get_para(const call_var_opt_t *opt, abpoa_pool_t *pool, int sub_aln, int out_msa, int max_n_cons) {
+    if (max_n_cons < 1 || max_n_cons > LONGCALLD_POA_MAX_N_CONS) _err_error_exit("Unsupported number of consensus sequences: %d\n", max_n_cons);
+    abpoa_para_t **abpt = &pool->abpt[sub_aln][out_msa][max_n_cons-1];
+    if (*abpt != NULL) return *abpt;
+    *abpt = abpoa_init_para();
+    // if (opt->out_somatic) (*abpt)->wf = 0.01; // more accurate for somatic variant calling
+    // else (*abpt)->wf = 0.001; // limit memory usage for long sequences
+    if (sub_aln) {
+        (*abpt)->sub_aln = 1;
+        (*abpt)->use_qv = 1; // base weights: number of collapsed identical reads
+    } else (*abpt)->wb = -1;
+    (*abpt)->cons_algrm = ABPOA_MF;
+    (*abpt)->inc_path_score = 1;
+    (*abpt)->out_cons = 1; (*abpt)->out_msa = out_msa;
+    (*abpt)->max_n_cons = max_n_cons; (*abpt)->min_freq = opt->min_af;
+    (*abpt)->match = opt->match; (*abpt)->mismatch = opt->mismatch;
+    (*abpt)->gap_open1 = opt->gap_open1; (*abpt)->gap_ext1 = opt->gap_ext1;
+    (*abpt)->gap_open2 = opt->gap_open2; (*abpt)->gap_ext2 = opt->gap_ext2;
+    abpoa_post_set_para(*abpt);
+    return *abpt;
+}
+
+// the DP matrix is kept between regions, drop it after a very long region
+static void abpoa_pool_put(abpoa_pool_t *pool, noisy_aln_prof_t *prof) {
+    uint64_t bytes = pool->ab->abm->s_msize;
+    if (bytes > prof->poa_peak_bytes) prof->poa_peak_bytes = bytes;
+    if (bytes > LONGCALLD_POA_POOL_MAX_BYTES) {
+        abpoa_free(pool->ab); pool->ab = abpoa_init();
+    }
+}
+
+// consensus vs reference: no heuristic, unless reads were subsampled or half of --noisy-max-time has passed
+static int ref_cons_wfa_heuristic(noisy_aln_prof_t *prof) {
+    if ((prof->fallbacks & LONGCALLD_NOISY_FB_SUBSAMPLE) || (prof->heuristic_time > 0 && realtime() > prof->heuristic_time)) {
+        prof->fallbacks |= LONGCALLD_NOISY_FB_HEURISTIC;
+        return LONGCALLD_WFA_ADAPTIVE;
+    }
+    return LONGCALLD_WFA_NO_HEURISTIC;
+}
+
+// identical read segments (same full_cover & sequence) are collapsed into one POA input, weighted by their read count
+// uniq_i: read -> unique segment; uniq_reads: unique segment -> first read; uniq_w: read count of each unique segment
+// no_collapse: one segment per read, all weighted 1
+static int collapse_dup_reads(int no_collapse, int n_reads, uint8_t **read_seqs, int *read_lens, int *read_full_cover, int *uniq_i, int *uniq_reads, int *uniq_w) {
+    if (no_collapse) {
+        for (int i = 0; i < n_reads; ++i) { uniq_i[i] = uniq_reads[i] = i; uniq_w[i] = 1; }
+        return n_reads;
+    }
+    uint64_t *hashes = (uint64_t*)malloc(n_reads * sizeof(uint64_t));
+    int n_uniq = 0;
     for (int i = 0; i < n_reads; ++i) {
+        uint64_t h = hash_64(((uint64_t)read_lens[i] << 16) | read_full_cover[i]);
+        for (int j = 0; j < read_lens[i]; ++j) h = (h ^ read_seqs[i][j]) * 0x100000001b3ULL; // FNV-1a
+        int k;
+        for (k = 0; k < n_uniq; ++k) {
+            int r = uniq_reads[k];
+            if (hashes[k] == h && read_lens[r] == read_lens[i] && read_full_cover[r] == read_full_cover[i] &&
+                memcmp(read_seqs[r], read_seqs[i], read_lens[i]) == 0) break;
+        }
+        if (k == n_uniq) {
+            hashes[n_uniq] = h; uniq_reads[n_uniq] = i; uniq_w[n_uniq] = 0; n_uniq++;
+        }
+        uniq_i[i] = k; uniq_w[k]++;
+    }
+    free(hashes);
+    return n_uniq;
+}
+
+int abpoa_partial_aln_msa_cons(const call_var_opt_t *opt, wfa_pool_t *pool, abpoa_pool_t *poa_pool, int sampling_reads, int n_reads, int *read_ids, uint8_t **read_seqs, uint8_t **read_quals, int *read_lens, int *read_full_cover, char **names,
+                               int max_n_cons, int *cons_lens, uint8_t **cons_seqs, int *clu_n_seqs, int **clu_read_ids, int *msa_seq_lens, uint8_t **msa_seqs, noisy_aln_prof_t *prof) {
+    int out_msa = (msa_seq_lens != NULL && msa_seqs != NULL) || LONGCALLD_VERBOSE >= 2;
+    abpoa_para_t *abpt = abpoa_pool_get_para(opt, poa_pool, 1, out_msa, max_n_cons);
+    abpoa_t *ab = poa_pool->ab;
+    // only distinct segments are aligned to the graph, read IDs are expanded again for clu_read_ids & msa_seqs
+    int *uniq_i = (int*)malloc(n_reads * sizeof(int)), *uniq_reads = (int*)malloc(n_reads * sizeof(int)), *uniq_w = (int*)malloc(n_reads * sizeof(int));
+    int n_uniq = collapse_dup_reads(opt->no_read_collapse, n_reads, read_seqs, read_lens, read_full_cover, uniq_i, uniq_reads, uniq_w);
+    int *weights = (int*)malloc(read_lens[0] * sizeof(int)), m_weights = read_lens[0];
+    if (LONGCALLD_VERBOSE >= 2 && n_uniq < n_reads) fprintf(stderr, "Collapsed %d reads into %d distinct segments\n", n_reads, n_uniq);
+    abpoa_reset(ab, abpt, read_lens[0]);
+    // min_freq & multi-consensus clustering are relative to n_seq: all reads, as without collapsing,
+    // only the first n_uniq read IDs are used, each weighted by its read count (use_qv)
+    ab->abs->n_seq = n_reads;
+    for (int u = 0; u < n_uniq; ++u) {
+        int i = uniq_reads[u];
         if (LONGCALLD_VERBOSE >= 3) {
-            fprintf(stderr, ">%s %d %d\n", names[i], read_lens[i], read_full_cover[i]);
+            fprintf(stderr, ">%s %d %d x%d\n", names[i], read_lens[i], read_full_cover[i], uniq_w[u]);
             for (int j = 0; j < read_lens[i]; ++j) {
                 fprintf(stderr, "%c", "ACGTN"[read_seqs[i][j]]);
             } fprintf(stderr, "\n");
         }
-        abpoa_res_t res; res.graph_cigar = 0, res.n_cigar = 0;
+        if (u > 0 && prof->deadline > 0 && realtime() > prof->deadline) { // consensus of the reads aligned so far
+            prof->fallbacks |= LONGCALLD_NOISY_FB_TRUNCATED;
+            break;
+        }
+        abpoa_res_t res; res.graph_cigar = 0; res.n_cigar = 0;
         int exc_beg = 0, exc_end = 1, seq_beg_cut = 0, seq_end_cut = 0;
         if (i != 0) {
             int ref_beg, ref_end, read_beg, read_end, beg_id, end_id;
-            if (collect_partial_aln_beg_end(opt, sampling_reads, read_seqs[0], read_lens[0], read_full_cover[0], read_seqs[i], read_lens[i], read_full_cover[i], &ref_beg, &ref_end, &read_beg, &read_end) == 0) continue;
+            if (collect_partial_aln_beg_end(opt, pool, sampling_reads, read_seqs[0], read_lens[0], read_full_cover[0], read_seqs[i], read_lens[i], read_full_cover[i], &ref_beg, &ref_end, &read_beg, &read_end) == 0) continue;
             beg_id = ref_beg+1, end_id = ref_end+1;
             seq_beg_cut = read_beg - 1, seq_end_cut = read_lens[i] - read_end;
             abpoa_subgraph_nodes(ab, abpt, beg_id, end_id, &exc_beg, &exc_end);
             // fprintf(stderr, "beg_id: %d, end_id: %d, read_beg: %d, read_end: %d, exc_beg: %d, exc_end: %d\n", beg_id, end_id, read_beg, read_end, exc_beg, exc_end);
         }
         if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "ExcBeg: %d, ExcEnd: %d, SeqBegCut: %d, SeqEndCut: %d, FullCover: %d\n", exc_beg, exc_end, seq_beg_cut, seq_end_cut, read_full_cover[i]);
-        abpoa_align_sequence_to_subgraph(ab, abpt, exc_beg, exc_end, read_seqs[i]+seq_beg_cut, read_lens[i]-seq_beg_cut-seq_end_cut, &res);
+        int qlen = read_lens[i]-seq_beg_cut-seq_end_cut;
+        if (qlen > m_weights) {
+            m_weights = qlen; weights = (int*)realloc(weights, m_weights * sizeof(int));
+        }
+        for (int j = 0; j < qlen; ++j) weights[j] = uniq_w[u];
+        prof->poa_cells += (int64_t)qlen * ab->abg->node_n;
+        abpoa_align_sequence_to_subgraph(ab, abpt, exc_beg, exc_end, read_seqs[i]+seq_beg_cut, qlen, &res);
         // abpoa_add_subgraph_alignment(ab, abpt, exc_begs[i], exc_ends[i], read_seqs[i]+seq_beg_cuts[i], NULL, read_lens[i]-seq_beg_cuts[i]-seq_end_cuts[i], NULL, res, i, n_reads, 1);
-        abpoa_add_subgraph_alignment(ab, abpt, exc_beg, exc_end, read_seqs[i]+seq_beg_cut, NULL, read_lens[i]-seq_beg_cut-seq_end_cut, NULL, res, i, n_reads, 0);
+        abpoa_add_subgraph_alignment(ab, abpt, exc_beg, exc_end, read_seqs[i]+seq_beg_cut, weights, qlen, NULL, res, u, n_reads, 0);
         if (res.n_cigar) free(res.graph_cigar);
     }
     if (LONGCALLD_VERBOSE >= 2) abpoa_output(ab, abpt, stderr);
@@ -823,13 +950,21 @@ int abpoa_partial_aln_msa_cons(const call_var_opt_t *opt, abpoa_t *ab, int sampl
             }
             if (clu_n_seqs != NULL && clu_read_ids != NULL) {
                 if (abc->n_cons > 1) {
+                    int *uniq_clu = (int*)malloc(n_uniq * sizeof(int));
                     for (int i = 0; i < abc->n_cons; ++i) {
-                        clu_n_seqs[i] = abc->clu_n_seq[i];
-                        clu_read_ids[i] = (int*)malloc(abc->clu_n_seq[i] * sizeof(int));
+                        for (int u = 0; u < n_uniq; ++u) uniq_clu[u] = 0;
+                        clu_n_seqs[i] = 0;
                         for (int j = 0; j < abc->clu_n_seq[i]; ++j) {
-                            clu_read_ids[i][j] = read_ids[abc->clu_read_ids[i][j]];
+                            int u = abc->clu_read_ids[i][j];
+                            if (u >= n_uniq) continue; // unused read ID, not in the graph
+                            uniq_clu[u] = 1; clu_n_seqs[i] += uniq_w[u];
+                        }
+                        clu_read_ids[i] = (int*)malloc(clu_n_seqs[i] * sizeof(int));
+                        for (int j = 0, k = 0; j < n_reads; ++j) {
+                            if (uniq_clu[uniq_i[j]]) clu_read_ids[i][k++] = read_ids[j];
                         }
                     }
+                    free(uniq_clu);
                 } else {
                     *clu_n_seqs = n_reads;
                     *clu_read_ids = (int*)malloc(n_reads * sizeof(int));
@@ -842,17 +977,19 @@ int abpoa_partial_aln_msa_cons(const call_var_opt_t *opt, abpoa_t *ab, int sampl
         }
     }
 
-    // msa bases, include consensus sequences
+    // msa bases, include consensus sequences: one row for each read, then one row for each consensus (after n_seq rows)
     if (msa_seq_lens != NULL && msa_seqs != NULL) {
         *msa_seq_lens = abc->msa_len;
-        for (int i = 0; i < abc->n_seq+n_cons; ++i) {
+        for (int i = 0; i < n_reads+n_cons; ++i) {
+            int row = i < n_reads ? uniq_i[i] : i;
             msa_seqs[i] = (uint8_t*)malloc(abc->msa_len * sizeof(uint8_t));
             for (int j = 0; j < abc->msa_len; ++j) {
-                msa_seqs[i][j] = abc->msa_base[i][j];
+                msa_seqs[i][j] = abc->msa_base[row][j];
             }
         }
     }
-    abpoa_free_para(abpt); if (needs_free_ab) abpoa_free(ab);
+    free(uniq_i); free(uniq_reads); free(uniq_w); free(weights);
+    abpoa_pool_put(poa_pool, prof);
     return n_cons;
  }
 
@@ -869,29 +1006,18 @@ int abpoa_partial_aln_msa_cons(const call_var_opt_t *opt, abpoa_t *ab, int sampl
 //  }
 
   // XXX limit abpoa memory usage, avoid memory allocation failure
- int abpoa_aln_msa_cons(const call_var_opt_t *opt, int n_reads, int *read_ids, uint8_t **read_seqs, int *read_lens, int max_n_cons,
+ int abpoa_aln_msa_cons(const call_var_opt_t *opt, abpoa_pool_t *poa_pool, int n_reads, int *read_ids, uint8_t **read_seqs, int *read_lens, int max_n_cons,
                         int *cons_lens, uint8_t **cons_seqs,
-                        int *clu_n_seqs, int **clu_read_ids, int *msa_seq_len, uint8_t ***msa_seq) {
-    abpoa_t *ab = abpoa_init();
-    abpoa_para_t *abpt = abpoa_init_para();
-    // if (opt->out_somatic) abpt->wf = 0.01; // XXX for more accurate somatic variant calling
-    // else abpt->wf = 0.001; // limit memory usage for long sequences
-    abpt->wb = -1;
-    abpt->inc_path_score = 1;
-    abpt->out_msa = 0; abpt->out_cons = 1;
-    if (msa_seq != NULL && msa_seq_len != NULL) abpt->out_msa = 1; else abpt->out_msa = 0;
-    if (LONGCALLD_VERBOSE >= 2) abpt->out_msa = 1;
-    abpt->cons_algrm = ABPOA_MF;
-    abpt->max_n_cons = max_n_cons; abpt->min_freq = opt->min_af;
-    abpt->match = opt->match; abpt->mismatch = opt->mismatch;
-    abpt->gap_open1 = opt->gap_open1; abpt->gap_ext1 = opt->gap_ext1;
-    abpt->gap_open2 = opt->gap_open2; abpt->gap_ext2 = opt->gap_ext2;
-    abpoa_post_set_para(abpt);
+                        int *clu_n_seqs, int **clu_read_ids, int *msa_seq_len, uint8_t ***msa_seq, noisy_aln_prof_t *prof) {
+    int out_msa = (msa_seq != NULL && msa_seq_len != NULL) || LONGCALLD_VERBOSE >= 2;
+    abpoa_para_t *abpt = abpoa_pool_get_para(opt, poa_pool, 0, out_msa, max_n_cons);
+    abpoa_t *ab = poa_pool->ab; // reset by abpoa_msa()
 
     if (LONGCALLD_VERBOSE >= 2) {
         fprintf(stderr, "For abPOA (max %d cons, min_freq: %.2f): %d\n", max_n_cons, abpt->min_freq, n_reads);
         abpoa_msa(ab, abpt, n_reads, NULL, read_lens, read_seqs, NULL, stderr);
     } else abpoa_msa(ab, abpt, n_reads, NULL, read_lens, read_seqs, NULL, NULL);
+    for (int i = 0; i < n_reads; ++i) prof->poa_cells += (int64_t)read_lens[i] * ab->abg->node_n; // final graph size
     abpoa_cons_t *abc = ab->abc;
     
     int n_cons = 0;
@@ -938,7 +1064,7 @@ int abpoa_partial_aln_msa_cons(const call_var_opt_t *opt, abpoa_t *ab, int sampl
                 msa_seq[i][abc->clu_n_seq[i]][j] = abc->msa_base[abc->n_seq+i][j];
         }
     }
-    abpoa_free_para(abpt); abpoa_free(ab); 
+    abpoa_pool_put(poa_pool, prof);
     return n_cons;
 }
 
@@ -1053,7 +1179,7 @@ int make_cons_read_aln_str(const call_var_opt_t *opt, uint8_t *cons_str, uint8_t
     return aln_len;
 }
 
-int make_ref_read_aln_str(const call_var_opt_t *opt, aln_str_t *ref_cons_aln_str, aln_str_t *cons_read_aln_str, aln_str_t *ref_read_aln_str) {
+int make_ref_read_aln_str(const call_var_opt_t *opt, wfa_pool_t *pool, aln_str_t *ref_cons_aln_str, aln_str_t *cons_read_aln_str, aln_str_t *ref_read_aln_str) {
     int aln_len = 0;
     int max_msa_len = ref_cons_aln_str->aln_len + cons_read_aln_str->aln_len;
     ref_read_aln_str->aln_len = 0;
@@ -1078,9 +1204,9 @@ int make_ref_read_aln_str(const call_var_opt_t *opt, aln_str_t *ref_cons_aln_str
                     fprintf(stderr, "%c", "ACGTN-"[cons_read_aln_str->query_aln[k]]);
                 } fprintf(stderr, "\n");
             }
-            wfa_end2end_aln(ref_cons_aln_str->target_aln+i, ref_del_len, cons_read_aln_str->query_aln+j, read_del_len, 
-                            opt->gap_aln, opt->mismatch, opt->gap_open1, opt->gap_ext1, opt->gap_open2, opt->gap_ext2, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, // no heuristic, affine-2p
-                            NULL, NULL, &ref_aln, &read_aln, &del_aln_len);
+            wfa_end2end_aln(pool, ref_cons_aln_str->target_aln+i, ref_del_len, cons_read_aln_str->query_aln+j, read_del_len, 
+                            opt->gap_aln, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, // no heuristic, affine-2p
+                            NULL, NULL, &ref_aln, &read_aln, &del_aln_len, NULL);
             for (int k = 0; k < del_aln_len; ++k) {
                 ref_read_aln_str->target_aln[aln_len] = ref_aln[k];
                 ref_read_aln_str->query_aln[aln_len] = read_aln[k];
@@ -1145,8 +1271,26 @@ int make_ref_read_aln_str(const call_var_opt_t *opt, aln_str_t *ref_cons_aln_str
     return aln_len;
 }
 
-int wfa_collect_noisy_aln_str_no_ps_hap(const call_var_opt_t *opt, int n_reads, int *read_ids, int *lens, uint8_t **seqs, char **qnames, int *fully_covers,
-                                        uint8_t *ref_seq, int ref_seq_len, int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs, int collect_ref_read_aln_str) {
+// --noisy-max-mem/cells of a whole-region POA, re-checked here as align_noisy_reg1() assumes anchor-split windows for long regions
+// return the number of reads to keep (the first ones in the sorted order), 0: over budget, prof->skipped is set
+static int whole_reg_poa_budget(const call_var_opt_t *opt, int ref_seq_len, int n_reads, noisy_aln_prof_t *prof) {
+    int64_t len = ref_seq_len;
+    if (opt->noisy_max_bytes > 0 && (len+1) * (len+1) * LONGCALLD_POA_CELL_BYTES > opt->noisy_max_bytes) {
+        prof->skipped = "skipped-mem"; return 0;
+    }
+    if (opt->noisy_max_cells > 0 && n_reads * len * len > opt->noisy_max_cells) {
+        int n_keep = (int)(opt->noisy_max_cells / (len * len));
+        if (n_keep < LONGCALLD_NOISY_MIN_SUBSAMPLE_READS) {
+            prof->skipped = "skipped-cells"; return 0;
+        }
+        prof->fallbacks |= LONGCALLD_NOISY_FB_SUBSAMPLE;
+        return n_keep;
+    }
+    return n_reads;
+}
+
+int wfa_collect_noisy_aln_str_no_ps_hap(const call_var_opt_t *opt, wfa_pool_t *pool, abpoa_pool_t *poa_pool, int n_reads, int *read_ids, int *lens, uint8_t **seqs, char **qnames, int *fully_covers,
+                                        uint8_t *ref_seq, int ref_seq_len, int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs, int collect_ref_read_aln_str, noisy_aln_prof_t *prof) {
     int *full_read_ids = (int*)malloc((n_reads+2) * sizeof(int));
     int *full_read_lens = (int*)malloc((n_reads+2) * sizeof(int));
     uint8_t **full_read_seqs = (uint8_t**)malloc((n_reads+2) * sizeof(uint8_t*));
@@ -1174,16 +1318,23 @@ int wfa_collect_noisy_aln_str_no_ps_hap(const call_var_opt_t *opt, int n_reads,
     int n_cons = 0;
     if (n_full_reads == 0) goto collect_noisy_msa_cons_no_ps_hap_end;
     else {
+        if (ref_seq_len > opt->max_noisy_reg_len) { // never anchor-split
+            prof->skipped = "skipped-long";
+            goto collect_noisy_msa_cons_no_ps_hap_end;
+        }
         if (full_read_lens[0] >= opt->max_noisy_reg_len) goto collect_noisy_msa_cons_no_ps_hap_end;
+        if ((n_full_reads = whole_reg_poa_budget(opt, ref_seq_len, n_full_reads, prof)) == 0) goto collect_noisy_msa_cons_no_ps_hap_end;
     }
 
-    n_cons = abpoa_aln_msa_cons(opt, n_full_reads, full_read_ids, full_read_seqs, full_read_lens, 2,
-                                cons_lens, cons_seqs, clu_n_seqs, clu_read_ids, msa_seq_lens, msa_seqs);
+    double t = realtime();
+    n_cons = abpoa_aln_msa_cons(opt, poa_pool, n_full_reads, full_read_ids, full_read_seqs, full_read_lens, 2,
+                                cons_lens, cons_seqs, clu_n_seqs, clu_read_ids, msa_seq_lens, msa_seqs, prof);
+    prof->poa_time += realtime() - t; t = realtime();
 
     // re-do POA with ref_seq and cons
     for (int i = 0; i < n_cons; ++i) {
         aln_str_t *clu_aln_str = aln_strs[i];
-        wfa_collect_aln_str(opt, ref_seq, ref_seq_len, cons_seqs[i], cons_lens[i], LONGCALLD_NOISY_BOTH_COVER, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str));
+        wfa_collect_aln_str(opt, pool, ref_seq, ref_seq_len, cons_seqs[i], cons_lens[i], LONGCALLD_NOISY_BOTH_COVER, ref_cons_wfa_heuristic(prof), LONGCALLD_WFA_AFFINE_2P, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str), &prof->wfa_peak_bytes);
         n_full_reads = 0;
         for (int j = 0; j < clu_n_seqs[i]; ++j) {
             int read_i = clu_read_ids[i][j];
@@ -1193,10 +1344,11 @@ int wfa_collect_noisy_aln_str_no_ps_hap(const call_var_opt_t *opt, int n_reads,
             // wfa_collect_aln_str(opt, cons_seqs[i], cons_lens[i], seqs[read_i], lens[read_i], fully_covers[read_i], LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, LONGCALLD_CONS_READ_ALN_STR(clu_aln_str, n_full_reads));
             make_cons_read_aln_str(opt, msa_seqs[i][clu_n_seqs[i]], msa_seqs[i][j], msa_seq_lens[i], fully_covers[i], LONGCALLD_CONS_READ_ALN_STR(clu_aln_str, n_full_reads));
             if (collect_ref_read_aln_str)
-                make_ref_read_aln_str(opt, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str), LONGCALLD_CONS_READ_ALN_STR(clu_aln_str, n_full_reads), LONGCALLD_REF_READ_ALN_STR(clu_aln_str, n_full_reads));
+                make_ref_read_aln_str(opt, pool, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str), LONGCALLD_CONS_READ_ALN_STR(clu_aln_str, n_full_reads), LONGCALLD_REF_READ_ALN_STR(clu_aln_str, n_full_reads));
             n_full_reads++;
         }
-    } 
+    }
+    prof->wfa_time += realtime() - t;
 collect_noisy_msa_cons_no_ps_hap_end:
     free(full_read_lens); free(full_read_seqs); free(full_read_names); free(full_fully_covers); free(full_read_ids);
     for (int i = 0; i < 2; ++i) {
@@ -1278,14 +1430,175 @@ hts_pos_t collect_phase_set_with_both_haps(int n_reads, int *read_haps, int *rea
     return max_ps;
 }
 
+// anchor-split POA for long noisy regions:
+//   anchors: k-mers unique in the reference region and found exactly once, in the same order, in most of the reads
+//   at most one anchor is picked in the first LONGCALLD_ANCHOR_ZONE_LEN bp of every LONGCALLD_ANCHOR_WIN_LEN bp,
+//   so each window between two anchors is aligned independently and memory is linear in the region length
+typedef struct {
+    int n_anchors; // n_anchors+1 windows
+    int *ref_begs, *cons_begs; // size: n_anchors+2, window i: [begs[i], begs[i+1])
+} noisy_anchor_wins_t;
+
+// return number of anchors; read_pos: size n_anchors x n_reads; kept[i]: 0 if read_i misses any anchor
+static int collect_noisy_reg_anchors(uint8_t *ref_seq, int ref_seq_len, int n_reads, uint8_t **read_seqs, int *read_lens, int min_reads,
+                                     int *anchor_ref_pos, int *anchor_read_pos, uint8_t *kept) {
+    int k = LONGCALLD_ANCHOR_KMER_LEN, win = LONGCALLD_ANCHOR_WIN_LEN; uint64_t mask = (1ULL << (2*k)) - 1;
+    // reference k-mers, sorted by k-mer then position
+    pair64_t *ref_kmers = (pair64_t*)malloc(ref_seq_len * sizeof(pair64_t)); int n_ref_kmers = 0;
+    uint64_t kmer = 0;
+    for (int i = 0, l = 0; i < ref_seq_len; ++i) {
+        if (ref_seq[i] < 4) {
+            kmer = (kmer << 2 | ref_seq[i]) & mask;
+            if (++l >= k) { ref_kmers[n_ref_kmers].x = kmer; ref_kmers[n_ref_kmers++].y = i-k+1; }
+        } else l = 0;
+    }
+    ks_introsort_128(n_ref_kmers, ref_kmers);
+    // candidates: unique k-mers in anchor zones, sorted by k-mer
+    pair64_t *cands = (pair64_t*)malloc((n_ref_kmers+1) * sizeof(pair64_t)); int n_cands = 0;
+    for (int i = 0; i < n_ref_kmers; ++i) {
+        if ((i > 0 && ref_kmers[i].x == ref_kmers[i-1].x) || (i < n_ref_kmers-1 && ref_kmers[i].x == ref_kmers[i+1].x)) continue;
+        int pos = (int)ref_kmers[i].y;
+        if (pos < win || pos % win >= LONGCALLD_ANCHOR_ZONE_LEN || pos + win/2 > ref_seq_len) continue;
+        cands[n_cands++] = ref_kmers[i];
+    }
+    free(ref_kmers);
+    int n_anchors = 0;
+    if (n_cands == 0) { free(cands); return 0; }
+    // position of each candidate in each read, -1: not found, -2: not unique
+    int *cand_read_pos = (int*)malloc((size_t)n_cands * n_reads * sizeof(int));
+    for (size_t i = 0; i < (size_t)n_cands * n_reads; ++i) cand_read_pos[i] = -1;
+    for (int r = 0; r < n_reads; ++r) {
+        kmer = 0;
+        for (int i = 0, l = 0; i < read_lens[r]; ++i) {
+            if (read_seqs[r][i] >= 4) { l = 0; continue; }
+            kmer = (kmer << 2 | read_seqs[r][i]) & mask;
+            if (++l < k) continue;
+            int lo = 0, hi = n_cands-1;
+            while (lo <= hi) {
+                int mid = (lo + hi) / 2;
+                if (cands[mid].x < kmer) lo = mid + 1;
+                else if (cands[mid].x > kmer) hi = mid - 1;
+                else {
+                    int *p = cand_read_pos + (size_t)mid * n_reads + r;
+                    *p = (*p == -1) ? i-k+1 : -2;
+                    break;
+                }
+            }
+        }
+    }
+    // pick anchors in reference order, reads have to be collinear with the previous anchor
+    int *order = (int*)malloc(n_cands * sizeof(int)), *last_read_pos = (int*)calloc(n_reads, sizeof(int));
+    pair64_t *ref_order = (pair64_t*)malloc(n_cands * sizeof(pair64_t));
+    for (int i = 0; i < n_cands; ++i) { ref_order[i].x = cands[i].y; ref_order[i].y = i; }
+    ks_introsort_128(n_cands, ref_order);
+    for (int i = 0; i < n_cands; ++i) order[i] = (int)ref_order[i].y;
+    free(ref_order);
+    for (int r = 0; r < n_reads; ++r) kept[r] = 1;
+    int last_zone = 0, min_n = MAX_OF_TWO(min_reads, (int)(n_reads * LONGCALLD_ANCHOR_MIN_READ_FRAC + 0.5));
+    for (int i = 0; i < n_cands; ++i) {
+        int c = order[i], ref_pos = (int)cands[c].y;
+        if (ref_pos / win == last_zone) continue;
+        int *pos = cand_read_pos + (size_t)c * n_reads, n_ok = 0;
+        for (int r = 0; r < n_reads; ++r) {
+            if (kept[r] && pos[r] >= last_read_pos[r] + (n_anchors == 0 ? 1 : k)) n_ok++;
+        }
+        if (n_ok < min_n) continue;
+        for (int r = 0; r < n_reads; ++r) {
+            if (kept[r] && pos[r] >= last_read_pos[r] + (n_anchors == 0 ? 1 : k)) {
+                anchor_read_pos[n_anchors * n_reads + r] = last_read_pos[r] = pos[r];
+            } else kept[r] = 0;
+        }
+        anchor_ref_pos[n_anchors++] = ref_pos; last_zone = ref_pos / win;
+    }
+    free(order); free(last_read_pos); free(cand_read_pos); free(cands);
+    return n_anchors;
+}
+
+// POA for each anchor-delimited window of the kept reads, consensus & MSA rows of all windows are concatenated
+// return 1 if all windows have one consensus, 0 otherwise (nothing is output)
+static int anchor_split_partial_aln_msa_cons(const call_var_opt_t *opt, wfa_pool_t *pool, abpoa_pool_t *poa_pool, int n_reads, int *read_ids, uint8_t **read_seqs, uint8_t **read_quals, int *read_lens, char **names,
+                                             int n_anchors, int *anchor_ref_pos, int *anchor_read_pos, uint8_t *kept, int ref_seq_len,
+                                             int *cons_len, uint8_t **cons_seq, int *clu_n_seqs, int **clu_read_ids, int *msa_seq_len, uint8_t **msa_seqs, noisy_anchor_wins_t *wins, noisy_aln_prof_t *prof) {
+    int n_kept = 0;
+    int *win_ids = (int*)malloc(n_reads * sizeof(int)), *win_lens = (int*)malloc(n_reads * sizeof(int)), *win_covers = (int*)malloc(n_reads * sizeof(int));
+    uint8_t **win_seqs = (uint8_t**)malloc(n_reads * sizeof(uint8_t*)), **win_quals = (uint8_t**)malloc(n_reads * sizeof(uint8_t*));
+    char **win_names = (char**)malloc(n_reads * sizeof(char*));
+    uint8_t **win_msa = (uint8_t**)calloc(n_reads+1, sizeof(uint8_t*));
+    for (int r = 0; r < n_reads; ++r) if (kept[r]) win_ids[n_kept++] = r;
+    int ret = 1, _cons_len = 0, _msa_len = 0; uint8_t *_cons_seq = NULL;
+    wins->n_anchors = n_anchors;
+    wins->ref_begs = (int*)malloc((n_anchors+2) * sizeof(int)); wins->cons_begs = (int*)malloc((n_anchors+2) * sizeof(int));
+    for (int w = 0; w <= n_anchors; ++w) {
+        wins->ref_begs[w] = w == 0 ? 0 : anchor_ref_pos[w-1]; wins->cons_begs[w] = _cons_len;
+        for (int j = 0; j < n_kept; ++j) {
+            int r = win_ids[j];
+            int beg = w == 0 ? 0 : anchor_read_pos[(w-1) * n_reads + r], end = w == n_anchors ? read_lens[r] : anchor_read_pos[w * n_reads + r];
+            win_seqs[j] = read_seqs[r] + beg; win_lens[j] = end - beg;
+            win_quals[j] = read_quals[r] == NULL ? NULL : read_quals[r] + beg;
+            win_covers[j] = LONGCALLD_NOISY_BOTH_COVER; win_names[j] = names[r];
+        }
+        int w_cons_len = 0, w_msa_len = 0, w_clu_n_seqs = 0, *w_clu_read_ids = NULL; uint8_t *w_cons_seq = NULL;
+        int w_n_cons = abpoa_partial_aln_msa_cons(opt, pool, poa_pool, 0, n_kept, win_ids, win_seqs, win_quals, win_lens, win_covers, win_names,
+                                                  1, &w_cons_len, &w_cons_seq, &w_clu_n_seqs, &w_clu_read_ids, &w_msa_len, win_msa, prof);
+        if (w_n_cons == 1) {
+            _cons_seq = (uint8_t*)realloc(_cons_seq, (_cons_len + w_cons_len) * sizeof(uint8_t));
+            memcpy(_cons_seq + _cons_len, w_cons_seq, w_cons_len); _cons_len += w_cons_len;
+            for (int j = 0; j <= n_kept; ++j) {
+                msa_seqs[j] = (uint8_t*)realloc(msa_seqs[j], (_msa_len + w_msa_len) * sizeof(uint8_t));
+                memcpy(msa_seqs[j] + _msa_len, win_msa[j], w_msa_len);
+            }
+            _msa_len += w_msa_len;
+        } else ret = 0;
+        if (w_cons_seq != NULL) free(w_cons_seq);
+        if (w_clu_read_ids != NULL) free(w_clu_read_ids);
+        for (int j = 0; j <= n_kept; ++j) { if (win_msa[j] != NULL) free(win_msa[j]); win_msa[j] = NULL; }
+        if (ret == 0) break;
+    }
+    wins->ref_begs[n_anchors+1] = ref_seq_len; wins->cons_begs[n_anchors+1] = _cons_len;
+    if (ret) {
+        *cons_len = _cons_len; *cons_seq = _cons_seq; *msa_seq_len = _msa_len;
+        *clu_n_seqs = n_kept; *clu_read_ids = (int*)malloc(n_kept * sizeof(int));
+        for (int j = 0; j < n_kept; ++j) (*clu_read_ids)[j] = read_ids[win_ids[j]];
+    } else {
+        if (_cons_seq != NULL) free(_cons_seq);
+        for (int j = 0; j <= n_kept; ++j) { if (msa_seqs[j] != NULL) free(msa_seqs[j]); msa_seqs[j] = NULL; }
+    }
+    free(win_ids); free(win_lens); free(win_covers); free(win_seqs); free(win_quals); free(win_names); free(win_msa);
+    return ret;
+}
+
+// ref vs cons, aligned window by window
+static void anchor_split_ref_cons_aln_str(const call_var_opt_t *opt, wfa_pool_t *pool, uint8_t *ref_seq, int ref_seq_len, uint8_t *cons_seq, int cons_len,
+                                          noisy_anchor_wins_t *wins, aln_str_t *aln_str, uint64_t *peak_bytes) {
+    int max_len = ref_seq_len + cons_len + 1, aln_len = 0;
+    aln_str->target_aln = (uint8_t*)malloc(max_len * 2 * sizeof(uint8_t));
+    aln_str->query_aln = aln_str->target_aln + max_len;
+    for (int w = 0; w <= wins->n_anchors; ++w) {
+        int rb = wins->ref_begs[w], rl = wins->ref_begs[w+1] - rb, cb = wins->cons_begs[w], cl = wins->cons_begs[w+1] - cb;
+        if (cl == 0) {
+            for (int i = 0; i < rl; ++i) { aln_str->target_aln[aln_len] = ref_seq[rb+i]; aln_str->query_aln[aln_len++] = 5; }
+            continue;
+        }
+        aln_str_t w_aln_str;
+        wfa_collect_aln_str(opt, pool, ref_seq+rb, rl, cons_seq+cb, cl, LONGCALLD_NOISY_BOTH_COVER, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, &w_aln_str, peak_bytes);
+        memcpy(aln_str->target_aln + aln_len, w_aln_str.target_aln, w_aln_str.aln_len);
+        memcpy(aln_str->query_aln + aln_len, w_aln_str.query_aln, w_aln_str.aln_len);
+        aln_len += w_aln_str.aln_len;
+        free(w_aln_str.target_aln);
+    }
+    aln_str->aln_len = aln_len;
+    aln_str->target_beg = 0; aln_str->target_end = aln_len-1;
+    aln_str->query_beg = 0; aln_str->query_end = aln_len-1;
+}
+
 // pairwise alignment of cons and ref to append ref to the MSA
 // total: 1+ n_reads*2
 // 1. ref vs cons: 1
 // 2. cons vs n_reads: n_reads
 // 3. ref vs n_reads: n_reads
-int wfa_collect_noisy_aln_str_with_ps_hap(const call_var_opt_t *opt, int sampling_reads, int n_reads, int *noisy_read_ids, int *lens, uint8_t **seqs, uint8_t *strands, uint8_t **quals, char **names,
+int wfa_collect_noisy_aln_str_with_ps_hap(const call_var_opt_t *opt, wfa_pool_t *pool, abpoa_pool_t *poa_pool, int sampling_reads, int n_reads, int *noisy_read_ids, int *lens, uint8_t **seqs, uint8_t *strands, uint8_t **quals, char **names,
                                           int *haps, hts_pos_t *phase_sets, int *fully_covers, hts_pos_t ps, int min_hap_full_reads, int min_hap_all_reads, uint8_t *ref_seq, int ref_seq_len,
-                                          int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs, int collect_ref_read_aln_str) {
+                                          int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs, int collect_ref_read_aln_str, noisy_aln_prof_t *prof) {
     // given specific phase_set, collect consensus sequences for each haplotype
     // optional: for long noisy regions, skip read with large edit distance to first read
     int n_cons = 0;
@@ -1310,12 +1623,19 @@ int wfa_collect_noisy_aln_str_with_ps_hap(const call_var_opt_t *opt, int samplin
     if (is_homopolymer(ref_seq, ref_seq_len, opt->noisy_reg_flank_len, &hp_flank_start, &hp_flank_end, &hp_len)) {
         use_non_full = 0;
     }
+    // anchor-split POA: only full-cover reads, each read has to contain all the anchors
+    int anchor_split = opt->anchor_split_len > 0 && ref_seq_len >= opt->anchor_split_len;
+    noisy_anchor_wins_t anchor_wins[2]; memset(anchor_wins, 0, 2 * sizeof(noisy_anchor_wins_t));
+    uint8_t *read_poa_hap = (uint8_t*)calloc(n_reads, sizeof(uint8_t)); // reads used in the POA of each haplotype
     for (int hap=1; hap<=2; ++hap) {
+        int hap_use_non_full = anchor_split ? 0 : use_non_full;
+collect_ps_hap_reads:
         // check if we have enough full-cover reads
         n_ps_hap_reads = 0;
         for (int i = 0; i < n_reads; ++i) {
             if (lens[i] <= 0 || phase_sets[i] != ps || haps[i] != hap) continue;
-            if (use_non_full == 0 && LONGCALLD_NOISY_IS_BOTH_COVER(fully_covers[i]) == 0) continue;
+            if (hap_use_non_full == 0 && LONGCALLD_NOISY_IS_BOTH_COVER(fully_covers[i]) == 0) continue;
+            read_poa_hap[i] = hap;
             ps_hap_read_ids[n_ps_hap_reads] = noisy_read_ids[i];
             ps_hap_read_lens[n_ps_hap_reads] = lens[i];
             ps_hap_read_seqs[n_ps_hap_reads] = seqs[i];
@@ -1325,28 +1645,75 @@ int wfa_collect_noisy_aln_str_with_ps_hap(const call_var_opt_t *opt, int samplin
             ps_hap_read_names[n_ps_hap_reads] = names[i];
             n_ps_hap_reads++;
         }
+        if (anchor_split && hap_use_non_full == 0 && n_ps_hap_reads > 0) {
+            int *anchor_ref_pos = (int*)malloc((ref_seq_len / LONGCALLD_ANCHOR_WIN_LEN + 1) * sizeof(int));
+            int *anchor_read_pos = (int*)malloc((size_t)(ref_seq_len / LONGCALLD_ANCHOR_WIN_LEN + 1) * n_ps_hap_reads * sizeof(int));
+            uint8_t *kept = (uint8_t*)malloc(n_ps_hap_reads * sizeof(uint8_t));
+            double t = realtime();
+            int n_anchors = collect_noisy_reg_anchors(ref_seq, ref_seq_len, n_ps_hap_reads, ps_hap_read_seqs, ps_hap_read_lens, min_hap_full_reads, anchor_ref_pos, anchor_read_pos, kept);
+            int ret = 0;
+            if (n_anchors > 0) {
+                ret = anchor_split_partial_aln_msa_cons(opt, pool, poa_pool, n_ps_hap_reads, ps_hap_read_ids, ps_hap_read_seqs, ps_hap_read_quals, ps_hap_read_lens, ps_hap_read_names,
+                                                        n_anchors, anchor_ref_pos, anchor_read_pos, kept, ref_seq_len, cons_lens+hap-1, cons_seqs+hap-1, clu_n_seqs+hap-1, clu_read_ids+hap-1,
+                                                        msa_seq_lens+hap-1, msa_seqs[hap-1], anchor_wins+hap-1, prof);
+                if (ret == 0) { free(anchor_wins[hap-1].ref_begs); free(anchor_wins[hap-1].cons_begs); anchor_wins[hap-1].n_anchors = 0; }
+            }
+            prof->poa_time += realtime() - t;
+            if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "AnchorSplit PS: %" PRIi64 " HAP: %d n_reads: %d n_anchors: %d ret: %d\n", ps, hap, n_ps_hap_reads, n_anchors, ret);
+            if (ret) {
+                n_cons++;
+                for (int i = 0, j = 0; i < n_reads; ++i) {
+                    if (read_poa_hap[i] != hap) continue;
+                    if (kept[j++] == 0) read_poa_hap[i] = 0;
+                }
+            }
+            free(anchor_ref_pos); free(anchor_read_pos); free(kept);
+            if (ret) continue;
+            // whole-region POA, the same as without anchor-split
+            if (ref_seq_len > opt->max_noisy_reg_len) {
+                prof->skipped = "skipped-long";
+                break;
+            }
+            if (use_non_full) {
+                hap_use_non_full = 1;
+                goto collect_ps_hap_reads;
+            }
+        }
         if (ps_hap_read_lens[0] >= opt->max_noisy_reg_len) {
             if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "SkipRegion: %" PRIi64 " %d %d %d\n", ps, hap, n_ps_hap_reads, ps_hap_read_lens[0]);
             break;
         }
         if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "PS: %" PRIi64 " HAP: %d n_reads: %d\n", ps, hap, n_ps_hap_reads);
         if (n_ps_hap_reads == 0) continue;
+        int n_keep = whole_reg_poa_budget(opt, ref_seq_len, n_ps_hap_reads, prof);
+        if (n_keep == 0) break;
+        if (n_keep < n_ps_hap_reads) { // reads after n_keep are not in the POA of this haplotype
+            for (int i = 0, j = 0; i < n_reads; ++i) {
+                if (read_poa_hap[i] != hap) continue;
+                if (j++ >= n_keep) read_poa_hap[i] = 0;
+            }
+            n_ps_hap_reads = n_keep;
+        }
         // collect consensus sequences
-        n_cons += abpoa_partial_aln_msa_cons(opt, NULL, sampling_reads, n_ps_hap_reads, ps_hap_read_ids, ps_hap_read_seqs, ps_hap_read_quals, ps_hap_read_lens, ps_hap_full_covers, ps_hap_read_names,
-                                             1, cons_lens+hap-1, cons_seqs+hap-1, clu_n_seqs+hap-1, clu_read_ids+hap-1, msa_seq_lens+hap-1, msa_seqs[hap-1]);
+        double t = realtime();
+        n_cons += abpoa_partial_aln_msa_cons(opt, pool, poa_pool, sampling_reads, n_ps_hap_reads, ps_hap_read_ids, ps_hap_read_seqs, ps_hap_read_quals, ps_hap_read_lens, ps_hap_full_covers, ps_hap_read_names,
+                                             1, cons_lens+hap-1, cons_seqs+hap-1, clu_n_seqs+hap-1, clu_read_ids+hap-1, msa_seq_lens+hap-1, msa_seqs[hap-1], prof);
+        prof->poa_time += realtime() - t;
     }
 
     if (n_cons != 2) n_cons = 0;
     else { // collect aln_strs
+        double t = realtime();
         for (int hap=1; hap<=2; ++hap) {
             // ref vs cons
             aln_str_t *clu_aln_str = aln_strs[hap-1];
             // fprintf(stderr, "WFA cons-ref align for HAP: %d %d vs %d\n", hap, ref_seq_len, cons_lens[hap-1]);
-            wfa_collect_aln_str(opt, ref_seq, ref_seq_len, cons_seqs[hap-1], cons_lens[hap-1], LONGCALLD_NOISY_BOTH_COVER, LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str));
+            if (anchor_wins[hap-1].n_anchors > 0)
+                anchor_split_ref_cons_aln_str(opt, pool, ref_seq, ref_seq_len, cons_seqs[hap-1], cons_lens[hap-1], anchor_wins+hap-1, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str), &prof->wfa_peak_bytes);
+            else wfa_collect_aln_str(opt, pool, ref_seq, ref_seq_len, cons_seqs[hap-1], cons_lens[hap-1], LONGCALLD_NOISY_BOTH_COVER, ref_cons_wfa_heuristic(prof), LONGCALLD_WFA_AFFINE_2P, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str), &prof->wfa_peak_bytes);
             n_ps_hap_reads = 0;
             for (int i = 0; i < n_reads; ++i) {
-                if (lens[i] <= 0 || phase_sets[i] != ps || haps[i] != hap) continue;
-                if (use_non_full == 0 && LONGCALLD_NOISY_IS_BOTH_COVER(fully_covers[i]) == 0) continue;
+                if (read_poa_hap[i] != hap) continue;
                 // cons vs read XXX make?
                 // heuristic = 1; affine_2p = 0; // 
                 // wfa_collect_aln_str(opt, cons_seqs[hap-1], cons_lens[hap-1], seqs[i], lens[i], fully_covers[i], LONGCALLD_WFA_NO_HEURISTIC, LONGCALLD_WFA_AFFINE_2P, LONGCALLD_CONS_READ_ALN_STR(clu_aln_str, n_ps_hap_reads));
@@ -1354,14 +1721,18 @@ int wfa_collect_noisy_aln_str_with_ps_hap(const call_var_opt_t *opt, int samplin
                 // ref vs read
                 if (collect_ref_read_aln_str)
                     // fprintf(stderr, "Make ref-read aln str for HAP: %d read_id: %d, %d vs %d (%d)\n", hap, noisy_read_ids[i], lens[i], ref_seq_len, fully_covers[i]);
-                    make_ref_read_aln_str(opt, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str), LONGCALLD_CONS_READ_ALN_STR(clu_aln_str, n_ps_hap_reads), LONGCALLD_REF_READ_ALN_STR(clu_aln_str, n_ps_hap_reads));
+                    make_ref_read_aln_str(opt, pool, LONGCALLD_REF_CONS_ALN_STR(clu_aln_str), LONGCALLD_CONS_READ_ALN_STR(clu_aln_str, n_ps_hap_reads), LONGCALLD_REF_READ_ALN_STR(clu_aln_str, n_ps_hap_reads));
                 n_ps_hap_reads++;
             }
             if (LONGCALLD_VERBOSE >=2 ) fprintf(stderr, "With Ref+Cons PS: %" PRIi64 " HAP: %d n_reads: %d\n", ps, hap, n_ps_hap_reads);
             if (n_ps_hap_reads == 0) continue;
         }
+        prof->wfa_time += realtime() - t;
     }
     free(ps_hap_read_ids); free(ps_hap_read_lens); free(ps_hap_read_seqs); free(ps_hap_read_strands); free(ps_hap_read_quals); free(ps_hap_full_covers); free(ps_hap_read_names);
+    for (int i = 0; i < 2; ++i) {
+        if (anchor_wins[i].n_anchors > 0) { free(anchor_wins[i].ref_begs); free(anchor_wins[i].cons_begs); }
+    } free(read_poa_hap);
     for (int i = 0; i < 2; ++i) {
         if (cons_seqs[i] != NULL) free(cons_seqs[i]);
         if (msa_seqs[i] != NULL) {
@@ -1374,20 +1745,21 @@ int wfa_collect_noisy_aln_str_with_ps_hap(const call_var_opt_t *opt, int samplin
     return n_cons;
 }
 
-int collect_noisy_read_info(const call_var_opt_t *opt, bam_chunk_t *chunk, hts_pos_t reg_beg, hts_pos_t reg_end, int noisy_reg_i, int n_noisy_reg_reads, int *noisy_reg_reads, int **read_lens,
+int collect_noisy_read_info(const call_var_opt_t *opt, bam_chunk_t *chunk, void *km, hts_pos_t reg_beg, hts_pos_t reg_end, int noisy_reg_i, int n_noisy_reg_reads, int *noisy_reg_reads, int **read_lens,
                             uint8_t ***read_seqs, uint8_t **strands, uint8_t ***read_quals, char ***read_names, int **fully_covers, int **read_id_to_full_covers, 
                             int **read_reg_beg, int **read_reg_end, int **read_haps, hts_pos_t **phase_sets) {
-    *read_lens = (int*)calloc(n_noisy_reg_reads, sizeof(int));
-    *read_seqs = (uint8_t**)malloc(n_noisy_reg_reads * sizeof(uint8_t*));
-    *strands = (uint8_t*)malloc(n_noisy_reg_reads * sizeof(uint8_t));
-    *read_quals = (uint8_t**)malloc(n_noisy_reg_reads * sizeof(uint8_t*));
-    *read_names = (char**)malloc(n_noisy_reg_reads * sizeof(char*));
-    *fully_covers = (int*)calloc(n_noisy_reg_reads, sizeof(int));
-    *read_id_to_full_covers = (int*)calloc(chunk->n_reads, sizeof(int));
-    *read_reg_beg = (int*)calloc(chunk->n_reads, sizeof(int));
-    *read_reg_end = (int*)calloc(chunk->n_reads, sizeof(int));
-    *read_haps = (int*)calloc(n_noisy_reg_reads, sizeof(int));
-    *phase_sets = (hts_pos_t*)calloc(n_noisy_reg_reads, sizeof(hts_pos_t));
+    // all freed at the end of collect_noisy_reg_aln_strs, so they come from the aligning thread's arena
+    *read_lens = (int*)kcalloc(km, n_noisy_reg_reads, sizeof(int));
+    *read_seqs = (uint8_t**)kmalloc(km, n_noisy_reg_reads * sizeof(uint8_t*));
+    *strands = (uint8_t*)kmalloc(km, n_noisy_reg_reads * sizeof(uint8_t));
+    *read_quals = (uint8_t**)kmalloc(km, n_noisy_reg_reads * sizeof(uint8_t*));
+    *read_names = (char**)kmalloc(km, n_noisy_reg_reads * sizeof(char*));
+    *fully_covers = (int*)kcalloc(km, n_noisy_reg_reads, sizeof(int));
+    *read_id_to_full_covers = (int*)kcalloc(km, chunk->n_reads, sizeof(int));
+    *read_reg_beg = (int*)kcalloc(km, chunk->n_reads, sizeof(int));
+    *read_reg_end = (int*)kcalloc(km, chunk->n_reads, sizeof(int));
+    *read_haps = (int*)kcalloc(km, n_noisy_reg_reads, sizeof(int));
+    *phase_sets = (hts_pos_t*)kcalloc(km, n_noisy_reg_reads, sizeof(hts_pos_t));
 
     for (int i = 0; i < n_noisy_reg_reads; ++i) {
         int read_id = noisy_reg_reads[i];
@@ -1444,10 +1816,10 @@ int collect_noisy_read_info(const call_var_opt_t *opt, bam_chunk_t *chunk, hts_p
             else cover = LONGCALLD_NOISY_RIGHT_COVER; // (*fully_covers)[i] = 2;
         } else cover = 0; // (*fully_covers)[i] = 0;
         // if (2*(reg_read_end-reg_read_beg+1) < (reg_end-reg_beg+1)) return 0;
-        (*read_seqs)[i] = (uint8_t*)malloc((reg_read_end - reg_read_beg + 1) * sizeof(uint8_t));
-        (*read_quals)[i] = (uint8_t*)malloc((reg_read_end - reg_read_beg + 1) * sizeof(uint8_t));
+        (*read_seqs)[i] = (uint8_t*)kmalloc(km, (reg_read_end - reg_read_beg + 1) * sizeof(uint8_t));
+        (*read_quals)[i] = (uint8_t*)kmalloc(km, (reg_read_end - reg_read_beg + 1) * sizeof(uint8_t));
         for (int j = reg_read_beg; j <= reg_read_end; ++j) {
-            (*read_seqs)[i][j-reg_read_beg] = seq_nt16_int[bam_seqi(read_digars->bseq, j)];
+            (*read_seqs)[i][j-reg_read_beg] = read_digars->seq[j];
             (*read_quals)[i][j-reg_read_beg] = read_digars->qual[j];
         }
         (*read_lens)[i] = reg_read_end - reg_read_beg + 1;
@@ -1519,13 +1891,8 @@ digar1_t *collect_right_digars(digar_t *digar, int read_noisy_end, hts_pos_t ref
             if (op == BAM_CINS || op == BAM_CEQUAL || op == BAM_CDIFF) {
                 digar1_t d = digar->digars[i]; d.len = digar_qi_end - read_noisy_end; // chop digar
                 d.qi = read_noisy_end + 1; // chop qi
-                if (op == BAM_CINS) {
-                    uint8_t *new_alt_seq = (uint8_t*)malloc(d.len * sizeof(uint8_t));
-                    for (int j = 0; j < d.len; ++j) {
-                        new_alt_seq[j] = digar->digars[i].alt_seq[j+read_noisy_end+1-qi];
-                    }
-                    free(d.alt_seq); d.alt_seq = new_alt_seq; // chop alt_seq
-                } else d.pos = ref_noisy_end + 1; // chop pos
+                if (op == BAM_CINS) d.alt_seq += read_noisy_end + 1 - qi; // chop alt_seq
+                else d.pos = ref_noisy_end + 1; // chop pos
                 right_digars = push_digar0(right_digars, n_right_digars, &m_right_digar, d);
             } else if (op == BAM_CDEL) {
                 digar1_t d = digar->digars[i]; d.len = digar_ref_end - ref_noisy_end; // chop digar
@@ -1540,7 +1907,7 @@ digar1_t *collect_right_digars(digar_t *digar, int read_noisy_end, hts_pos_t ref
     return right_digars;
 }
 
-digar1_t *collect_full_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg, int msa_len, uint8_t *read_str, uint8_t *ref_str, int *n_msa_digars) {
+digar1_t *collect_full_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg, int msa_len, uint8_t *read_str, uint8_t *ref_str, uint8_t *read_seq, int *n_msa_digars) {
     digar1_t *msa_digars = NULL;
     *n_msa_digars = 0; int m_msa_digars = 0;
     if (msa_len <= 0) return NULL;
@@ -1555,8 +1922,7 @@ digar1_t *collect_full_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg,
                     msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
                 } else { // X
                     digar1_t d = (digar1_t){.pos = ref_pos, .qi = read_pos, .type = BAM_CDIFF, .len = 1, .alt_seq = NULL, .is_low_qual = 0};
-                    d.alt_seq = (uint8_t*)malloc(1 * sizeof(uint8_t));
-                    d.alt_seq[0] = read_str[i];
+                    d.alt_seq = read_seq + read_pos; // same base as read_str[i]
                     msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
                 }
             }
@@ -1564,8 +1930,7 @@ digar1_t *collect_full_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg,
         } else if (read_str[i] != 5) { // INS: ref_str[i] == 5
             if (i >= left_read_start && i <= right_read_end) {
                 digar1_t d = (digar1_t){.pos = ref_pos, .qi = read_pos, .type = BAM_CINS, .len = 1, .alt_seq = NULL, .is_low_qual = 0};
-                d.alt_seq = (uint8_t*)malloc(1 * sizeof(uint8_t));
-                d.alt_seq[0] = read_str[i];
+                d.alt_seq = read_seq + read_pos; // same base as read_str[i]
                 msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
             }
             read_pos++;
@@ -1580,7 +1945,7 @@ digar1_t *collect_full_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg,
     return msa_digars;
 }
 
-digar1_t *collect_left_msa_digars(int read_beg, int read_end, int qlen, hts_pos_t ref_beg, int msa_len, uint8_t *read_str, uint8_t *ref_str, int *n_msa_digars) {
+digar1_t *collect_left_msa_digars(int read_beg, int read_end, int qlen, hts_pos_t ref_beg, int msa_len, uint8_t *read_str, uint8_t *ref_str, uint8_t *read_seq, int *n_msa_digars) {
     digar1_t *msa_digars = NULL;
     *n_msa_digars = 0; int m_msa_digars = 0;
     if (msa_len <= 0) return NULL;
@@ -1609,8 +1974,7 @@ digar1_t *collect_left_msa_digars(int read_beg, int read_end, int qlen, hts_pos_
                     msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
                 } else { // X
                     digar1_t d = (digar1_t){.pos = ref_pos, .qi = read_pos, .type = BAM_CDIFF, .len = 1, .alt_seq = NULL, .is_low_qual = 0};
-                    d.alt_seq = (uint8_t*)malloc(1 * sizeof(uint8_t));
-                    d.alt_seq[0] = read_str[i];
+                    d.alt_seq = read_seq + read_pos; // same base as read_str[i]
                     msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
                 }
             }
@@ -1618,8 +1982,7 @@ digar1_t *collect_left_msa_digars(int read_beg, int read_end, int qlen, hts_pos_
         } else if (read_str[i] != 5) { // INS: ref_str[i] == 5
             if (i >= left_read_start && i <= right_read_end) {
                 digar1_t d = (digar1_t){.pos = ref_pos, .qi = read_pos, .type = BAM_CINS, .len = 1, .alt_seq = NULL, .is_low_qual = 0};
-                d.alt_seq = (uint8_t*)malloc(1 * sizeof(uint8_t));
-                d.alt_seq[0] = read_str[i];
+                d.alt_seq = read_seq + read_pos; // same base as read_str[i]
                 msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
             }
             read_pos++;
@@ -1639,7 +2002,7 @@ digar1_t *collect_left_msa_digars(int read_beg, int read_end, int qlen, hts_pos_
     return msa_digars;
 }
 
-digar1_t *collect_right_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg, hts_pos_t ref_end, int msa_len, uint8_t *read_str, uint8_t *ref_str, int *n_msa_digars) {
+digar1_t *collect_right_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg, hts_pos_t ref_end, int msa_len, uint8_t *read_str, uint8_t *ref_str, uint8_t *read_seq, int *n_msa_digars) {
     digar1_t *msa_digars = NULL;
     *n_msa_digars = 0; int m_msa_digars = 0;
     if (msa_len <= 0) return NULL;
@@ -1678,15 +2041,13 @@ digar1_t *collect_right_msa_digars(int read_beg, int read_end, hts_pos_t ref_beg
                 msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
             } else { // X
                 digar1_t d = (digar1_t){.pos = ref_pos, .qi = read_pos, .type = BAM_CDIFF, .len = 1, .alt_seq = NULL, .is_low_qual = 0};
-                d.alt_seq = (uint8_t*)malloc(1 * sizeof(uint8_t));
-                d.alt_seq[0] = read_str[i];
+                d.alt_seq = read_seq + read_pos; // same base as read_str[i]
                 msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
             }
             read_pos++; ref_pos++;
         } else if (read_str[i] != 5) { // INS: ref_str[i] == 5
             digar1_t d = (digar1_t){.pos = ref_pos, .qi = read_pos, .type = BAM_CINS, .len = 1, .alt_seq = NULL, .is_low_qual = 0};
-            d.alt_seq = (uint8_t*)malloc(1 * sizeof(uint8_t));
-            d.alt_seq[0] = read_str[i];
+            d.alt_seq = read_seq + read_pos; // same base as read_str[i]
             msa_digars = push_digar0(msa_digars, n_msa_digars, &m_msa_digars, d);
             read_pos++;
         } else { // DEL read_str[i] == 5, ref_str[i] != 5
@@ -1709,25 +2070,25 @@ void update_digars_from_msa1(char *tname, digar_t *digar, int msa_len, uint8_t *
         // chop digar
         old_left_digars = collect_left_digars(digar, read_beg, noisy_reg_beg, &old_left_n_digars);
         old_right_digars = collect_right_digars(digar, read_end, noisy_reg_end, &old_right_n_digars);
-        msa_digars = collect_full_msa_digars(read_beg, read_end, noisy_reg_beg, msa_len, read_str, ref_str, &msa_n_digars);
+        msa_digars = collect_full_msa_digars(read_beg, read_end, noisy_reg_beg, msa_len, read_str, ref_str, digar->seq, &msa_n_digars);
         // push to new digar
-        for (int i = 0; i < old_left_n_digars; ++i) new_digars = push_digar_alt_seq(new_digars, &new_n_digars, &new_m_digar, old_left_digars[i]);
+        for (int i = 0; i < old_left_n_digars; ++i) new_digars = push_digar0(new_digars, &new_n_digars, &new_m_digar, old_left_digars[i]);
         for (int i = 0; i < msa_n_digars; ++i) new_digars = push_digar0(new_digars, &new_n_digars, &new_m_digar, msa_digars[i]);
-        for (int i = 0; i < old_right_n_digars; ++i) new_digars = push_digar_alt_seq(new_digars, &new_n_digars, &new_m_digar, old_right_digars[i]);
+        for (int i = 0; i < old_right_n_digars; ++i) new_digars = push_digar0(new_digars, &new_n_digars, &new_m_digar, old_right_digars[i]);
     } else if (LONGCALLD_NOISY_IS_LEFT_COVER(full_cover)) { // left-cover: update digar
         // chop digar
         old_left_digars = collect_left_digars(digar, read_beg, noisy_reg_beg, &old_left_n_digars);
-        msa_digars = collect_left_msa_digars(read_beg, read_end, digar->qlen, noisy_reg_beg, msa_len, read_str, ref_str, &msa_n_digars);
+        msa_digars = collect_left_msa_digars(read_beg, read_end, digar->qlen, noisy_reg_beg, msa_len, read_str, ref_str, digar->seq, &msa_n_digars);
         // push to new digar
-        for (int i = 0; i < old_left_n_digars; ++i) new_digars = push_digar_alt_seq(new_digars, &new_n_digars, &new_m_digar, old_left_digars[i]);
+        for (int i = 0; i < old_left_n_digars; ++i) new_digars = push_digar0(new_digars, &new_n_digars, &new_m_digar, old_left_digars[i]);
         for (int i = 0; i < msa_n_digars; ++i) new_digars = push_digar0(new_digars, &new_n_digars, &new_m_digar, msa_digars[i]);
     } else if (LONGCALLD_NOISY_IS_RIGHT_COVER(full_cover)) { // right-cover: update digar and start pos
         // chop digar
         old_right_digars = collect_right_digars(digar, read_end, noisy_reg_end, &old_right_n_digars);
-        msa_digars = collect_right_msa_digars(read_beg, read_end, noisy_reg_beg, noisy_reg_end, msa_len, read_str, ref_str, &msa_n_digars);
+        msa_digars = collect_right_msa_digars(read_beg, read_end, noisy_reg_beg, noisy_reg_end, msa_len, read_str, ref_str, digar->seq, &msa_n_digars);
         // push to new digar
         for (int i = 0; i < msa_n_digars; ++i) new_digars = push_digar0(new_digars, &new_n_digars, &new_m_digar, msa_digars[i]);
-        for (int i = 0; i < old_right_n_digars; ++i) new_digars = push_digar_alt_seq(new_digars, &new_n_digars, &new_m_digar, old_right_digars[i]);
+        for (int i = 0; i < old_right_n_digars; ++i) new_digars = push_digar0(new_digars, &new_n_digars, &new_m_digar, old_right_digars[i]);
     }
     if (double_check_digar(new_digars, new_n_digars)) {
         // fprintf(stderr, "%s: Error: after updating digar from MSA, invalid digar!\n", tname);
@@ -1757,20 +2118,21 @@ void update_digars_from_aln_str(bam_chunk_t *chunk, hts_pos_t noisy_reg_beg, hts
 
 // return n_cons
 // 1. consensu calling; 2. WFA-based MSA
-int collect_noisy_reg_aln_strs(const call_var_opt_t *opt, bam_chunk_t *chunk, hts_pos_t noisy_reg_beg, hts_pos_t noisy_reg_end, int noisy_reg_i,
+int collect_noisy_reg_aln_strs(const call_var_opt_t *opt, bam_chunk_t *chunk, wfa_pool_t *wfa_pool, abpoa_pool_t *poa_pool, void *km, hts_pos_t noisy_reg_beg, hts_pos_t noisy_reg_end, int noisy_reg_i,
                                int n_noisy_reg_reads, int *noisy_read_ids, uint8_t *ref_seq, int ref_seq_len,
-                               int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs) {
+                               int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs, noisy_aln_prof_t *prof) {
     if (n_noisy_reg_reads <= 0) return 0;
     // fully_cover: 0 -> none, 1 -> left, 2 -> right, 3 -> both
     char **names = NULL; uint8_t **seqs = NULL; uint8_t *strands=NULL; int *fully_covers = NULL, *lens = NULL, *haps = NULL; hts_pos_t *phase_sets = NULL; uint8_t **base_quals = NULL;
     int *read_id_to_full_covers = NULL, *read_reg_beg = NULL, *read_reg_end = NULL;
-    collect_noisy_read_info(opt, chunk, noisy_reg_beg, noisy_reg_end, noisy_reg_i, n_noisy_reg_reads, noisy_read_ids,
+    collect_noisy_read_info(opt, chunk, km, noisy_reg_beg, noisy_reg_end, noisy_reg_i, n_noisy_reg_reads, noisy_read_ids,
                             &lens, &seqs, &strands, &base_quals, &names, &fully_covers, &read_id_to_full_covers, 
                             &read_reg_beg, &read_reg_end, &haps, &phase_sets);
 
     // for large noisy regions, sort reads by fully_cover, error_base_rate, and length
     int sampling_reads = 0;
     if (noisy_reg_end - noisy_reg_beg + 1 >= opt->min_noisy_reg_size_to_sample_reads) sampling_reads = 1;
+    prof->sampling_reads = sampling_reads;
     sort_noisy_region_reads(n_noisy_reg_reads, noisy_read_ids, lens, seqs, base_quals, strands, fully_covers, names, haps, phase_sets, sampling_reads);
     // >= min_hap_full_read_count reads for each hap && >= min_hap_read_count reads (including not full-cover, but >= full-cover length) for each hap
     int min_hap_full_read_count = opt->min_hap_full_reads, min_hap_read_count = opt->min_hap_reads;
@@ -1787,16 +2149,19 @@ int collect_noisy_reg_aln_strs(const call_var_opt_t *opt, bam_chunk_t *chunk, ht
     // XXX only use fully-covered reads, including cliping reads (after re-align to backbone read)
     // two cases to call consensus sequences
     if (ps_with_both_haps > 0) { // call consensus sequences for each haplotype
-        n_cons = wfa_collect_noisy_aln_str_with_ps_hap(opt, sampling_reads, n_noisy_reg_reads, noisy_read_ids, lens, seqs, strands, base_quals, names, haps, phase_sets, fully_covers, ps_with_both_haps, min_hap_full_read_count, min_hap_read_count,
-                                                       ref_seq, ref_seq_len, clu_n_seqs, clu_read_ids, aln_strs, collect_ref_read_aln_str);
+        prof->aln_mode = LONGCALLD_NOISY_ALN_HAP;
+        n_cons = wfa_collect_noisy_aln_str_with_ps_hap(opt, wfa_pool, poa_pool, sampling_reads, n_noisy_reg_reads, noisy_read_ids, lens, seqs, strands, base_quals, names, haps, phase_sets, fully_covers, ps_with_both_haps, min_hap_full_read_count, min_hap_read_count,
+                                                       ref_seq, ref_seq_len, clu_n_seqs, clu_read_ids, aln_strs, collect_ref_read_aln_str, prof);
         if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "Hap %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " %d reads (%d full) n_cons: %d\n", chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, n_noisy_reg_reads, n_full_reads, n_cons);
     // >= min_no_hap_full_read_count full reads in total
     } else if (ps_with_both_haps <= 0 && n_full_reads >= min_no_hap_full_read_count) {
         // XXX do NOT de novo abPOA for homopolymer regions
-        n_cons = wfa_collect_noisy_aln_str_no_ps_hap(opt, n_noisy_reg_reads, noisy_read_ids, lens, seqs, names, fully_covers,
-                                                     ref_seq, ref_seq_len, clu_n_seqs, clu_read_ids, aln_strs, collect_ref_read_aln_str);
+        prof->aln_mode = LONGCALLD_NOISY_ALN_NO_HAP;
+        n_cons = wfa_collect_noisy_aln_str_no_ps_hap(opt, wfa_pool, poa_pool, n_noisy_reg_reads, noisy_read_ids, lens, seqs, names, fully_covers,
+                                                     ref_seq, ref_seq_len, clu_n_seqs, clu_read_ids, aln_strs, collect_ref_read_aln_str, prof);
         if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "NoHap %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " %d reads (%d full) n_cons: %d\n", chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, n_noisy_reg_reads, n_full_reads, n_cons);
     } else {
+        if (ref_seq_len > opt->max_noisy_reg_len) prof->skipped = "skipped-long"; // not anchor-split without phased reads
         if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "Skipped %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " %d reads (%d full)\n", chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, n_noisy_reg_reads, n_full_reads);
     }
     // update digar based on ref vs read in MSA
@@ -1805,9 +2170,9 @@ int collect_noisy_reg_aln_strs(const call_var_opt_t *opt, bam_chunk_t *chunk, ht
                                    aln_strs, n_cons, clu_n_seqs, clu_read_ids);
     }
     for (int i = 0; i < n_noisy_reg_reads; ++i) {
-        free(seqs[i]); free(base_quals[i]);
+        kfree(km, seqs[i]); kfree(km, base_quals[i]);
     }
-    free(names); free(strands); free(seqs); free(base_quals); free(lens); free(read_reg_beg); free(read_reg_end);
-    free(fully_covers); free(read_id_to_full_covers); free(haps); free(phase_sets);
+    kfree(km, names); kfree(km, strands); kfree(km, seqs); kfree(km, base_quals); kfree(km, lens); kfree(km, read_reg_beg); kfree(km, read_reg_end);
+    kfree(km, fully_covers); kfree(km, read_id_to_full_covers); kfree(km, haps); kfree(km, phase_sets);
     return n_cons;
 }
\ No newline at end of file
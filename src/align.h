@@ -35,10 +35,33 @@
 #define LONGCALLD_WFA_NO_HEURISTIC 0
 #define LONGCALLD_WFA_ADAPTIVE 1
 #define LONGCALLD_WFA_ZDROP 2
+#define LONGCALLD_WFA_XDROP 3 // only used by wfa_heuristic_aln()
+#define LONGCALLD_WFA_N_HEURISTICS 4
 
 #define LONGCALLD_WFA_AFFINE_1P 0
 #define LONGCALLD_WFA_AFFINE_2P 1
 
+#define LONGCALLD_WFA_POOL_MAX_BYTES (1ULL << 30) // pooled aligner grown beyond 1 GB is freed after use
+#define LONGCALLD_POA_POOL_MAX_BYTES (1ULL << 30) // same for the pooled abPOA DP matrix
+#define LONGCALLD_NOISY_KM_MAX_BYTES (1ULL << 30) // same for the per-worker noisy-region kalloc arenas, checked after each chunk
+#define LONGCALLD_POA_MAX_N_CONS 2
+#define LONGCALLD_POA_CELL_BYTES 12 // est. abPOA DP bytes per cell: 32-bit H/E/F scores, for --noisy-max-mem
+
+// anchor-split POA of long noisy regions, see collect_noisy_reg_anchors()
+#define LONGCALLD_ANCHOR_KMER_LEN 21
+#define LONGCALLD_ANCHOR_WIN_LEN 2000 // ~length of each window between two anchors
+#define LONGCALLD_ANCHOR_ZONE_LEN 200 // anchors are picked in the first 200 bp of each 2-kb window
+#define LONGCALLD_ANCHOR_MIN_READ_FRAC 0.8 // anchor has to be found in >= 80% of the reads
+
+#define LONGCALLD_NOISY_ALN_NONE   0 // not enough reads
+#define LONGCALLD_NOISY_ALN_HAP    1 // one consensus for each haplotype of a phase set
+#define LONGCALLD_NOISY_ALN_NO_HAP 2 // haplotype-unaware MSA of all full-cover reads
+
+// cheaper strategies of a noisy region over its budget, bit flags of noisy_aln_prof_t::fallbacks
+#define LONGCALLD_NOISY_FB_SUBSAMPLE 0x1 // reads subsampled to fit --noisy-max-cells
+#define LONGCALLD_NOISY_FB_HEURISTIC 0x2 // consensus vs reference aligned with heuristic WFA
+#define LONGCALLD_NOISY_FB_TRUNCATED 0x4 // POA stopped adding reads at --noisy-max-time
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -47,22 +70,50 @@ struct bam_chunk_t;
 struct aln_str_t;
 struct cand_var_t;
 
+// alignment cost of one noisy region, collected for --stats & --noisy-reg-log
+typedef struct noisy_aln_prof_t {
+    uint8_t sampling_reads, aln_mode; // LONGCALLD_NOISY_ALN_*
+    double poa_time, wfa_time; // wall-clock seconds
+    int64_t poa_cells; // upper bound: aligned bases x graph nodes
+    uint64_t poa_peak_bytes, wfa_peak_bytes; // abPOA DP matrix, WFA aligner of consensus vs reference
+    uint8_t fallbacks; // LONGCALLD_NOISY_FB_*
+    double heuristic_time, deadline; // wall-clock time of --noisy-max-time/2 and --noisy-max-time, set by the caller, 0: none
+    const char *skipped; // set if the POA that has to run is over the limits, e.g., "skipped-long", NULL: not skipped
+} noisy_aln_prof_t;
+
+// per-worker WFA aligners, created on first use and reused for all alignments of the same attributes
+typedef struct wfa_pool_t {
+    int b, q, e, q2, e2; // penalties, copied from call_var_opt_t
+    int ultralow_len; // use ultralow memory mode (BiWFA) if max(plen, tlen) >= ultralow_len, 0: never
+    wavefront_aligner_t *aligners[2][LONGCALLD_WFA_N_HEURISTICS][2]; // [affine_gap][heuristic][ultralow]
+    uint8_t *rev_seq; int m_rev_seq; // reversed pattern & text for LONGCALLD_GAP_LEFT_ALN
+} wfa_pool_t;
+
+wfa_pool_t *wfa_pool_init(const call_var_opt_t *opt);
+void wfa_pool_destroy(wfa_pool_t *pool);
+
+// per-worker abPOA object, reset for each noisy region, and finalized parameters for each configuration
+typedef struct abpoa_pool_t abpoa_pool_t;
+
+abpoa_pool_t *abpoa_pool_init(void);
+void abpoa_pool_destroy(abpoa_pool_t *pool);
+
 int collect_te_info_from_var(const call_var_opt_t *opt, bam_chunk_t *chunk, cand_var_t *var);
 int collect_te_info_from_cons(const call_var_opt_t *opt, bam_chunk_t *chunk, hts_pos_t gap_ref_start, int msa_gap_start, int var_type, int gap_len, uint8_t *cons_msa_seq, 
                               uint8_t **tsd_seq, hts_pos_t *tsd_pos1, hts_pos_t *tsd_pos2, int *tsd_polya_len, int *te_seq_i, int *te_is_rev);
 int edlib_end2end_aln(uint8_t *target, int tlen, uint8_t *query, int qlen, int *n_eq, int *n_xid);
 int edlib_infix_aln(uint8_t *target, int tlen, uint8_t *query, int qlen, int *n_eq, int *n_xid);
 // int wfa_aln(int gap_pos, char *pattern, int plen, char *text, int tlen, uint32_t **cigar_buf);
-int end2end_aln(const call_var_opt_t *opt, char *pattern, int plen, uint8_t *text, int tlen, uint32_t **cigar_buf);
-int wfa_end2end_aln(uint8_t *pattern, int plen, uint8_t *text, int tlen,
-                    int gap_aln, int a, int b, int q, int e, int q2, int e2, int use_heuristic,
-                    uint32_t **cigar_buf, int *cigar_length, uint8_t **pattern_alg, uint8_t **text_alg, int *alg_length);
-int wfa_heuristic_aln(uint8_t *pattern, int plen, uint8_t *text, int tlen, int a, int b, int q, int e, int q2, int e2, int *n_eq, int *n_xid);
+int end2end_aln(const call_var_opt_t *opt, wfa_pool_t *pool, char *pattern, int plen, uint8_t *text, int tlen, uint32_t **cigar_buf);
+int wfa_end2end_aln(wfa_pool_t *pool, uint8_t *pattern, int plen, uint8_t *text, int tlen, int gap_aln, int heuristic, int affine_gap,
+                    uint32_t **cigar_buf, int *cigar_length, uint8_t **pattern_alg, uint8_t **text_alg, int *alg_length, uint64_t *peak_bytes);
+int wfa_heuristic_aln(wfa_pool_t *pool, uint8_t *pattern, int plen, uint8_t *text, int tlen, int *n_eq, int *n_xid);
 
-int collect_noisy_reg_aln_strs(const call_var_opt_t *opt, bam_chunk_t *chunk, hts_pos_t noisy_reg_beg, hts_pos_t noisy_reg_end, 
+// only reads & updates the digars of noisy_reads, so read-disjoint noisy regions can be aligned in parallel with their own pools
+int collect_noisy_reg_aln_strs(const call_var_opt_t *opt, bam_chunk_t *chunk, wfa_pool_t *wfa_pool, abpoa_pool_t *poa_pool, void *km, hts_pos_t noisy_reg_beg, hts_pos_t noisy_reg_end,
                                int noisy_reg_i, int n_noisy_reg_reads, int *noisy_reads, uint8_t *ref_seq, int ref_seq_len,
-                               int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs);
-int wfa_collect_diff_ins_seq(const call_var_opt_t *opt, uint8_t* large_seq, int large_len, uint8_t *small_seq, int small_len, uint8_t **diff_seq);
+                               int *clu_n_seqs, int **clu_read_ids, aln_str_t **aln_strs, noisy_aln_prof_t *prof);
+int wfa_collect_diff_ins_seq(const call_var_opt_t *opt, wfa_pool_t *pool, uint8_t* large_seq, int large_len, uint8_t *small_seq, int small_len, uint8_t **diff_seq);
 
 #ifdef __cplusplus
 }
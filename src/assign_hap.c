@@ -13,9 +13,10 @@
 extern int LONGCALLD_VERBOSE;
 
 // init reads' hap & ps
-void read_init_hap_phase_set(bam_chunk_t *chunk) {
-    for (int i = 0; i < chunk->n_reads; ++i) {
-        chunk->haps[i] = 0; chunk->phase_sets[i] = -1; chunk->phase_scores[i] = 0;
+void read_init_hap_phase_set(bam_chunk_t *chunk, int n_reads, int *read_ids) {
+    for (int i = 0; i < n_reads; ++i) {
+        int read_i = read_ids[i];
+        chunk->haps[read_i] = 0; chunk->phase_sets[read_i] = -1; chunk->phase_scores[read_i] = 0;
     }
 }
 
@@ -39,55 +40,34 @@ static int get_var_init_max_cov_allele(int is_ont, cand_var_t *var) {
 void var_init_hap_profile_cons_allele(const call_var_opt_t *opt, cand_var_t *cand_vars, int *var_idx, int n_cand_vars, int *var_i_to_cate) {
     for (int _var_i = 0; _var_i < n_cand_vars; ++_var_i) {
         int var_i = var_idx[_var_i]; cand_var_t *var = cand_vars+var_i;
-        if (var->hap_to_alle_profile == NULL) {
-            var->hap_to_alle_profile = (int**)malloc((LONGCALLD_DEF_PLOID+1) * sizeof(int*));
-            for (int i = 0; i <= LONGCALLD_DEF_PLOID; ++i) var->hap_to_alle_profile[i] = (int*)calloc(var->n_uniq_alles, sizeof(int));
-            var->hap_to_cons_alle = (int*)malloc((LONGCALLD_DEF_PLOID+1) * sizeof(int));
-            var->hap_to_cons_alle[0] = get_var_init_max_cov_allele(opt->is_ont, var); // hom_idx
-            if (var_i_to_cate[var_i] == LONGCALLD_NOISY_CAND_HOM_VAR || var_i_to_cate[var_i] == LONGCALLD_CLEAN_HOM_VAR) {
-                for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = 1;
-            } else {
-                for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = -1;
-            }
+        // HOM profile is only reset at the first time
+        for (int j = var->has_hap_profile ? 1 : 0; j <= LONGCALLD_DEF_PLOID; ++j)
+            memset(var->hap_to_alle_profile[j], 0, var->n_uniq_alles * sizeof(int));
+        var->has_hap_profile = 1;
+        var->hap_to_cons_alle[0] = get_var_init_max_cov_allele(opt->is_ont, var); // hom_idx
+        if (var_i_to_cate[var_i] == LONGCALLD_NOISY_CAND_HOM_VAR || var_i_to_cate[var_i] == LONGCALLD_CLEAN_HOM_VAR) {
+            for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = 1;
         } else {
-            for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j)
-                memset(var->hap_to_alle_profile[j], 0, var->n_uniq_alles * sizeof(int));
-            var->hap_to_cons_alle[0] = get_var_init_max_cov_allele(opt->is_ont, var); // hom_idx
-            if (var_i_to_cate[var_i] == LONGCALLD_NOISY_CAND_HOM_VAR || var_i_to_cate[var_i] == LONGCALLD_CLEAN_HOM_VAR) {
-                for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = 1;
-            } else {
-                for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = -1;
-            }
+            for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = -1;
         }
     }
 }
 
 void var_init_hap_profile_cons_allele1(const call_var_opt_t *opt, cand_var_t *var) {
-    if (var->hap_to_alle_profile == NULL) {
-        var->hap_to_alle_profile = (int**)malloc((LONGCALLD_DEF_PLOID+1) * sizeof(int*));
-        for (int i = 0; i <= LONGCALLD_DEF_PLOID; ++i) var->hap_to_alle_profile[i] = (int*)calloc(var->n_uniq_alles, sizeof(int));
-        var->hap_to_cons_alle = (int*)malloc((LONGCALLD_DEF_PLOID+1) * sizeof(int));
-        var->hap_to_cons_alle[0] = get_var_init_max_cov_allele(opt->is_ont, var); // hom_idx
-        for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = -1;
-    } else {
-        for (int j = 0; j <= LONGCALLD_DEF_PLOID; ++j) memset(var->hap_to_alle_profile[j], 0, var->n_uniq_alles * sizeof(int));
-        var->hap_to_cons_alle[0] = get_var_init_max_cov_allele(opt->is_ont, var); // hom_idx
-        for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = -1;
-    }
+    for (int j = 0; j <= LONGCALLD_DEF_PLOID; ++j) memset(var->hap_to_alle_profile[j], 0, var->n_uniq_alles * sizeof(int));
+    var->has_hap_profile = 1;
+    var->hap_to_cons_alle[0] = get_var_init_max_cov_allele(opt->is_ont, var); // hom_idx
+    for (int j = 1; j <= LONGCALLD_DEF_PLOID; ++j) var->hap_to_cons_alle[j] = -1;
 }
 
 
 void var_init_hap_to_alle_profile(cand_var_t *cand_vars, int *var_idx, int n_cand_vars) {
     for (int _var_i = 0; _var_i < n_cand_vars; ++_var_i) {
         int var_i = var_idx[_var_i]; cand_var_t *var = cand_vars+var_i;
-        if (var->hap_to_alle_profile == NULL) {
-            var->hap_to_alle_profile = (int**)malloc((LONGCALLD_DEF_PLOID+1) * sizeof(int*));
-            for (int i = 0; i <= LONGCALLD_DEF_PLOID; ++i) var->hap_to_alle_profile[i] = (int*)calloc(var->n_uniq_alles, sizeof(int));
-        } else {
-            for (int j = 0; j <= LONGCALLD_DEF_PLOID; ++j) {
-                memset(var->hap_to_alle_profile[j], 0, var->n_uniq_alles * sizeof(int));
-            }
+        for (int j = 0; j <= LONGCALLD_DEF_PLOID; ++j) {
+            memset(var->hap_to_alle_profile[j], 0, var->n_uniq_alles * sizeof(int));
         }
+        var->has_hap_profile = 1;
     }
 }
 
@@ -197,6 +177,167 @@ int init_assign_read_hap_based_on_cons_alle(bam_chunk_t *chunk, int read_i, cand
     // return max_hap;
 }
 
+// bitplanes for read-to-haplotype scoring in kmeans_phase_vars(), same result as init_assign_read_hap_based_on_cons_alle()
+// bit (var_i & 63) of word (var_i >> 6) is cand_vars[var_i]; read alleles are packed once per k-means run,
+// consensus alleles are re-packed whenever hap_to_cons_alle is changed
+// vars with >2 alleles can not be put into 0/1 planes and are scored with read_to_cons_allele_score()
+typedef struct {
+    int n_words;
+    uint64_t *use, *hom, *w2, *clean_snp, *multi; // scored vars, CLEAN_HOM (not in hap_scores), score-2 vars, clean SNPs (agree/conflict counts), >2 alleles
+    uint64_t *cons[LONGCALLD_DEF_PLOID+1][2]; // cons[hap][a]: hap_to_cons_alle[hap] == a
+    int *read_word_beg, *read_n_words; size_t *read_off; // per read_i: words [read_word_beg, read_word_beg+read_n_words) at read_alle[a]+read_off
+    uint64_t *read_alle[2]; // alleles == 0/1 of all reads
+} hap_bits_t;
+
+#define hap_bits_set(b, i, v) ((v) ? ((b)[(i)>>6] |= 1ULL << ((i)&63)) : ((b)[(i)>>6] &= ~(1ULL << ((i)&63))))
+#define hap_bits_get(b, i) (((b)[(i)>>6] >> ((i)&63)) & 1)
+
+static void hap_bits_update_cons(hap_bits_t *hb, cand_var_t *cand_vars, int var_beg, int var_end) {
+    for (int var_i = var_beg; var_i <= var_end; ++var_i) {
+        if (hap_bits_get(hb->use, var_i) == 0) continue;
+        for (int hap = 1; hap <= LONGCALLD_DEF_PLOID; ++hap) {
+            int cons = cand_vars[var_i].hap_to_cons_alle[hap];
+            hap_bits_set(hb->cons[hap][0], var_i, cons == 0); hap_bits_set(hb->cons[hap][1], var_i, cons == 1);
+        }
+    }
+}
+
+static void hap_bits_update_all_cons(hap_bits_t *hb, cand_var_t *cand_vars, int *var_idx, int n_vars) {
+    for (int _var_i = 0; _var_i < n_vars; ++_var_i) hap_bits_update_cons(hb, cand_vars, var_idx[_var_i], var_idx[_var_i]);
+}
+
+static hap_bits_t *hap_bits_init(bam_chunk_t *chunk, int *var_idx, int n_vars, int *var_i_to_cate, int target_var_cate, int n_reads, int *read_ids) {
+    hap_bits_t *hb = (hap_bits_t*)_err_calloc(1, sizeof(hap_bits_t));
+    cand_var_t *cand_vars = chunk->cand_vars; read_var_profile_t *p = chunk->read_var_profile;
+    int n_words = hb->n_words = (chunk->n_cand_vars + 63) >> 6;
+    hb->use = (uint64_t*)_err_calloc(n_words, sizeof(uint64_t)); hb->hom = (uint64_t*)_err_calloc(n_words, sizeof(uint64_t));
+    hb->w2 = (uint64_t*)_err_calloc(n_words, sizeof(uint64_t)); hb->clean_snp = (uint64_t*)_err_calloc(n_words, sizeof(uint64_t));
+    hb->multi = (uint64_t*)_err_calloc(n_words, sizeof(uint64_t));
+    for (int hap = 1; hap <= LONGCALLD_DEF_PLOID; ++hap) {
+        hb->cons[hap][0] = (uint64_t*)_err_calloc(n_words, sizeof(uint64_t)); hb->cons[hap][1] = (uint64_t*)_err_calloc(n_words, sizeof(uint64_t));
+    }
+    // same filters as init_assign_read_hap_based_on_cons_alle()
+    for (int _var_i = 0; _var_i < n_vars; ++_var_i) {
+        int var_i = var_idx[_var_i], var_cate = var_i_to_cate[var_i]; cand_var_t *var = cand_vars+var_i;
+        if ((var_cate & target_var_cate) == 0 || var->is_homopolymer_indel == 1 || var_cate == LONGCALLD_NOISY_CAND_HOM_VAR) continue;
+        hap_bits_set(hb->use, var_i, 1);
+        if (var_cate == LONGCALLD_CLEAN_HOM_VAR) hap_bits_set(hb->hom, var_i, 1);
+        if (var_cate == LONGCALLD_CLEAN_HET_SNP || var_cate == LONGCALLD_CLEAN_HET_INDEL) hap_bits_set(hb->w2, var_i, 1);
+        if ((var_cate & LONGCALLD_CAND_GERMLINE_CLEAN_VAR_CATE) > 0 && var->var_type == BAM_CDIFF) hap_bits_set(hb->clean_snp, var_i, 1);
+        if (var->n_uniq_alles > 2) hap_bits_set(hb->multi, var_i, 1);
+    }
+    hap_bits_update_all_cons(hb, cand_vars, var_idx, n_vars);
+    // read alleles, reads not in read_ids have no words and are scored by the scalar code
+    hb->read_word_beg = (int*)_err_calloc(chunk->n_reads, sizeof(int)); hb->read_n_words = (int*)_err_calloc(chunk->n_reads, sizeof(int));
+    hb->read_off = (size_t*)_err_calloc(chunk->n_reads, sizeof(size_t));
+    size_t tot_words = 0;
+    for (int i = 0; i < n_reads; ++i) {
+        int read_i = read_ids[i];
+        if (chunk->is_skipped[read_i] || p[read_i].start_var_idx < 0) continue;
+        hb->read_word_beg[read_i] = p[read_i].start_var_idx >> 6;
+        hb->read_n_words[read_i] = (p[read_i].end_var_idx >> 6) - hb->read_word_beg[read_i] + 1;
+        hb->read_off[read_i] = tot_words; tot_words += hb->read_n_words[read_i];
+    }
+    hb->read_alle[0] = (uint64_t*)_err_calloc(tot_words * 2 + 1, sizeof(uint64_t)); hb->read_alle[1] = hb->read_alle[0] + tot_words;
+    for (int i = 0; i < n_reads; ++i) {
+        int read_i = read_ids[i];
+        if (hb->read_n_words[read_i] == 0) continue;
+        // bit of var_i: (var_i>>6) - read_word_beg words after the read's first word
+        uint64_t *r0 = hb->read_alle[0] + hb->read_off[read_i], *r1 = hb->read_alle[1] + hb->read_off[read_i];
+        int bit_beg = hb->read_word_beg[read_i] << 6;
+        for (int var_i = p[read_i].start_var_idx; var_i <= p[read_i].end_var_idx; ++var_i) {
+            int allele_i = p[read_i].alleles[var_i - p[read_i].start_var_idx];
+            if (allele_i == 0) hap_bits_set(r0, var_i - bit_beg, 1);
+            else if (allele_i == 1) hap_bits_set(r1, var_i - bit_beg, 1);
+        }
+    }
+    return hb;
+}
+
+static void hap_bits_destroy(hap_bits_t *hb) {
+    free(hb->use); free(hb->hom); free(hb->w2); free(hb->clean_snp); free(hb->multi);
+    for (int hap = 1; hap <= LONGCALLD_DEF_PLOID; ++hap) { free(hb->cons[hap][0]); free(hb->cons[hap][1]); }
+    free(hb->read_word_beg); free(hb->read_n_words); free(hb->read_off); free(hb->read_alle[0]);
+    free(hb);
+}
+
+// score one word of binary vars for hap 1 & 2, see hap_bits_assign_read_hap()
+static void hap_bits_score_word(hap_bits_t *hb, int w, uint64_t r0, uint64_t r1, uint64_t use, uint64_t read_alle, cand_var_t *cand_vars,
+                                int *hap_scores, int *n_vars_used, int *n_clean_agree_snps, int *n_clean_conflict_snps) {
+    uint64_t c0[3], c1[3], fill[3];
+    for (int hap = 1; hap <= 2; ++hap) c0[hap] = hb->cons[hap][0][w], c1[hap] = hb->cons[hap][1][w];
+    for (int hap = 1; hap <= 2; ++hap) { // missing cons allele of hap is filled with the other one of 3-hap
+        fill[hap] = read_alle & ~(c0[hap] | c1[hap]) & (c0[3-hap] | c1[3-hap]);
+    }
+    for (int hap = 1; hap <= 2; ++hap) {
+        c0[hap] |= fill[hap] & c1[3-hap]; c1[hap] |= fill[hap] & c0[3-hap];
+    }
+    for (int hap = 1; hap <= 2; ++hap) {
+        uint64_t agree = ((r0 & c0[hap]) | (r1 & c1[hap])) & use, conflict = ((r0 & c1[hap]) | (r1 & c0[hap])) & use;
+        uint64_t het = ~hb->hom[w];
+        n_vars_used[hap] += __builtin_popcountll((agree | conflict) & het);
+        hap_scores[hap] += __builtin_popcountll(agree & het) + __builtin_popcountll(agree & het & hb->w2[w])
+                         - __builtin_popcountll(conflict & het) - __builtin_popcountll(conflict & het & hb->w2[w]);
+        n_clean_agree_snps[hap] += __builtin_popcountll(agree & hb->clean_snp[w]);
+        n_clean_conflict_snps[hap] += __builtin_popcountll(conflict & hb->clean_snp[w]);
+    }
+    // write filled cons alleles back, as read_to_cons_allele_score() does
+    for (uint64_t f = fill[1] | fill[2]; f; f &= f - 1) {
+        int var_i = (w << 6) + __builtin_ctzll(f); cand_var_t *var = cand_vars + var_i;
+        for (int hap = 1; hap <= 2; ++hap)
+            if (var->hap_to_cons_alle[hap] == -1) var->hap_to_cons_alle[hap] = 1 - var->hap_to_cons_alle[3-hap];
+    }
+    hb->cons[1][0][w] = c0[1]; hb->cons[1][1][w] = c1[1]; hb->cons[2][0][w] = c0[2]; hb->cons[2][1][w] = c1[2];
+}
+
+// same as init_assign_read_hap_based_on_cons_alle(), including filling hap_to_cons_alle[hap] with 1-hap_to_cons_alle[3-hap]
+static int hap_bits_assign_read_hap(bam_chunk_t *chunk, hap_bits_t *hb, int read_i, cand_var_t *cand_vars, read_var_profile_t *p, int *var_i_to_cate, int target_var_cate) {
+    if (hb == NULL || hb->read_n_words[read_i] == 0) return init_assign_read_hap_based_on_cons_alle(chunk, read_i, cand_vars, p, var_i_to_cate, target_var_cate);
+    int hap_scores[3] = {0, 0, 0}, n_vars_used[3] = {0, 0, 0}, n_clean_agree_snps[3] = {0, 0, 0}, n_clean_conflict_snps[3] = {0, 0, 0};
+    chunk->n_clean_agree_snps[read_i] = chunk->n_clean_conflict_snps[read_i] = 0;
+    int word_beg = hb->read_word_beg[read_i], n_words = hb->read_n_words[read_i];
+    const uint64_t *r0 = hb->read_alle[0] + hb->read_off[read_i], *r1 = hb->read_alle[1] + hb->read_off[read_i];
+    for (int k = 0; k < n_words; ++k) {
+        int w = word_beg + k;
+        uint64_t use = hb->use[w] & ~hb->multi[w], read_alle = (r0[k] | r1[k]) & use;
+        if (read_alle != 0) hap_bits_score_word(hb, w, r0[k], r1[k], use, read_alle, cand_vars, hap_scores, n_vars_used, n_clean_agree_snps, n_clean_conflict_snps);
+        // vars with >2 alleles
+        for (uint64_t m = hb->use[w] & hb->multi[w]; m; m &= m - 1) {
+            int var_i = (w << 6) + __builtin_ctzll(m);
+            if (var_i < p[read_i].start_var_idx || var_i > p[read_i].end_var_idx) continue;
+            int allele_i = p[read_i].alleles[var_i - p[read_i].start_var_idx];
+            if (allele_i < 0) continue;
+            cand_var_t *var = cand_vars+var_i;
+            for (int hap = 1; hap <= 2; ++hap) {
+                int score0 = read_to_cons_allele_score(read_i, hap, var, var_i_to_cate[var_i], allele_i);
+                if (score0 != 0) {
+                    if (var_i_to_cate[var_i] != LONGCALLD_CLEAN_HOM_VAR) n_vars_used[hap]++;
+                    if (hap_bits_get(hb->clean_snp, var_i)) {
+                        if (score0 > 0) n_clean_agree_snps[hap]++;
+                        else n_clean_conflict_snps[hap]++;
+                    }
+                }
+                if (var_i_to_cate[var_i] != LONGCALLD_CLEAN_HOM_VAR) hap_scores[hap] += score0;
+            }
+            hap_bits_update_cons(hb, cand_vars, var_i, var_i);
+        }
+    }
+    int max_hap = 0, max_score = 0, min_hap = 0, min_score = 0;
+    for (int hap = 1; hap <= 2; ++hap) {
+        if (hap_scores[hap] > max_score) {
+            max_hap = hap; max_score = hap_scores[hap];
+        } else if (hap_scores[hap] < min_score) {
+            min_hap = hap; min_score = hap_scores[hap];
+        }
+    }
+    if (n_vars_used[1] == 0 && n_vars_used[2] == 0) return -1; // no used vars
+    else if (max_score == 0 && min_score == 0) return 0; // tied
+    else if (max_score > 0) {
+        chunk->n_clean_agree_snps[read_i] = n_clean_agree_snps[max_hap]; chunk->n_clean_conflict_snps[read_i] = n_clean_conflict_snps[max_hap];
+        return max_hap;
+    } else return 3-min_hap;
+}
+
 // Assign read haplotype based on consensus allele of candidate variants
 // check for reject counts, reject the haplotype has too many clean rejects (>=2)
 // int assign_read_hap_based_on_cons_alle(int read_i, cand_var_t *cand_vars, read_var_profile_t *p, int *var_i_to_cate, int target_var_cate) {
@@ -319,9 +460,9 @@ int check_agree_haps(int read_i, int hap, cand_var_t *vars, int var1, int var2,
     else return -1;
 }
 
-void update_read_phase_set(bam_chunk_t *chunk, int *var_is_valid, read_var_profile_t *p, cand_var_t *cand_vars) {
-    for (int i = 0; i < chunk->n_reads; ++i) {
-        int read_i = chunk->ordered_read_ids[i];
+void update_read_phase_set(bam_chunk_t *chunk, int n_reads, int *read_ids, int *var_is_valid, read_var_profile_t *p, cand_var_t *cand_vars) {
+    for (int i = 0; i < n_reads; ++i) {
+        int read_i = read_ids[i];
         if (chunk->is_skipped[read_i]) continue;
         if (p[read_i].start_var_idx == -1) continue;
         hts_pos_t phase_set = -1;
@@ -422,23 +563,20 @@ int iter_update_var_hap_cons_phase_set(bam_chunk_t *chunk, int *var_idx, read_va
 }
 
 // update read's haps & var's hap_to_cons_alle
-int iter_update_var_hap_to_cons_alle(const call_var_opt_t *opt, bam_chunk_t *chunk, int *var_idx, int n_cand_vars, read_var_profile_t *p, cand_var_t *cand_vars, int *var_i_to_cate, int target_var_cate) {
-    int **cur_hap_to_cons_alle = (int**)malloc(n_cand_vars * sizeof(int*));
+int iter_update_var_hap_to_cons_alle(const call_var_opt_t *opt, bam_chunk_t *chunk, hap_bits_t *hb, int n_reads, int *read_ids, int *var_idx, int n_cand_vars, read_var_profile_t *p, cand_var_t *cand_vars, int *var_i_to_cate, int target_var_cate) {
+    int (*cur_hap_to_cons_alle)[LONGCALLD_N_HAP_PROFILE] = malloc(n_cand_vars * sizeof(*cur_hap_to_cons_alle));
     for (int _var_i = 0; _var_i < n_cand_vars; ++_var_i) {
         int var_i = var_idx[_var_i]; cand_var_t *var = cand_vars+var_i;
-        cur_hap_to_cons_alle[_var_i] = (int*)malloc((LONGCALLD_DEF_PLOID+1) * sizeof(int));
-        for (int hap = 1; hap <= LONGCALLD_DEF_PLOID; ++hap) {
-            cur_hap_to_cons_alle[_var_i][hap] = var->hap_to_cons_alle[hap];
-        }
+        memcpy(cur_hap_to_cons_alle[_var_i], var->hap_to_cons_alle, sizeof(var->hap_to_cons_alle));
     }
     // var-wise loop, update phase set XXX
     // update hap_to_alle_profile + hap_to_cons_alle
     var_init_hap_to_alle_profile(cand_vars, var_idx, n_cand_vars);
-    for (int i = 0; i < chunk->n_reads; ++i) {
-        int read_i = chunk->ordered_read_ids[i];
+    for (int i = 0; i < n_reads; ++i) {
+        int read_i = read_ids[i];
         if (chunk->is_skipped[read_i]) continue;
         int hap;
-        hap = init_assign_read_hap_based_on_cons_alle(chunk, read_i, cand_vars, p, var_i_to_cate, target_var_cate);
+        hap = hap_bits_assign_read_hap(chunk, hb, read_i, cand_vars, p, var_i_to_cate, target_var_cate);
         // if (opt->is_ont) hap = init_assign_read_hap_based_on_cons_alle(read_i, cand_vars, p, var_i_to_cate, target_var_cate);
         // else hap = assign_read_hap_based_on_cons_alle(read_i, cand_vars, p, var_i_to_cate, target_var_cate);
         if (hap == -1) hap = 0;
@@ -452,6 +590,7 @@ int iter_update_var_hap_to_cons_alle(const call_var_opt_t *opt, bam_chunk_t *chu
             update_var_hap_to_cons_alle(opt, var, var_i_to_cate[var_i], hap);
         }
     }
+    hap_bits_update_all_cons(hb, cand_vars, var_idx, n_cand_vars);
     // check if any hap_to_cons_alle changed
     int changed = 0;
     for (int _var_i = 0; _var_i < n_cand_vars; ++_var_i) {
@@ -462,34 +601,22 @@ int iter_update_var_hap_to_cons_alle(const call_var_opt_t *opt, bam_chunk_t *chu
             }
         }
     }
-    for (int i = 0; i < n_cand_vars; ++i) free(cur_hap_to_cons_alle[i]); free(cur_hap_to_cons_alle);
+    free(cur_hap_to_cons_alle);
     return changed;
 }
 
-// this is for germline variant calling only
-// read's PS was assigned using a fake HET (HOM) var
-// goal: 1) assign haplotype + phase set to all reads
-//       2) variant calling based on clustered reads
-int assign_hap_based_on_germline_het_vars_kmeans(const call_var_opt_t *opt, bam_chunk_t *chunk, int target_var_cate) {
+// k-means phasing of the valid vars (var_idx) with reads read_ids (in ordered_read_ids order)
+// var_i_to_cate: vars outside var_idx have to be masked as 0, so they are neither used nor updated
+static void kmeans_phase_vars(const call_var_opt_t *opt, bam_chunk_t *chunk, int n_valid_vars, int *valid_var_idx, int *var_is_valid, int *var_i_to_cate,
+                              int n_reads, int *read_ids, int target_var_cate) {
     read_var_profile_t *p = chunk->read_var_profile;
-    int n_valid_vars = 0, *valid_var_idx = (int*)malloc(chunk->n_cand_vars * sizeof(int));
-    int *var_is_valid = (int*)calloc(chunk->n_cand_vars, sizeof(int));
-    for (int i = 0; i < chunk->n_cand_vars; ++i) {
-        if ((chunk->var_i_to_cate[i] & target_var_cate) == 0) continue;
-        valid_var_idx[n_valid_vars++] = i;
-        var_is_valid[i] = 1;
-    }
-    if (n_valid_vars == 0) {
-        free(valid_var_idx); free(var_is_valid);
-        return 0;
-    }
-    int *var_i_to_cate = chunk->var_i_to_cate;
     cand_var_t *cand_vars = chunk->cand_vars;
     cgranges_t *read_var_cr = chunk->read_var_cr;
     int64_t ovlp_i, ovlp_n, *ovlp_b = 0, max_b = 0;
 
-    read_init_hap_phase_set(chunk);
+    read_init_hap_phase_set(chunk, n_reads, read_ids);
     var_init_hap_profile_cons_allele(opt, cand_vars, valid_var_idx, n_valid_vars, var_i_to_cate);
+    hap_bits_t *hb = hap_bits_init(chunk, valid_var_idx, n_valid_vars, var_i_to_cate, target_var_cate, n_reads, read_ids);
 
     // 1st loop: var-wise loop
     int init_var_i = select_init_var(cand_vars, valid_var_idx, n_valid_vars, var_i_to_cate);
@@ -514,7 +641,7 @@ int assign_hap_based_on_germline_het_vars_kmeans(const call_var_opt_t *opt, bam_
                 if (chunk->is_skipped[read_i] || chunk->haps[read_i] != 0) continue;
                 // this round of assignment may not be correct for all reads, will be updated in the following rounds
                 // 1/2: hap, 0: tied, no hap, -1: no var can be used
-                int hap = init_assign_read_hap_based_on_cons_alle(chunk, read_i, cand_vars, p, var_i_to_cate, target_var_cate);
+                int hap = hap_bits_assign_read_hap(chunk, hb, read_i, cand_vars, p, var_i_to_cate, target_var_cate);
                 if (hap == -1) { // no used vars, new phase set
                     if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "new PS: %" PRIi64 " %s\n", cand_vars[var_i].pos, bam_get_qname(chunk->reads[read_i]));
                     hap = 1;
@@ -523,6 +650,7 @@ int assign_hap_based_on_germline_het_vars_kmeans(const call_var_opt_t *opt, bam_
                 if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "read: %s hap: %d\n", bam_get_qname(chunk->reads[read_i]), hap);
                 // update_var_hap_profile_based_on_read_hap(read_i, hap, cand_vars, p, var_i_to_cate, target_var_cate);
                 update_var_hap_profile_cons_alle_based_on_read_hap(opt, read_i, hap, cand_vars, p, var_i_to_cate, target_var_cate);
+                hap_bits_update_cons(hb, cand_vars, p[read_i].start_var_idx, p[read_i].end_var_idx);
             }
         } free(var_ii); free(ovlp_b);
     }
@@ -533,19 +661,150 @@ int assign_hap_based_on_germline_het_vars_kmeans(const call_var_opt_t *opt, bam_
         // XXX var-wise loop update PS
         // update var->hap_to_cons_alle & var->phase_set
         int changed_hap1 = iter_update_var_hap_cons_phase_set(chunk, valid_var_idx, p, cand_vars, n_valid_vars, var_i_to_cate);
+        if (changed_hap1) hap_bits_update_all_cons(hb, cand_vars, valid_var_idx, n_valid_vars);
         // update
-        int changed_hap2 = iter_update_var_hap_to_cons_alle(opt, chunk, valid_var_idx, n_valid_vars, p, cand_vars, var_i_to_cate, target_var_cate);
+        int changed_hap2 = iter_update_var_hap_to_cons_alle(opt, chunk, hb, n_reads, read_ids, valid_var_idx, n_valid_vars, p, cand_vars, var_i_to_cate, target_var_cate);
         if (changed_hap1 == 0 && changed_hap2 == 0) break;
         else {
             if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "changed_hap1: %d changed_hap2: %d\n", changed_hap1, changed_hap2);
         }
     }
     // update PS for read & var after all iterations
-    update_read_phase_set(chunk, var_is_valid, p, cand_vars);
+    update_read_phase_set(chunk, n_reads, read_ids, var_is_valid, p, cand_vars);
+    hap_bits_destroy(hb);
+}
+
+// this is for germline variant calling only
+// read's PS was assigned using a fake HET (HOM) var
+// goal: 1) assign haplotype + phase set to all reads
+//       2) variant calling based on clustered reads
+int assign_hap_based_on_germline_het_vars_kmeans(const call_var_opt_t *opt, bam_chunk_t *chunk, int target_var_cate) {
+    int n_valid_vars = 0, *valid_var_idx = (int*)malloc(chunk->n_cand_vars * sizeof(int));
+    int *var_is_valid = (int*)calloc(chunk->n_cand_vars, sizeof(int));
+    for (int i = 0; i < chunk->n_cand_vars; ++i) {
+        if ((chunk->var_i_to_cate[i] & target_var_cate) == 0) continue;
+        valid_var_idx[n_valid_vars++] = i;
+        var_is_valid[i] = 1;
+    }
+    if (n_valid_vars > 0)
+        kmeans_phase_vars(opt, chunk, n_valid_vars, valid_var_idx, var_is_valid, chunk->var_i_to_cate, chunk->n_reads, chunk->ordered_read_ids, target_var_cate);
     free(valid_var_idx); free(var_is_valid);
     return 0;
 }
 
+// first valid var (index in valid_var_idx) of the phase set of valid var _var_i
+static int phase_set_first_var(cand_var_t *cand_vars, int *valid_var_idx, int _var_i) {
+    hts_pos_t ps = cand_vars[valid_var_idx[_var_i]].phase_set;
+    if (ps <= 0) return _var_i; // new var, not phased yet
+    while (_var_i > 0 && cand_vars[valid_var_idx[_var_i-1]].phase_set == ps) _var_i--;
+    return _var_i;
+}
+
+static int phase_set_last_var(cand_var_t *cand_vars, int *valid_var_idx, int n_valid_vars, int _var_i) {
+    hts_pos_t ps = cand_vars[valid_var_idx[_var_i]].phase_set;
+    if (ps <= 0) return _var_i;
+    while (_var_i < n_valid_vars-1 && cand_vars[valid_var_idx[_var_i+1]].phase_set == ps) _var_i++;
+    return _var_i;
+}
+
+// re-phase only around the vars within [reg_begs[i], reg_ends[i]] (noisy regions with newly called vars)
+// window: whole phase sets of the vars covered by the reads overlapping the new vars, haps/PS of other reads & vars are kept
+// windows are phased separately; falls back to the whole chunk if windows cover most of the vars
+int assign_hap_based_on_germline_het_vars_kmeans_local(const call_var_opt_t *opt, bam_chunk_t *chunk, int target_var_cate, int n_regs, hts_pos_t *reg_begs, hts_pos_t *reg_ends) {
+    if (chunk->read_var_profile == NULL || chunk->read_var_cr == NULL) return 0;
+    int n_valid_vars = 0, *valid_var_idx = (int*)malloc(chunk->n_cand_vars * sizeof(int));
+    int *var_to_valid_i = (int*)malloc(chunk->n_cand_vars * sizeof(int)); // -1: not valid
+    for (int i = 0; i < chunk->n_cand_vars; ++i) {
+        var_to_valid_i[i] = -1;
+        if ((chunk->var_i_to_cate[i] & target_var_cate) == 0) continue;
+        var_to_valid_i[i] = n_valid_vars;
+        valid_var_idx[n_valid_vars++] = i;
+    }
+    if (n_valid_vars == 0 || n_regs == 0) {
+        free(valid_var_idx); free(var_to_valid_i);
+        return 0;
+    }
+    cand_var_t *cand_vars = chunk->cand_vars; read_var_profile_t *p = chunk->read_var_profile; cgranges_t *read_var_cr = chunk->read_var_cr;
+    int64_t ovlp_i, ovlp_n, *ovlp_b = 0, max_b = 0;
+    // 1. windows: [win_begs[i], win_ends[i]] in valid_var_idx, one for each region
+    int n_wins = 0, *win_begs = (int*)malloc(n_regs * sizeof(int)), *win_ends = (int*)malloc(n_regs * sizeof(int));
+    for (int reg_i = 0; reg_i < n_regs; ++reg_i) {
+        int win_beg = INT32_MAX, win_end = -1, first_i = 0;
+        for (int right = n_valid_vars; first_i < right; ) { // first valid var >= reg_begs[reg_i]-1
+            int mid = first_i + ((right - first_i) >> 1);
+            if (cand_vars[valid_var_idx[mid]].pos < reg_begs[reg_i]-1) first_i = mid + 1;
+            else right = mid;
+        }
+        for (int _var_i = first_i; _var_i < n_valid_vars; ++_var_i) {
+            int var_i = valid_var_idx[_var_i];
+            if (cand_vars[var_i].pos > reg_ends[reg_i]+1) break; // +/-1: indel pos vs. 0/1-based region
+            win_beg = MIN_OF_TWO(win_beg, _var_i); win_end = MAX_OF_TWO(win_end, _var_i);
+            ovlp_n = cr_overlap(read_var_cr, "cr", var_i, var_i+1, &ovlp_b, &max_b);
+            for (ovlp_i = 0; ovlp_i < ovlp_n; ++ovlp_i) {
+                int read_i = cr_label(read_var_cr, ovlp_b[ovlp_i]);
+                if (chunk->is_skipped[read_i]) continue;
+                for (int j = p[read_i].start_var_idx; j <= p[read_i].end_var_idx; ++j) {
+                    if (var_to_valid_i[j] < 0) continue;
+                    win_beg = MIN_OF_TWO(win_beg, var_to_valid_i[j]); break;
+                }
+                for (int j = p[read_i].end_var_idx; j >= p[read_i].start_var_idx; --j) {
+                    if (var_to_valid_i[j] < 0) continue;
+                    win_end = MAX_OF_TWO(win_end, var_to_valid_i[j]); break;
+                }
+            }
+        }
+        if (win_end < 0) continue;
+        // extend to whole phase sets of the first & last phased vars
+        for (int _var_i = win_beg; _var_i <= win_end; ++_var_i) {
+            if (cand_vars[valid_var_idx[_var_i]].phase_set > 0) { win_beg = MIN_OF_TWO(win_beg, phase_set_first_var(cand_vars, valid_var_idx, _var_i)); break; }
+        }
+        for (int _var_i = win_end; _var_i >= win_beg; --_var_i) {
+            if (cand_vars[valid_var_idx[_var_i]].phase_set > 0) { win_end = MAX_OF_TWO(win_end, phase_set_last_var(cand_vars, valid_var_idx, n_valid_vars, _var_i)); break; }
+        }
+        win_begs[n_wins] = win_beg; win_ends[n_wins++] = win_end;
+    }
+    // 2. merge overlapping windows
+    for (int i = 1; i < n_wins; ++i) { // insertion sort by win_beg, n_wins is small
+        int b = win_begs[i], e = win_ends[i], j;
+        for (j = i; j > 0 && win_begs[j-1] > b; --j) { win_begs[j] = win_begs[j-1]; win_ends[j] = win_ends[j-1]; }
+        win_begs[j] = b; win_ends[j] = e;
+    }
+    int n_merged = 0, n_win_vars = 0;
+    for (int i = 0; i < n_wins; ++i) {
+        if (n_merged > 0 && win_begs[i] <= win_ends[n_merged-1]+1) win_ends[n_merged-1] = MAX_OF_TWO(win_ends[n_merged-1], win_ends[i]);
+        else { win_begs[n_merged] = win_begs[i]; win_ends[n_merged++] = win_ends[i]; }
+    }
+    for (int i = 0; i < n_merged; ++i) n_win_vars += win_ends[i] - win_begs[i] + 1;
+    if (n_win_vars * 2 > n_valid_vars) { // not worth it
+        free(ovlp_b); free(win_begs); free(win_ends); free(valid_var_idx); free(var_to_valid_i);
+        return assign_hap_based_on_germline_het_vars_kmeans(opt, chunk, target_var_cate);
+    }
+    if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "LocalRePhase: %s %d windows, %d/%d vars\n", chunk->tname, n_merged, n_win_vars, n_valid_vars);
+    // 3. k-means phasing within each window, vars outside the window are masked
+    int *win_var_i_to_cate = (int*)calloc(chunk->n_cand_vars, sizeof(int)), *var_is_valid = (int*)calloc(chunk->n_cand_vars, sizeof(int));
+    int *read_is_in = (int*)calloc(chunk->n_reads, sizeof(int)), *read_ids = (int*)malloc(chunk->n_reads * sizeof(int));
+    for (int win_i = 0; win_i < n_merged; ++win_i) {
+        int *win_var_idx = valid_var_idx + win_begs[win_i], n_win_vars1 = win_ends[win_i] - win_begs[win_i] + 1;
+        for (int i = 0; i < n_win_vars1; ++i) {
+            win_var_i_to_cate[win_var_idx[i]] = chunk->var_i_to_cate[win_var_idx[i]]; var_is_valid[win_var_idx[i]] = 1;
+        }
+        ovlp_n = cr_overlap(read_var_cr, "cr", win_var_idx[0], win_var_idx[n_win_vars1-1]+1, &ovlp_b, &max_b);
+        for (ovlp_i = 0; ovlp_i < ovlp_n; ++ovlp_i) read_is_in[cr_label(read_var_cr, ovlp_b[ovlp_i])] = 1;
+        int n_win_reads = 0;
+        for (int i = 0; i < chunk->n_reads; ++i) {
+            int read_i = chunk->ordered_read_ids[i];
+            if (read_is_in[read_i]) { read_ids[n_win_reads++] = read_i; read_is_in[read_i] = 0; }
+        }
+        kmeans_phase_vars(opt, chunk, n_win_vars1, win_var_idx, var_is_valid, win_var_i_to_cate, n_win_reads, read_ids, target_var_cate);
+        for (int i = 0; i < n_win_vars1; ++i) {
+            win_var_i_to_cate[win_var_idx[i]] = 0; var_is_valid[win_var_idx[i]] = 0;
+        }
+    }
+    free(ovlp_b); free(win_begs); free(win_ends); free(valid_var_idx); free(var_to_valid_i);
+    free(win_var_i_to_cate); free(var_is_valid); free(read_is_in); free(read_ids);
+    return 0;
+}
+
 static int add_phase_set(hts_pos_t ps, hts_pos_t *uniq_phase_sets, int *n_uniq_phase_sets) {
     int i;
     for (i = 0; i < *n_uniq_phase_sets; ++i) {
@@ -746,13 +1005,13 @@ int digar1_is_homopolymer_error(bam_chunk_t *chunk, digar_t *digar, digar1_t *di
         *qi_hp_start = digar1->qi; *qi_hp_end = digar1->qi + digar1->len - 1;
         int i = digar1->qi-1;
         while (i >= 0) {
-            if (seq_nt16_int[bam_seqi(digar->bseq, i)] != ins_base0) break; // not a homopolymer
+            if (digar->seq[i] != ins_base0) break; // not a homopolymer
             *qi_hp_start = i;
             i--;
         }
         i = digar1->qi+ digar1->len;
         while (i < digar->qlen) {
-            if (seq_nt16_int[bam_seqi(digar->bseq, i)] != ins_base0) break; // not a homopolymer
+            if (digar->seq[i] != ins_base0) break; // not a homopolymer
             *qi_hp_end = i;
             i++;
         }
@@ -769,13 +1028,13 @@ int digar1_is_homopolymer_error(bam_chunk_t *chunk, digar_t *digar, digar1_t *di
         *qi_hp_start = digar1->qi; *qi_hp_end = digar1->qi;
         int i = digar1->qi-1;
         while (i >= 0) {
-            if (seq_nt16_int[bam_seqi(digar->bseq, i)] != del_base0) break; // not a homopolymer
+            if (digar->seq[i] != del_base0) break; // not a homopolymer
             *qi_hp_start = i;
             i--;
         }
         i = digar1->qi;
         while (i < digar->qlen) {
-            if (seq_nt16_int[bam_seqi(digar->bseq, i)] != del_base0) break; // not a homopolymer
+            if (digar->seq[i] != del_base0) break; // not a homopolymer
             *qi_hp_end = i;
             i++;
         }
@@ -861,7 +1120,7 @@ int collect_noisy_read_info1(const call_var_opt_t *opt, bam_chunk_t *chunk, int
     // if (2*(reg_read_end-reg_read_beg+1) < (reg_end-reg_beg+1)) return 0;
     (*read_seqs) = (uint8_t*)malloc((reg_read_end - reg_read_beg + 1) * sizeof(uint8_t));
     for (int j = reg_read_beg; j <= reg_read_end; ++j) {
-        (*read_seqs)[j-reg_read_beg] = seq_nt16_int[bam_seqi(read_digars->bseq, j)];
+        (*read_seqs)[j-reg_read_beg] = read_digars->seq[j];
     }
     (*read_len) = reg_read_end - reg_read_beg + 1;
     (*fully_covers) = cover;
@@ -969,18 +1228,18 @@ int var_low_comp_reg_has_error(bam_chunk_t *chunk, int var_i, digar_t *digar, ht
     return 0;
 }
 
-int is_diff_between_ref_hap_aln(const call_var_opt_t *opt, uint8_t *read_reg_seq, int read_reg_len, uint8_t *hap_reg_seq, int hap_reg_len, uint8_t *ref_reg_seq, int ref_reg_len, int alt_ref_pos) {
+int is_diff_between_ref_hap_aln(const call_var_opt_t *opt, wfa_pool_t *pool, uint8_t *read_reg_seq, int read_reg_len, uint8_t *hap_reg_seq, int hap_reg_len, uint8_t *ref_reg_seq, int ref_reg_len, int alt_ref_pos) {
     int is_diff = 0;
     // wfa alignment between read_reg_seq and hap_reg_seq
     uint8_t *read_hap_aln_str, *read_ref_aln_str, *hap_aln_str, *ref_aln_str;
     int hap_aln_len = 0, ref_aln_len = 0;
-    wfa_end2end_aln(hap_reg_seq, hap_reg_len, read_reg_seq, read_reg_len,
-                    opt->gap_aln, opt->mismatch, opt->gap_open1, opt->gap_ext1, opt->gap_open2, opt->gap_ext2, LONGCALLD_WFA_ADAPTIVE, LONGCALLD_WFA_AFFINE_1P, // wf-adaptive, affine-1p
-                    NULL, NULL, &hap_aln_str, &read_hap_aln_str, &hap_aln_len);
+    wfa_end2end_aln(pool, hap_reg_seq, hap_reg_len, read_reg_seq, read_reg_len,
+                    opt->gap_aln, LONGCALLD_WFA_ADAPTIVE, LONGCALLD_WFA_AFFINE_1P, // wf-adaptive, affine-1p
+                    NULL, NULL, &hap_aln_str, &read_hap_aln_str, &hap_aln_len, NULL);
     // wfa alignment between read_reg_seq and ref_reg_seq
-    wfa_end2end_aln(ref_reg_seq, ref_reg_len, read_reg_seq, read_reg_len,
-                    opt->gap_aln, opt->mismatch, opt->gap_open1, opt->gap_ext1, opt->gap_open2, opt->gap_ext2, LONGCALLD_WFA_ADAPTIVE, LONGCALLD_WFA_AFFINE_1P, // wf-adaptive, affine-1p
-                    NULL, NULL, &ref_aln_str, &read_ref_aln_str, &ref_aln_len);
+    wfa_end2end_aln(pool, ref_reg_seq, ref_reg_len, read_reg_seq, read_reg_len,
+                    opt->gap_aln, LONGCALLD_WFA_ADAPTIVE, LONGCALLD_WFA_AFFINE_1P, // wf-adaptive, affine-1p
+                    NULL, NULL, &ref_aln_str, &read_ref_aln_str, &ref_aln_len, NULL);
     // check if the alignment at position alt_qi is the same or not
     int hap_aln_i = -1, ref_aln_i = -1;
     int read_aln_i = -1, alt_read_pos = -1;
@@ -1049,7 +1308,7 @@ int var_is_homopolymer_error(const call_var_opt_t *opt, bam_chunk_t *chunk, int
         if (allele_i != 1) continue;
         // last_pos ... var_pos-1
         if (var_end + 1 > last_pos) {
-            for (hts_pos_t j = last_pos; j < var_pos; ++j) hap_reg_seq[hap_reg_len++] = nst_nt4_table[(int)chunk->ref_seq[j - chunk->ref_beg]];
+            for (hts_pos_t j = last_pos; j < var_pos; ++j) hap_reg_seq[hap_reg_len++] = chunk->ref_bseq[j - chunk->ref_beg];
             // alt_seq
             for (int j = 0; j < var->alt_len; ++j) hap_reg_seq[hap_reg_len++] = var->alt_seq[j];
             // update last_pos as var_end + 1
@@ -1058,16 +1317,16 @@ int var_is_homopolymer_error(const call_var_opt_t *opt, bam_chunk_t *chunk, int
     }
     // last_pos ... ref_reg_end
     for (hts_pos_t j = last_pos; j <= ref_reg_end; ++j) {
-        hap_reg_seq[hap_reg_len++] = nst_nt4_table[(int)chunk->ref_seq[j - chunk->ref_beg]];
+        hap_reg_seq[hap_reg_len++] = chunk->ref_bseq[j - chunk->ref_beg];
     }
     int ref_reg_len = 0;
     for (hts_pos_t j = ref_reg_beg; j <= ref_reg_end; ++j) {
-        ref_reg_seq[ref_reg_len++] = nst_nt4_table[(int)chunk->ref_seq[j - chunk->ref_beg]];
+        ref_reg_seq[ref_reg_len++] = chunk->ref_bseq[j - chunk->ref_beg];
     }
     int is_hp_compresed = is_hp_compressed_match(read_reg_seq, read_reg_len, hap_reg_seq, hap_reg_len);
     int is_diff_between_ref_cons_aln = 0;
     if (is_hp_compresed == 0)
-       is_diff_between_ref_cons_aln = is_diff_between_ref_hap_aln(opt, read_reg_seq, read_reg_len, hap_reg_seq, hap_reg_len, ref_reg_seq, ref_reg_len, alt_ref_pos);
+       is_diff_between_ref_cons_aln = is_diff_between_ref_hap_aln(opt, chunk->wfa_pool, read_reg_seq, read_reg_len, hap_reg_seq, hap_reg_len, ref_reg_seq, ref_reg_len, alt_ref_pos);
     // fprintf(stderr, "ref_seq: ");
     // for (int i = 0; i < ref_reg_len; ++i) {
     //     fprintf(stderr, "%c", "ACGTN-"[ref_reg_seq[i]]);
@@ -1277,7 +1536,7 @@ int low_comp_ins_comp_var(const call_var_opt_t *opt, bam_chunk_t *chunk, cand_va
         if (large_ins_len < small_ins_len) return 0; // not low_comp_ins
         // if ((vntr_fuzzy_comp_seq(opt, large_var->alt_seq, large_var->alt_len, small_var->alt_seq, small_var->alt_len) == 0)) return 0;
         int diff_len = 0; uint8_t *diff_seq = 0;
-        diff_len = wfa_collect_diff_ins_seq(opt, large_var->alt_seq, large_var->alt_len, small_var->alt_seq, small_var->alt_len, &diff_seq);
+        diff_len = wfa_collect_diff_ins_seq(opt, chunk->wfa_pool, large_var->alt_seq, large_var->alt_len, small_var->alt_seq, small_var->alt_len, &diff_seq);
         uint64_t *r; int n=0, T=LONGCALLD_SDUST_T, W=LONGCALLD_SDUST_W;
         r = sdust(0, diff_seq, diff_len, T, W, &n);
         int low_comp_len = 0;
@@ -1,6 +1,8 @@
 #ifndef LONGCALLD_ASSIGN_HAP_H
 #define LONGCALLD_ASSIGN_HAP_H
 
+#include "htslib/hts.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -10,6 +12,7 @@ struct call_var_opt_t;
 struct cand_somatic_var_aux_info_t;
 
 int assign_hap_based_on_germline_het_vars_kmeans(const struct call_var_opt_t *opt, struct bam_chunk_t *chunk, int target_var_cate);
+int assign_hap_based_on_germline_het_vars_kmeans_local(const struct call_var_opt_t *opt, struct bam_chunk_t *chunk, int target_var_cate, int n_regs, hts_pos_t *reg_begs, hts_pos_t *reg_ends);
 int assign_somatic_hap_based_on_phased_reads(const struct call_var_opt_t *opt, struct bam_chunk_t *chunk, int target_var_cate);
 void free_somatic_var_aux_info(struct cand_somatic_var_aux_info_t *aux_info);
 
@@ -6,31 +6,35 @@
 #include "collect_var.h"
 #include "call_var_main.h"
 #include "sdust.h"
+#include "ref_pac.h"
+#include "kalloc.h"
 
 extern int LONGCALLD_VERBOSE;
 
 
-static read_var_profile_t *init_read_var_profile_inner(int n_reads, int *read_ids, int n_total_vars) {
-    size_t n_profile_bytes = (size_t)n_reads * sizeof(read_var_profile_t);
-    size_t n_var_values = (size_t)n_reads * (size_t)n_total_vars;
-    size_t n_value_bytes = n_var_values * sizeof(int);
-    uint8_t *raw = (uint8_t*)malloc(n_profile_bytes + n_value_bytes * 2);
-    read_var_profile_t *p = (read_var_profile_t*)raw;
-    int *alleles = NULL, *alt_qi = NULL;
+#define read_var_pool_alt_qi(pool, i) ((int32_t*)(pool)->blocks[i])
+#define read_var_pool_alleles(pool, i) ((int8_t*)((pool)->blocks[i] + (pool)->block_m[i] * sizeof(int32_t)))
 
-    if (p == NULL) return NULL;
+// pool header and read entries share one allocation, bands are allocated on demand
+static read_var_profile_t *init_read_var_profile_inner(int n_reads, int *read_ids, int n_total_vars) {
+    size_t n_pool_bytes = (sizeof(read_var_pool_t) + 15) & ~(size_t)15;
+    uint8_t *raw = (uint8_t*)malloc(n_pool_bytes + (size_t)n_reads * sizeof(read_var_profile_t));
+    if (raw == NULL) return NULL;
+    read_var_pool_t *pool = (read_var_pool_t*)raw;
+    read_var_profile_t *p = (read_var_profile_t*)(raw + n_pool_bytes);
 
-    alleles = (int*)(raw + n_profile_bytes);
-    alt_qi = alleles + n_var_values;
-    memset(alleles, 0xFF, n_value_bytes);
-    memset(alt_qi, 0xFF, n_value_bytes);
+    memset(pool, 0, sizeof(read_var_pool_t));
+    size_t n_var_values = (size_t)n_reads * (size_t)n_total_vars;
+    pool->block_size = MIN_OF_TWO(n_var_values, LONGCALLD_READ_VAR_POOL_BLOCK_SIZE);
+    if (pool->block_size < 16) pool->block_size = 16;
 
     for (int i = 0; i < n_reads; ++i) {
         p[i].read_id = (read_ids == NULL ? i : read_ids[i]);
         p[i].start_var_idx = -1;
         p[i].end_var_idx = -2;
-        p[i].alleles = alleles + (size_t)i * (size_t)n_total_vars;
-        p[i].alt_qi = alt_qi + (size_t)i * (size_t)n_total_vars;
+        p[i].band_cap = 0;
+        p[i].alleles = NULL; p[i].alt_qi = NULL;
+        p[i].pool = pool;
     }
     return p;
 }
@@ -45,7 +49,55 @@ read_var_profile_t *init_read_var_profile_with_ids(int n_reads, int *read_ids, i
 
 void free_read_var_profile(read_var_profile_t *p, int n_reads) {
     (void)n_reads;
-    free(p);
+    if (p == NULL) return;
+    size_t n_pool_bytes = (sizeof(read_var_pool_t) + 15) & ~(size_t)15;
+    read_var_pool_t *pool = (read_var_pool_t*)((uint8_t*)p - n_pool_bytes);
+    for (int i = 0; i < pool->n_blocks; ++i) free(pool->blocks[i]);
+    free(pool->blocks); free(pool->block_n); free(pool->block_m);
+    free(pool);
+}
+
+// grow read's band to hold at least `cap` entries, new entries are set as -1
+// band at the tail of the last block is extended in place, otherwise it is moved to the tail
+static void read_var_profile_grow_band(read_var_profile_t *p1, int cap) {
+    read_var_pool_t *pool = p1->pool;
+    int last = pool->n_blocks - 1;
+    if (last >= 0 && p1->band_cap > 0 && p1->alleles + p1->band_cap == read_var_pool_alleles(pool, last) + pool->block_n[last]
+        && pool->block_m[last] - pool->block_n[last] >= (size_t)(cap - p1->band_cap)) {
+        memset(p1->alleles + p1->band_cap, 0xFF, (cap - p1->band_cap) * sizeof(int8_t));
+        memset(p1->alt_qi + p1->band_cap, 0xFF, (cap - p1->band_cap) * sizeof(int32_t));
+        pool->block_n[last] += cap - p1->band_cap;
+        p1->band_cap = cap;
+        return;
+    }
+    int new_cap = MAX_OF_TWO(cap, p1->band_cap * 2);
+    if (last < 0 || pool->block_m[last] - pool->block_n[last] < (size_t)new_cap) {
+        if (pool->n_blocks == pool->m_blocks) {
+            pool->m_blocks = pool->m_blocks == 0 ? 4 : pool->m_blocks * 2;
+            pool->blocks = (uint8_t**)realloc(pool->blocks, pool->m_blocks * sizeof(uint8_t*));
+            pool->block_n = (size_t*)realloc(pool->block_n, pool->m_blocks * sizeof(size_t));
+            pool->block_m = (size_t*)realloc(pool->block_m, pool->m_blocks * sizeof(size_t));
+        }
+        last = pool->n_blocks++;
+        pool->block_m[last] = MAX_OF_TWO(pool->block_size, (size_t)new_cap);
+        pool->block_n[last] = 0;
+        pool->blocks[last] = (uint8_t*)_err_malloc(pool->block_m[last] * (sizeof(int32_t) + sizeof(int8_t)));
+    }
+    int8_t *alleles = read_var_pool_alleles(pool, last) + pool->block_n[last];
+    int32_t *alt_qi = read_var_pool_alt_qi(pool, last) + pool->block_n[last];
+    if (p1->band_cap > 0) {
+        memcpy(alleles, p1->alleles, p1->band_cap * sizeof(int8_t));
+        memcpy(alt_qi, p1->alt_qi, p1->band_cap * sizeof(int32_t));
+    }
+    memset(alleles + p1->band_cap, 0xFF, (new_cap - p1->band_cap) * sizeof(int8_t));
+    memset(alt_qi + p1->band_cap, 0xFF, (new_cap - p1->band_cap) * sizeof(int32_t));
+    pool->block_n[last] += new_cap;
+    p1->alleles = alleles; p1->alt_qi = alt_qi; p1->band_cap = new_cap;
+}
+
+// make room for `cap` entries, existing entries keep their offsets in the band
+void reserve_read_var_profile_band(read_var_profile_t *p1, int cap) {
+    if (cap > p1->band_cap) read_var_profile_grow_band(p1, cap);
 }
 
 int has_equal_X_in_bam_cigar(bam1_t *read) {
@@ -87,15 +139,17 @@ char *get_aux_str_from_bam(bam1_t *b, const char *tag) {
     return (char*)s;
 }
 
-static void longcalld_copy_digar_read_buffers(bam_chunk_t *chunk, bam1_t *read, digar_t *digar) {
+// boundary reads handed to the downstream chunk outlive this chunk's arena
+static void longcalld_copy_digar_read_buffers(bam_chunk_t *chunk, int read_i, bam1_t *read, digar_t *digar) {
     uint32_t qlen = read->core.l_qseq;
-    size_t packed_bseq_bytes = ((size_t)qlen + 1) / 2;
+    const uint8_t *bseq = bam_get_seq(read);
+    void *km = chunk->digar_is_shared[read_i] ? NULL : chunk->km;
 
     digar->qlen = qlen;
-    digar->bseq = packed_bseq_bytes > 0 ? (uint8_t *)malloc(packed_bseq_bytes) : NULL;
-    if (packed_bseq_bytes > 0) memcpy(digar->bseq, bam_get_seq(read), packed_bseq_bytes);
+    digar->seq = qlen > 0 ? (uint8_t *)kmalloc(km, (size_t)qlen) : NULL;
+    for (uint32_t i = 0; i < qlen; ++i) digar->seq[i] = seq_nt16_int[bam_seqi(bseq, i)];
 
-    digar->qual = qlen > 0 ? (uint8_t *)malloc((size_t)qlen) : NULL;
+    digar->qual = qlen > 0 ? (uint8_t *)kmalloc(km, (size_t)qlen) : NULL;
     if (qlen > 0) memcpy(digar->qual, bam_get_qual(read), (size_t)qlen);
     for (uint32_t i = 0; i < qlen; ++i) {
         chunk->qual_counts[digar->qual[i]]++;
@@ -250,6 +304,7 @@ void update_read_var_profile_with_allele(int var_i, int allele_i, int alt_qi, re
     if (read_var_profile->start_var_idx == -1) read_var_profile->start_var_idx = var_i;
     read_var_profile->end_var_idx = var_i;
     int _var_i = var_i - read_var_profile->start_var_idx;
+    if (_var_i >= read_var_profile->band_cap) read_var_profile_grow_band(read_var_profile, _var_i+1);
     read_var_profile->alleles[_var_i] = allele_i; // ref:0, alt:1~n, or -1: not ref/alt
     read_var_profile->alt_qi[_var_i] = alt_qi; // position of alt base in read, -1 if not alt
 }
@@ -561,34 +616,7 @@ int same_digar1(digar1_t d1, digar1_t d2) {
     } return 0; // diff
 }
 
-// allocate new memory for alt_seq, instead of using the pointer directly
-digar1_t *push_digar_alt_seq(digar1_t *digar, int *n_digar, int *m_digar, digar1_t d) {
-    if (d.len <= 0) return digar; // no need to push
-    if (*n_digar == 0 || same_digar1(digar[*n_digar-1], d) == 0) { // not the same as the last digar
-        if (*n_digar == *m_digar) {
-            *m_digar = *m_digar ? (*m_digar << 1) : 4;
-            digar = (digar1_t*)realloc(digar, *m_digar * sizeof(digar1_t));
-        }
-        digar[*n_digar].pos = d.pos; digar[*n_digar].type = d.type;
-        digar[*n_digar].len = d.len; digar[*n_digar].alt_seq = NULL;
-        if (d.type == BAM_CDIFF || d.type == BAM_CINS) {
-            digar[*n_digar].alt_seq = (uint8_t*)malloc(d.len * sizeof(uint8_t));
-            for (int i = 0; i < d.len; ++i) digar[*n_digar].alt_seq[i] =  d.alt_seq[i];
-        }
-        digar[*n_digar].qi = d.qi; digar[*n_digar].is_low_qual = d.is_low_qual;
-        (*n_digar)++;
-    } else {
-        if (digar[*n_digar-1].type == BAM_CINS) {
-            uint8_t *alt_seq = (uint8_t*)realloc(digar[*n_digar-1].alt_seq, (digar[*n_digar-1].len + d.len) * sizeof(uint8_t));
-            for (int i = digar[*n_digar-1].len; i < digar[*n_digar-1].len + d.len; ++i)
-                alt_seq[i] = d.alt_seq[i - digar[*n_digar-1].len];
-            digar[*n_digar-1].alt_seq = alt_seq;
-        }
-        digar[*n_digar-1].len += d.len; // merge INS/DEL with the last digar
-    }
-    return digar; // return the new digar pointer
-}
-
+// alt_seq of X/I is a view into the read's seq, so merging an INS with the last one only extends len
 digar1_t *push_digar0(digar1_t *digar, int *n_digar, int *m_digar, digar1_t d) {
     if (d.len <= 0) return digar;
     if (*n_digar == 0 || same_digar1(digar[*n_digar-1], d) == 0) { // not the same as the last digar
@@ -600,27 +628,10 @@ digar1_t *push_digar0(digar1_t *digar, int *n_digar, int *m_digar, digar1_t d) {
         digar[*n_digar].len = d.len; digar[*n_digar].alt_seq = d.alt_seq;
         digar[*n_digar].qi = d.qi; digar[*n_digar].is_low_qual = d.is_low_qual;
         (*n_digar)++;
-    } else {
-        if (digar[*n_digar-1].type == BAM_CINS) {
-            uint8_t *alt_seq = (uint8_t*)realloc(digar[*n_digar-1].alt_seq, (digar[*n_digar-1].len + d.len) * sizeof(uint8_t));
-            for (int i = digar[*n_digar-1].len; i < digar[*n_digar-1].len + d.len; ++i) 
-                alt_seq[i] = d.alt_seq[i - digar[*n_digar-1].len];
-            digar[*n_digar-1].alt_seq = alt_seq;
-            free(d.alt_seq); // free the new alt_seq
-        }
-        digar[*n_digar-1].len += d.len; // merge INS/DEL with the last digar
-    }
+    } else digar[*n_digar-1].len += d.len; // merge INS/DEL with the last digar
     return digar; // return the new digar pointer
 }
 
-void push_digar1(digar_t *digar, digar1_t d) {
-    _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
-    digar->digars[digar->n_digar].pos = d.pos; digar->digars[digar->n_digar].type = d.type;
-    digar->digars[digar->n_digar].len = d.len; digar->digars[digar->n_digar].alt_seq = d.alt_seq;
-    digar->digars[digar->n_digar].qi = d.qi; digar->digars[digar->n_digar].is_low_qual = d.is_low_qual;
-    digar->n_digar++;
-}
-
 void print_digar1(digar1_t *digars, int n_digar, FILE *fp) {
     fprintf(fp, "pos\ttype\tlen\tqi\tbase\tis_low_qual\n");
     for (int i = 0; i < n_digar; ++i) {
@@ -702,16 +713,13 @@ int collect_digar_from_eqx_cigar(bam_chunk_t *chunk, int read_i, const struct ca
     bam1_t *read = chunk->reads[read_i];
     hts_pos_t pos = read->core.pos+1, qi = 0;
     const uint32_t *cigar = bam_get_cigar(read); int n_cigar = read->core.n_cigar;
-    hts_pos_t reg_beg = chunk->reg_beg, reg_end = chunk->reg_end; cgranges_t *chunk_noisy_regs = chunk->chunk_noisy_regs;
     int max_s = opt->noisy_reg_max_xgaps, win = opt->noisy_reg_slide_win;
     double max_noisy_frac_per_read = opt->max_noisy_frac_per_read, max_var_ratio_per_read = opt->max_var_ratio_per_read;
     int end_clip_reg = opt->end_clip_reg, end_clip_reg_flank_win = opt->end_clip_reg_flank_win;
     digar->n_digar = 0; digar->m_digar = 2 * n_cigar; digar->digars = (digar1_t*)malloc(n_cigar * 2 * sizeof(digar1_t));
     digar->noisy_regs = cr_init();
     digar->beg = pos; digar->end = bam_endpos(read); digar->is_rev = bam_is_rev(read);
-    uint32_t qlen = read->core.l_qseq;
-    longcalld_copy_digar_read_buffers(chunk, read, digar);
-    int _n_digar = 0, _m_digar = 2 * n_cigar; digar1_t *_digars = (digar1_t*)malloc(_m_digar * sizeof(digar1_t));
+    longcalld_copy_digar_read_buffers(chunk, read_i, read, digar);
     int rlen = bam_cigar2rlen(n_cigar, cigar); int tlen = chunk->whole_ref_len;
     xid_queue_t *q = init_xid_queue(rlen, max_s, win); // for noisy region
     hts_pos_t noisy_start = -1, noisy_end = -1; int cr_q_start = -1, cr_q_end = -1;
@@ -727,36 +735,34 @@ int collect_digar_from_eqx_cigar(bam_chunk_t *chunk, int read_i, const struct ca
         int op = bam_cigar_op(cigar[i]), len = bam_cigar_oplen(cigar[i]);
         if (op == BAM_CDIFF) {
             for (int j = 0; j < len; ++j) {
-                _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                uint8_t *x_seq = (uint8_t*)malloc(sizeof(uint8_t));
-                x_seq[0] = seq_nt16_int[bam_seqi(digar->bseq, qi)];
+                _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                uint8_t *x_seq = digar->seq + qi;
                 if (digar->qual[qi] >= opt->min_bq) { // skip low-quality bases for noisy regions
                     push_xid_size_queue_win(q, pos, 1, 1, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                    set_digar(_digars+_n_digar, pos, op, 1, qi, 0, x_seq);
-                } else set_digar(_digars+_n_digar, pos, op, 1, qi, 1, x_seq);
-                _n_digar++; // push_xid_queue(q, pos, 1, 1);
+                    set_digar(digar->digars+digar->n_digar, pos, op, 1, qi, 0, x_seq);
+                } else set_digar(digar->digars+digar->n_digar, pos, op, 1, qi, 1, x_seq);
+                digar->n_digar++; // push_xid_queue(q, pos, 1, 1);
                 n_total_cand_vars++;
                 pos++; qi++;
             }
         } else if (op == BAM_CEQUAL) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-            set_digar(_digars+_n_digar, pos, op, len, qi, 0, NULL);
-            _n_digar++; // push_xid_queue(q, pos, 0, 0);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+            set_digar(digar->digars+digar->n_digar, pos, op, len, qi, 0, NULL);
+            digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
             // push_xid_queue_win(q, pos, len, 0, digar->noisy_regs, &noisy_start, &noisy_end);
             pos += len; qi += len;
         } else if (op == BAM_CDEL) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             if ((qi == 0 || digar->qual[qi-1] >= opt->min_bq) && digar->qual[qi] >= opt->min_bq) {
                 push_xid_size_queue_win(q, pos, len, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                set_digar(_digars+_n_digar, pos, op, len, qi, 0, NULL);
-            } else set_digar(_digars+_n_digar, pos, op, len, qi, 1, NULL);
-            _n_digar++; // push_xid_queue(q, pos, len, 1);
+                set_digar(digar->digars+digar->n_digar, pos, op, len, qi, 0, NULL);
+            } else set_digar(digar->digars+digar->n_digar, pos, op, len, qi, 1, NULL);
+            digar->n_digar++; // push_xid_queue(q, pos, len, 1);
             n_total_cand_vars++;
             pos += len;
         } else if (op == BAM_CINS) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-            uint8_t *ins_seq = (uint8_t*)malloc(len * sizeof(uint8_t));
-            for (int j = 0; j < len; ++j) ins_seq[j] = seq_nt16_int[bam_seqi(digar->bseq, qi+j)];
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+            uint8_t *ins_seq = digar->seq + qi;
             int is_low_qual = 1;
             for (int _i = 0; _i < len; ++_i) {
                 if (digar->qual[qi+_i] >= opt->min_bq) {
@@ -764,16 +770,16 @@ int collect_digar_from_eqx_cigar(bam_chunk_t *chunk, int read_i, const struct ca
                 }
             }
             if (!is_low_qual) push_xid_size_queue_win(q, pos, 0, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-            set_digar(_digars+_n_digar, pos, op, len, qi, is_low_qual, ins_seq); // insertion
-            _n_digar++; // push_xid_queue(q, pos, 0, 1);
+            set_digar(digar->digars+digar->n_digar, pos, op, len, qi, is_low_qual, ins_seq); // insertion
+            digar->n_digar++; // push_xid_queue(q, pos, 0, 1);
             n_total_cand_vars++;
             qi += len;
         } else if (op == BAM_CSOFT_CLIP || op == BAM_CHARD_CLIP) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             if ((i == 0 && left_clip_is_palindrome) || (i != 0 && right_clip_is_palindrome))
-                set_digar(_digars+_n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindrome
-            else set_digar(_digars+_n_digar, pos, op, len, qi, 0, NULL); // clipping
-            _n_digar++; // push_xid_queue(q, pos, 0, 0);
+                set_digar(digar->digars+digar->n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindrome
+            else set_digar(digar->digars+digar->n_digar, pos, op, len, qi, 0, NULL); // clipping
+            digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
             // skip checking noisy region for clipping close to start/end of chromosome/contig: within 10bp
             if ((i == 0 && pos > 10) || (i != 0 && pos < tlen - 10)) {
                 if (len > end_clip_reg) {
@@ -793,9 +799,6 @@ int collect_digar_from_eqx_cigar(bam_chunk_t *chunk, int read_i, const struct ca
             _err_error_exit("CIGAR operation 'M' is not expected in EQX CIGAR: %s\n", bam_get_qname(read));
         }
     }
-    for (int i = 0; i < _n_digar; ++i) { // XXX not set noisy-region for digars
-        push_digar1(digar, _digars[i]);
-    }
     if (noisy_start != -1) {
         int var_size = 0;
         for (int i = cr_q_start; i <= cr_q_end; ++i) var_size += q->counts[i];
@@ -812,21 +815,7 @@ int collect_digar_from_eqx_cigar(bam_chunk_t *chunk, int read_i, const struct ca
         // fprintf(stderr, "SkipRead: %s %d-noisy %d-var %d-ref_span\n", bam_get_qname(read), total_noisy_reg_len, n_total_cand_vars, mapped_len);
         skip = 1;
     } else {
-        for (int i = 0; i < digar->noisy_regs->n_r; ++i) { // we may double-count reads with multiple nearby noisy regions 
-                                                        // downside is minor, as we just consider an easy region as noisy, variant calling result should not be affected
-                                                        // read1:  ---- [noisy] ---- [noisy] ----
-                                                        // read2:  --------- [  noisy  ] --------
-            if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "NoisyRead %s %s:%d-%d %d\n", bam_get_qname(read), chunk->tname, cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-            if (is_overlap_reg(cr_start(digar->noisy_regs, i)+1, cr_end(digar->noisy_regs, i), reg_beg, reg_end)) {
-                // set cr_label as the largest insertion in noisy region
-                // the insertion size is used to determine the merge_distance:
-                // ins_size: merge_dis
-                //   <= 100: 100
-                //    < 500: ins_size
-                //   >= 500: 500
-                cr_add(chunk_noisy_regs, "cr", cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-            }
-        }
+        // noisy regions are added to chunk_noisy_regs later, see add_digar_noisy_regs_to_chunk
         if (LONGCALLD_VERBOSE >= 3) {
             fprintf(stderr, "DIGAR1: %s\n", bam_get_qname(read));
             print_digar(digar, stderr);
@@ -836,7 +825,7 @@ int collect_digar_from_eqx_cigar(bam_chunk_t *chunk, int read_i, const struct ca
             }
         }
     }
-    free(_digars); free_xid_queue(q);
+    free_xid_queue(q);
     return skip == 1 ? -1 : 0;
 }
 
@@ -847,7 +836,6 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
     if (cs_tag == NULL) { _err_error_exit("cs tag not found in the BAM file: %s", bam_get_qname(read)); }
     const uint32_t *cigar = bam_get_cigar(read); int n_cigar = read->core.n_cigar;
     if (n_cigar <= 0) { _err_error_exit("CIGAR not found in the BAM file: %s", bam_get_qname(read)); }
-    hts_pos_t reg_beg = chunk->reg_beg, reg_end = chunk->reg_end; cgranges_t *chunk_noisy_regs = chunk->chunk_noisy_regs;
     hts_pos_t pos = read->core.pos+1, qi = 0;
     digar->beg = pos; digar->end = bam_endpos(read); digar->is_rev = bam_is_rev(read);
     int max_s = opt->noisy_reg_max_xgaps, win = opt->noisy_reg_slide_win;
@@ -856,9 +844,7 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
 
     digar->n_digar = 0; digar->m_digar = 2 * n_cigar; digar->digars = (digar1_t*)malloc(n_cigar * 2 * sizeof(digar1_t));
     digar->noisy_regs = cr_init();
-    uint32_t qlen = read->core.l_qseq;
-    longcalld_copy_digar_read_buffers(chunk, read, digar);
-    int _n_digar = 0, _m_digar = 2 * n_cigar; digar1_t *_digars = (digar1_t*)malloc(_m_digar * sizeof(digar1_t));
+    longcalld_copy_digar_read_buffers(chunk, read_i, read, digar);
     char *cs = bam_aux2Z(cs_tag);
     int rlen = bam_cigar2rlen(n_cigar, cigar); int tlen = chunk->whole_ref_len;
     xid_queue_t *q = init_xid_queue(rlen, max_s, win);
@@ -875,10 +861,10 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
     // left-end clipping
     if (bam_cigar_op(cigar[0]) == BAM_CSOFT_CLIP || bam_cigar_op(cigar[0]) == BAM_CHARD_CLIP) {
         int len = bam_cigar_oplen(cigar[0]);
-        _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-        if (left_clip_is_palindrome) set_digar(_digars+_n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindrome
-        else set_digar(_digars+_n_digar, pos, bam_cigar_op(cigar[0]), len, qi, 0, NULL); // clipping
-        _n_digar++; // push_xid_queue(q, pos, 0, 0);
+        _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+        if (left_clip_is_palindrome) set_digar(digar->digars+digar->n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindrome
+        else set_digar(digar->digars+digar->n_digar, pos, bam_cigar_op(cigar[0]), len, qi, 0, NULL); // clipping
+        digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
         if (len > end_clip_reg && !left_clip_is_palindrome) {
             if (pos > 10) cr_add(digar->noisy_regs, "cr", pos-1, pos+end_clip_reg_flank_win, 0); // left end
             // if (pos < tlen) cr_add(digar->noisy_regs, "cr", pos-1-end_clip_reg_flank_win, pos, 0); // right end
@@ -888,38 +874,36 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
     }
     while (*cs) {
         if (*cs == ':') { // identical seq length
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             int len = strtol(&cs[1], &cs, 10);
-            set_digar(_digars+_n_digar, pos, BAM_CEQUAL, len, qi, 0, NULL);
-            _n_digar++; // push_xid_queue(q, pos, 0, 0);
+            set_digar(digar->digars+digar->n_digar, pos, BAM_CEQUAL, len, qi, 0, NULL);
+            digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
             pos += len; qi += len;
         } else if (*cs == '=') { // identical sequence
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             cs++; int len = 0;
             while (isalpha(*cs)) {
                 len++; cs++;
             }
-            set_digar(_digars+_n_digar, pos, BAM_CEQUAL, len, qi, 0, NULL);
-            _n_digar++; // push_xid_queue(q, pos, 0, 0);
+            set_digar(digar->digars+digar->n_digar, pos, BAM_CEQUAL, len, qi, 0, NULL);
+            digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
             pos += len; qi += len;
         } else if (*cs == '*') { // mismatch: 1bp
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-            uint8_t *x_seq = (uint8_t*)malloc(sizeof(uint8_t));
-            x_seq[0] = nst_nt4_table[(int)*(cs+2)];
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+            uint8_t *x_seq = digar->seq + qi;
             if (digar->qual[qi] >= opt->min_bq) {
                 push_xid_size_queue_win(q, pos, 1, 1, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                set_digar(_digars+_n_digar, pos, BAM_CDIFF, 1, qi, 0, x_seq);
-            } else set_digar(_digars+_n_digar, pos, BAM_CDIFF, 1, qi, 1, x_seq);
-            _n_digar++; pos++; qi++; cs += 3;
+                set_digar(digar->digars+digar->n_digar, pos, BAM_CDIFF, 1, qi, 0, x_seq);
+            } else set_digar(digar->digars+digar->n_digar, pos, BAM_CDIFF, 1, qi, 1, x_seq);
+            digar->n_digar++; pos++; qi++; cs += 3;
             n_total_cand_vars++;
         } else if (*cs == '+') { // insertion
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             cs++; int len = 0;
             while (isalpha(*cs)) {
                 len++; cs++;
             }
-            uint8_t *ins_seq = (uint8_t*)malloc(len * sizeof(uint8_t));
-            for (int i = 0; i < len; ++i) ins_seq[i] = nst_nt4_table[(int)*(cs-len+i)];
+            uint8_t *ins_seq = digar->seq + qi;
             int is_low_qual = 1;
             for (int _i = 0; _i < len; ++_i) {
                 if (digar->qual[qi+_i] >= opt->min_bq) {
@@ -927,20 +911,20 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
                 }
             }
             if (!is_low_qual) push_xid_size_queue_win(q, pos, 0, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-            set_digar(_digars+_n_digar, pos, BAM_CINS, len, qi, is_low_qual, ins_seq);
-            _n_digar++; qi += len;
+            set_digar(digar->digars+digar->n_digar, pos, BAM_CINS, len, qi, is_low_qual, ins_seq);
+            digar->n_digar++; qi += len;
             n_total_cand_vars++;
         } else if (*cs == '-') { // deletion
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             cs++; int len = 0;
             while (isalpha(*cs)) {
                 len++; cs++;
             }
             if ((qi == 0 || digar->qual[qi-1] >= opt->min_bq) && digar->qual[qi] >= opt->min_bq) {
                 push_xid_size_queue_win(q, pos, len, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                set_digar(_digars+_n_digar, pos, BAM_CDEL, len, qi, 0, NULL);
-            } else set_digar(_digars+_n_digar, pos, BAM_CDEL, len, qi, 1, NULL);
-            _n_digar++; pos += len;
+                set_digar(digar->digars+digar->n_digar, pos, BAM_CDEL, len, qi, 0, NULL);
+            } else set_digar(digar->digars+digar->n_digar, pos, BAM_CDEL, len, qi, 1, NULL);
+            digar->n_digar++; pos += len;
             n_total_cand_vars++;
         } else if (*cs == '~') { // intron/splice
             cs++;
@@ -953,10 +937,10 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
     // right-end clipping
     if (bam_cigar_op(cigar[n_cigar-1]) == BAM_CSOFT_CLIP || bam_cigar_op(cigar[n_cigar-1]) == BAM_CHARD_CLIP) {
         int len = bam_cigar_oplen(cigar[n_cigar-1]);
-        _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-        if (right_clip_is_palindrome) set_digar(_digars+_n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindrome
-        else set_digar(_digars+_n_digar, pos, bam_cigar_op(cigar[n_cigar-1]), len, qi, 0, NULL); // clipping
-        _n_digar++; // push_xid_queue(q, pos, 0, 0);
+        _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+        if (right_clip_is_palindrome) set_digar(digar->digars+digar->n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindrome
+        else set_digar(digar->digars+digar->n_digar, pos, bam_cigar_op(cigar[n_cigar-1]), len, qi, 0, NULL); // clipping
+        digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
         if (len > end_clip_reg && !right_clip_is_palindrome) {
             if (pos < tlen-10) cr_add(digar->noisy_regs, "cr", pos-1-end_clip_reg_flank_win, pos, 0); // right end
             n_total_cand_vars++;
@@ -964,9 +948,6 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
         if (bam_cigar_op(cigar[n_cigar-1]) == BAM_CSOFT_CLIP) qi += len;
     }
 
-    for (int i = 0; i < _n_digar; ++i) {
-        push_digar1(digar, _digars[i]);
-    }
     if (noisy_start != -1) {
         int var_size = 0;
         for (int i = cr_q_start; i <= cr_q_end; ++i) var_size += q->counts[i];
@@ -982,11 +963,7 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
         // fprintf(stderr, "Skip: %s %d-noisy %d-var %d-ref_span\n", bam_get_qname(read), total_noisy_reg_len, n_total_cand_vars, mapped_len);
         skip = 1;
     } else {
-        for (int i = 0; i < digar->noisy_regs->n_r; ++i) {
-            if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "NoisyRead %s %s:%d-%d %d\n", bam_get_qname(read), chunk->tname, cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-            if (is_overlap_reg(cr_start(digar->noisy_regs, i)+1, cr_end(digar->noisy_regs, i), reg_beg, reg_end))
-                cr_add(chunk_noisy_regs, "cr", cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-        }
+        // noisy regions are added to chunk_noisy_regs later, see add_digar_noisy_regs_to_chunk
         if (LONGCALLD_VERBOSE >= 3) {
             fprintf(stderr, "DIGAR2: %s\n", bam_get_qname(read));
             print_digar(digar, stderr);
@@ -996,13 +973,12 @@ int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_
             }
         }
     }
-    free(_digars); free_xid_queue(q);
+    free_xid_queue(q);
     return skip == 1 ? -1 : 0;
 }
 
 int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_var_opt_t *opt, digar_t *digar) {
     bam1_t *read = chunk->reads[read_i];
-    hts_pos_t reg_beg = chunk->reg_beg, reg_end = chunk->reg_end; cgranges_t *chunk_noisy_regs = chunk->chunk_noisy_regs;
     uint8_t *s = bam_aux_get(read, "MD");
     if (s == NULL) { _err_error_exit("MD tag not found in the BAM file: %s", bam_get_qname(read)); }
     hts_pos_t pos = read->core.pos+1, qi = 0;
@@ -1014,9 +990,7 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
 
     digar->n_digar = 0; digar->m_digar = 2 * n_cigar; digar->digars = (digar1_t*)malloc(n_cigar * 2 * sizeof(digar1_t));
     digar->noisy_regs = cr_init();
-    uint32_t qlen = read->core.l_qseq;
-    longcalld_copy_digar_read_buffers(chunk, read, digar);
-    int _n_digar = 0, _m_digar = 2 * n_cigar; digar1_t *_digars = (digar1_t*)malloc(_m_digar * sizeof(digar1_t));
+    longcalld_copy_digar_read_buffers(chunk, read_i, read, digar);
     char *md = bam_aux2Z(s); int md_i = 0;
     // printf("MD: %s\n", md);
     int rlen = bam_cigar2rlen(n_cigar, cigar); int tlen = chunk->whole_ref_len;
@@ -1042,15 +1016,15 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
                 if (last_eq_len > 0) {
                     if (last_eq_len >= m_len) {
                         eq_len = m_len;
-                        _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                        set_digar(_digars+_n_digar, pos, BAM_CEQUAL, eq_len, qi, 0, NULL);
-                        _n_digar++; // push_xid_queue(q, pos, 0, 0);
+                        _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                        set_digar(digar->digars+digar->n_digar, pos, BAM_CEQUAL, eq_len, qi, 0, NULL);
+                        digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
                         pos += eq_len; qi += eq_len;
                         last_eq_len -= m_len; m_len = 0;
                     } else { // last_eq_len < m_len
-                        _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                        set_digar(_digars+_n_digar, pos, BAM_CEQUAL, last_eq_len, qi, 0, NULL);
-                        _n_digar++; // push_xid_queue(q, pos, 0, 0);
+                        _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                        set_digar(digar->digars+digar->n_digar, pos, BAM_CEQUAL, last_eq_len, qi, 0, NULL);
+                        digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
                         pos += last_eq_len; qi += last_eq_len;
                         m_len -= last_eq_len; md_i = 0; // start of the next run
                         last_eq_len = 0;
@@ -1063,21 +1037,20 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
                     } else if (eq_len == 0) {
                         md_i=0; continue;
                     }
-                    _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                    set_digar(_digars+_n_digar, pos, BAM_CEQUAL, eq_len, qi, 0, NULL); // qual unset XXX
-                    _n_digar++; // push_xid_queue(q, pos, 0, 0);
+                    _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                    set_digar(digar->digars+digar->n_digar, pos, BAM_CEQUAL, eq_len, qi, 0, NULL); // qual unset XXX
+                    digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
                     pos += eq_len; qi += eq_len;
                     m_len -= eq_len; md_i = 0; // start of the next run
                 } else if (isalpha(md[md_i])) { // X
                     // if (qual[qi] >= min_bq) {
-                    _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                    uint8_t *x_seq = (uint8_t*)malloc(sizeof(uint8_t));
-                    x_seq[0] = seq_nt16_int[bam_seqi(digar->bseq, qi)];
+                    _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                    uint8_t *x_seq = digar->seq + qi;
                     if (digar->qual[qi] >= opt->min_bq) {
                         push_xid_size_queue_win(q, pos, 1, 1, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                        set_digar(_digars+_n_digar, pos, BAM_CDIFF, 1, qi, 0, x_seq);
-                    } else set_digar(_digars+_n_digar, pos, BAM_CDIFF, 1, qi, 1, x_seq);
-                    _n_digar++; // push_xid_queue(q, pos, 1, 1);
+                        set_digar(digar->digars+digar->n_digar, pos, BAM_CDIFF, 1, qi, 0, x_seq);
+                    } else set_digar(digar->digars+digar->n_digar, pos, BAM_CDIFF, 1, qi, 1, x_seq);
+                    digar->n_digar++; // push_xid_queue(q, pos, 1, 1);
                     n_total_cand_vars++;
                     pos++; qi++; m_len -= 1; 
                     if (md[md_i+1] == '\0' || md[md_i+1] != '0') md_i++;
@@ -1086,12 +1059,12 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
                 if (m_len <= 0) break;
             }
         } else if (op == BAM_CDEL) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             if ((qi == 0 || digar->qual[qi-1] >= opt->min_bq) && digar->qual[qi] >= opt->min_bq) {
                 push_xid_size_queue_win(q, pos, len, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                set_digar(_digars+_n_digar, pos, BAM_CDEL, len, qi, 0, NULL);
-            } else set_digar(_digars+_n_digar, pos, BAM_CDEL, len, qi, 1, NULL);
-            _n_digar++; // push_xid_queue(q, pos, len, 1);
+                set_digar(digar->digars+digar->n_digar, pos, BAM_CDEL, len, qi, 0, NULL);
+            } else set_digar(digar->digars+digar->n_digar, pos, BAM_CDEL, len, qi, 1, NULL);
+            digar->n_digar++; // push_xid_queue(q, pos, len, 1);
             n_total_cand_vars++;
             pos += len;
             // MD
@@ -1099,9 +1072,8 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
             while (md[md_i] && isalpha(md[md_i])) md_i++;
             if (md[md_i] == '0') md_i++; // skip 0 after D
         } else if (op == BAM_CINS) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-            uint8_t *ins_seq = (uint8_t*)malloc(len * sizeof(uint8_t));
-            for (int j = 0; j < len; ++j) ins_seq[j] = seq_nt16_int[bam_seqi(digar->bseq, qi+j)];
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+            uint8_t *ins_seq = digar->seq + qi;
             int is_low_qual = 1;
             for (int _i = 0; _i < len; ++_i) {
                 if (digar->qual[qi+_i] >= opt->min_bq) {
@@ -1109,16 +1081,16 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
                 }
             }
             if (!is_low_qual) push_xid_size_queue_win(q, pos, 0, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-            set_digar(_digars+_n_digar, pos, BAM_CINS, len, qi, is_low_qual, ins_seq); // insertion
-            _n_digar++; // push_xid_queue(q, pos, 0, 1);
+            set_digar(digar->digars+digar->n_digar, pos, BAM_CINS, len, qi, is_low_qual, ins_seq); // insertion
+            digar->n_digar++; // push_xid_queue(q, pos, 0, 1);
             n_total_cand_vars++;
             qi += len;
         } else if (op == BAM_CSOFT_CLIP || op == BAM_CHARD_CLIP) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             if ((i == 0 && left_clip_is_palindrome) || (i != 0 && right_clip_is_palindrome))
-                set_digar(_digars+_n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindromic: using HARD_CLIP
-            else set_digar(_digars+_n_digar, pos, op, len, qi, 0, NULL); // normal clipping
-            _n_digar++; // push_xid_queue(q, pos, 0, 0);
+                set_digar(digar->digars+digar->n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindromic: using HARD_CLIP
+            else set_digar(digar->digars+digar->n_digar, pos, op, len, qi, 0, NULL); // normal clipping
+            digar->n_digar++; // push_xid_queue(q, pos, 0, 0);
             if ((i == 0 && pos > 10) || (i != 0 && pos < tlen - 10)) {
                 if (len > end_clip_reg) {
                     if (i == 0 && !left_clip_is_palindrome) {
@@ -1137,9 +1109,6 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
             _err_error_exit("CIGAR operation '=/X' is not expected: %s\n", bam_get_qname(read));
         }
     }
-    for (int i = 0; i < _n_digar; ++i) {
-        push_digar1(digar, _digars[i]);
-    }
     if (noisy_start != -1) {
         int var_size = 0;
         for (int i = cr_q_start; i <= cr_q_end; ++i) var_size += q->counts[i];
@@ -1155,11 +1124,7 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
         // fprintf(stderr, "Skip: %s %d-noisy %d-var %d-ref_span\n", bam_get_qname(read), total_noisy_reg_len, n_total_cand_vars, mapped_len);
         skip = 1;
     } else {
-        for (int i = 0; i < digar->noisy_regs->n_r; ++i) {
-            if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "NoisyRead %s %s:%d-%d %d\n", bam_get_qname(read), chunk->tname, cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-            if (is_overlap_reg(cr_start(digar->noisy_regs, i)+1, cr_end(digar->noisy_regs, i), reg_beg, reg_end))
-                cr_add(chunk_noisy_regs, "cr", cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-        }
+        // noisy regions are added to chunk_noisy_regs later, see add_digar_noisy_regs_to_chunk
         if (LONGCALLD_VERBOSE >= 3) {
             fprintf(stderr, "DIGAR2: %s\n", bam_get_qname(read));
             print_digar(digar, stderr);
@@ -1169,14 +1134,13 @@ int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_
             }
         }
     }
-    free(_digars); free_xid_queue(q);
+    free_xid_queue(q);
     return skip == 1 ? -1 : 0;
 }
 
 int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call_var_opt_t *opt, digar_t *digar) {
     bam1_t *read = chunk->reads[read_i];
-    char *ref_seq = chunk->ref_seq; hts_pos_t ref_beg = chunk->ref_beg, ref_end = chunk->ref_end;
-    hts_pos_t reg_beg = chunk->reg_beg, reg_end = chunk->reg_end; cgranges_t *chunk_noisy_regs = chunk->chunk_noisy_regs;
+    uint8_t *ref_bseq = chunk->ref_bseq; hts_pos_t ref_beg = chunk->ref_beg, ref_end = chunk->ref_end;
     hts_pos_t pos = read->core.pos+1, qi = 0;
     digar->beg = pos; digar->end = bam_endpos(read); digar->is_rev = bam_is_rev(read);
     const uint32_t *cigar = bam_get_cigar(read); int n_cigar = read->core.n_cigar;
@@ -1186,9 +1150,7 @@ int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call
 
     digar->n_digar = 0; digar->m_digar = 2 * n_cigar; digar->digars = (digar1_t*)malloc(n_cigar * 2 * sizeof(digar1_t));
     digar->noisy_regs = cr_init();
-    uint32_t qlen = read->core.l_qseq;
-    longcalld_copy_digar_read_buffers(chunk, read, digar);
-    int _n_digar = 0, _m_digar = 2 * n_cigar; digar1_t *_digars = (digar1_t*)malloc(_m_digar * sizeof(digar1_t));
+    longcalld_copy_digar_read_buffers(chunk, read_i, read, digar);
     int rlen = bam_cigar2rlen(n_cigar, cigar); int tlen = chunk->whole_ref_len;
     xid_queue_t *q = init_xid_queue(rlen, max_s, win);
     hts_pos_t noisy_start = -1, noisy_end = -1; int cr_q_start = -1, cr_q_end = -1;
@@ -1215,47 +1177,45 @@ int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call
                     }
                     pos++; qi++; continue;
                 }
-                int ref_base = nst_nt4_table[(int)ref_seq[pos-ref_beg]];
-                int read_base = seq_nt16_int[bam_seqi(digar->bseq, qi)];
+                int ref_base = ref_bseq[pos-ref_beg];
+                int read_base = digar->seq[qi];
                 if (ref_base != read_base) {
                     if (eq_len > 0) {
-                        _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                        set_digar(_digars+_n_digar, pos-eq_len, BAM_CEQUAL, eq_len, qi-eq_len, 0, NULL);
-                        _n_digar++; // push_xid_queue(q, pos-eq_len, 0, 0);
+                        _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                        set_digar(digar->digars+digar->n_digar, pos-eq_len, BAM_CEQUAL, eq_len, qi-eq_len, 0, NULL);
+                        digar->n_digar++; // push_xid_queue(q, pos-eq_len, 0, 0);
                         eq_len = 0;
                     }
-                    _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                    uint8_t *x_seq = (uint8_t*)malloc(sizeof(uint8_t));
-                    x_seq[0] = read_base; //seq_nt16_int[bam_seqi(digar->bseq, qi)];
+                    _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                    uint8_t *x_seq = digar->seq + qi;
                     if (digar->qual[qi] >= opt->min_bq) {
                         push_xid_size_queue_win(q, pos, 1, 1, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                        set_digar(_digars+_n_digar, pos, BAM_CDIFF, 1, qi, 0, x_seq);
-                    } else set_digar(_digars+_n_digar, pos, BAM_CDIFF, 1, qi, 1, x_seq);
-                    _n_digar++;
+                        set_digar(digar->digars+digar->n_digar, pos, BAM_CDIFF, 1, qi, 0, x_seq);
+                    } else set_digar(digar->digars+digar->n_digar, pos, BAM_CDIFF, 1, qi, 1, x_seq);
+                    digar->n_digar++;
                     n_total_cand_vars++;
                 } else eq_len++;
                 pos++; qi++;
             }
             if (eq_len > 0) {
-                _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-                set_digar(_digars+_n_digar, pos-eq_len, BAM_CEQUAL, eq_len, qi-eq_len, 0, NULL);
-                _n_digar++; // push_xid_queue(q, pos-eq_len, 0, 0);
+                _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+                set_digar(digar->digars+digar->n_digar, pos-eq_len, BAM_CEQUAL, eq_len, qi-eq_len, 0, NULL);
+                digar->n_digar++; // push_xid_queue(q, pos-eq_len, 0, 0);
                 eq_len = 0;
             }
         } else if (op == BAM_CDEL) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             if ((qi == 0 || digar->qual[qi-1] >= opt->min_bq) && digar->qual[qi] >= opt->min_bq) {
                 push_xid_size_queue_win(q, pos, len, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-                set_digar(_digars+_n_digar, pos, BAM_CDEL, len, qi, 0, NULL);
-            } else set_digar(_digars+_n_digar, pos, BAM_CDEL, len, qi, 1, NULL);
-            _n_digar++; // push_xid_queue(q, pos, len, 1);
+                set_digar(digar->digars+digar->n_digar, pos, BAM_CDEL, len, qi, 0, NULL);
+            } else set_digar(digar->digars+digar->n_digar, pos, BAM_CDEL, len, qi, 1, NULL);
+            digar->n_digar++; // push_xid_queue(q, pos, len, 1);
             n_total_cand_vars++;
             pos += len;
         } else if (op == BAM_CINS) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
-            uint8_t *ins_seq = (uint8_t*)malloc(len * sizeof(uint8_t));
-            for (int j = 0; j < len; ++j) ins_seq[j] = seq_nt16_int[bam_seqi(digar->bseq, qi+j)];
-            // set_digar(_digars+_n_digar, pos, BAM_CINS, len, qi); // insertion
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
+            uint8_t *ins_seq = digar->seq + qi;
+            // set_digar(digar->digars+digar->n_digar, pos, BAM_CINS, len, qi); // insertion
             int is_low_qual = 1;
             for (int _i = 0; _i < len; ++_i) {
                 if (digar->qual[qi+_i] >= opt->min_bq) {
@@ -1263,16 +1223,16 @@ int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call
                 }
             }
             if (!is_low_qual) push_xid_size_queue_win(q, pos, 0, len, digar->noisy_regs, &noisy_start, &noisy_end, &cr_q_start, &cr_q_end);
-            set_digar(_digars+_n_digar, pos, BAM_CINS, len, qi, is_low_qual, ins_seq);
-            _n_digar++; //push_xid_queue(q, pos, 0, 1);
+            set_digar(digar->digars+digar->n_digar, pos, BAM_CINS, len, qi, is_low_qual, ins_seq);
+            digar->n_digar++; //push_xid_queue(q, pos, 0, 1);
             n_total_cand_vars++;
             qi += len;
         } else if (op == BAM_CSOFT_CLIP || op == BAM_CHARD_CLIP) {
-            _uni_realloc(_digars, _n_digar, _m_digar, digar1_t);
+            _uni_realloc(digar->digars, digar->n_digar, digar->m_digar, digar1_t);
             if ((i == 0 && left_clip_is_palindrome) || (i != 0 && right_clip_is_palindrome))
-                set_digar(_digars+_n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindromic: using HARD_CLIP
-            else set_digar(_digars+_n_digar, pos, op, len, qi, 0, NULL); // clipping 
-            _n_digar++; //push_xid_queue(q, pos, 0, 0);
+                set_digar(digar->digars+digar->n_digar, pos, BAM_CHARD_CLIP, len, qi, 0, NULL); // palindromic: using HARD_CLIP
+            else set_digar(digar->digars+digar->n_digar, pos, op, len, qi, 0, NULL); // clipping 
+            digar->n_digar++; //push_xid_queue(q, pos, 0, 0);
             if ((i==0 && pos >10) || (i!=0 && pos < tlen -10))  {
                 if (len > end_clip_reg) {
                     if (i == 0 && !left_clip_is_palindrome) {
@@ -1291,9 +1251,6 @@ int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call
             // _err_error_exit("CIGAR operation '=/X' is not expected: %s\n", bam_get_qname(read));
         // }
     }
-    for (int i = 0; i < _n_digar; ++i) {
-        push_digar1(digar, _digars[i]);
-    }
     if (noisy_start != -1) {
         int var_size = 0;
         for (int i = cr_q_start; i <= cr_q_end; ++i) var_size += q->counts[i];
@@ -1308,11 +1265,7 @@ int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call
     if (total_noisy_reg_len > mapped_len * max_noisy_frac_per_read || n_total_cand_vars > mapped_len * max_var_ratio_per_read) {
         skip = 1;
     } else {
-        for (int i = 0; i < digar->noisy_regs->n_r; ++i) {
-            if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "NoisyRead %s %s:%d-%d %d\n", bam_get_qname(read), chunk->tname, cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-            if (is_overlap_reg(cr_start(digar->noisy_regs, i)+1, cr_end(digar->noisy_regs, i), reg_beg, reg_end))
-                cr_add(chunk_noisy_regs, "cr", cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
-        }
+        // noisy regions are added to chunk_noisy_regs later, see add_digar_noisy_regs_to_chunk
         if (LONGCALLD_VERBOSE >= 3) {
             fprintf(stderr, "DIGAR3: %s\n", bam_get_qname(read));
             print_digar(digar, stderr);
@@ -1322,14 +1275,38 @@ int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call
             }
         }
     }
-    free(_digars); free_xid_queue(q);
+    free_xid_queue(q);
     return skip == 1 ? -1 : 0;
 }
 
-int bam_chunk_init0(bam_chunk_t *chunk, const struct call_var_opt_t *opt, int n_reads, int n_bam) {
+// add the read's noisy regions overlapping the chunk's region to chunk_noisy_regs
+// called for all decoded reads in order, so chunk_noisy_regs does not depend on which reads are reused from the upstream chunk
+void add_digar_noisy_regs_to_chunk(bam_chunk_t *chunk, int read_i) {
+    digar_t *digar = chunk->digars + read_i;
+    for (int i = 0; i < digar->noisy_regs->n_r; ++i) { // we may double-count reads with multiple nearby noisy regions 
+                                                    // downside is minor, as we just consider an easy region as noisy, variant calling result should not be affected
+                                                    // read1:  ---- [noisy] ---- [noisy] ----
+                                                    // read2:  --------- [  noisy  ] --------
+        if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "NoisyRead %s %s:%d-%d %d\n", bam_get_qname(chunk->reads[read_i]), chunk->tname, cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
+        if (is_overlap_reg(cr_start(digar->noisy_regs, i)+1, cr_end(digar->noisy_regs, i), chunk->reg_beg, chunk->reg_end)) {
+            // set cr_label as the largest insertion in noisy region
+            // the insertion size is used to determine the merge_distance:
+            // ins_size: merge_dis
+            //   <= 100: 100
+            //    < 500: ins_size
+            //   >= 500: 500
+            cr_add(chunk->chunk_noisy_regs, "cr", cr_start(digar->noisy_regs, i), cr_end(digar->noisy_regs, i), cr_label(digar->noisy_regs, i));
+        }
+    }
+}
+
+// reads: m_reads read records to be re-used (enlarged to n_reads if needed), allocated if NULL
+int bam_chunk_init0(bam_chunk_t *chunk, const struct call_var_opt_t *opt, int n_reads, int n_bam, bam1_t **reads, int m_reads) {
+    chunk->km = km_init();
     // input
     chunk->n_reads = 0; chunk->m_reads = n_reads; chunk->ordered_read_ids = (int*)malloc(n_reads * sizeof(int));
-    if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames) {
+    chunk->read_begs = (hts_pos_t*)malloc(n_reads * sizeof(hts_pos_t));
+    if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames || opt->out_hap_tag_fp != NULL) {
         chunk->read_names = (char**)malloc(n_reads * sizeof(char*));
         for (int i = 0; i < n_reads; i++) chunk->read_names[i] = NULL;
     }
@@ -1342,9 +1319,23 @@ int bam_chunk_init0(bam_chunk_t *chunk, const struct call_var_opt_t *opt, int n_
         chunk->up_ovlp_read_i[i] = (int*)malloc(n_reads * sizeof(int));
         chunk->down_ovlp_read_i[i] = (int*)malloc(n_reads * sizeof(int));
     }
-    chunk->reads = (bam1_t**)malloc(n_reads * sizeof(bam1_t*));
-    chunk->ref_seq = NULL;
+    if (reads == NULL) m_reads = 0;
+    if (m_reads < n_reads) {
+        reads = (bam1_t**)realloc(reads, n_reads * sizeof(bam1_t*));
+        for (int i = m_reads; i < n_reads; i++) reads[i] = bam_init1();
+        m_reads = n_reads;
+    }
+    chunk->reads = reads; chunk->m_read_recs = m_reads;
+    chunk->reads_are_lent = 0;
+    chunk->n_skip_reads = chunk->m_skip_reads = 0; chunk->skip_reads = NULL; chunk->skip_read_next_i = NULL;
+    chunk->bam_read_ends = chunk->bam_skip_read_ends = NULL;
+    if (opt->out_aln_fp != NULL) {
+        chunk->bam_read_ends = (int*)calloc(n_bam, sizeof(int));
+        chunk->bam_skip_read_ends = (int*)calloc(n_bam, sizeof(int));
+    }
+    chunk->ref_seq = NULL; chunk->ref_bseq = NULL;
     chunk->low_comp_cr = NULL;
+    chunk->n_skip_noisy_regs = chunk->m_skip_noisy_regs = 0; chunk->skip_noisy_regs = NULL;
     // intermediate
     chunk->qual_counts = (int*)calloc(256, sizeof(int));
     chunk->is_skipped = (uint8_t*)calloc(n_reads, sizeof(uint8_t));
@@ -1353,14 +1344,13 @@ int bam_chunk_init0(bam_chunk_t *chunk, const struct call_var_opt_t *opt, int n_
     chunk->is_ont_palindrome = (uint8_t*)calloc(n_reads, sizeof(uint8_t));
     chunk->is_skipped_for_somatic = (uint8_t*)calloc(n_reads, sizeof(uint8_t));
     chunk->digars = (digar_t*)calloc(n_reads, sizeof(digar_t));
-    for (int i = 0; i < n_reads; i++) {
-        chunk->reads[i] = bam_init1();
-        chunk->digars[i].n_digar = chunk->digars[i].m_digar = 0;
-    }
+    for (int i = 0; i < n_reads; i++) chunk->digars[i].n_digar = chunk->digars[i].m_digar = 0;
+    chunk->digar_is_shared = (uint8_t*)calloc(n_reads, sizeof(uint8_t));
+    chunk->up_handoff = chunk->down_handoff = NULL;
     // noisy regions
     chunk->chunk_noisy_regs = NULL; chunk->noisy_reg_to_reads = NULL; chunk->noisy_reg_to_n_reads = NULL;
     // variant
-    chunk->n_cand_vars = 0; chunk->cand_vars = NULL; chunk->var_i_to_cate = NULL;
+    chunk->n_cand_vars = chunk->m_cand_vars = 0; chunk->cand_vars = NULL; chunk->var_i_to_cate = NULL;
     chunk->read_var_profile = NULL; chunk->read_var_cr = NULL;
     chunk->var_noisy_read_cov_cr = NULL; chunk->var_noisy_read_err_cr = NULL;
     chunk->var_noisy_read_marks = NULL; chunk->var_noisy_read_mark_id = 0;
@@ -1388,10 +1378,15 @@ int bam_chunk_realloc(bam_chunk_t *chunk, const struct call_var_opt_t *opt) {
         chunk->var_noisy_read_marks = NULL;
     }
     chunk->var_noisy_read_mark_id = 0;
-    chunk->reads = (bam1_t**)realloc(chunk->reads, m_reads * sizeof(bam1_t*));
-    if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames) 
+    if (m_reads > chunk->m_read_recs) {
+        chunk->reads = (bam1_t**)realloc(chunk->reads, m_reads * sizeof(bam1_t*));
+        for (int i = chunk->m_read_recs; i < m_reads; i++) chunk->reads[i] = bam_init1();
+        chunk->m_read_recs = m_reads;
+    }
+    if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames || opt->out_hap_tag_fp != NULL) 
         chunk->read_names = (char**)realloc(chunk->read_names, m_reads * sizeof(char*));
     chunk->ordered_read_ids = (int*)realloc(chunk->ordered_read_ids, m_reads * sizeof(int));
+    chunk->read_begs = (hts_pos_t*)realloc(chunk->read_begs, m_reads * sizeof(hts_pos_t));
     for (int i = 0; i < chunk->n_bam; ++i) {
         chunk->up_ovlp_read_i[i] = (int*)realloc(chunk->up_ovlp_read_i[i], m_reads * sizeof(int));
         chunk->down_ovlp_read_i[i] = (int*)realloc(chunk->down_ovlp_read_i[i], m_reads * sizeof(int));
@@ -1402,12 +1397,12 @@ int bam_chunk_realloc(bam_chunk_t *chunk, const struct call_var_opt_t *opt) {
     chunk->is_ont_palindrome = (uint8_t*)realloc(chunk->is_ont_palindrome, m_reads * sizeof(uint8_t));
     chunk->is_skipped_for_somatic = (uint8_t*)realloc(chunk->is_skipped_for_somatic, m_reads * sizeof(uint8_t));
     chunk->digars = (digar_t*)realloc(chunk->digars, m_reads * sizeof(digar_t));
+    chunk->digar_is_shared = (uint8_t*)realloc(chunk->digar_is_shared, m_reads * sizeof(uint8_t));
     chunk->haps = (int*)realloc(chunk->haps, m_reads * sizeof(int));
     chunk->phase_scores = (int*)realloc(chunk->phase_scores, m_reads * sizeof(int));
     chunk->phase_sets = (hts_pos_t*)realloc(chunk->phase_sets, m_reads * sizeof(hts_pos_t));
     for (int i = chunk->m_reads; i < m_reads; i++) {
-        chunk->reads[i] = bam_init1();
-        chunk->digars[i].n_digar = chunk->digars[i].m_digar = 0;
+        chunk->digars[i].n_digar = chunk->digars[i].m_digar = 0; chunk->digar_is_shared[i] = 0;
         chunk->is_skipped[i] = 0;
         chunk->phase_scores[i] = 0; chunk->haps[i] = 0; chunk->phase_sets[i] = -1;
         chunk->is_skipped_for_somatic[i] = 0;
@@ -1416,12 +1411,8 @@ int bam_chunk_realloc(bam_chunk_t *chunk, const struct call_var_opt_t *opt) {
     return 0;
 }
 
+// alt_seq is not owned by digar1_t, see digar_t::seq
 void free_digar1(digar1_t *digar1, int n_digar) {
-    for (int i = 0; i < n_digar; i++) {
-        if (digar1[i].type == BAM_CINS || digar1[i].type == BAM_CDIFF) {
-            free(digar1[i].alt_seq);
-        }
-    }
     free(digar1);
 }
 
@@ -1440,20 +1431,25 @@ static void bam_chunk_clear_var_noisy_read_cache(bam_chunk_t *chunk) {
 }
 
 void bam_chunk_free(bam_chunk_t *chunk) {
-    free(chunk->qual_counts);
+    free(chunk->qual_counts); free(chunk->skip_noisy_regs);
     if (chunk->ref_seq != NULL) free(chunk->ref_seq);
+    if (chunk->ref_bseq != NULL) free(chunk->ref_bseq);
     if (chunk->low_comp_cr != NULL) cr_destroy(chunk->low_comp_cr);
     bam_chunk_clear_var_noisy_read_cache(chunk);
     for (int i = 0; i < chunk->m_reads; i++) {
         if (chunk->digars[i].m_digar > 0) {
             free_digar1(chunk->digars[i].digars, chunk->digars[i].n_digar);
-            free(chunk->digars[i].bseq); free(chunk->digars[i].qual);
+            if (chunk->digar_is_shared[i]) continue; // freed with the handoff
+            kfree(chunk->km, chunk->digars[i].seq); kfree(chunk->km, chunk->digars[i].qual);
             cr_destroy(chunk->digars[i].noisy_regs);
         }
     }
-    free(chunk->ordered_read_ids);
+    free(chunk->digar_is_shared);
+    read_handoff_release(chunk->up_handoff); read_handoff_release(chunk->down_handoff);
+    chunk->up_handoff = chunk->down_handoff = NULL;
+    free(chunk->ordered_read_ids); free(chunk->read_begs);
     if (LONGCALLD_VERBOSE >= 2) {
-        for (int i = 0; i < chunk->m_reads; i++) {
+        for (int i = 0; i < chunk->m_read_recs; i++) {
             bam_destroy1(chunk->reads[i]);
         }
         free(chunk->reads);
@@ -1479,22 +1475,28 @@ void bam_chunk_free(bam_chunk_t *chunk) {
         if (chunk->down_ovlp_read_i[i] != NULL) free(chunk->down_ovlp_read_i[i]);
     }
     free(chunk->n_up_ovlp_reads); free(chunk->n_down_ovlp_reads); free(chunk->n_up_ovlp_skip_reads); free(chunk->n_down_ovlp_skip_reads);
+    km_destroy(chunk->km); chunk->km = NULL;
 }
 
 void bam_chunk_free_digar(bam_chunk_t *chunk) {
     for (int i = 0; i < chunk->m_reads; i++) {
         if (chunk->digars[i].m_digar > 0) {
             free_digar1(chunk->digars[i].digars, chunk->digars[i].n_digar);
-            free(chunk->digars[i].bseq); free(chunk->digars[i].qual);
+            if (chunk->digar_is_shared[i]) continue; // freed with the handoff
+            kfree(chunk->km, chunk->digars[i].seq); kfree(chunk->km, chunk->digars[i].qual);
             cr_destroy(chunk->digars[i].noisy_regs);
         }
     }
+    free(chunk->digar_is_shared);
+    read_handoff_release(chunk->up_handoff); read_handoff_release(chunk->down_handoff);
+    chunk->up_handoff = chunk->down_handoff = NULL;
     free(chunk->digars);
 }
 
 void bam_chunk_post_free(bam_chunk_t *chunk, const struct call_var_opt_t *opt) {
-    free(chunk->qual_counts);
+    free(chunk->qual_counts); free(chunk->noisy_reg_log.s); free(chunk->skip_noisy_regs);
     if (chunk->ref_seq != NULL) free(chunk->ref_seq);
+    if (chunk->ref_bseq != NULL) free(chunk->ref_bseq);
     if (chunk->cand_vars != NULL) free_cand_vars(chunk->cand_vars, chunk->n_cand_vars);
     if (chunk->var_i_to_cate != NULL) free(chunk->var_i_to_cate);
     bam_chunk_clear_var_noisy_read_cache(chunk);
@@ -1509,19 +1511,25 @@ void bam_chunk_post_free(bam_chunk_t *chunk, const struct call_var_opt_t *opt) {
     free(chunk->n_up_ovlp_reads); free(chunk->n_down_ovlp_reads); free(chunk->n_up_ovlp_skip_reads); free(chunk->n_down_ovlp_skip_reads);
     free(chunk->up_ovlp_read_i); free(chunk->down_ovlp_read_i);
     if (opt->out_aln_fp != NULL && opt->refine_bam) bam_chunk_free_digar(chunk);
-    if (LONGCALLD_VERBOSE >= 2) {
-        for (int i = 0; i < chunk->m_reads; i++) {
+    if (!chunk->reads_are_lent && chunk->reads != NULL) {
+        for (int i = 0; i < chunk->m_read_recs; i++) {
             bam_destroy1(chunk->reads[i]);
         }
         free(chunk->reads);
     }
-    free(chunk->ordered_read_ids);
+    if (chunk->skip_reads != NULL) {
+        for (int i = 0; i < chunk->m_skip_reads; i++) bam_destroy1(chunk->skip_reads[i]);
+        free(chunk->skip_reads); free(chunk->skip_read_next_i);
+    }
+    if (chunk->bam_read_ends != NULL) { free(chunk->bam_read_ends); free(chunk->bam_skip_read_ends); }
+    free(chunk->ordered_read_ids); free(chunk->read_begs);
     // save read_var_profile for output_sv_rnames or output_somatic_sv_rnames, which will be used in make_variants
     if (chunk->read_var_profile != NULL) free_read_var_profile(chunk->read_var_profile, chunk->n_reads);
-    if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames) {
+    if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames || opt->out_hap_tag_fp != NULL) {
         for (int i = 0; i < chunk->n_reads; i++) free(chunk->read_names[i]); 
         free(chunk->read_names);
     }
+    km_destroy(chunk->km); chunk->km = NULL; // after all kfree() above
 }
 
 // free variables that will not be used in stitch & make variants
@@ -1552,33 +1560,79 @@ void bam_chunks_post_free(bam_chunk_t *chunks, int n_chunks, const struct call_v
     free(chunks);
 }
 
-void get_bam_chunk_reg_ref_seq0(faidx_t *fai, bam_chunk_t *chunk, hts_pos_t beg, hts_pos_t end) {
-    assert(fai != NULL); // faidx_t *fai = fai_load(ref_fasta);
-    int ref_seq_len = faidx_seq_len(fai, chunk->tname);
+// with ref_pac, the chunk's window is decoded from the shared mmap'ed packed reference, otherwise fetched with the worker's own faidx
+void get_bam_chunk_reg_ref_seq0(faidx_t *fai, const ref_pac_t *ref_pac, const cgranges_t *low_comp_cr, bam_chunk_t *chunk, hts_pos_t beg, hts_pos_t end) {
+    int pac_id = -1; hts_pos_t ref_seq_len;
+    if (ref_pac != NULL) {
+        if ((pac_id = ref_pac_name2id(ref_pac, chunk->tname)) < 0) {
+            _err_error("Failed to fetch reference sequence for %s:%" PRId64 "-%" PRId64 " from the fasta file.\n", chunk->tname, beg, end);
+            _err_error_exit("Please make sure the reference genome and the alignment file match.\n");
+        }
+        ref_seq_len = ref_pac_seq_len(ref_pac, pac_id);
+    } else {
+        assert(fai != NULL); // faidx_t *fai = fai_load(ref_fasta);
+        ref_seq_len = faidx_seq_len(fai, chunk->tname);
+    }
     int flank_len = 50000; // [reg_beg-flank_len, reg_end+flank_len]
     hts_pos_t ref_beg = MAX_OF_TWO(flank_len, beg-1)-flank_len;
     hts_pos_t ref_end = MIN_OF_TWO(ref_seq_len-flank_len-1, end-1)+flank_len;
     chunk->whole_ref_len = ref_seq_len;
 
-    int len;
-    chunk->ref_seq = faidx_fetch_seq(fai, chunk->tname, ref_beg, ref_end, &len); // ref_beg & ref_end: 0-based
-    if (chunk->ref_seq == NULL || len <= 0) {
-        _err_error("Failed to fetch reference sequence for %s:%" PRId64 "-%" PRId64 " from the fasta file.\n", chunk->tname, beg, end);
-        _err_error_exit("Please make sure the reference genome and the alignment file match.\n");
-                         
+    hts_pos_t len;
+    if (pac_id >= 0) {
+        if (ref_end >= ref_seq_len) ref_end = ref_seq_len-1;
+        len = ref_end - ref_beg + 1;
+        chunk->ref_seq = (char*)malloc((len+1) * sizeof(char));
+        chunk->ref_bseq = (uint8_t*)malloc(len * sizeof(uint8_t));
+        ref_pac_fetch(ref_pac, pac_id, ref_beg, ref_end+1, chunk->ref_seq, chunk->ref_bseq);
+        chunk->ref_seq[len] = '\0';
+    } else {
+        chunk->ref_seq = faidx_fetch_seq64(fai, chunk->tname, ref_beg, ref_end, &len); // ref_beg & ref_end: 0-based
+        if (chunk->ref_seq == NULL || len <= 0) {
+            _err_error("Failed to fetch reference sequence for %s:%" PRId64 "-%" PRId64 " from the fasta file.\n", chunk->tname, beg, end);
+            _err_error_exit("Please make sure the reference genome and the alignment file match.\n");
+        }
+        // soft-masked/IUPAC bases to upper-case ACGTN, same as ref_pac_fetch
+        chunk->ref_bseq = (uint8_t*)malloc(len * sizeof(uint8_t));
+        for (hts_pos_t i = 0; i < len; ++i) {
+            chunk->ref_bseq[i] = nst_nt4_table[(uint8_t)chunk->ref_seq[i]];
+            chunk->ref_seq[i] = "ACGTN"[chunk->ref_bseq[i]];
+        }
     }
     chunk->ref_beg = ref_beg+1;   // 1-based
     chunk->ref_end = ref_beg+len; // 1-based
 
     // collect low-complexity regions
     chunk->low_comp_cr = cr_init();
-    uint64_t *r; int n=0, T=LONGCALLD_SDUST_T, W=LONGCALLD_SDUST_W;
-    r = sdust(0, (uint8_t*)chunk->ref_seq-chunk->ref_beg+chunk->reg_beg, chunk->reg_end - chunk->reg_beg+1, T, W, &n);
-    for (int i = 0; i < n; ++i) {
-        // fprintf(stderr, "low_comp_cr: %s %d-%d\n", chunk->tname, chunk->reg_beg+(int)(r[i]>>32)-1, chunk->reg_beg+(int)r[i]-1);
-        cr_add(chunk->low_comp_cr, "cr", chunk->reg_beg+(int)(r[i]>>32)-1, chunk->reg_beg+(int)r[i]-1, 0);
+    if (low_comp_cr != NULL) { // slice of the genome-wide mask
+        int64_t *b = 0, m_b = 0, n = cr_overlap(low_comp_cr, chunk->tname, chunk->reg_beg-1, chunk->reg_end, &b, &m_b);
+        for (int64_t i = 0; i < n; ++i) cr_add(chunk->low_comp_cr, "cr", cr_start(low_comp_cr, b[i]), cr_end(low_comp_cr, b[i]), 0);
+        free(b);
+    } else {
+        uint64_t *r; int n=0, T=LONGCALLD_SDUST_T, W=LONGCALLD_SDUST_W;
+        r = sdust(0, (uint8_t*)chunk->ref_seq-chunk->ref_beg+chunk->reg_beg, chunk->reg_end - chunk->reg_beg+1, T, W, &n);
+        for (int i = 0; i < n; ++i) {
+            // fprintf(stderr, "low_comp_cr: %s %d-%d\n", chunk->tname, chunk->reg_beg+(int)(r[i]>>32)-1, chunk->reg_beg+(int)r[i]-1);
+            cr_add(chunk->low_comp_cr, "cr", chunk->reg_beg+(int)(r[i]>>32)-1, chunk->reg_beg+(int)r[i]-1, 0);
+        }
+        free(r);
     }
-    cr_index(chunk->low_comp_cr); free(r);
+    cr_index(chunk->low_comp_cr);
+}
+
+// keep the just-loaded skipped record (reads[n_reads]) for output, reads[n_reads] gets an empty record
+static void bam_chunk_keep_skip_read(bam_chunk_t *chunk) {
+    if (chunk->n_skip_reads == chunk->m_skip_reads) {
+        int m = chunk->m_skip_reads == 0 ? 256 : chunk->m_skip_reads * 2;
+        chunk->skip_reads = (bam1_t**)realloc(chunk->skip_reads, m * sizeof(bam1_t*));
+        chunk->skip_read_next_i = (int*)realloc(chunk->skip_read_next_i, m * sizeof(int));
+        for (int i = chunk->m_skip_reads; i < m; ++i) chunk->skip_reads[i] = bam_init1();
+        chunk->m_skip_reads = m;
+    }
+    bam1_t *tmp = chunk->skip_reads[chunk->n_skip_reads];
+    chunk->skip_reads[chunk->n_skip_reads] = chunk->reads[chunk->n_reads];
+    chunk->reads[chunk->n_reads] = tmp;
+    chunk->skip_read_next_i[chunk->n_skip_reads++] = chunk->n_reads;
 }
 
 static int is_ovlp_with_prev_region(const struct call_var_pl_t *pl, bam_chunk_t *chunk, bam1_t *read) {
@@ -1613,6 +1667,121 @@ static int is_ovlp_with_next_region(const struct call_var_pl_t *pl, bam_chunk_t
     }
 }
 
+static int has_prev_region(const struct call_var_pl_t *pl, bam_chunk_t *chunk) {
+    int reg_chunk_i = chunk->reg_chunk_i, reg_i = chunk->reg_i;
+    return reg_i > 0 && pl->reg_chunks[reg_chunk_i].reg_tids[reg_i-1] == chunk->tid;
+}
+
+static int has_next_region(const struct call_var_pl_t *pl, bam_chunk_t *chunk) {
+    int reg_chunk_i = chunk->reg_chunk_i, reg_i = chunk->reg_i;
+    return reg_i < pl->reg_chunks[reg_chunk_i].n_regions-1 && pl->reg_chunks[reg_chunk_i].reg_tids[reg_i+1] == chunk->tid;
+}
+
+read_handoff_ex_t *read_handoff_ex_init(void) {
+    read_handoff_ex_t *ex = (read_handoff_ex_t*)_err_calloc(1, sizeof(read_handoff_ex_t));
+    pthread_mutex_init(&ex->mutex, 0);
+    return ex;
+}
+
+void read_handoff_ex_destroy(read_handoff_ex_t *ex) {
+    if (ex == NULL) return;
+    for (int i = 0; i < ex->n; ++i) read_handoff_release(ex->a[i].h);
+    pthread_mutex_destroy(&ex->mutex);
+    free(ex->a); free(ex);
+}
+
+void read_handoff_release(read_handoff_t *h) {
+    if (h == NULL || __sync_sub_and_fetch(&h->ref, 1) > 0) return;
+    for (int i = 0; i < h->n_bam; ++i) {
+        for (int j = 0; j < h->n_reads[i]; ++j) {
+            read_handoff1_t *r = h->reads[i] + j;
+            if (!r->is_set) continue;
+            free(r->digar.digars); free(r->digar.seq); free(r->digar.qual);
+            cr_destroy(r->digar.noisy_regs);
+        }
+        free(h->reads[i]);
+    }
+    free(h->n_reads); free(h->reads); free(h);
+}
+
+// remove the entry of upstream region (reg_chunk_i, reg_i) if found, caller holds ex->mutex
+static int read_handoff_ex_pop(read_handoff_ex_t *ex, int reg_chunk_i, int reg_i, read_handoff_t **h) {
+    for (int i = 0; i < ex->n; ++i) {
+        if (ex->a[i].reg_chunk_i != reg_chunk_i || ex->a[i].reg_i != reg_i) continue;
+        *h = ex->a[i].h; ex->a[i] = ex->a[--ex->n];
+        return 1;
+    }
+    return 0;
+}
+
+static void read_handoff_ex_push(read_handoff_ex_t *ex, int reg_chunk_i, int reg_i, read_handoff_t *h) {
+    if (ex->n == ex->m) {
+        ex->m = ex->m ? ex->m * 2 : 16;
+        ex->a = realloc(ex->a, ex->m * sizeof(*ex->a));
+    }
+    ex->a[ex->n].reg_chunk_i = reg_chunk_i; ex->a[ex->n].reg_i = reg_i; ex->a[ex->n++].h = h;
+}
+
+// called by the upstream chunk once its downstream-overlapping reads are decoded, before their digars are modified
+// reads with digar_is_shared were decoded for the handoff, others (also overlapping the upstream region) are left to the downstream chunk
+void read_handoff_put(const struct call_var_pl_t *pl, bam_chunk_t *chunk) {
+    if (!has_next_region(pl, chunk)) return;
+    read_handoff_t *h = (read_handoff_t*)_err_calloc(1, sizeof(read_handoff_t));
+    h->ref = 2; h->n_bam = chunk->n_bam;
+    h->n_reads = (int*)malloc(chunk->n_bam * sizeof(int));
+    h->reads = (read_handoff1_t**)malloc(chunk->n_bam * sizeof(read_handoff1_t*));
+    for (int i = 0; i < chunk->n_bam; ++i) {
+        h->n_reads[i] = chunk->n_down_ovlp_reads[i];
+        h->reads[i] = (read_handoff1_t*)calloc(h->n_reads[i], sizeof(read_handoff1_t));
+        for (int j = 0; j < h->n_reads[i]; ++j) {
+            int read_i = chunk->down_ovlp_read_i[i][j]; digar_t *d = chunk->digars + read_i;
+            if (!chunk->digar_is_shared[read_i] || d->m_digar == 0) continue;
+            read_handoff1_t *r = h->reads[i] + j;
+            r->is_set = 1; r->is_ont_palindrome = chunk->is_ont_palindrome[read_i]; r->is_skipped = chunk->is_skipped[read_i] != 0;
+            r->digar = *d; r->digar.m_digar = d->n_digar;
+            r->digar.digars = d->n_digar > 0 ? (digar1_t*)malloc(d->n_digar * sizeof(digar1_t)) : NULL;
+            if (d->n_digar > 0) memcpy(r->digar.digars, d->digars, d->n_digar * sizeof(digar1_t));
+        }
+    }
+    chunk->down_handoff = h;
+    read_handoff_ex_t *ex = pl->handoff_ex; read_handoff_t *declined = NULL;
+    pthread_mutex_lock(&ex->mutex);
+    int is_declined = read_handoff_ex_pop(ex, chunk->reg_chunk_i, chunk->reg_i, &declined);
+    if (!is_declined) read_handoff_ex_push(ex, chunk->reg_chunk_i, chunk->reg_i, h);
+    pthread_mutex_unlock(&ex->mutex);
+    if (is_declined) read_handoff_release(h); // the downstream chunk has decoded the reads itself
+}
+
+// called by the downstream chunk once its other reads are decoded, does not wait for the upstream chunk
+// returns NULL if the upstream chunk has not handed its reads over yet, a later read_handoff_put() then drops them
+read_handoff_t *read_handoff_get(const struct call_var_pl_t *pl, bam_chunk_t *chunk) {
+    if (!has_prev_region(pl, chunk)) return NULL;
+    read_handoff_ex_t *ex = pl->handoff_ex; read_handoff_t *h = NULL;
+    pthread_mutex_lock(&ex->mutex);
+    if (!read_handoff_ex_pop(ex, chunk->reg_chunk_i, chunk->reg_i-1, &h))
+        read_handoff_ex_push(ex, chunk->reg_chunk_i, chunk->reg_i-1, NULL);
+    pthread_mutex_unlock(&ex->mutex);
+    if (h != NULL && h->n_bam != chunk->n_bam) {
+        read_handoff_release(h); h = NULL;
+    }
+    return h;
+}
+
+// take over the ovlp_j-th upstream-overlapping read of bam_i from the handoff, return 0 if it has to be decoded
+int reuse_digar_from_handoff(bam_chunk_t *chunk, int read_i, read_handoff_t *h, int bam_i, int ovlp_j) {
+    if (h == NULL || ovlp_j >= h->n_reads[bam_i]) return 0;
+    read_handoff1_t *r = h->reads[bam_i] + ovlp_j; bam1_t *read = chunk->reads[read_i];
+    if (!r->is_set || r->digar.beg != read->core.pos+1 || r->digar.qlen != read->core.l_qseq || r->digar.is_rev != bam_is_rev(read)) return 0;
+    digar_t *digar = chunk->digars + read_i;
+    *digar = r->digar; // digars is moved, seq/qual/noisy_regs stay with the handoff
+    r->digar.digars = NULL; r->digar.n_digar = r->digar.m_digar = 0;
+    chunk->digar_is_shared[read_i] = 1;
+    chunk->is_ont_palindrome[read_i] = r->is_ont_palindrome;
+    if (r->is_skipped) chunk->is_skipped[read_i] = BAM_RECORD_WRONG_MAP;
+    for (int i = 0; i < digar->qlen; ++i) chunk->qual_counts[digar->qual[i]]++;
+    return 1;
+}
+
 typedef struct {
     int read_i;
     hts_pos_t pos, end;
@@ -1664,7 +1833,14 @@ int collect_ref_seq_bam_main(const struct call_var_pl_t *pl, struct call_var_io_
     call_var_opt_t *opt = pl->opt;
 
     int min_mapq = opt->min_mq;
-    bam_chunk_init0(chunk, opt, 4096, io_aux->n_bam);
+    // read records are released right after digars are collected (see collect_digars_from_bam),
+    // so they are borrowed from the worker and kept warm across chunks
+    // with phased BAM output, records are kept until the chunk is written
+    int lend_reads = LONGCALLD_VERBOSE < 2 && opt->out_aln_fp == NULL;
+    // per-read arrays start at the usual chunk size and only grow with this chunk's depth
+    if (lend_reads) bam_chunk_init0(chunk, opt, LONGCALLD_BAM_CHUNK_READ_COUNT, io_aux->n_bam, io_aux->reads, io_aux->m_reads);
+    else bam_chunk_init0(chunk, opt, 4096, io_aux->n_bam, NULL, 0);
+    chunk->reads_are_lent = lend_reads;
     chunk->reg_chunk_i = reg_chunk_i; chunk->reg_i = reg_i;
     chunk->tid = tid; chunk->tname = io_aux->headers[0]->target_name[tid]; chunk->reg_beg = reg_beg; chunk->reg_end = reg_end;
     hts_pos_t min_read_beg = reg_beg, max_read_end = reg_end;
@@ -1672,6 +1848,10 @@ int collect_ref_seq_bam_main(const struct call_var_pl_t *pl, struct call_var_io_
         // create iterator for the region
         hts_itr_t *iter = sam_itr_queryi(io_aux->idxs[i], tid, reg_beg-1, reg_end); // (reg_beg-1, reg_end] ==> [reg_beg, reg_end]
         if (iter == NULL) {
+            if (lend_reads) io_aux->reads = chunk->reads, io_aux->m_reads = chunk->m_read_recs;
+            if (opt->out_aln_fp != NULL) {
+                for (int j = i; j < io_aux->n_bam; ++j) chunk->bam_read_ends[j] = chunk->n_reads, chunk->bam_skip_read_ends[j] = chunk->n_skip_reads;
+            }
             _err_warning("Failed to create iterator for region: %s:%" PRId64 "-%" PRId64 "\n", io_aux->headers[i]->target_name[tid], reg_beg, reg_end);
             return -1;
         }
@@ -1683,6 +1863,7 @@ int collect_ref_seq_bam_main(const struct call_var_pl_t *pl, struct call_var_io_
             if (chunk->reads[chunk->n_reads]->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FSUPPLEMENTARY) || chunk->reads[chunk->n_reads]->core.qual < min_mapq) {
                 if (is_ovlp_with_prev_region(pl, chunk, chunk->reads[chunk->n_reads])) chunk->n_up_ovlp_skip_reads[i]++;
                 if (is_ovlp_with_next_region(pl, chunk, chunk->reads[chunk->n_reads])) chunk->n_down_ovlp_skip_reads[i]++;
+                if (opt->out_aln_fp != NULL) bam_chunk_keep_skip_read(chunk);
                 continue; // BAM_FSUPPLEMENTARY
             }
             // fprintf(stderr, "CHUNK-READ: %s %d-%d\n", bam_get_qname(chunk->reads[chunk->n_reads]), chunk->reg_beg, chunk->reg_end);
@@ -1693,21 +1874,24 @@ int collect_ref_seq_bam_main(const struct call_var_pl_t *pl, struct call_var_io_
             if (is_ovlp_with_next_region(pl, chunk, chunk->reads[chunk->n_reads])) {
                 chunk->down_ovlp_read_i[i][chunk->n_down_ovlp_reads[i]++] = chunk->n_reads;
             }
+            chunk->read_begs[chunk->n_reads] = chunk->reads[chunk->n_reads]->core.pos;
             // update min_read_beg, max_read_end
             if (chunk->reads[chunk->n_reads]->core.pos+1 < min_read_beg) min_read_beg = chunk->reads[chunk->n_reads]->core.pos+1;
             if (bam_endpos(chunk->reads[chunk->n_reads]) > max_read_end) max_read_end = bam_endpos(chunk->reads[chunk->n_reads]);
             // check if read is overlapping with next region
-            if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames) {
+            if (opt->output_var_rnames || opt->output_sv_rnames || opt->output_somatic_var_rnames || opt->out_hap_tag_fp != NULL) {
                 chunk->read_names[chunk->n_reads] = strdup(bam_get_qname(chunk->reads[chunk->n_reads]));
             }
             chunk->n_reads++;
             if (chunk->n_reads == chunk->m_reads) bam_chunk_realloc(chunk, opt);
         }
         bam_itr_destroy(iter);
+        if (opt->out_aln_fp != NULL) chunk->bam_read_ends[i] = chunk->n_reads, chunk->bam_skip_read_ends[i] = chunk->n_skip_reads;
     }
+    if (lend_reads) io_aux->reads = chunk->reads, io_aux->m_reads = chunk->m_read_recs; // may be enlarged by bam_chunk_realloc
     if (chunk->n_reads <= 0) return 0;
     // load ref seq
-    get_bam_chunk_reg_ref_seq0(io_aux->fai, chunk, min_read_beg, max_read_end);
+    get_bam_chunk_reg_ref_seq0(io_aux->fai, pl->ref_pac, pl->low_comp_cr, chunk, min_read_beg, max_read_end);
     if (LONGCALLD_VERBOSE >= 2) {
         fprintf(stderr, "CHUNK: tname: %s, tid: %d, beg: %" PRId64 ", end: %" PRId64 ", n_reads: %d\n", chunk->tname, chunk->tid, chunk->reg_beg, chunk->reg_end, chunk->n_reads);
     }
@@ -1941,31 +2125,9 @@ int refine_bam1(bam_chunk_t *chunk, int read_i, bam1_t *b) {
     return 0;
 }
 
-int write_unprocessed_read_to_bam(bam_chunk_t *chunk, bam_hdr_t *header, htsFile *out_aln_fp, bam1_t *read) {
-    // write unprocessed read to bam
-    uint8_t *hp = bam_aux_get(read, "HP");
-    if (hp != NULL) bam_aux_del(read, hp);
-
-    uint8_t *ps_tag = bam_aux_get(read, "PS");
-    if (ps_tag != NULL) bam_aux_del(read, ps_tag);
-    if (sam_write1(out_aln_fp, header, read) < 0) _err_error_exit("Failed to write BAM record. %s:%" PRIi64 " %s\n", chunk->tname, read->core.pos+1, bam_get_qname(read));
-    return 0;
-}
-
-int write_processed_read_to_bam(const call_var_opt_t *opt, bam_chunk_t *chunk, bam_hdr_t *header, bam1_t *read, int read_i) {
-    // refine bam cigars
-    if (opt->refine_bam) {
-        // check if bam and chunk->digars[read_i] match
-        if (digar2qlen(chunk->digars+read_i) != read->core.l_qseq) {
-            _err_error_exit("Read length mismatch when writing BAM record: %s:%" PRId64 " %s, digar_qlen: %d, bam_qlen: %d\n",
-                            chunk->tname, read->core.pos+1, bam_get_qname(read),
-                            digar2qlen(chunk->digars+read_i), read->core.l_qseq);
-        }
-        if (refine_bam1(chunk, read_i, read) != 0)
-            _err_error_exit("Failed to refine BAM record: %s:%" PRId64 " %s\n", chunk->tname, read->core.pos+1, bam_get_qname(read));
-    }
+// set HP/PS tags of a read, existing HP/PS tags are removed if hap/ps is 0
+void bam1_set_hap_tags(bam1_t *read, int hap, hts_pos_t ps) {
     // Add HP tag
-    int hap = chunk->haps[read_i];
     if (hap != 0) {
         // check if HP tag exists
         uint8_t *hp = bam_aux_get(read, "HP");
@@ -1983,7 +2145,6 @@ int write_processed_read_to_bam(const call_var_opt_t *opt, bam_chunk_t *chunk, b
         if (hp != NULL) bam_aux_del(read, hp);
     }
     // Add PS tag
-    hts_pos_t ps = chunk->phase_sets[read_i];
     if (ps > 0) {
         // check if PS tag exists
         uint8_t *ps_tag = bam_aux_get(read, "PS");
@@ -2000,53 +2161,81 @@ int write_processed_read_to_bam(const call_var_opt_t *opt, bam_chunk_t *chunk, b
         uint8_t *ps_tag = bam_aux_get(read, "PS");
         if (ps_tag != NULL) bam_aux_del(read, ps_tag);
     }
+}
+
+int write_unprocessed_read_to_bam(bam_chunk_t *chunk, bam_hdr_t *header, htsFile *out_aln_fp, bam1_t *read) {
+    // write unprocessed read to bam
+    bam1_set_hap_tags(read, 0, 0);
+    if (sam_write1(out_aln_fp, header, read) < 0) _err_error_exit("Failed to write BAM record. %s:%" PRIi64 " %s\n", chunk->tname, read->core.pos+1, bam_get_qname(read));
+    return 0;
+}
+
+int write_processed_read_to_bam(const call_var_opt_t *opt, bam_chunk_t *chunk, bam_hdr_t *header, bam1_t *read, int read_i) {
+    // refine bam cigars
+    if (opt->refine_bam) {
+        // check if bam and chunk->digars[read_i] match
+        if (digar2qlen(chunk->digars+read_i) != read->core.l_qseq) {
+            _err_error_exit("Read length mismatch when writing BAM record: %s:%" PRId64 " %s, digar_qlen: %d, bam_qlen: %d\n",
+                            chunk->tname, read->core.pos+1, bam_get_qname(read),
+                            digar2qlen(chunk->digars+read_i), read->core.l_qseq);
+        }
+        if (refine_bam1(chunk, read_i, read) != 0)
+            _err_error_exit("Failed to refine BAM record: %s:%" PRId64 " %s\n", chunk->tname, read->core.pos+1, bam_get_qname(read));
+    }
+    bam1_set_hap_tags(read, chunk->haps[read_i], chunk->phase_sets[read_i]);
     // write to bam
     if (sam_write1(opt->out_aln_fp, header, read) < 0) _err_error_exit("Failed to write BAM record. %s:%" PRIi64 " %s\n", chunk->tname, read->core.pos+1, bam_get_qname(read));
     return 0;
 }
 
-// open & read bam, then output phased bam
+// output phased bam from the records kept during loading, in the same order as the input
+// reads overlapping with the previous region have been written with the previous chunk
 int write_read_to_bam(bam_chunk_t *chunk, const struct call_var_opt_t *opt, const struct call_var_io_aux_t *io_aux) {
     int n_out_reads = 0;
-    int min_mapq = opt->min_mq;
-    hts_pos_t reg_beg = chunk->reg_beg, reg_end = chunk->reg_end; int tid = chunk->tid;
-    int global_read_i = 0;
+    int read_i = 0, skip_read_i = 0;
     for (int i = 0; i < chunk->n_bam; ++i) {
-        samFile *in_bam = opt->bams[i]; bam_hdr_t *header = opt->headers[i]; hts_idx_t *idx = opt->idxs[i];
-        // fprintf(stderr, "Write bam for region: %s:%" PRId64 "-%" PRId64 "\n", header->target_name[tid], reg_beg, reg_end);
-        hts_itr_t *iter = sam_itr_queryi(idx, tid, reg_beg-1, reg_end); // (reg_beg-1, reg_end] ==> [reg_beg, reg_end]
-        if (iter == NULL) {
-            _err_warning("Failed to create iterator for region: %s:%" PRId64 "-%" PRId64 ". Skipping.\n", header->target_name[tid], reg_beg, reg_end);
-        } else {
-            // load bam records
-            bam1_t *read = bam_init1();
-            int read_i = 0, skip_read_i = 0;
-            while (sam_itr_next(in_bam, iter, read) >= 0) {
-                // fprintf(stderr, "read_i: %d, %s, %d, %ld\n", read_i, bam_get_qname(read), read->core.flag, read->core.pos+1);
-                if (read->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FSUPPLEMENTARY) || read->core.qual < min_mapq) {
-                    if (skip_read_i >= chunk->n_up_ovlp_skip_reads[i]) {
-                        write_unprocessed_read_to_bam(chunk, header, opt->out_aln_fp, read);
-                        n_out_reads++;
-                    }
-                    skip_read_i++;
-                    // fprintf(stderr, "skip %s\n", bam_get_qname(read));
-                    continue;
+        bam_hdr_t *header = io_aux->headers[i];
+        int bam_read_i = 0, bam_skip_read_i = 0;
+        while (read_i < chunk->bam_read_ends[i] || skip_read_i < chunk->bam_skip_read_ends[i]) {
+            if (skip_read_i < chunk->bam_skip_read_ends[i] && (read_i >= chunk->bam_read_ends[i] || chunk->skip_read_next_i[skip_read_i] <= read_i)) {
+                if (bam_skip_read_i >= chunk->n_up_ovlp_skip_reads[i]) {
+                    write_unprocessed_read_to_bam(chunk, header, opt->out_aln_fp, chunk->skip_reads[skip_read_i]);
+                    n_out_reads++;
                 }
-                // check if read is overlapping with previous region
-                if (read_i >= chunk->n_up_ovlp_reads[i]) {
-                    // start_to_output = 1; // start to output reads
-                    // fprintf(stderr, "output %d %s\n", global_read_i, bam_get_qname(read));
-                    write_processed_read_to_bam(opt, chunk, header, read, global_read_i);
+                skip_read_i++; bam_skip_read_i++;
+            } else {
+                if (bam_read_i >= chunk->n_up_ovlp_reads[i]) {
+                    write_processed_read_to_bam(opt, chunk, header, chunk->reads[read_i], read_i);
                     n_out_reads++;
                 }
-                read_i++; global_read_i++;
+                read_i++; bam_read_i++;
             }
-            bam_itr_destroy(iter); bam_destroy1(read);
         }
     }
     return n_out_reads;
 }
 
+// haplotag sidecar: one line per phased read, sorted by position, i.e., the same order as phased BAM output
+// chrom, pos (1-based), qname, HP, PS
+int write_read_hap_tags(bam_chunk_t *chunk, const struct call_var_opt_t *opt) {
+    int n_out_reads = 0; kstring_t ks = {0, 0, NULL};
+    uint8_t *is_up_ovlp = (uint8_t*)calloc(chunk->n_reads, sizeof(uint8_t)); // written with the previous chunk
+    for (int i = 0; i < chunk->n_bam; ++i) {
+        for (int j = 0; j < chunk->n_up_ovlp_reads[i]; ++j) is_up_ovlp[chunk->up_ovlp_read_i[i][j]] = 1;
+    }
+    for (int i = 0; i < chunk->n_reads; ++i) {
+        int read_i = chunk->ordered_read_ids[i];
+        if (is_up_ovlp[read_i]) continue;
+        int hap = chunk->haps[read_i]; hts_pos_t ps = chunk->phase_sets[read_i];
+        if (hap == 0 && ps <= 0) continue;
+        ksprintf(&ks, "%s\t%" PRIi64 "\t%s\t%d\t%" PRIi64 "\n", chunk->tname, chunk->read_begs[read_i]+1, chunk->read_names[read_i], hap, ps > 0 ? ps : 0);
+        n_out_reads++;
+    }
+    if (ks.l > 0 && bgzf_write(opt->out_hap_tag_fp, ks.s, ks.l) < 0) _err_error_exit("Failed to write haplotag file: %s\n", opt->out_hap_tag_fn);
+    free(ks.s); free(is_up_ovlp);
+    return n_out_reads;
+}
+
 // check if multiple RG/SM tag are the same, if not same, output warning message
 char *extract_sample_name_from_bam_header(bam_hdr_t *header) {
     int n_rg = sam_hdr_count_lines(header, "RG");
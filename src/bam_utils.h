@@ -1,13 +1,21 @@
 #ifndef LONGCALLD_BAM_UTILS_H
 #define LONGCALLD_BAM_UTILS_H
 
+#include <pthread.h>
 #include "htslib/sam.h"
 #include "htslib/kstring.h"
 #include "cgranges.h"
 #include "collect_var.h"
+#include "call_var_stats.h"
 
 #define LONGCALLD_BAM_CHUNK_READ_COUNT 4000
 #define LONGCALLD_BAM_CHUNK_REG_SIZE 500000 // 0.5M/1M
+// regions are sized by index bytes (BAI/CSI): cut at window boundaries once the average bytes of a REG_SIZE region is reached
+#define LONGCALLD_BAM_CHUNK_WIN_SIZE 50000 // also the min. region size, if read length is unknown
+#define LONGCALLD_BAM_CHUNK_WIN_READS 5 // otherwise: 5 x mean read span, in [MIN_WIN_SIZE, REG_SIZE]
+#define LONGCALLD_BAM_CHUNK_MIN_WIN_SIZE 10000
+#define LONGCALLD_BAM_CHUNK_WIN_SAMPLE_READS 1000 // first primary reads used to estimate read length
+#define LONGCALLD_BAM_CHUNK_MAX_REG_SIZE (4 * LONGCALLD_BAM_CHUNK_REG_SIZE) // sparse regions are merged up to this size
 // region-based BAM_CHUNK: no split for a single chromosome
 //                         multi regions may be merged into a single chunk if n_regs < 64
 // #define LONGCALLD_BAM_MIN_REG_CHUNK_PER_RUN 64 // n_threads * 4
@@ -28,7 +36,7 @@ typedef struct digar1_t {
     // pos: 1-based ref position
     // qi: 0-based query position (for =XI); for DEL, qi is the first read base after the deletion
     hts_pos_t pos; int type, len, qi;
-    uint8_t *alt_seq; // X/I: alt_seq; =/D: NULL
+    uint8_t *alt_seq; // X/I: alt_seq, points into digar_t::seq, not owned; =/D: NULL
     uint8_t is_low_qual; // low-base-qual, effective for clean-region digars
 } digar1_t;
 
@@ -39,9 +47,33 @@ typedef struct {
     digar1_t *digars;
     // read-wise noisy region: active region for re-alignment
     cgranges_t *noisy_regs; // merge low_qual digar1_t if they are next to each other
-    int qlen; uint8_t *bseq, *qual; // copy from bam1_t
+    int qlen; uint8_t *seq, *qual; // copy from bam1_t, seq: 0-4 (ACGTN), shared by alt_seq of all digars
 } digar_t; // detailed CIGAR for each read
 
+// reads spanning the boundary of two neighbouring regions are decoded by the upstream chunk only, then reused by the downstream one
+// reads are paired by input BAM & order, the same as down_ovlp_read_i/up_ovlp_read_i (see flip_variant_hap)
+typedef struct {
+    uint8_t is_set, is_ont_palindrome, is_skipped; // is_set: 0: not decoded by the upstream chunk
+    digar_t digar; // seq/qual/noisy_regs are owned by the handoff, digars is a copy moved to the downstream chunk
+} read_handoff1_t;
+
+typedef struct read_handoff_t {
+    int ref; // upstream & downstream chunks, the last release frees it
+    int n_bam, *n_reads; read_handoff1_t **reads; // size: n_bam x n_reads[i]
+} read_handoff_t;
+
+// handoffs published by upstream chunks but not yet taken, or declined by downstream chunks that could not wait (h == NULL)
+typedef struct read_handoff_ex_t {
+    pthread_mutex_t mutex;
+    int n, m; struct { int reg_chunk_i, reg_i; read_handoff_t *h; } *a; // reg_chunk_i/reg_i: upstream region
+} read_handoff_ex_t;
+
+// noisy region skipped as too long/deep or over its budget, see align_noisy_reg1()
+typedef struct noisy_skip_reg_t {
+    hts_pos_t beg, end; // 1-based, [beg, end]
+    const char *reason; // INFO/SKIPREASON: long, deep, cells, mem, time
+} noisy_skip_reg_t;
+
 typedef struct bam_chunk_t {
     // input
     // tid = pl->reg_chunks[reg_chunk_i].reg_tids[reg_i] 
@@ -53,7 +85,8 @@ typedef struct bam_chunk_t {
     // ref_seq: 
     //   reference sequence for this chunk, size: ref_end-ref_beg+1
     //   if reg_reg_cr contain >1 regions, ref_seq will be concatenated, including additonal gaps between regions
-    char *ref_seq; hts_pos_t ref_beg, ref_end, whole_ref_len; // [ref_beg, ref_end]
+    char *ref_seq; hts_pos_t ref_beg, ref_end, whole_ref_len; // [ref_beg, ref_end], upper-case
+    uint8_t *ref_bseq; // 0-4, same range as ref_seq
     // reg_cr: 
     //   reference region for this chunk. usually just 1 region, but could be multiple regions when regions are small, or reads are long
     //   only variants within regions will be considered, variants outside will be skipped
@@ -62,20 +95,30 @@ typedef struct bam_chunk_t {
     // should always be 1 region XXX
     cgranges_t *low_comp_cr; // tandem_rep_cr;
     int n_reads, m_reads; int *ordered_read_ids; // size: m_reads, for multiple input bams, merge sort reads by pos, end, NM, name
+    hts_pos_t *read_begs; // size: m_reads, 0-based, kept after reads are released
     char **read_names; // size: m_reads, for output
     int n_bam; // for each input bam, record the number of region-overlapping reads
     int *n_up_ovlp_reads, *n_down_ovlp_reads, *n_up_ovlp_skip_reads, *n_down_ovlp_skip_reads; // number of reads overlapping with up/downstream bam chunk
     int **up_ovlp_read_i, **down_ovlp_read_i;
-    bam1_t **reads;
+    bam1_t **reads; uint8_t reads_are_lent; // lent: owned by the worker's io_aux, dropped after digars are collected
+    int m_read_recs; // size of reads, >= m_reads: lent records are kept at the worker's peak depth, per-read arrays are not
+    // for phased BAM output only: all loaded records are kept, so the input is not read again when writing
+    // skip_reads: unmapped/secondary/supplementary/low-MAPQ records, skip_read_next_i: index of the next record in reads
+    // bam_read_ends/bam_skip_read_ends: size: n_bam, number of reads/skip_reads loaded after each input bam
+    int n_skip_reads, m_skip_reads; bam1_t **skip_reads; int *skip_read_next_i;
+    int *bam_read_ends, *bam_skip_read_ends;
     // intermidiate
     int *n_clean_agree_snps, *n_clean_conflict_snps; // size: m_reads; XXX include both het and hom clean vars
     uint8_t *is_ont_palindrome; // size: m_reads, 1: palindromic read, 0: non-palindromic read
     digar_t *digars; uint8_t *is_skipped, *is_skipped_for_somatic; // size: m_reads, is_skipped: wrong mapping, low qual, etc.
+    // up_handoff: boundary reads reused from the upstream chunk, down_handoff: decoded for the downstream chunk
+    // digar_is_shared: size: m_reads, 1: seq/qual/noisy_regs of digars[i] are owned by one of the two handoffs
+    struct read_handoff_t *up_handoff, *down_handoff; uint8_t *digar_is_shared;
     // variant-related
     // n_cand_vars: including candidate germline variants and somatic variants
     // for germline variants, including clean region and noisy region
     // for somatic, only non-noisy regions, we don't call somatic variants in noisy regions (for now)
-    int n_cand_vars; cand_var_t *cand_vars; int *var_i_to_cate;
+    int n_cand_vars, m_cand_vars; cand_var_t *cand_vars; int *var_i_to_cate; // m_cand_vars: allocated size of cand_vars/var_i_to_cate
     read_var_profile_t *read_var_profile; cgranges_t *read_var_cr;
     cgranges_t *var_noisy_read_cov_cr, *var_noisy_read_err_cr;
     int *var_noisy_read_marks, var_noisy_read_mark_id;
@@ -89,6 +132,15 @@ typedef struct bam_chunk_t {
     // read-wise
     // phase_score: used to determine low-qual phased reads, which should not be used for somatic variant calling
     int *phase_scores, *haps; hts_pos_t *phase_sets; // size: m_reads 
+    call_var_stats_t stats; // timers & counters, reported with --stats
+    kstring_t noisy_reg_log; // lines of --noisy-reg-log, output by the writer in the order of chunks
+    int n_skip_noisy_regs, m_skip_noisy_regs; noisy_skip_reg_t *skip_noisy_regs; // starting in [reg_beg, reg_end], output as filtered VCF records
+    struct wfa_pool_t *wfa_pool; struct abpoa_pool_t *poa_pool; // borrowed from the worker's io_aux while the chunk is called
+    struct wfa_pool_t **noisy_wfa_pools; struct abpoa_pool_t **noisy_poa_pools; // same, used by the extra --noisy-threads
+    void *noisy_km; void **noisy_kms; // same, kalloc arenas for buffers of one noisy region
+    void *noisy_fp; // same, kt_forpool of --noisy-threads threads, NULL: regions are aligned by the calling worker
+    void *km; // kalloc arena for chunk-lifetime buffers (read seq/qual, var sites), used by one thread at a time
+              // created in bam_chunk_init0, destroyed in bam_chunk_post_free
 } bam_chunk_t; // reg-based bam_chunk_t
 
 struct call_var_pl_t;
@@ -152,9 +204,7 @@ static inline int is_overlap_reg(hts_pos_t beg, hts_pos_t end, hts_pos_t reg_beg
     return 1;
 }
 
-digar1_t *push_digar_alt_seq(digar1_t *digar, int *n_digar, int *m_digar, digar1_t d);
 digar1_t *push_digar0(digar1_t *digar, int *n_digar, int *m_digar, digar1_t d);
-void push_digar1(digar_t *digar, digar1_t d);
 void free_digar1(digar1_t *digar1, int n_digar);
 int get_aux_int_from_bam(bam1_t *b, const char *tag);
 char *get_aux_str_from_bam(bam1_t *b, const char *tag);
@@ -168,13 +218,23 @@ int collect_digar_from_eqx_cigar(bam_chunk_t *chunk, int read_i, const struct ca
 int collect_digar_from_cs_tag(bam_chunk_t *chunk, int read_i, const struct call_var_opt_t *opt, digar_t *digar);
 int collect_digar_from_MD_tag(bam_chunk_t *chunk, int read_i, const struct call_var_opt_t *opt, digar_t *digar);
 int collect_digar_from_ref_seq(bam_chunk_t *chunk, int read_i, const struct call_var_opt_t *opt, digar_t *digar);
+void add_digar_noisy_regs_to_chunk(bam_chunk_t *chunk, int read_i);
+read_handoff_ex_t *read_handoff_ex_init(void);
+void read_handoff_ex_destroy(read_handoff_ex_t *ex);
+void read_handoff_release(read_handoff_t *h);
+void read_handoff_put(const struct call_var_pl_t *pl, bam_chunk_t *chunk);
+read_handoff_t *read_handoff_get(const struct call_var_pl_t *pl, bam_chunk_t *chunk);
+int reuse_digar_from_handoff(bam_chunk_t *chunk, int read_i, read_handoff_t *h, int bam_i, int ovlp_j);
 int update_cand_vars_from_digar(const struct call_var_opt_t *opt, bam_chunk_t *chunk, digar_t *digar, int n_var_sites, struct var_site_t *var_sites, struct cand_var_t *cand_vars);
 void update_read_var_profile_with_allele(int var_i, int allele_i, int alt_qi, read_var_profile_t *read_var_profile);
+void reserve_read_var_profile_band(read_var_profile_t *p1, int cap);
 int update_read_vs_all_var_profile_from_digar(const struct call_var_opt_t *opt, bam_chunk_t *chunk, digar_t *digar, int n_cand_vars, struct cand_var_t *cand_vars, int *var_i_to_cate, struct read_var_profile_t *read_var_profile);
 int update_read_vs_somatic_var_profile_from_digar(const struct call_var_opt_t *opt, bam_chunk_t *chunk, digar_t *digar, int n_cand_vars, struct cand_var_t *cand_vars, struct read_var_profile_t *read_var_profile);
 
 int collect_ref_seq_bam_main(const struct call_var_pl_t *pl, struct call_var_io_aux_t *io_aux, int reg_chunk_i, int reg_i, bam_chunk_t *chunks);
 int write_read_to_bam(bam_chunk_t *chunk, const struct call_var_opt_t *opt, const struct call_var_io_aux_t *io_aux);
+int write_read_hap_tags(bam_chunk_t *chunk, const struct call_var_opt_t *opt);
+void bam1_set_hap_tags(bam1_t *read, int hap, hts_pos_t ps);
 void bam_chunk_mid_free(bam_chunk_t *chunk, const struct call_var_opt_t *opt);
 void bam_chunks_mid_free(bam_chunk_t *chunks, int n_chunks, const struct call_var_opt_t *opt);
 void bam_chunk_post_free(bam_chunk_t *chunk, const struct call_var_opt_t *opt);
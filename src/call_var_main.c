@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <string.h>
+#include <pthread.h>
 #ifdef __linux__
 #include <sys/sysinfo.h>  // Linux-specific
 #elif __APPLE__
@@ -19,9 +20,13 @@
 #include "seq.h"
 #include "collect_var.h"
 #include "kthread.h"
+#include "kalloc.h"
 #include "align.h"
 #include "math_utils.h"
 #include "kmer.h"
+#include "ref_pac.h"
+#include "call_var_stats.h"
+#include "htslib/tbx.h"
 
 extern int LONGCALLD_VERBOSE;
 
@@ -31,12 +36,15 @@ const struct option call_var_opt [] = {
     { "hifi", 0, NULL, 0},
     { "ont", 0, NULL, 0},
     { "region-file", 1, NULL, 0},
+    { "low-comp-bed", 1, NULL, 0},
     { "regions-file", 1, NULL, 0},
     { "all-ctg", 0, NULL, 0},
     { "autosome-XY", 0, NULL, 0},
     { "autosome", 0, NULL, 0},
     { "mosaic", 0, NULL, 0},
     { "refine-aln", 0, NULL, 0},
+    { "out-hap-tags", 1, NULL, 0},
+    { "ref-pac", 1, NULL, 0},
     { "out-var-rnames", 0, NULL, 0},
     { "out-sv-rnames", 0, NULL, 0},
     { "out-som-var-rnames", 0, NULL, 0},
@@ -45,6 +53,18 @@ const struct option call_var_opt [] = {
     { "max-somvar", 1, NULL, 0},
     { "som-alt", 1, NULL, 0},
     { "som-mei-alt", 1, NULL, 0},
+    { "inflight-chunks", 1, NULL, 0},
+    { "io-threads", 1, NULL, 0},
+    { "stats", 1, NULL, 0},
+    { "stats-per-chunk", 0, NULL, 0},
+    { "noisy-reg-log", 1, NULL, 0},
+    { "wfa-ultralow", 1, NULL, 0},
+    { "anchor-split", 1, NULL, 0},
+    { "no-read-collapse", 0, NULL, 0},
+    { "noisy-threads", 1, NULL, 0},
+    { "noisy-max-cells", 1, NULL, 0},
+    { "noisy-max-mem", 1, NULL, 0},
+    { "noisy-max-time", 1, NULL, 0},
 
     { "exclude-ctg", 1, NULL, 'E'},
     { "extra-bam", 1, NULL, 'X'},
@@ -141,7 +161,7 @@ call_var_opt_t *call_var_init_para(void) {
     call_var_opt_t *opt = (call_var_opt_t*)_err_malloc(sizeof(call_var_opt_t));
 
     opt->sample_name = NULL;
-    opt->ref_fa_fn = NULL; opt->ref_fa_fai_fn = NULL; opt->reg_bed_fn = NULL;
+    opt->ref_fa_fn = NULL; opt->ref_fa_fai_fn = NULL; opt->ref_pac_fn = NULL; opt->reg_bed_fn = NULL; opt->low_comp_bed_fn = NULL;
     opt->input_is_list = 0; opt->n_in_bam_fn = 1; opt->m_in_bam_fn = 4; opt->in_bam_fns = (char**)malloc(4 * sizeof(char*));
     for (int i = 0; i < 4; i++) opt->in_bam_fns[i] = NULL;
 
@@ -158,6 +178,9 @@ call_var_opt_t *call_var_init_para(void) {
     opt->min_af = LONGCALLD_MIN_CAND_AF;
     opt->max_af = LONGCALLD_MAX_CAND_AF;
     opt->max_noisy_reg_cov = LONGCALLD_MAX_NOISY_REG_COV;
+    opt->noisy_max_cells = LONGCALLD_NOISY_MAX_CELLS;
+    opt->noisy_max_bytes = (int64_t)(LONGCALLD_NOISY_MAX_MEM_GB * (1 << 30));
+    opt->noisy_max_time = 0;
     // somatic/mosaic var
     opt->min_somatic_dis_to_var = LONGCALLD_MIN_SOMATIC_DIS_TO_VAR;
     opt->min_somatic_dis_to_homopolymer_indel_error = LONGCALLD_MIN_SOMATIC_DIS_TO_HP_INDEL_ERROR;
@@ -201,10 +224,16 @@ call_var_opt_t *call_var_init_para(void) {
     opt->gap_ext2 = LONGCALLD_GAP_EXT2_SCORE;
     opt->gap_aln = LONGCALLD_GAP_LEFT_ALN;
     opt->partial_aln_ratio = LONGCALLD_PARTIAL_ALN_RATIO;
+    opt->wfa_ultralow_len = 0;
+    opt->anchor_split_len = 0;
+    opt->no_read_collapse = 0;
     opt->min_noisy_reg_size_to_sample_reads = LONGCALLD_MIN_NOISY_REG_SIZE_TO_SAMPLE_READS;
 
     opt->pl_threads = MIN_OF_TWO(CALL_VAR_PL_THREAD_N, get_num_processors());
     opt->n_threads = MIN_OF_TWO(CALL_VAR_THREAD_N, get_num_processors());
+    opt->noisy_threads = 1;
+    opt->max_inflight_chunks = 0;
+    opt->n_io_threads = MIN_OF_TWO(CALL_VAR_IO_THREAD_N, get_num_processors()); opt->io_tpool.pool = NULL; opt->io_tpool.qsize = 0;
 
     opt->min_sv_len = LONGCALLD_MIN_SV_LEN;
     opt->min_tsd_len = LONGCALLD_MIN_TSD_LEN; opt->max_tsd_len = LONGCALLD_MAX_TSD_LEN;
@@ -216,8 +245,10 @@ call_var_opt_t *call_var_init_para(void) {
 
     opt->p_error = 0.001; opt->log_p = -3.0; opt->log_1p = log10(1-opt->p_error); opt->log_2 = 0.301023;
     opt->max_gq = 60; opt->max_qual = 60;
-    opt->out_vcf = NULL; opt->vcf_hdr = NULL; opt->out_vcf_fn = NULL; opt->out_vcf_type = 'v'; opt->no_vcf_header = 0; opt->out_amb_base = 0;
+    opt->out_vcf = NULL; opt->vcf_hdr = NULL; opt->out_vcf_fn = NULL; opt->out_vcf_idx_fn = NULL; opt->out_vcf_type = 'v';
+    opt->stats_fn = NULL; opt->stats_per_chunk = 0; opt->noisy_reg_log_fp = NULL; opt->noisy_reg_log_fn = NULL; opt->no_vcf_header = 0; opt->out_amb_base = 0;
     opt->out_aln_fp = NULL; opt->out_aln_is_cram = 0; opt->refine_bam = 0;
+    opt->out_hap_tag_fp = NULL; opt->out_hap_tag_fn = NULL;
     opt->out_somatic = 0; opt->out_methylation = 0;
     // opt->verbose = 0;
     return opt;
@@ -229,16 +260,6 @@ void call_var_free_para(call_var_opt_t *opt) {
         if (opt->in_bam_fns[i] != NULL) free(opt->in_bam_fns[i]);
     }
     free(opt->in_bam_fns);
-    if (opt->bams != NULL) {
-        for (int i = 0; i < opt->n_in_bam_fn; ++i) {
-            if (opt->bams[i]) {
-                if (opt->idxs[i]) hts_idx_destroy(opt->idxs[i]);
-                bam_hdr_destroy(opt->headers[i]);
-                sam_close(opt->bams[i]);
-            }
-        }
-        free(opt->bams); free(opt->idxs); free(opt->headers);
-    }
     if (opt->sample_name) free(opt->sample_name);
     // if (opt->region_list) free(opt->region_list);
     if (opt->n_exc_tnames > 0) {
@@ -246,6 +267,13 @@ void call_var_free_para(call_var_opt_t *opt) {
         free(opt->exc_tnames);
     }
     if (opt->out_vcf_fn != NULL) free(opt->out_vcf_fn);
+    if (opt->out_vcf_idx_fn != NULL) free(opt->out_vcf_idx_fn);
+    if (opt->stats_fn != NULL) free(opt->stats_fn);
+    if (opt->noisy_reg_log_fn != NULL) free(opt->noisy_reg_log_fn);
+    if (opt->out_hap_tag_fn != NULL) free(opt->out_hap_tag_fn);
+    if (opt->low_comp_bed_fn != NULL) free(opt->low_comp_bed_fn);
+    if (opt->ref_pac_fn != NULL) free(opt->ref_pac_fn);
+    if (opt->io_tpool.pool != NULL) hts_tpool_destroy(opt->io_tpool.pool); // after all files are closed
     if (opt->te_seq_fn != NULL) {
         free(opt->te_seq_fn);
         for (int i = 0; i < opt->n_te_seqs; ++i) {
@@ -267,7 +295,7 @@ void reg_chunks_free(reg_chunks_t *reg_chunks, int m_reg_chunks) {
     free(reg_chunks);
 }
 
-void call_var_io_aux_free(call_var_io_aux_t *aux, int n) {
+void call_var_io_aux_free(call_var_io_aux_t *aux, int n, int n_noisy_pools) {
     for (int i = 0; i < n; ++i) {
         if (aux[i].fai) fai_destroy(aux[i].fai);
         if (aux[i].n_bam > 0) {
@@ -280,11 +308,31 @@ void call_var_io_aux_free(call_var_io_aux_t *aux, int n) {
             }
             free(aux[i].bams); free(aux[i].idxs); free(aux[i].headers);
         }
+        if (aux[i].reads != NULL) {
+            for (int j = 0; j < aux[i].m_reads; ++j) bam_destroy1(aux[i].reads[j]);
+            free(aux[i].reads);
+        }
+        wfa_pool_destroy(aux[i].wfa_pool); abpoa_pool_destroy(aux[i].poa_pool);
+        if (aux[i].noisy_wfa_pools != NULL) {
+            for (int j = 0; j < n_noisy_pools; ++j) {
+                wfa_pool_destroy(aux[i].noisy_wfa_pools[j]); abpoa_pool_destroy(aux[i].noisy_poa_pools[j]);
+            }
+            free(aux[i].noisy_wfa_pools); free(aux[i].noisy_poa_pools);
+        }
+        if (aux[i].noisy_fp != NULL) kt_forpool_destroy(aux[i].noisy_fp);
+        km_destroy(aux[i].noisy_km);
+        if (aux[i].noisy_kms != NULL) {
+            for (int j = 0; j < n_noisy_pools; ++j) km_destroy(aux[i].noisy_kms[j]);
+            free(aux[i].noisy_kms);
+        }
     }
     free(aux);
 }
 void call_var_free_pl(call_var_pl_t pl) {
-    call_var_io_aux_free(pl.io_aux, pl.n_threads);
+    call_var_io_aux_free(pl.io_aux, pl.n_threads, pl.opt->noisy_threads-1);
+    read_handoff_ex_destroy(pl.handoff_ex);
+    ref_pac_destroy(pl.ref_pac);
+    if (pl.low_comp_cr != NULL) cr_destroy(pl.low_comp_cr);
     reg_chunks_free(pl.reg_chunks, pl.m_reg_chunks);
 }
 
@@ -318,24 +366,95 @@ void var1_free(var1_t *v) {
     }
 }
 
-static void collect_bam_call_var_worker_for(void *_data, long ii, int tid) {
-    call_var_step_t *step = (call_var_step_t*)_data;
-    bam_chunk_t *c = step->chunks + ii;
-    if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "[%s] thread-id: %d, chunk: %ld (%d) ... \n", __func__, tid, ii, step->n_chunks);
-    // if (collect_ref_seq_bam_main(step->pl, step->pl->io_aux+tid, step->pl->reg_chunk_i, ii, c) > 0) {
-    collect_ref_seq_bam_main(step->pl, step->pl->io_aux+tid, step->pl->reg_chunk_i, ii, c);
-    collect_var_main(step->pl, c);
-    // }
-    bam_chunk_mid_free(c, step->pl->opt);
-    if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "[%s] thread-id: %d, chunk: %ld (%d) ... done\n", __func__, tid, ii, step->n_chunks);
+// sliding window over all regions of all reg_chunks (across chromosome boundaries)
+// regions in [out_reg, next_reg) are in-flight, region reg uses slot reg % step->max_chunks
+// region reg-1 is kept until region reg is stitched, so at most max_chunks chunks are resident
+typedef struct {
+    call_var_step_t *step; // ring buffer of chunks/vars, size: step->max_chunks
+    int n_regs, *reg_chunk_is, *reg_is; // flattened regions
+    int next_reg, out_reg; uint8_t *is_called; // per slot
+    pthread_mutex_t mutex; pthread_cond_t cv_load, cv_called;
+} call_var_win_t;
+
+static void call_var_win_init(call_var_win_t *win, call_var_pl_t *pl, int win_size) {
+    memset(win, 0, sizeof(call_var_win_t));
+    for (int i = 0; i < pl->n_reg_chunks; ++i) win->n_regs += pl->reg_chunks[i].n_regions;
+    win->reg_chunk_is = (int*)malloc(win->n_regs * sizeof(int)); win->reg_is = (int*)malloc(win->n_regs * sizeof(int));
+    for (int i = 0, k = 0; i < pl->n_reg_chunks; ++i) {
+        for (int j = 0; j < pl->reg_chunks[i].n_regions; ++j, ++k) {
+            win->reg_chunk_is[k] = i; win->reg_is[k] = j;
+        }
+    }
+    win->step = (call_var_step_t*)calloc(1, sizeof(call_var_step_t));
+    win->step->pl = pl; win->step->n_chunks = win->step->max_chunks = win_size;
+    win->step->chunks = (bam_chunk_t*)calloc(win_size, sizeof(bam_chunk_t));
+    win->step->vars = (var_t*)calloc(win_size, sizeof(var_t));
+    win->is_called = (uint8_t*)calloc(win_size, sizeof(uint8_t));
+    pthread_mutex_init(&win->mutex, 0);
+    pthread_cond_init(&win->cv_load, 0); pthread_cond_init(&win->cv_called, 0);
+}
+
+static void call_var_win_free(call_var_win_t *win) {
+    pthread_mutex_destroy(&win->mutex);
+    pthread_cond_destroy(&win->cv_load); pthread_cond_destroy(&win->cv_called);
+    free(win->reg_chunk_is); free(win->reg_is); free(win->is_called);
+    free(win->step->chunks); free(win->step->vars); free(win->step);
 }
 
-// merge variants from two chunks
-static void make_var_worker_for(void *_data, long ii, int tid) {
-    call_var_step_t *step = (call_var_step_t*)_data;
-    bam_chunk_t *c = step->chunks+ii; var_t *var = step->vars+ii;
-    if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "[%s] thread-id: %d, chunk: %ld (%d), n_reads: %d\n", __func__, tid, ii, step->n_chunks, c->n_reads);
-    make_var_main(step, c, var, ii);
+// a noisy-region arena keeps its peak size, drop the ones grown by a very long/deep region
+// return the number of arenas freed
+static int noisy_km_reset(call_var_io_aux_t *aux, int n_noisy_kms) {
+    int n_resets = 0;
+    for (int i = 0; i <= n_noisy_kms; ++i) {
+        void **km = i == 0 ? &aux->noisy_km : aux->noisy_kms + i-1;
+        km_stat_t ks; km_stat(*km, &ks);
+        if (ks.capacity > LONGCALLD_NOISY_KM_MAX_BYTES) {
+            km_destroy(*km); *km = km_init(); n_resets++;
+        }
+    }
+    return n_resets;
+}
+
+// load reads & call variants for the next region, as long as the window is not full
+static void call_var_win_load(call_var_win_t *win, int tid) {
+    call_var_step_t *step = win->step; call_var_pl_t *pl = step->pl;
+    while (1) {
+        pthread_mutex_lock(&win->mutex);
+        while (win->next_reg < win->n_regs && win->next_reg >= win->out_reg + step->max_chunks)
+            pthread_cond_wait(&win->cv_load, &win->mutex);
+        if (win->next_reg >= win->n_regs) {
+            pthread_mutex_unlock(&win->mutex); break;
+        }
+        int reg = win->next_reg++;
+        pthread_mutex_unlock(&win->mutex);
+
+        int slot = reg % step->max_chunks; bam_chunk_t *c = step->chunks + slot;
+        memset(c, 0, sizeof(bam_chunk_t)); memset(step->vars + slot, 0, sizeof(var_t));
+        if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "[%s] thread-id: %d, region: %d (%d) ... \n", __func__, tid, reg, win->n_regs);
+        double t = realtime();
+        collect_ref_seq_bam_main(pl, pl->io_aux+tid, win->reg_chunk_is[reg], win->reg_is[reg], c);
+        c->stats.tid = tid; c->stats.time[LONGCALLD_STAGE_LOAD_BAM] = realtime() - t; c->stats.cnt[LONGCALLD_CNT_READS] = c->n_reads;
+        c->wfa_pool = pl->io_aux[tid].wfa_pool; c->poa_pool = pl->io_aux[tid].poa_pool;
+        c->noisy_wfa_pools = pl->io_aux[tid].noisy_wfa_pools; c->noisy_poa_pools = pl->io_aux[tid].noisy_poa_pools;
+        c->noisy_km = pl->io_aux[tid].noisy_km; c->noisy_kms = pl->io_aux[tid].noisy_kms; c->noisy_fp = pl->io_aux[tid].noisy_fp;
+        collect_var_main(pl, c);
+        // variants are made here, the writer only flips their GT/PS while stitching
+        t = realtime();
+        make_var_main(step, c, step->vars + slot, slot);
+        c->stats.time[LONGCALLD_STAGE_MAKE_VAR] = realtime() - t;
+        c->wfa_pool = NULL; c->poa_pool = NULL; c->noisy_wfa_pools = NULL; c->noisy_poa_pools = NULL;
+        c->noisy_km = NULL; c->noisy_kms = NULL; c->noisy_fp = NULL;
+        c->stats.cnt[LONGCALLD_CNT_NOISY_KM_RESETS] = noisy_km_reset(pl->io_aux+tid, pl->opt->noisy_threads-1);
+        km_stat_t ks; km_stat(c->km, &ks);
+        c->stats.cnt[LONGCALLD_CNT_KM_CAPACITY] = ks.capacity; c->stats.cnt[LONGCALLD_CNT_KM_IN_USE] = ks.capacity - ks.available;
+        bam_chunk_mid_free(c, pl->opt);
+        if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "[%s] thread-id: %d, region: %d (%d) ... done\n", __func__, tid, reg, win->n_regs);
+
+        pthread_mutex_lock(&win->mutex);
+        win->is_called[slot] = 1;
+        pthread_cond_signal(&win->cv_called);
+        pthread_mutex_unlock(&win->mutex);
+    }
 }
 
 static void reg_chunks_realloc(call_var_pl_t *pl) {
@@ -469,48 +588,165 @@ static int skip_target_region(call_var_opt_t *opt, char *tname) {
     return 0;
 }
 
-static int collect_regions_from_region_list(call_var_opt_t *opt, call_var_pl_t *pl, hts_itr_t *iter, int n_regions, char **regions) {
-    int last_tid = -1; bam_hdr_t *hdr = pl->io_aux[0].headers[0];
+static void reg_chunks_add_region(reg_chunks_t *reg_chunks, int tid, hts_pos_t beg, hts_pos_t end) {
+    reg_chunks_region_realloc(reg_chunks);
+    reg_chunks->reg_tids[reg_chunks->n_regions] = tid;
+    reg_chunks->reg_begs[reg_chunks->n_regions] = beg; // [beg, end]
+    reg_chunks->reg_ends[reg_chunks->n_regions] = end;
+    reg_chunks->n_regions++;
+}
+
+// compressed bytes of [beg, end] (1-based) in all input files, from the BAI/CSI offsets; -1: no such index, e.g., CRAM
+// offsets of coarser bins and of the linear index point back to reads already counted in the previous windows,
+// so only bytes after last_coff[i], the end of the offsets counted so far in file i, are added
+static int64_t reg_index_bytes(call_var_io_aux_t *aux, int tid, hts_pos_t beg, hts_pos_t end, int64_t *last_coff) {
+    int64_t n_bytes = 0;
+    for (int i = 0; i < aux->n_bam; ++i) {
+        hts_idx_t *idx = aux->idxs[i];
+        if (idx == NULL || (hts_idx_fmt(idx) != HTS_FMT_BAI && hts_idx_fmt(idx) != HTS_FMT_CSI)) return -1;
+        hts_itr_t *itr = hts_itr_query(idx, tid, beg-1, end, NULL);
+        if (itr == NULL) return -1;
+        for (int j = 0; j < itr->n_off; ++j) { // sorted & merged by hts_itr_query
+            int64_t u = (int64_t)(itr->off[j].u >> 16), v = (int64_t)(itr->off[j].v >> 16);
+            if (v <= last_coff[i]) continue;
+            n_bytes += v - MAX_OF_TWO(u, last_coff[i]); last_coff[i] = v;
+        }
+        hts_itr_destroy(itr);
+    }
+    return n_bytes;
+}
+
+// min. region size: LONGCALLD_BAM_CHUNK_WIN_READS x the mean reference span of the first reads in the first input file,
+// so that a read is not loaded again by many short regions; LONGCALLD_BAM_CHUNK_WIN_SIZE if no read is mapped
+static hts_pos_t reg_win_size_from_read_len(call_var_io_aux_t *aux) {
+    bam1_t *b = bam_init1(); int64_t n_reads = 0, tot_len = 0;
+    for (int n = 0; n < 10 * LONGCALLD_BAM_CHUNK_WIN_SAMPLE_READS && n_reads < LONGCALLD_BAM_CHUNK_WIN_SAMPLE_READS; ++n) {
+        if (sam_read1(aux->bams[0], aux->headers[0], b) < 0) break;
+        if (b->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FSUPPLEMENTARY)) continue;
+        tot_len += bam_endpos(b) - b->core.pos; n_reads++;
+    }
+    bam_destroy1(b);
+    if (n_reads == 0) return LONGCALLD_BAM_CHUNK_WIN_SIZE;
+    hts_pos_t win = tot_len / n_reads * LONGCALLD_BAM_CHUNK_WIN_READS;
+    return MIN_OF_TWO(MAX_OF_TWO(win, LONGCALLD_BAM_CHUNK_MIN_WIN_SIZE), LONGCALLD_BAM_CHUNK_REG_SIZE);
+}
+
+// move a region end out of a low-complexity interval, so that it is not split between two chunks
+static hts_pos_t reg_end_off_low_comp(call_var_pl_t *pl, const char *tname, hts_pos_t end, hts_pos_t max_end) {
+    if (pl->low_comp_cr == NULL) return end;
+    int64_t *b = 0, m_b = 0, n = cr_overlap(pl->low_comp_cr, tname, end-1, end+1, &b, &m_b);
+    hts_pos_t new_end = end;
+    for (int64_t i = 0; i < n; ++i) { // 0-based: [st, en)
+        if (cr_start(pl->low_comp_cr, b[i]) <= end-1 && cr_end(pl->low_comp_cr, b[i]) > end)
+            new_end = MAX_OF_TWO(new_end, cr_end(pl->low_comp_cr, b[i]));
+    }
+    free(b);
+    if (new_end - end > LONGCALLD_BAM_CHUNK_WIN_SIZE / 2 || new_end >= max_end) return end;
+    return new_end;
+}
+
+// split intervals into regions with similar amounts of alignments, then group regions into reg_chunks:
+// dense windows are cut into regions of >= 1 window, sparse ones are merged up to LONGCALLD_BAM_CHUNK_MAX_REG_SIZE
+// without BAI/CSI, regions are of fixed size: max_reg_len_per_chunk
+static int split_intervals_into_reg_chunks(call_var_pl_t *pl, reg_chunks_t *intvs) {
+    bam_hdr_t *hdr = pl->io_aux[0].headers[0]; hts_pos_t win = reg_win_size_from_read_len(pl->io_aux);
     int min_reg_chunks_per_run = pl->min_reg_chunks_per_run, max_reg_len_per_chunk = pl->max_reg_len_per_chunk;
-    for (int i = 0; i < iter->n_reg; ++i) {
-        for (int j = 0; j < iter->reg_list[i].count; ++j) { // ACGT:1234, (beg, end]:(0,4]
-            int tid = iter->reg_list[i].tid; hts_pos_t chr_len = hdr->target_len[tid]; char *tname = hdr->target_name[tid];
-            if (skip_target_region(opt, tname)) continue;
-            // fprintf(stderr, "Region: %s:%" PRId64 "-%" PRId64 "\n", hdr->target_name[tid], iter->reg_list[i].intervals[j].beg, iter->reg_list[i].intervals[j].end);
-            if (last_tid != -1 && tid != last_tid && pl->reg_chunks[pl->n_reg_chunks].n_regions >= min_reg_chunks_per_run)
-                pl->n_reg_chunks++;
-            reg_chunks_realloc(pl);
-            hts_pos_t reg_beg = MAX_OF_TWO(1, iter->reg_list[i].intervals[j].beg + 1); // 0-base
-            hts_pos_t reg_end = MIN_OF_TWO(iter->reg_list[i].intervals[j].end, chr_len);
-            hts_pos_t n_regions = (reg_end - reg_beg + max_reg_len_per_chunk) / max_reg_len_per_chunk;
-            reg_chunks_t *reg_chunks = &pl->reg_chunks[pl->n_reg_chunks];
-            for (int reg_i = 0; reg_i < n_regions; ++ reg_i) {
-                hts_pos_t beg = (hts_pos_t) reg_i * max_reg_len_per_chunk + reg_beg;
-                hts_pos_t end = MIN_OF_TWO((hts_pos_t) (reg_i + 1) * max_reg_len_per_chunk + reg_beg-1, reg_end);
-                // add region
-                reg_chunks_region_realloc(reg_chunks);
-                reg_chunks->reg_tids[reg_chunks->n_regions] = tid;
-                reg_chunks->reg_begs[reg_chunks->n_regions] = beg; // [beg, end]
-                reg_chunks->reg_ends[reg_chunks->n_regions] = end;
-                reg_chunks->n_regions++;
+    int64_t n_wins = 0, tot_bytes = 0, tot_len = 0;
+    for (int i = 0; i < intvs->n_regions; ++i) n_wins += (intvs->reg_ends[i] - intvs->reg_begs[i] + win) / win;
+    int64_t *win_bytes = (int64_t*)_err_malloc(MAX_OF_TWO(1, n_wins) * sizeof(int64_t));
+    int64_t *last_coff = (int64_t*)_err_calloc(pl->io_aux->n_bam, sizeof(int64_t));
+    for (int i = 0, w = 0; i < intvs->n_regions && tot_bytes >= 0; ++i) {
+        // intervals from --region-file/BED may be unsorted: only skip bytes counted by the previous interval if it is upstream
+        if (i > 0 && (intvs->reg_tids[i] != intvs->reg_tids[i-1] || intvs->reg_begs[i] <= intvs->reg_ends[i-1]))
+            memset(last_coff, 0, pl->io_aux->n_bam * sizeof(int64_t));
+        for (hts_pos_t beg = intvs->reg_begs[i]; beg <= intvs->reg_ends[i]; beg += win, ++w) {
+            hts_pos_t end = MIN_OF_TWO(beg + win - 1, intvs->reg_ends[i]);
+            if ((win_bytes[w] = reg_index_bytes(pl->io_aux, intvs->reg_tids[i], beg, end, last_coff)) < 0) { tot_bytes = -1; break; }
+            tot_bytes += win_bytes[w]; tot_len += end - beg + 1;
+        }
+    }
+    free(last_coff);
+    double target_bytes;
+    if (tot_bytes > 0) {
+        target_bytes = (double)tot_bytes / tot_len * max_reg_len_per_chunk;
+    } else { // no index bytes: fall back to fixed-size regions
+        for (int i = 0, w = 0; i < intvs->n_regions; ++i) {
+            for (hts_pos_t beg = intvs->reg_begs[i]; beg <= intvs->reg_ends[i]; beg += win, ++w)
+                win_bytes[w] = MIN_OF_TWO(beg + win - 1, intvs->reg_ends[i]) - beg + 1;
+        }
+        target_bytes = max_reg_len_per_chunk;
+    }
+    int last_tid = -1;
+    for (int i = 0, w = 0; i < intvs->n_regions; ++i) {
+        int tid = intvs->reg_tids[i];
+        if (last_tid != -1 && tid != last_tid && pl->reg_chunks[pl->n_reg_chunks].n_regions >= min_reg_chunks_per_run)
+            pl->n_reg_chunks++;
+        reg_chunks_realloc(pl);
+        reg_chunks_t *reg_chunks = &pl->reg_chunks[pl->n_reg_chunks];
+        hts_pos_t intv_beg = intvs->reg_begs[i], intv_end = intvs->reg_ends[i], reg_beg = intv_beg; double reg_bytes = 0;
+        for (hts_pos_t win_beg = intv_beg; win_beg <= intv_end; win_beg += win, ++w) {
+            hts_pos_t win_end = MIN_OF_TWO(win_beg + win - 1, intv_end);
+            reg_bytes += win_bytes[w];
+            if (win_end == intv_end) {
+                reg_chunks_add_region(reg_chunks, tid, reg_beg, intv_end);
+            } else if (win_end >= reg_beg && (reg_bytes >= target_bytes || win_end - reg_beg + 1 >= LONGCALLD_BAM_CHUNK_MAX_REG_SIZE)) {
+                hts_pos_t reg_end = reg_end_off_low_comp(pl, hdr->target_name[tid], win_end, intv_end);
+                reg_chunks_add_region(reg_chunks, tid, reg_beg, reg_end);
+                reg_beg = reg_end + 1; reg_bytes = 0;
             }
-            last_tid = tid;
         }
+        last_tid = tid;
     }
     if (pl->reg_chunks[pl->n_reg_chunks].n_regions > 0) pl->n_reg_chunks++;
-    hts_itr_destroy(iter);
+    free(win_bytes);
+    if (LONGCALLD_VERBOSE >= 1) {
+        int n_regs = 0; for (int i = 0; i < pl->n_reg_chunks; ++i) n_regs += pl->reg_chunks[i].n_regions;
+        if (tot_bytes > 0) _err_info("Split %d interval(s) into %d region(s) by index density, %.1f KB per region.\n", intvs->n_regions, n_regs, target_bytes / 1024);
+        else _err_info("Split %d interval(s) into %d region(s) of %d kb.\n", intvs->n_regions, n_regs, max_reg_len_per_chunk / 1000);
+    }
     // Print the region_chunks
     if (LONGCALLD_VERBOSE >= 2) {
+        fprintf(stderr, "Collected %d region chunks:\n", pl->n_reg_chunks);
         for (int i = 0; i < pl->n_reg_chunks; i++) {
             fprintf(stderr, "Chunk %d:\n", i);
             for (int j = 0; j < pl->reg_chunks[i].n_regions; j++) {
-                fprintf(stderr, "\tRegion %d %s:%" PRIi64 "-%" PRIi64 "\n", j, pl->io_aux[0].headers[0]->target_name[pl->reg_chunks[i].reg_tids[j]], pl->reg_chunks[i].reg_begs[j], pl->reg_chunks[i].reg_ends[j]);
+                fprintf(stderr, "\tRegion %d %s:%" PRIi64 "-%" PRIi64 "\n", j, hdr->target_name[pl->reg_chunks[i].reg_tids[j]], pl->reg_chunks[i].reg_begs[j], pl->reg_chunks[i].reg_ends[j]);
             }
         }
     }
     return pl->n_reg_chunks;
 }
 
+static void reg_intvs_init(reg_chunks_t *intvs) {
+    intvs->n_regions = 0; intvs->m_regions = 512;
+    intvs->reg_tids = (int*)malloc(intvs->m_regions * sizeof(int));
+    intvs->reg_begs = (hts_pos_t*)malloc(intvs->m_regions * sizeof(hts_pos_t));
+    intvs->reg_ends = (hts_pos_t*)malloc(intvs->m_regions * sizeof(hts_pos_t));
+}
+
+static void reg_intvs_free(reg_chunks_t *intvs) {
+    free(intvs->reg_tids); free(intvs->reg_begs); free(intvs->reg_ends);
+}
+
+static int collect_regions_from_region_list(call_var_opt_t *opt, call_var_pl_t *pl, hts_itr_t *iter, int n_regions, char **regions) {
+    bam_hdr_t *hdr = pl->io_aux[0].headers[0]; reg_chunks_t intvs; reg_intvs_init(&intvs);
+    for (int i = 0; i < iter->n_reg; ++i) {
+        for (int j = 0; j < iter->reg_list[i].count; ++j) { // ACGT:1234, (beg, end]:(0,4]
+            int tid = iter->reg_list[i].tid; hts_pos_t chr_len = hdr->target_len[tid]; char *tname = hdr->target_name[tid];
+            if (skip_target_region(opt, tname)) continue;
+            // fprintf(stderr, "Region: %s:%" PRId64 "-%" PRId64 "\n", hdr->target_name[tid], iter->reg_list[i].intervals[j].beg, iter->reg_list[i].intervals[j].end);
+            hts_pos_t reg_beg = MAX_OF_TWO(1, iter->reg_list[i].intervals[j].beg + 1); // 0-base
+            hts_pos_t reg_end = MIN_OF_TWO(iter->reg_list[i].intervals[j].end, chr_len);
+            if (reg_beg > reg_end) continue;
+            reg_chunks_add_region(&intvs, tid, reg_beg, reg_end);
+        }
+    }
+    hts_itr_destroy(iter);
+    split_intervals_into_reg_chunks(pl, &intvs);
+    reg_intvs_free(&intvs);
+    return pl->n_reg_chunks;
+}
+
 static int collect_regions_from_bed_file(call_var_opt_t *opt, call_var_pl_t *pl) {
     FILE *fp = fopen(opt->reg_bed_fn, "r");
     if (fp == NULL) {
@@ -559,8 +795,6 @@ static int collect_regions_from_bed_file(call_var_opt_t *opt, call_var_pl_t *pl)
 }
 
 static int collect_regions(call_var_pl_t *pl, call_var_opt_t *opt, int n_regions, char **regions) {
-    int min_reg_chunks_per_run = pl->min_reg_chunks_per_run;
-    int max_reg_len_per_chunk = pl->max_reg_len_per_chunk;
     pl->n_reg_chunks = 0; pl->m_reg_chunks = 100;
     pl->reg_chunks = (reg_chunks_t*)malloc(pl->m_reg_chunks * sizeof(reg_chunks_t));
     for (int i = 0; i < pl->m_reg_chunks; i++) {
@@ -594,43 +828,48 @@ static int collect_regions(call_var_pl_t *pl, call_var_opt_t *opt, int n_regions
             _err_error("Will process the whole alignment file.\n");
         } else return pl->n_reg_chunks;
     }
-    // whole genome, plit chromosomes into region_chunks
-    // collect_regions_from_whole_genome(opt, pl, min_reg_chunks_per_run, max_reg_len_per_chunk);
+    // whole genome, split chromosomes into region_chunks
+    reg_chunks_t intvs; reg_intvs_init(&intvs);
     for (int i = 0; i < pl->io_aux[0].headers[0]->n_targets; i++) {
-        reg_chunks_realloc(pl);
-        // all regions in a chromosome will be in one reg_chunk
         char *tname = pl->io_aux[0].headers[0]->target_name[i];
         if (skip_target_region(opt, tname)) continue;
-        int tid = i; hts_pos_t chr_len = pl->io_aux[0].headers[0]->target_len[i];
-        int n_regions_chr = (chr_len + max_reg_len_per_chunk - 1) / max_reg_len_per_chunk;
-        reg_chunks_t *reg_chunks = &pl->reg_chunks[pl->n_reg_chunks];
-        for (int reg_i = 0; reg_i < n_regions_chr; reg_i++) {
-            hts_pos_t beg = (hts_pos_t) reg_i * max_reg_len_per_chunk + 1;
-            hts_pos_t end = MIN_OF_TWO((hts_pos_t) (reg_i + 1) * max_reg_len_per_chunk, chr_len);
-            // add region
-            reg_chunks_region_realloc(reg_chunks);
-            reg_chunks->reg_tids[reg_chunks->n_regions] = tid;
-            reg_chunks->reg_begs[reg_chunks->n_regions] = beg;
-            reg_chunks->reg_ends[reg_chunks->n_regions] = end;
-            reg_chunks->n_regions++;
-        }
-        if (reg_chunks->n_regions >= min_reg_chunks_per_run) {
-            pl->n_reg_chunks++;
-        }
+        hts_pos_t chr_len = pl->io_aux[0].headers[0]->target_len[i];
+        if (chr_len > 0) reg_chunks_add_region(&intvs, i, 1, chr_len);
     }
-    if (pl->reg_chunks[pl->n_reg_chunks].n_regions > 0) pl->n_reg_chunks++;
+    split_intervals_into_reg_chunks(pl, &intvs);
+    reg_intvs_free(&intvs);
+    return pl->n_reg_chunks; // num of collected chromosomes/contigs
+}
 
-    // Print the region_chunks
-    if (LONGCALLD_VERBOSE >= 2) {
-        fprintf(stderr, "Collected %d region chunks:\n", pl->n_reg_chunks);
-        for (int i = 0; i < pl->n_reg_chunks; i++) {
-            fprintf(stderr, "Chunk %d:\n", i);
-            for (int j = 0; j < pl->reg_chunks[i].n_regions; j++) {
-                fprintf(stderr, "\tRegion %d %s:%" PRIi64 "-%" PRIi64 "\n", j, pl->io_aux[0].headers[0]->target_name[pl->reg_chunks[i].reg_tids[j]], pl->reg_chunks[i].reg_begs[j], pl->reg_chunks[i].reg_ends[j]);
-            }
+// load genome-wide low-complexity regions (BED, 0-based) generated by 'longcallD mask'
+static cgranges_t *load_low_comp_bed(const char *fn, bam_hdr_t *hdr) {
+    FILE *fp = fopen(fn, "r");
+    if (fp == NULL) _err_error_exit("Failed to open low-complexity region bed file: %s\n", fn);
+    cgranges_t *cr = cr_init(); char line[1024]; int n_known_ctg = 0, T = -1, W = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') {
+            if (strncmp(line+1, LONGCALLD_LOW_COMP_BED_HEADER, strlen(LONGCALLD_LOW_COMP_BED_HEADER)) == 0)
+                sscanf(line+1+strlen(LONGCALLD_LOW_COMP_BED_HEADER), " T=%d W=%d", &T, &W);
+            continue;
         }
+        char *tname = strtok(line, "\t"), *beg = strtok(NULL, "\t"), *end = strtok(NULL, "\t\n");
+        if (tname == NULL || beg == NULL || end == NULL) continue;
+        char *p1, *p2; long long st = strtoll(beg, &p1, 10), en = strtoll(end, &p2, 10);
+        if (p1 == beg || p2 == end || st < 0 || en < st)
+            _err_error_exit("Invalid interval in %s: %s\t%s\t%s\n", fn, tname, beg, end);
+        // cgranges stores 32-bit coordinates, longer contigs (e.g., from mask) cannot be loaded
+        if (en > INT32_MAX)
+            _err_error_exit("Interval in %s ends beyond %d bp, which is not supported: %s:%lld-%lld\n", fn, INT32_MAX, tname, st, en);
+        if (cr_get_ctg(cr, tname) < 0 && bam_name2id(hdr, tname) >= 0) n_known_ctg++;
+        cr_add(cr, tname, (int32_t)st, (int32_t)en, 0);
     }
-    return pl->n_reg_chunks; // num of collected chromosomes/contigs
+    fclose(fp);
+    if (T != LONGCALLD_SDUST_T || W != LONGCALLD_SDUST_W)
+        _err_warning("Low-complexity regions in %s were not generated with the default sdust parameters (T=%d W=%d).\n", fn, LONGCALLD_SDUST_T, LONGCALLD_SDUST_W);
+    if (n_known_ctg == 0) _err_warning("No contig in %s is found in the alignment file header.\n", fn);
+    cr_index(cr);
+    _err_info("Loaded %" PRIi64 " low-complexity regions from %s\n", cr->n_r, fn);
+    return cr;
 }
 
 // only works with sorted index BAM/CRAM
@@ -642,18 +881,38 @@ static void call_var_pl_open_fa_bam(call_var_opt_t *opt, call_var_pl_t *pl, char
             _err_error_exit("Input from pipe/stdin is not supported\n");
         _err_info("Opening alignment file: %s\n", opt->in_bam_fns[j]);
     }
+    // reference genome: with --ref-pac, one packed copy mmap'ed by all threads, otherwise one faidx per thread
+    pl->ref_pac = opt->ref_pac_fn != NULL ? ref_pac_load(opt->ref_fa_fn, opt->ref_fa_fai_fn, opt->ref_pac_fn) : NULL;
     pl->io_aux = (call_var_io_aux_t*)malloc(pl->n_threads * sizeof(call_var_io_aux_t));
     // multi-threading
     for (int i = 0; i < pl->n_threads; ++i){
         call_var_io_aux_t *aux = &pl->io_aux[i];
-        aux->n_bam = opt->n_in_bam_fn;
+        aux->n_bam = opt->n_in_bam_fn; aux->m_reads = 0; aux->reads = NULL;
+        aux->wfa_pool = wfa_pool_init(opt); aux->poa_pool = abpoa_pool_init();
+        aux->noisy_wfa_pools = NULL; aux->noisy_poa_pools = NULL;
+        if (opt->noisy_threads > 1) {
+            aux->noisy_wfa_pools = (wfa_pool_t**)malloc((opt->noisy_threads-1) * sizeof(wfa_pool_t*));
+            aux->noisy_poa_pools = (abpoa_pool_t**)malloc((opt->noisy_threads-1) * sizeof(abpoa_pool_t*));
+            for (int j = 0; j < opt->noisy_threads-1; ++j) {
+                aux->noisy_wfa_pools[j] = wfa_pool_init(opt); aux->noisy_poa_pools[j] = abpoa_pool_init();
+            }
+        }
+        aux->noisy_km = km_init(); aux->noisy_kms = NULL;
+        if (opt->noisy_threads > 1) {
+            aux->noisy_kms = (void**)malloc((opt->noisy_threads-1) * sizeof(void*));
+            for (int j = 0; j < opt->noisy_threads-1; ++j) aux->noisy_kms[j] = km_init();
+        }
+        aux->noisy_fp = opt->noisy_threads > 1 ? kt_forpool_init(opt->noisy_threads) : NULL;
         aux->bams = (samFile **)calloc(aux->n_bam, sizeof(samFile *));
         aux->headers = (bam_hdr_t **)calloc(aux->n_bam, sizeof(bam_hdr_t *));
         aux->idxs = (hts_idx_t **)calloc(aux->n_bam, sizeof(hts_idx_t *));
         if (!aux->bams || !aux->headers || !aux->idxs) _err_error_exit("Memory allocation failure\n");
-        aux->fai = fai_load3(opt->ref_fa_fn, opt->ref_fa_fai_fn, NULL, FAI_CREATE);
-        if (aux->fai == NULL)
-            _err_error_exit("Failed to load/build reference fasta index: %s\n", opt->ref_fa_fn);
+        aux->fai = NULL;
+        if (pl->ref_pac == NULL) {
+            aux->fai = fai_load3(opt->ref_fa_fn, opt->ref_fa_fai_fn, NULL, FAI_CREATE);
+            if (aux->fai == NULL)
+                _err_error_exit("Failed to load/build reference fasta index: %s\n", opt->ref_fa_fn);
+        }
 
         for (int j = 0; j < aux->n_bam; ++j) {
             aux->bams[j] = sam_open(opt->in_bam_fns[j], "r"); if (aux->bams[j] == NULL) _err_error_exit("Failed to open alignment file \'%s\'\n", opt->in_bam_fns[j]);
@@ -666,6 +925,8 @@ static void call_var_pl_open_fa_bam(call_var_opt_t *opt, call_var_pl_t *pl, char
                 sam_close(aux->bams[j]);
                 _err_error_exit("Failed to read alignment file header \'%s\'\n", opt->in_bam_fns[j]);
             }
+            if (opt->io_tpool.pool != NULL && hts_set_thread_pool(aux->bams[j], &opt->io_tpool) != 0)
+                _err_warning("Failed to attach I/O thread pool to \'%s\'\n", opt->in_bam_fns[j]);
             if (fmt->format == cram) {
                 if (hts_set_fai_filename(aux->bams[j], opt->ref_fa_fn) != 0) {
                     fai_destroy(aux->fai); sam_hdr_destroy(aux->headers[j]); sam_close(aux->bams[j]);
@@ -688,47 +949,7 @@ static void call_var_pl_open_fa_bam(call_var_opt_t *opt, call_var_pl_t *pl, char
             }
         }
     }
-    if (opt->out_aln_fp != NULL) {
-        opt->bams = (samFile **)calloc(opt->n_in_bam_fn, sizeof(samFile *));
-        opt->headers = (bam_hdr_t **)calloc(opt->n_in_bam_fn, sizeof(bam_hdr_t *));
-        opt->idxs = (hts_idx_t **)calloc(opt->n_in_bam_fn, sizeof(hts_idx_t *));
-        if (!opt->bams || !opt->headers || !opt->idxs) _err_error_exit("Memory allocation failure\n");
-        for (int j = 0; j < opt->n_in_bam_fn; ++j) {
-            opt->bams[j] = sam_open(opt->in_bam_fns[j], "r"); if (opt->bams[j] == NULL) _err_error_exit("Failed to open alignment file \'%s\'\n", opt->in_bam_fns[j]);
-            const htsFormat *fmt = hts_get_format(opt->bams[j]); if (!fmt) _err_error_exit("Failed to get format of alignment file \'%s\'\n", opt->in_bam_fns[j]);
-            if (fmt->format != bam && fmt->format != cram) {
-                sam_close(opt->bams[j]); _err_error_exit("Input alignment file must be BAM or CRAM format.\n");
-            }
-            opt->headers[j] = sam_hdr_read(opt->bams[j]);
-            if (opt->headers[j] == NULL) {
-                sam_close(opt->bams[j]);
-                _err_error_exit("Failed to read alignment file header \'%s\'\n", opt->in_bam_fns[j]);
-            }
-            if (fmt->format == cram) {
-                if (hts_set_fai_filename(opt->bams[j], opt->ref_fa_fn) != 0) {
-                    sam_hdr_destroy(opt->headers[j]); sam_close(opt->bams[j]);
-                    _err_error_exit("Failed to set reference file for CRAM decoding: %s %s\n", opt->in_bam_fns[j], opt->ref_fa_fn);
-                }
-            }
-            // hts_set_threads(opt->bams[j], opt->n_threads);
-            opt->idxs[j] = sam_index_load(opt->bams[j], opt->in_bam_fns[j]);
-            if (opt->idxs[j] == NULL) { // attempt to create index if not exist
-                _err_warning("Index not found for \'%s\', creating now ...\n", opt->in_bam_fns[j]);
-                if (sam_index_build(opt->in_bam_fns[j], 0) < 0) {
-                    sam_hdr_destroy(opt->headers[j]); sam_close(opt->bams[j]);
-                    _err_error_exit("Failed to build index for \'%s\'\n", opt->in_bam_fns[j]);
-                } else {
-                    opt->idxs[j] = sam_index_load(opt->bams[j], opt->in_bam_fns[j]);
-                    if (opt->idxs[j] == NULL) {
-                        sam_hdr_destroy(opt->headers[j]); sam_close(opt->bams[j]);
-                        _err_error_exit("Failed to load index for \'%s\'\n", opt->in_bam_fns[j]);
-                    }
-                }
-            }
-        }
-    } else {
-        opt->bams = NULL; opt->headers = NULL; opt->idxs = NULL;
-    }
+    if (opt->low_comp_bed_fn != NULL) pl->low_comp_cr = load_low_comp_bed(opt->low_comp_bed_fn, pl->io_aux[0].headers[0]);
     // collect sample name (SM) from BAM header
     if (opt->sample_name == NULL) opt->sample_name = extract_sample_name_from_bam_header(pl->io_aux[0].headers[0]); // extract sample names from first BAM header
     if (opt->sample_name == NULL) {
@@ -753,63 +974,83 @@ static void call_var_pl_write_bam_header(call_var_opt_t *opt, bam_hdr_t *header)
     if (opt->out_aln_is_cram) {
         if (hts_set_fai_filename(opt->out_aln_fp, opt->ref_fa_fn) != 0) _err_error_exit("Failed to set reference file for output CRAM encoding: %s\n", opt->ref_fa_fn);
     }
-    hts_set_threads(opt->out_aln_fp, opt->n_threads);
+    if (opt->io_tpool.pool != NULL) hts_set_thread_pool(opt->out_aln_fp, &opt->io_tpool);
     if (sam_hdr_add_pg(header, PROG, "VN", LONGCALLD_VERSION, "CL", CMD, NULL) < 0) _err_error_exit("Fail to add PG line to bam header.\n");
     if (sam_hdr_write(opt->out_aln_fp, header) < 0) _err_error_exit("Failed to write BAM header.\n");
 }
 
-// work with sorted SAM/BAM/CRAM
-static void *call_var_worker_pipeline(void *shared, int step, void *in) { // kt_pipeline() callback
-    call_var_pl_t *pl = (call_var_pl_t*)shared;
-    if (step == 0) { // step 0: read bam records into BAM chunks, call variants
-        if (pl->reg_chunk_i >= pl->n_reg_chunks) return 0;
-        if (LONGCALLD_VERBOSE >= 2) _err_info("Step 0: load BAM & call variants.\n");
-        // _err_info("Processing contig(s): %d/%d ...\n", pl->reg_chunk_i+1, pl->n_reg_chunks);
-        call_var_step_t *s = calloc(1, sizeof(call_var_step_t));
-        s->pl = pl;
-        s->n_chunks = pl->reg_chunks[pl->reg_chunk_i].n_regions;
-        s->chunks = calloc(s->n_chunks, sizeof(bam_chunk_t));
-        // _err_info("Processing ctg-id: %d, n_chunks: %d (%d/%d)\n", pl->reg_chunks[pl->reg_chunk_i].reg_tids[0], s->n_chunks, pl->reg_chunk_i+1, pl->n_reg_chunks);
-        kt_for(pl->n_threads, collect_bam_call_var_worker_for, s, s->n_chunks);
-        pl->reg_chunk_i++;
-        return s;
-    } else if (step == 1) { // step 1: stitch the results
-                            //         merge variants from different chunks
-                            //         1) merge overlapping variants
-                            //         2) update phase set and haplotype (flip if needed)
-        if (LONGCALLD_VERBOSE >= 2) _err_info("Step 2: stitch & make variants\n");
-        if (((call_var_step_t*)in)->n_chunks > 0) {
-            ((call_var_step_t*)in)->vars = calloc(((call_var_step_t*)in)->n_chunks, sizeof(var_t));
-            stitch_var_main((call_var_step_t*)in, ((call_var_step_t*)in)->chunks);
-            kt_for(pl->n_threads, make_var_worker_for, in, ((call_var_step_t*)in)->n_chunks);
+// stitch, make & output variants in the order of regions, as soon as each region is called
+static void call_var_win_write(call_var_win_t *win) {
+    call_var_step_t *s = win->step; call_var_pl_t *pl = s->pl; call_var_opt_t *opt = pl->opt;
+    int W = s->max_chunks;
+    int64_t n_processed_reads = 0; int n_out_vars = 0, n_out_reads = 0, n_out_tags = 0;
+    for (int reg = 0; reg < win->n_regs; ++reg) {
+        int slot = reg % W; bam_chunk_t *c = s->chunks + slot;
+        pthread_mutex_lock(&win->mutex);
+        while (win->is_called[slot] == 0) pthread_cond_wait(&win->cv_called, &win->mutex);
+        pthread_mutex_unlock(&win->mutex);
+        // 1) update phase set and haplotype (flip if needed) based on the previous region
+        double t = realtime(), t1;
+        if (reg > 0) stitch_var_main(s, s->chunks + (reg-1) % W, c, s->vars + slot);
+        t1 = realtime(); c->stats.time[LONGCALLD_STAGE_STITCH] = t1 - t; t = t1;
+        // 2) output variants (& phased reads)
+        if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "[%s] region: %d (%d), n_reads: %d\n", __func__, reg, win->n_regs, c->n_reads);
+        int n = write_var_to_vcf(s->vars + slot, opt, c);
+        n_out_vars += n; c->stats.cnt[LONGCALLD_CNT_OUT_VARS] = n;
+        t1 = realtime(); c->stats.time[LONGCALLD_STAGE_WRITE_VCF] = t1 - t; t = t1;
+        if (opt->out_aln_fp != NULL) {
+            n = write_read_to_bam(c, opt, pl->io_aux);
+            n_out_reads += n; c->stats.cnt[LONGCALLD_CNT_OUT_READS] = n;
         }
-        int64_t n_processed_reads = 0;
-        for (int i = 0; i < ((call_var_step_t*)in)->n_chunks; ++i) {
-            int n_up_ovlp_reads = 0;
-            for (int j = 0; j < pl->opt->n_in_bam_fn; ++j) n_up_ovlp_reads += ((call_var_step_t*)in)->chunks[i].n_up_ovlp_reads[j]; 
-            n_processed_reads += (((call_var_step_t*)in)->chunks[i].n_reads - n_up_ovlp_reads);
+        if (opt->out_hap_tag_fp != NULL) {
+            n = write_read_hap_tags(c, opt);
+            n_out_tags += n; c->stats.cnt[LONGCALLD_CNT_OUT_HAP_TAGS] = n;
         }
-        if (n_processed_reads > 0) _err_info("Processed %" PRIi64 " reads, %d/%d chunks\n", n_processed_reads, pl->reg_chunk_i, pl->n_reg_chunks);
-        return in;
-    } else if (step == 2) { // step 3: write the buffer to output
-        if (LONGCALLD_VERBOSE >= 2) _err_info("Step 3: output variants (& phased bam)\n");
-        call_var_step_t *s = (call_var_step_t*)in;
-        int n_out_vars = 0, n_out_reads = 0;
-        for (int i = 0; i < s->n_chunks; ++i) {
-            bam_chunk_t *c = s->chunks + i;
-            n_out_vars += write_var_to_vcf(s->vars+i, pl->opt, c);
-            if (pl->opt->out_aln_fp != NULL) n_out_reads += write_read_to_bam(c, pl->opt, pl->io_aux);
-            var_free(s->vars + i);  // free output
+        c->stats.time[LONGCALLD_STAGE_WRITE_BAM] = realtime() - t;
+        if (pl->stats != NULL) call_var_stats_report_chunk(pl->stats, &c->stats, c->tname, c->reg_beg, c->reg_end);
+        if (opt->noisy_reg_log_fp != NULL && c->noisy_reg_log.l > 0) fputs(c->noisy_reg_log.s, opt->noisy_reg_log_fp);
+        var_free(s->vars + slot);
+        int n_up_ovlp_reads = 0;
+        for (int j = 0; j < opt->n_in_bam_fn; ++j) n_up_ovlp_reads += c->n_up_ovlp_reads[j];
+        n_processed_reads += c->n_reads - n_up_ovlp_reads;
+        // 3) release the previous region, its slot can be re-used
+        if (reg > 0) {
+            int pre_slot = (reg-1) % W;
+            bam_chunk_post_free(s->chunks + pre_slot, opt);
+            pthread_mutex_lock(&win->mutex);
+            win->is_called[pre_slot] = 0; win->out_reg = reg;
+            pthread_cond_broadcast(&win->cv_load);
+            pthread_mutex_unlock(&win->mutex);
         }
-        if (n_out_vars > 0) _err_info("Output %d variants to VCF\n", n_out_vars);
-        if (n_out_reads > 0) {
-            if (pl->opt->out_aln_is_cram) _err_info("Output %d reads to CRAM\n", n_out_reads);
-            else _err_info("Output %d reads to BAM\n", n_out_reads);
+        if (reg == win->n_regs-1 || win->reg_chunk_is[reg+1] != win->reg_chunk_is[reg]) { // last region of a reg_chunk
+            pl->reg_chunk_i = win->reg_chunk_is[reg] + 1;
+            if (n_processed_reads > 0) _err_info("Processed %" PRIi64 " reads, %d/%d chunks\n", n_processed_reads, pl->reg_chunk_i, pl->n_reg_chunks);
+            if (n_out_vars > 0) _err_info("Output %d variants to VCF\n", n_out_vars);
+            if (n_out_reads > 0) {
+                if (opt->out_aln_is_cram) _err_info("Output %d reads to CRAM\n", n_out_reads);
+                else _err_info("Output %d reads to BAM\n", n_out_reads);
+            }
+            if (n_out_tags > 0) _err_info("Output %d haplotagged reads to %s\n", n_out_tags, opt->out_hap_tag_fn);
+            n_processed_reads = 0; n_out_vars = 0; n_out_reads = 0; n_out_tags = 0;
         }
-        bam_chunks_post_free(s->chunks, s->n_chunks, pl->opt); // free input
-        free(s->vars); free(s);
     }
-    return 0;
+    if (win->n_regs > 0) bam_chunk_post_free(s->chunks + (win->n_regs-1) % W, opt);
+}
+
+// kt_forpool() callback: job i < n_threads loads regions with io_aux[i], the last job is the writer
+// each job runs until all regions are done, so per-worker state stays pinned to one thread
+static void call_var_win_worker_for(void *_data, long i, int tid) {
+    call_var_win_t *win = (call_var_win_t*)_data;
+    if (i < win->step->pl->n_threads) call_var_win_load(win, i);
+    else call_var_win_write(win);
+}
+
+// work with sorted SAM/BAM/CRAM
+// regions are called by n_threads workers in a bounded sliding window, and output by 1 writer in order
+static void call_var_win_main(call_var_pl_t *pl) {
+    call_var_win_t win; call_var_win_init(&win, pl, pl->opt->max_inflight_chunks);
+    kt_forpool(pl->fp, call_var_win_worker_for, &win, pl->n_threads+1);
+    call_var_win_free(&win);
 }
 
 static void call_var_usage(void) {//main usage
@@ -831,6 +1072,8 @@ static void call_var_usage(void) {//main usage
     fprintf(stderr, "                          each line is a region, e.g., chr1         (whole chromosome)\n");
     fprintf(stderr, "                                                       chr1 100     (chr1:100-END)\n");
     fprintf(stderr, "                                                       chr1 100 200 (chr1:100-200)\n");
+    fprintf(stderr, "    --low-comp-bed  FILE  low-complexity regions of the reference, generated by \'%s mask\' []\n", PROG);
+    fprintf(stderr, "                          if not provided, low-complexity regions are detected on the fly\n");
     fprintf(stderr, "    -L --input-is-list    input file is a list of BAM/CRAM files of the same sample\n");
     fprintf(stderr, "                          each line is a file path, e.g., longcallD call -L ref.fa bam_list.txt\n");
     fprintf(stderr, "    -X --extra-bam  FILE  extra input BAM/CRAM file(s) of the same sample for variant calling []\n");
@@ -842,6 +1085,9 @@ static void call_var_usage(void) {//main usage
     fprintf(stderr, "    -E --exclude-ctg STR  exclude contig/chromosome []\n");
     fprintf(stderr, "                          can be used multiple times, e.g., -E hs37d5 -E chrM\n");
     fprintf(stderr, "    -r --ref-idx    FILE  .fai index file for reference FASTA file, detect automaticaly if not provided []\n");
+    fprintf(stderr, "    --ref-pac       FILE  2-bit packed reference, memory-mapped & shared by all threads []\n");
+    fprintf(stderr, "                          built on the first run (and when the FASTA changes), e.g., ref.fa.lpac\n");
+    fprintf(stderr, "                          soft-masking & IUPAC codes are not kept, non-ACGT bases are read as N\n");
     fprintf(stderr, "    -T --trans-elem FILE  transposable element sequence FASTA file []\n");
     // fprintf(stderr, "    --STR           FILE  short tandem repeat annotation file []\n");
     // fprintf(stderr, "                          required 4 columns: chrom, start, end, motif\n");
@@ -849,7 +1095,8 @@ static void call_var_usage(void) {//main usage
     fprintf(stderr, "  Output:\n");
     fprintf(stderr, "    -n --sample-name STR  sample name in VCF output. RG/SM tag or BAM file name will be used if not provided []\n");
     fprintf(stderr, "    -o --out-vcf    FILE  output phased VCF file [stdout]\n");
-    fprintf(stderr, "    -O --out-type    STR  v/z: un/compressed VCF [v]\n");
+    fprintf(stderr, "    -O --out-type    STR  v/z: un/compressed VCF, b/u: compressed/uncompressed BCF [v]\n");
+    fprintf(stderr, "                          index (.tbi for z, .csi for b) is built while writing to -o FILE\n");
     fprintf(stderr, "    -l --min-sv-len  INT  min. length to be considered as SV [%d]\n", LONGCALLD_MIN_SV_LEN);
     fprintf(stderr, "                          SV-related information will be added to INFO field, e.g., SVLEN/SVTYPE/TSD\n");
     fprintf(stderr, "    -H --no-vcf-header    suppress the header in VCF output\n");
@@ -862,6 +1109,8 @@ static void call_var_usage(void) {//main usage
     fprintf(stderr, "                          note: multiple input BAM/CRAM files will be merged in SAM/BAM/CRAM output\n");
     fprintf(stderr, "    --refine-aln          refine alignment in SAM/BAM/CRAM output\n");
     fprintf(stderr, "                          note: output SAM/BAM/CRAM may be unsorted when --refine-aln is set\n");
+    fprintf(stderr, "    --out-hap-tags  FILE  output HP/PS tags of phased reads to a bgzipped & tabix-indexed file []\n");
+    fprintf(stderr, "                          much smaller than -b/-C, use \'%s tag\' to apply the tags to the BAM/CRAM\n", PROG);
     fprintf(stderr, "    --out-var-rnames      output names of supporting reads in VCF FORMAT field for all variants [False]\n");
     fprintf(stderr, "    --out-som-var-rnames  output names of supporting reads in VCF FORMAT field for somatic variants [False]\n");
     fprintf(stderr, "    --out-sv-rnames       output names of supporting reads in VCF FORMAT field for SVs [False]\n");
@@ -897,6 +1146,26 @@ static void call_var_usage(void) {//main usage
     // fprintf(stderr, "\n");
     fprintf(stderr, "  General:\n");
     fprintf(stderr, "    -t --threads     INT  number of threads to use [%d]\n", MIN_OF_TWO(CALL_VAR_THREAD_N, get_num_processors()));
+    fprintf(stderr, "    --inflight-chunks INT max. number of %d-kb region chunks loaded at the same time [%d x threads]\n", LONGCALLD_BAM_CHUNK_REG_SIZE/1000, CALL_VAR_INFLIGHT_CHUNK_PER_THREAD);
+    fprintf(stderr, "                          bounds memory usage, larger values balance the load better across threads\n");
+    fprintf(stderr, "    --io-threads     INT  number of extra threads for BAM/CRAM/VCF (de)compression, shared by all files [%d]\n", MIN_OF_TWO(CALL_VAR_IO_THREAD_N, get_num_processors()));
+    fprintf(stderr, "                          not counted in -t, 0 to decompress in the calling threads\n");
+    fprintf(stderr, "    --noisy-threads  INT  number of threads to align noisy regions of one chunk in parallel [1]\n");
+    fprintf(stderr, "                          -t threads are split into -t/INT chunk workers of INT threads each\n");
+    fprintf(stderr, "    --wfa-ultralow   INT  use WFA ultralow-memory mode for sequences >= INT bp, 0 to disable [0]\n");
+    fprintf(stderr, "                          lowers memory of very long noisy regions at the cost of speed\n");
+    fprintf(stderr, "    --anchor-split   INT  split phased noisy regions >= INT bp at unique k-mer anchors for POA, 0 to disable [0]\n");
+    fprintf(stderr, "                          split regions up to %d kb are then called, others are still skipped above %d kb\n", LONGCALLD_MAX_ANCHOR_SPLIT_REG_LEN/1000, LONGCALLD_MAX_NOISY_REG_LEN/1000);
+    fprintf(stderr, "    --no-read-collapse    align identical noisy-region read segments to the POA graph one by one\n");
+    fprintf(stderr, "    --noisy-max-cells NUM per noisy region, subsample reads if est. POA cells (reads x length x graph size) > NUM [%.0e]\n", (double)LONGCALLD_NOISY_MAX_CELLS);
+    fprintf(stderr, "                          region is skipped if < %d reads are left, 0 for no limit\n", LONGCALLD_NOISY_MIN_SUBSAMPLE_READS);
+    fprintf(stderr, "    --noisy-max-mem FLOAT per noisy region, skip if est. POA DP matrix > FLOAT GB, 0 for no limit [%.0f]\n", LONGCALLD_NOISY_MAX_MEM_GB);
+    fprintf(stderr, "    --noisy-max-time FLOAT per noisy region, use heuristic WFA after FLOAT/2 sec and stop adding reads to POA after FLOAT sec [0]\n");
+    fprintf(stderr, "                          0 for no limit, otherwise the output may depend on the machine load\n");
+    fprintf(stderr, "                          skipped regions are output as VCF records with FILTER=NoisySkip and INFO/SKIPREASON\n");
+    fprintf(stderr, "    --stats         FILE  output per-stage run time and counters (reads, noisy regions, POA cells, etc.) in JSON []\n");
+    fprintf(stderr, "    --stats-per-chunk     also output the run time and counters of each region chunk in --stats FILE\n");
+    fprintf(stderr, "    --noisy-reg-log FILE  output coordinates, read count, alignment time/memory and outcome of each noisy region []\n");
     // fprintf(stderr, "    -h --help             print this help usage\n");
     fprintf(stderr, "    -v --version          print version number\n");
     // fprintf(stderr, "    -V --verbose     INT  verbose level (0-2). 0: none, 1: information, 2: debug [0]\n");
@@ -925,8 +1194,8 @@ int call_var_main(int argc, char *argv[]) {
             case 'r': opt->ref_fa_fai_fn = strdup(optarg); break;
             // case 'b': cgp->var_block_size = atoi(optarg); break;
             case 'o': opt->out_vcf_fn = strdup(optarg); break; // = fopen(optarg, "w"); break;
-            case 'O': if (strcmp(optarg, "v") == 0 || strcmp(optarg, "z") == 0) opt->out_vcf_type = optarg[0];
-                      else _err_error_exit("\'-O/--out-type\' can only be \'v\' or \'z\'\n");
+            case 'O': if (strcmp(optarg, "v") == 0 || strcmp(optarg, "z") == 0 || strcmp(optarg, "b") == 0 || strcmp(optarg, "u") == 0) opt->out_vcf_type = optarg[0];
+                      else _err_error_exit("\'-O/--out-type\' can only be \'v\', \'z\', \'b\' or \'u\'\n");
                       break;
             case 'H': opt->no_vcf_header = 1; break;
             case 'l': opt->min_sv_len = atoi(optarg); break;
@@ -936,6 +1205,8 @@ int call_var_main(int argc, char *argv[]) {
                     // else if (strcmp(call_var_opt[op_idx].name, "ont") == 0) set_ont_opt(opt);
                     else if (strcmp(call_var_opt[op_idx].name, "region-file") == 0 || 
                              strcmp(call_var_opt[op_idx].name, "regions-file") == 0) opt->reg_bed_fn = strdup(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "low-comp-bed") == 0) opt->low_comp_bed_fn = strdup(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "ref-pac") == 0) opt->ref_pac_fn = strdup(optarg);
                     else if (strcmp(call_var_opt[op_idx].name, "all-ctg") == 0) opt->only_autosome = 0, opt->only_autosome_XY=0;
                     else if (strcmp(call_var_opt[op_idx].name, "autosome") == 0) opt->only_autosome = 1;
                     else if (strcmp(call_var_opt[op_idx].name, "autosome-XY") == 0) opt->only_autosome_XY = 1;
@@ -948,9 +1219,22 @@ int call_var_main(int argc, char *argv[]) {
                         opt->somatic_win_max_vars = strtol(optarg, &s, 10); 
                         if (*s == ',') opt->somatic_win = strtol(s+1, &s, 10);
                     } else if (strcmp(call_var_opt[op_idx].name, "refine-aln") == 0) opt->refine_bam = 1;
+                    else if (strcmp(call_var_opt[op_idx].name, "out-hap-tags") == 0) opt->out_hap_tag_fn = strdup(optarg);
                     else if (strcmp(call_var_opt[op_idx].name, "out-var-rnames") == 0) opt->output_var_rnames = 1;
                     else if (strcmp(call_var_opt[op_idx].name, "out-sv-rnames") == 0) opt->output_sv_rnames = 1;
                     else if (strcmp(call_var_opt[op_idx].name, "out-som-var-rnames") == 0) opt->output_somatic_var_rnames = 1;
+                    else if (strcmp(call_var_opt[op_idx].name, "inflight-chunks") == 0) opt->max_inflight_chunks = atoi(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "io-threads") == 0) opt->n_io_threads = atoi(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "stats") == 0) opt->stats_fn = strdup(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "stats-per-chunk") == 0) opt->stats_per_chunk = 1;
+                    else if (strcmp(call_var_opt[op_idx].name, "noisy-reg-log") == 0) opt->noisy_reg_log_fn = strdup(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "wfa-ultralow") == 0) opt->wfa_ultralow_len = atoi(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "anchor-split") == 0) opt->anchor_split_len = atoi(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "no-read-collapse") == 0) opt->no_read_collapse = 1;
+                    else if (strcmp(call_var_opt[op_idx].name, "noisy-threads") == 0) opt->noisy_threads = atoi(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "noisy-max-cells") == 0) opt->noisy_max_cells = (int64_t)atof(optarg);
+                    else if (strcmp(call_var_opt[op_idx].name, "noisy-max-mem") == 0) opt->noisy_max_bytes = (int64_t)(atof(optarg) * (1 << 30));
+                    else if (strcmp(call_var_opt[op_idx].name, "noisy-max-time") == 0) opt->noisy_max_time = atof(optarg);
                     break;
             case 's': opt->out_somatic = 1; break;
             case 'm': opt->out_methylation = 1; break;
@@ -1003,9 +1287,32 @@ int call_var_main(int argc, char *argv[]) {
         opt->n_threads = MIN_OF_TWO(opt->n_threads, get_num_processors());
         opt->pl_threads = MIN_OF_TWO(2, opt->n_threads); // MIN_OF_TWO(opt->n_threads, CALL_VAR_PL_THREAD_N);
     }
+    if (opt->noisy_threads <= 0) opt->noisy_threads = 1;
+    // -t is shared: -t/--noisy-threads chunk workers, each aligning noisy regions with --noisy-threads threads
+    if (opt->noisy_threads > opt->n_threads) opt->noisy_threads = opt->n_threads;
+    opt->n_threads /= opt->noisy_threads;
+    // region chunk i is kept until chunk i+1 is stitched, so at least 2 chunks are needed
+    if (opt->max_inflight_chunks <= 0) opt->max_inflight_chunks = opt->n_threads * CALL_VAR_INFLIGHT_CHUNK_PER_THREAD;
+    if (opt->max_inflight_chunks < 2) opt->max_inflight_chunks = 2;
+    if (opt->n_io_threads > 0) {
+        if ((opt->io_tpool.pool = hts_tpool_init(opt->n_io_threads)) == NULL) _err_error_exit("Failed to create I/O thread pool with %d threads\n", opt->n_io_threads);
+        opt->io_tpool.qsize = opt->n_io_threads * 2; // max. queued blocks per file
+    }
+    if (opt->out_hap_tag_fn != NULL) {
+        if ((opt->out_hap_tag_fp = bgzf_open(opt->out_hap_tag_fn, "w")) == NULL) _err_error_exit("Failed to open haplotag file: %s\n", opt->out_hap_tag_fn);
+        if (opt->io_tpool.pool != NULL) bgzf_thread_pool(opt->out_hap_tag_fp, opt->io_tpool.pool, opt->io_tpool.qsize);
+        const char *hdr = "#chrom\tpos\tqname\tHP\tPS\n";
+        if (bgzf_write(opt->out_hap_tag_fp, hdr, strlen(hdr)) < 0) _err_error_exit("Failed to write haplotag file: %s\n", opt->out_hap_tag_fn);
+    }
+    if (opt->noisy_reg_log_fn != NULL) {
+        if ((opt->noisy_reg_log_fp = fopen(opt->noisy_reg_log_fn, "w")) == NULL) _err_error_exit("Failed to open noisy region log: %s\n", opt->noisy_reg_log_fn);
+        fprintf(opt->noisy_reg_log_fp, "#chrom\tbeg\tend\tlen\tn_reads\tsampling\taln_mode\tn_cons\tpoa_time\twfa_time\treal_time\tpoa_cells\tpoa_peak_bytes\twfa_peak_bytes\toutcome\tfallbacks\n");
+    }
     if (opt->out_vcf_fn == NULL) opt->out_vcf_fn = strdup("-");
-    if (opt->out_vcf_type == 'z') opt->out_vcf = hts_open(opt->out_vcf_fn, "wz");
-    else opt->out_vcf = hts_open(opt->out_vcf_fn, "w");
+    const char *vcf_mode = opt->out_vcf_type == 'z' ? "wz" : (opt->out_vcf_type == 'b' ? "wb" : (opt->out_vcf_type == 'u' ? "wbu" : "w"));
+    opt->out_vcf = hts_open(opt->out_vcf_fn, vcf_mode);
+    int vcf_is_bgzf = opt->out_vcf_type == 'z' || opt->out_vcf_type == 'b';
+    if (opt->out_vcf != NULL && vcf_is_bgzf && opt->io_tpool.pool != NULL) hts_set_thread_pool(opt->out_vcf, &opt->io_tpool);
     // set up pipeline for multi-threading
     call_var_pl_t pl;
     memset(&pl, 0, sizeof(call_var_pl_t));
@@ -1016,17 +1323,36 @@ int call_var_main(int argc, char *argv[]) {
 
     // write VCF/BAM header
     if (opt->out_aln_fp != NULL) call_var_pl_write_bam_header(opt, pl.io_aux[0].headers[0]);
-    if (opt->out_vcf != NULL && (opt->out_vcf_type == 'z' || opt->no_vcf_header == 0)) write_vcf_header(pl.io_aux[0].headers[0], opt);
+    if (opt->out_vcf != NULL && (opt->out_vcf_type != 'v' || opt->no_vcf_header == 0)) write_vcf_header(pl.io_aux[0].headers[0], opt);
+    // index on the fly, TBI for VCF, CSI for BCF
+    if (opt->out_vcf != NULL && vcf_is_bgzf && opt->vcf_hdr != NULL && strcmp(opt->out_vcf_fn, "-") != 0) {
+        opt->out_vcf_idx_fn = (char*)malloc(strlen(opt->out_vcf_fn) + 5);
+        sprintf(opt->out_vcf_idx_fn, "%s.%s", opt->out_vcf_fn, opt->out_vcf_type == 'b' ? "csi" : "tbi");
+        if (bcf_idx_init(opt->out_vcf, opt->vcf_hdr, opt->out_vcf_type == 'b' ? 14 : 0, opt->out_vcf_idx_fn) < 0)
+            _err_warning("Failed to initialize index for output file: %s\n", opt->out_vcf_fn);
+    }
     // start to work !!!
     pl.opt = opt;
-    kt_pipeline(opt->pl_threads, call_var_worker_pipeline, &pl, 3);
+    if (opt->stats_fn != NULL) pl.stats = call_var_stats_report_init(opt->stats_fn, pl.n_threads, opt->stats_per_chunk);
+    pl.fp = kt_forpool_init(pl.n_threads+1); // kept alive for the whole run
+    pl.handoff_ex = read_handoff_ex_init();
+    call_var_win_main(&pl);
+    kt_forpool_destroy(pl.fp);
     if (opt->out_aln_fp != NULL) hts_close(opt->out_aln_fp);
+    if (opt->noisy_reg_log_fp != NULL && fclose(opt->noisy_reg_log_fp) != 0) _err_error("Failed to write noisy region log: %s\n", opt->noisy_reg_log_fn);
+    if (opt->out_hap_tag_fp != NULL) {
+        if (bgzf_close(opt->out_hap_tag_fp) < 0) _err_error_exit("Failed to close haplotag file: %s\n", opt->out_hap_tag_fn);
+        tbx_conf_t conf = {TBX_GENERIC, 1, 2, 2, '#', 0}; // chrom, pos, pos
+        if (tbx_index_build(opt->out_hap_tag_fn, 0, &conf) != 0) _err_warning("Failed to build index for haplotag file: %s\n", opt->out_hap_tag_fn);
+    }
     if (opt->out_vcf != NULL) {
+        if (opt->out_vcf->idx != NULL && bcf_idx_save(opt->out_vcf) < 0) _err_warning("Failed to write index for output file: %s\n", opt->out_vcf_fn);
+        if (hts_close(opt->out_vcf) < 0) _err_error_exit("Failed to close output file: %s\n", opt->out_vcf_fn);
         if (opt->vcf_hdr != NULL) bcf_hdr_destroy(opt->vcf_hdr);
-        hts_close(opt->out_vcf);
     }
     call_var_free_pl(pl); call_var_free_para(opt); 
     // finish
+    call_var_stats_report_destroy(pl.stats, realtime() - realtime0, cputime(), peakrss() / 1024.0 / 1024.0 / 1024.0);
     _err_info("Real time: %.3f sec; CPU: %.3f sec; Peak RSS: %.3f GB.\n", realtime() - realtime0, cputime(), peakrss() / 1024.0 / 1024.0 / 1024.0);
     _err_success("%s\n", CMD);
     return 0;
@@ -10,10 +10,13 @@
 #include "wavefront/wavefront_align.h"
 #include "htslib/vcf.h"
 #include "htslib/sam.h"
+#include "htslib/bgzf.h"
 #include "htslib/thread_pool.h"
 
 #define CALL_VAR_PL_THREAD_N 2 // num of threads for pipeline
 #define CALL_VAR_THREAD_N 8    // num of threads for variant calling
+#define CALL_VAR_INFLIGHT_CHUNK_PER_THREAD 4 // max. num of region chunks loaded at the same time, per thread
+#define CALL_VAR_IO_THREAD_N 4 // num of threads for BGZF/CRAM (de)compression, shared by all input/output files
 
 #define LONGCALLD_MIN_CAND_MQ 30 // ignore reads with MAPQ < 30
 #define LONGCALLD_MIN_CAND_BQ 10 // ignore bases with BQ < 10
@@ -40,6 +43,11 @@
 #define LONGCALLD_NOISY_REG_FLANK_LEN 10 // during re-alignment, include 10-bp flanking region for both ends of noisy region
 
 #define LONGCALLD_MAX_NOISY_REG_LEN 50000 // >50kb noisy region will be skipped
+#define LONGCALLD_MAX_ANCHOR_SPLIT_REG_LEN 200000 // with --anchor-split, >200kb noisy region will be skipped
+// per-noisy-region budgets, see align_noisy_reg1()
+#define LONGCALLD_NOISY_MAX_CELLS 100000000000LL // est. POA cells: reads x region length x graph size, reads are subsampled above it
+#define LONGCALLD_NOISY_MAX_MEM_GB 0.0 // est. size of one POA DP matrix, region is skipped above it, 0: no limit
+#define LONGCALLD_NOISY_MIN_SUBSAMPLE_READS 10 // region is skipped if fewer reads are left after subsampling
 #define LONGCALLD_NOISY_REG_READS 2 // >= 5 reads supporting noisy region
 // #define LONGCALLD_NOISY_REG_RATIO 0.20 // >= 25% reads supporting noisy region
 
@@ -81,6 +89,7 @@
 // for sdust
 #define LONGCALLD_SDUST_T 5  // 10
 #define LONGCALLD_SDUST_W 20 // 50
+#define LONGCALLD_LOW_COMP_BED_HEADER "longcallD low-complexity mask: sdust" // header line of 'longcallD mask' output
 
 // for math_utils
 #define LONGCALLD_LGAMMA_MAX_I 500
@@ -128,10 +137,11 @@ typedef struct var_t {
 typedef struct call_var_opt_t {
     // input
     char *ref_fa_fn, *ref_fa_fai_fn;
+    char *ref_pac_fn; // 2-bit packed reference, built if missing/stale, NULL: fetch with faidx only
     char *reg_bed_fn;
+    char *low_comp_bed_fn; // genome-wide sdust mask from 'longcallD mask', NULL: run sdust for each chunk
     char *sample_name;
     int n_in_bam_fn, m_in_bam_fn, input_is_list; char **in_bam_fns;
-    samFile **bams; bam_hdr_t **headers; hts_idx_t **idxs; // for write to output bam/cram
     uint8_t is_pb_hifi, is_ont; float strand_bias_pval; // for ONT reads
     // variant calling regions
     uint8_t only_autosome, only_autosome_XY;
@@ -151,12 +161,16 @@ typedef struct call_var_opt_t {
     int noisy_reg_merge_dis, noisy_reg_flank_len; // noisy_reg_merge_win; // for re-alignment
     // filters for noisy region, i.e., coverage/ratio
     int max_noisy_reg_len, max_noisy_reg_cov; //, min_noisy_reg_reads; 
+    int64_t noisy_max_cells, noisy_max_bytes; double noisy_max_time; // per-noisy-region budgets, 0: no limit
     double max_var_ratio_per_read, max_noisy_frac_per_read; //, min_noisy_reg_ratio;
     int min_hap_full_reads, min_hap_reads; //, min_no_hap_full_reads;
     // alignment
     int match, mismatch, gap_open1, gap_ext1, gap_open2, gap_ext2;
     int gap_aln; // default: 1: left (minimap2, abpoa), 2: right (wfa2)
     double min_read_to_hap_cons_sim, partial_aln_ratio;
+    int wfa_ultralow_len; // WFA in ultralow memory mode for sequences >= wfa_ultralow_len, 0: off
+    int anchor_split_len; // split noisy regions >= anchor_split_len at k-mer anchors for POA, 0: off
+    int no_read_collapse; // 1: identical read segments are not collapsed into one weighted POA input
     int min_noisy_reg_size_to_sample_reads; //, sampling_hap_read_count, sampling_non_hap_read_count;
     // int disable_read_sampling; // disable read-sampling in long noisy regions; by default read sampling is enabled; disable to capture mosaic variants in long noisy regions
     // TSD & polyA/T
@@ -168,13 +182,20 @@ typedef struct call_var_opt_t {
     // general
     // int max_ploidy;
     int pl_threads, n_threads;
+    int noisy_threads; // threads aligning read-disjoint noisy regions of one chunk, see collect_var_main()
+    int max_inflight_chunks; // size of the sliding window of region chunks, 0: n_threads * CALL_VAR_INFLIGHT_CHUNK_PER_THREAD
+    int n_io_threads; htsThreadPool io_tpool; // one htslib thread pool shared by all input BAM/CRAM and output files, 0: no pool
     // math utils
     double lgamma_cache[LONGCALLD_LGAMMA_MAX_I+1]; int min_lgamma_i, max_lgamma_i; // 0, 999
 
     // output
     int min_sv_len; // classify as SV if length >= min_sv_len (50)
     htsFile *out_aln_fp; uint8_t out_aln_is_cram; uint8_t refine_bam; // phased bam
+    BGZF *out_hap_tag_fp; char *out_hap_tag_fn; // haplotag sidecar, see write_read_hap_tags()
     htsFile *out_vcf; bcf_hdr_t *vcf_hdr; char *out_vcf_fn; char out_vcf_type; // u/b/v/z
+    char *out_vcf_idx_fn; // .tbi/.csi built while writing, kept until bcf_idx_save()
+    char *stats_fn; int stats_per_chunk; // JSON report of per-stage timers & counters
+    FILE *noisy_reg_log_fp; char *noisy_reg_log_fn; // per-noisy-region alignment cost & outcome, TSV
     double p_error, log_p, log_1p, log_2; int max_gq; int max_qual;
     int8_t no_vcf_header, out_amb_base, out_somatic, out_methylation;
 } call_var_opt_t;
@@ -185,16 +206,22 @@ typedef struct {
 } reg_chunks_t;
 
 typedef struct call_var_io_aux_t {
-    faidx_t *fai;
+    faidx_t *fai; // only used without pl->ref_pac
     int n_bam;
     samFile **bams; bam_hdr_t **headers; hts_idx_t **idxs;
+    int m_reads; bam1_t **reads; // read records lent to the chunk being loaded, kept for the whole run
+    struct wfa_pool_t *wfa_pool; struct abpoa_pool_t *poa_pool; // WFA aligners & abPOA object reused by all chunks of this thread
+    struct wfa_pool_t **noisy_wfa_pools; struct abpoa_pool_t **noisy_poa_pools; // size: noisy_threads-1, for the extra --noisy-threads
+    void *noisy_km; void **noisy_kms; // kalloc arenas for noisy-region buffers, same layout as the pools
+    void *noisy_fp; // kt_forpool aligning the noisy regions of one wave, kept for the whole run, NULL if noisy_threads == 1
 } call_var_io_aux_t; // per thread
 
 // shared data for all threads
 typedef struct call_var_pl_t {
     // input files
     call_var_io_aux_t *io_aux;
-    // TODO mv aligner_obj (WFA/abPOA) here
+    struct ref_pac_t *ref_pac; // shared by all threads, NULL: fetch with io_aux->fai
+    cgranges_t *low_comp_cr; // shared by all threads, loaded from opt->low_comp_bed_fn
     // parameters, output files
     struct call_var_opt_t *opt;
     // m-threads
@@ -202,7 +229,9 @@ typedef struct call_var_pl_t {
     // int max_reads_per_chunk, 
     int min_reg_chunks_per_run, max_reg_len_per_chunk;
     int reg_chunk_i, n_reg_chunks, m_reg_chunks; reg_chunks_t *reg_chunks;
-    int n_threads;
+    int n_threads; void *fp; // long-lived kt_forpool: n_threads workers (io_aux[i]) + 1 writer
+    struct call_var_stats_report_t *stats; // NULL: no --stats
+    struct read_handoff_ex_t *handoff_ex; // decoded boundary reads passed from one region's chunk to the next one
 } call_var_pl_t;
 
 struct bam_chunk_t;
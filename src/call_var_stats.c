@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "call_var_stats.h"
+#include "main.h"
+#include "utils.h"
+
+static const char *call_var_stage_names[LONGCALLD_N_STAGES] = {
+    "load_bam", "digar", "classify", "kmeans_phasing", "noisy_msa", "somatic", "make_var",
+    "stitch", "write_vcf", "write_bam"
+};
+
+static const char *call_var_cnt_names[LONGCALLD_N_CNTS] = {
+    "reads", "reused_reads", "cand_sites", "clean_cand_vars", "noisy_regs", "noisy_resolved", "noisy_skipped", "noisy_unresolved",
+    "noisy_over_budget", "noisy_subsampled", "noisy_heuristic_wfa", "noisy_truncated", "poa_cells",
+    "km_capacity", "km_in_use", "noisy_km_resets", "out_vars", "out_reads", "out_hap_tags"
+};
+
+static void stats_add(call_var_stats_t *dst, const call_var_stats_t *src, int stage_beg, int stage_end, int cnt_beg, int cnt_end) {
+    for (int i = stage_beg; i < stage_end; ++i) dst->time[i] += src->time[i];
+    for (int i = cnt_beg; i < cnt_end; ++i) dst->cnt[i] += src->cnt[i];
+}
+
+static void stats_write_json_str(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+static void stats_write_json(FILE *fp, const call_var_stats_t *s, int stage_beg, int stage_end, int cnt_beg, int cnt_end) {
+    fprintf(fp, "\"time\": {");
+    for (int i = stage_beg; i < stage_end; ++i) fprintf(fp, "%s\"%s\": %.6f", i == stage_beg ? "" : ", ", call_var_stage_names[i], s->time[i]);
+    fprintf(fp, "}, \"count\": {");
+    for (int i = cnt_beg; i < cnt_end; ++i) fprintf(fp, "%s\"%s\": %" PRIi64, i == cnt_beg ? "" : ", ", call_var_cnt_names[i], s->cnt[i]);
+    fprintf(fp, "}");
+}
+
+call_var_stats_report_t *call_var_stats_report_init(const char *fn, int n_threads, int per_chunk) {
+    call_var_stats_report_t *rep = (call_var_stats_report_t*)_err_calloc(1, sizeof(call_var_stats_report_t));
+    if ((rep->fp = fopen(fn, "w")) == NULL) _err_error_exit("Failed to open stats file: %s\n", fn);
+    rep->fn = strdup(fn); rep->per_chunk = per_chunk;
+    rep->n_threads = n_threads;
+    rep->threads = (call_var_stats_t*)_err_calloc(n_threads+1, sizeof(call_var_stats_t));
+    fprintf(rep->fp, "{\n  \"command\": "); stats_write_json_str(rep->fp, CMD);
+    fprintf(rep->fp, ",\n  \"version\": \"%s\",\n  \"threads\": %d", LONGCALLD_VERSION, n_threads);
+    if (per_chunk) fprintf(rep->fp, ",\n  \"chunks\": [");
+    return rep;
+}
+
+// called by the writer once the chunk is output
+void call_var_stats_report_chunk(call_var_stats_report_t *rep, const call_var_stats_t *s, const char *tname, int64_t reg_beg, int64_t reg_end) {
+    stats_add(&rep->total, s, 0, LONGCALLD_N_STAGES, 0, LONGCALLD_N_CNTS);
+    stats_add(rep->threads + s->tid, s, 0, LONGCALLD_STAGE_WRITER_BEG, 0, LONGCALLD_CNT_WRITER_BEG);
+    stats_add(rep->threads + rep->n_threads, s, LONGCALLD_STAGE_WRITER_BEG, LONGCALLD_N_STAGES, LONGCALLD_CNT_WRITER_BEG, LONGCALLD_N_CNTS);
+    if (rep->per_chunk) {
+        fprintf(rep->fp, "%s\n    {\"region\": ", rep->n_chunks == 0 ? "" : ",");
+        fprintf(rep->fp, "\"%s:%" PRIi64 "-%" PRIi64 "\", \"thread\": %d, ", tname, reg_beg, reg_end, s->tid);
+        stats_write_json(rep->fp, s, 0, LONGCALLD_N_STAGES, 0, LONGCALLD_N_CNTS);
+        fprintf(rep->fp, "}");
+    }
+    rep->n_chunks++;
+}
+
+void call_var_stats_report_destroy(call_var_stats_report_t *rep, double real_time, double cpu_time, double peak_rss_gb) {
+    if (rep == NULL) return;
+    if (rep->per_chunk) fprintf(rep->fp, "\n  ]");
+    fprintf(rep->fp, ",\n  \"per_thread\": [");
+    for (int i = 0; i <= rep->n_threads; ++i) {
+        call_var_stats_t *s = rep->threads + i;
+        if (i < rep->n_threads) {
+            fprintf(rep->fp, "%s\n    {\"thread\": %d, ", i == 0 ? "" : ",", i);
+            stats_write_json(rep->fp, s, 0, LONGCALLD_STAGE_WRITER_BEG, 0, LONGCALLD_CNT_WRITER_BEG);
+        } else {
+            fprintf(rep->fp, ",\n    {\"thread\": \"writer\", ");
+            stats_write_json(rep->fp, s, LONGCALLD_STAGE_WRITER_BEG, LONGCALLD_N_STAGES, LONGCALLD_CNT_WRITER_BEG, LONGCALLD_N_CNTS);
+        }
+        fprintf(rep->fp, "}");
+    }
+    fprintf(rep->fp, "\n  ],\n  \"total\": {\"chunks\": %d, ", rep->n_chunks);
+    stats_write_json(rep->fp, &rep->total, 0, LONGCALLD_N_STAGES, 0, LONGCALLD_N_CNTS);
+    fprintf(rep->fp, "},\n  \"real_time\": %.3f,\n  \"cpu_time\": %.3f,\n  \"peak_rss_gb\": %.3f\n}\n", real_time, cpu_time, peak_rss_gb);
+    if (fclose(rep->fp) != 0) _err_error("Failed to write stats file: %s\n", rep->fn);
+    free(rep->fn); free(rep->threads); free(rep);
+}
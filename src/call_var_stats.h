@@ -0,0 +1,74 @@
+#ifndef LONGCALLD_CALL_VAR_STATS_H
+#define LONGCALLD_CALL_VAR_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// per-chunk timers (wall-clock seconds) and counters
+// filled by the worker that calls the chunk, then by the writer; aggregated by the writer only, so no locking is needed
+enum {
+    LONGCALLD_STAGE_LOAD_BAM = 0, // reference sequence & BAM records
+    LONGCALLD_STAGE_DIGAR,        // digars from CIGAR/MD
+    LONGCALLD_STAGE_CLASSIFY,     // candidate sites/variants, noisy regions, clean/noisy classification
+    LONGCALLD_STAGE_KMEANS,       // read-variant profile & k-means phasing with clean-region variants
+    LONGCALLD_STAGE_NOISY_MSA,    // POA/WFA of each noisy region, including re-phasing after new variants
+    LONGCALLD_STAGE_SOMATIC,
+    LONGCALLD_STAGE_MAKE_VAR,     // GT/DP/AD etc. of the chunk's variants, before stitching
+    LONGCALLD_STAGE_STITCH,       // stages below are run by the writer
+    LONGCALLD_STAGE_WRITE_VCF,
+    LONGCALLD_STAGE_WRITE_BAM,    // phased BAM/CRAM & haplotag sidecar
+    LONGCALLD_N_STAGES
+};
+#define LONGCALLD_STAGE_WRITER_BEG LONGCALLD_STAGE_STITCH
+
+enum {
+    LONGCALLD_CNT_READS = 0,
+    LONGCALLD_CNT_REUSED_READS,     // boundary reads decoded by the upstream chunk
+    LONGCALLD_CNT_CAND_SITES,
+    LONGCALLD_CNT_CLEAN_CAND_VARS,
+    LONGCALLD_CNT_NOISY_REGS,
+    LONGCALLD_CNT_NOISY_RESOLVED,
+    LONGCALLD_CNT_NOISY_SKIPPED,    // too long or too deep
+    LONGCALLD_CNT_NOISY_UNRESOLVED, // no consensus
+    LONGCALLD_CNT_NOISY_OVER_BUDGET, // skipped by --noisy-max-cells/mem/time, also counted in NOISY_SKIPPED
+    LONGCALLD_CNT_NOISY_SUBSAMPLED, // attempts with the fallbacks of --noisy-max-*, see LONGCALLD_NOISY_FB_*
+    LONGCALLD_CNT_NOISY_HEURISTIC,
+    LONGCALLD_CNT_NOISY_TRUNCATED,
+    LONGCALLD_CNT_POA_CELLS,        // upper bound: aligned bases x graph nodes
+    LONGCALLD_CNT_KM_CAPACITY,      // bytes held by the chunk's kalloc arena, before bam_chunk_mid_free
+    LONGCALLD_CNT_KM_IN_USE,        // bytes of the above still allocated
+    LONGCALLD_CNT_NOISY_KM_RESETS,  // noisy-region arenas of the worker freed after this chunk, see LONGCALLD_NOISY_KM_MAX_BYTES
+    LONGCALLD_CNT_OUT_VARS,         // counters below are filled by the writer
+    LONGCALLD_CNT_OUT_READS,
+    LONGCALLD_CNT_OUT_HAP_TAGS,
+    LONGCALLD_N_CNTS
+};
+#define LONGCALLD_CNT_WRITER_BEG LONGCALLD_CNT_OUT_VARS
+
+typedef struct {
+    int tid; // worker that called the chunk
+    double time[LONGCALLD_N_STAGES];
+    int64_t cnt[LONGCALLD_N_CNTS];
+} call_var_stats_t;
+
+// JSON report of one run: optional per-chunk entries, per-thread (workers + writer) and total sums
+typedef struct call_var_stats_report_t {
+    FILE *fp; char *fn;
+    int per_chunk, n_chunks;
+    int n_threads; call_var_stats_t *threads; // size: n_threads+1, the last one is the writer
+    call_var_stats_t total;
+} call_var_stats_report_t;
+
+call_var_stats_report_t *call_var_stats_report_init(const char *fn, int n_threads, int per_chunk);
+void call_var_stats_report_chunk(call_var_stats_report_t *rep, const call_var_stats_t *s, const char *tname, int64_t reg_beg, int64_t reg_end);
+void call_var_stats_report_destroy(call_var_stats_report_t *rep, double real_time, double cpu_time, double peak_rss_gb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // end of LONGCALLD_CALL_VAR_STATS_H
@@ -10,6 +10,8 @@
 #include "seq.h"
 #include "assign_hap.h"
 #include "vcf_utils.h"
+#include "kthread.h"
+#include "kalloc.h"
 
 extern int LONGCALLD_VERBOSE;
 
@@ -30,12 +32,7 @@ cand_var_t *init_cand_vars_based_on_sites(int n_var_sites, var_site_t *var_sites
         cand_vars[i].ref_len = var_sites[i].ref_len; cand_vars[i].ref_base = 4; // unknown
 
         cand_vars[i].total_cov = 0; cand_vars[i].low_qual_cov = 0; 
-        cand_vars[i].n_uniq_alles = 2; // ref/alt
-        cand_vars[i].alle_covs = (int*)calloc(2, sizeof(int)); // ref/alt
-        cand_vars[i].strand_to_alle_covs = (int**)malloc(2 * sizeof(int*));
-        for (int j = 0; j < 2; ++j) {
-            cand_vars[i].strand_to_alle_covs[j] = (int*)calloc(2, sizeof(int)); // ref/alt
-        }
+        cand_vars[i].n_uniq_alles = 2; // ref/alt, alle_covs/strand_to_alle_covs are zeroed by memset
         cand_vars[i].alt_len = var_sites[i].alt_len; // cand_vars[i].alt_seq = var_sites[i].alt_seq;
         if (cand_vars[i].var_type == BAM_CINS || cand_vars[i].var_type == BAM_CDIFF) {
             cand_vars[i].alt_seq = (uint8_t*)malloc(cand_vars[i].alt_len * sizeof(uint8_t));
@@ -43,7 +40,7 @@ cand_var_t *init_cand_vars_based_on_sites(int n_var_sites, var_site_t *var_sites
         } else cand_vars[i].alt_seq = NULL;
         cand_vars[i].alt_ref_base = 4; // unknown
         // dynamic information, allocate and update during haplotype assignment
-        cand_vars[i].hap_to_alle_profile = NULL; cand_vars[i].hap_to_cons_alle = NULL;
+        cand_vars[i].has_hap_profile = 0;
         // somatic/TSD/TE information
         cand_vars[i].somatic_aux_info = NULL; // unset
         cand_vars[i].te_seq_i = -1; // unset
@@ -52,21 +49,9 @@ cand_var_t *init_cand_vars_based_on_sites(int n_var_sites, var_site_t *var_sites
 }
 
 void free_cand_vars1(cand_var_t *cand_vars) {
-    if (cand_vars->alle_covs != NULL) free(cand_vars->alle_covs); 
-    if (cand_vars->strand_to_alle_covs != NULL) {
-        for (int j = 0; j < 2; ++j) {
-            free(cand_vars->strand_to_alle_covs[j]);
-        } free(cand_vars->strand_to_alle_covs);
-    }
     if (cand_vars->alt_seq != NULL) free(cand_vars->alt_seq);
     if (cand_vars->somatic_aux_info != NULL) free_somatic_var_aux_info(cand_vars->somatic_aux_info);
     if (cand_vars->tsd_len > 0) free(cand_vars->tsd_seq);
-    if (cand_vars->hap_to_alle_profile != NULL) {
-        for (int j = 0; j <= LONGCALLD_DEF_PLOID; ++j) {
-            free(cand_vars->hap_to_alle_profile[j]);
-        } free(cand_vars->hap_to_alle_profile);
-    }
-    if (cand_vars->hap_to_cons_alle != NULL) free(cand_vars->hap_to_cons_alle);
 }
 
 
@@ -194,13 +179,13 @@ int fuzzy_comp_cand_var(const call_var_opt_t *opt, cand_var_t *var1, cand_var_t
     return exact_comp_var_site(opt, &var_site1, &var_site2);
 }
 
-int fuzzy_comp_ins_var_low_complexity(const call_var_opt_t *opt, var_site_t *large_var, var_site_t *small_var) {
+int fuzzy_comp_ins_var_low_complexity(const call_var_opt_t *opt, wfa_pool_t *pool, var_site_t *large_var, var_site_t *small_var) {
     if (large_var->var_type == BAM_CINS && small_var->var_type == BAM_CINS) {
         int large_ins_len = large_var->alt_len, small_ins_len = small_var->alt_len;
         if (large_ins_len < small_ins_len) return 0; // not low_comp_ins
         // if ((vntr_fuzzy_comp_seq(opt, large_var->alt_seq, large_var->alt_len, small_var->alt_seq, small_var->alt_len) == 0)) return 0;
         int diff_len = 0; uint8_t *diff_seq = 0;
-        diff_len = wfa_collect_diff_ins_seq(opt, large_var->alt_seq, large_var->alt_len, small_var->alt_seq, small_var->alt_len, &diff_seq);
+        diff_len = wfa_collect_diff_ins_seq(opt, pool, large_var->alt_seq, large_var->alt_len, small_var->alt_seq, small_var->alt_len, &diff_seq);
         uint64_t *r; int n=0, T=LONGCALLD_SDUST_T, W=LONGCALLD_SDUST_W;
         r = sdust(0, diff_seq, diff_len, T, W, &n);
         int low_comp_len = 0;
@@ -439,13 +424,8 @@ void copy_var(cand_var_t *to_var, cand_var_t *from_var) {
     to_var->ref_len = from_var->ref_len;
 
     // allele_covs, alt_seq, alt_len
-    if (to_var->alle_covs) free(to_var->alle_covs);
-    to_var->alle_covs = (int*)malloc(from_var->n_uniq_alles * sizeof(int));
     to_var->n_uniq_alles = from_var->n_uniq_alles;
-
-    for (int j = 0; j < to_var->n_uniq_alles; ++j) {
-        to_var->alle_covs[j] = from_var->alle_covs[j];
-    }
+    memcpy(to_var->alle_covs, from_var->alle_covs, sizeof(to_var->alle_covs));
     if (to_var->alt_len != from_var->alt_len) {
         to_var->alt_len = from_var->alt_len;
         free(to_var->alt_seq); to_var->alt_seq = (uint8_t*)malloc(from_var->alt_len * sizeof(uint8_t));
@@ -906,7 +886,7 @@ int classify_cand_vars(bam_chunk_t *chunk, int n_var_sites, const call_var_opt_t
     int *var_i_to_cate = (int*)malloc(n_var_sites * sizeof(int));
     cgranges_t *var_pos_cr = cr_init(); cgranges_t *noisy_var_cr = cr_init(); // overlapping vars: DP needs to be >= min_alt_dp
     cgranges_t *low_comp_cr = chunk->low_comp_cr;
-    chunk->var_i_to_cate = (int*)malloc(n_var_sites * sizeof(int));
+    chunk->var_i_to_cate = (int*)malloc(n_var_sites * sizeof(int)); chunk->m_cand_vars = n_var_sites;
     int min_dp = opt->min_dp, min_alt_dp = opt->min_alt_dp;
     double min_af = opt->min_af, max_af = opt->max_af, min_noisy_reg_ratio = opt->min_af;//opt->min_noisy_reg_ratio;
     int var_cate = -1;
@@ -1022,10 +1002,6 @@ int classify_cand_vars(bam_chunk_t *chunk, int n_var_sites, const call_var_opt_t
     }
 
     for (int i = cand_var_i; i < n_var_sites; ++i) {
-        free(cand_vars[i].alle_covs);
-        for (int j = 0; j < cand_vars[i].n_uniq_alles; ++j) {
-            free(cand_vars[i].strand_to_alle_covs[j]);
-        } free(cand_vars[i].strand_to_alle_covs);
         if (cand_vars[i].alt_seq != NULL) free(cand_vars[i].alt_seq);
         if (cand_vars[i].tsd_len > 0) free(cand_vars[i].tsd_seq);
     }
@@ -1060,26 +1036,61 @@ int collect_noisy_reg_reads1(bam_chunk_t *chunk, hts_pos_t noisy_reg_beg, hts_po
     return n_noisy_reads;
 }
 
+static void collect_digar1_from_bam(bam_chunk_t *chunk, int read_i, const call_var_opt_t *opt) {
+    bam1_t *read = chunk->reads[read_i];
+    if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "%d: qname: %s, flag: %d, pos: %" PRId64 ", end: %" PRId64 "\n", read_i, bam_get_qname(read), read->core.flag, read->core.pos+1, bam_endpos(read));
+    if (chunk->is_skipped[read_i]) return;
+    int ret;
+    if (has_equal_X_in_bam_cigar(read)) {
+        ret = collect_digar_from_eqx_cigar(chunk, read_i, opt, chunk->digars+read_i);
+    } else if (has_cs_in_bam(read)) {
+        ret = collect_digar_from_cs_tag(chunk, read_i, opt, chunk->digars+read_i);
+    } else if (has_MD_in_bam(read)) {
+        ret = collect_digar_from_MD_tag(chunk, read_i, opt, chunk->digars+read_i);
+    } else { // no =/X in cigar and no cs/MD tag, compare bases with ref_seq
+        ret = collect_digar_from_ref_seq(chunk, read_i, opt, chunk->digars+read_i);
+    }
+    if (ret < 0) chunk->is_skipped[read_i] = BAM_RECORD_WRONG_MAP;
+}
+
+// reads spanning a region boundary are decoded once, by the upstream chunk (see read_handoff_t):
+// 1. reads only overlapping the downstream region are decoded first, and handed over as early as possible
+// 2. reads not overlapping other regions
+// 3. reads overlapping the upstream region are reused from its chunk if already handed over, otherwise decoded here
 void collect_digars_from_bam(bam_chunk_t *chunk, const struct call_var_pl_t *pl) {
     chunk->chunk_noisy_regs = cr_init();
     call_var_opt_t *opt = pl->opt;
+    uint8_t *read_ovlp = (uint8_t*)calloc(chunk->n_reads > 0 ? chunk->n_reads : 1, sizeof(uint8_t)); // 1: upstream, 2: downstream
+    for (int i = 0; i < chunk->n_bam; ++i) {
+        for (int j = 0; j < chunk->n_up_ovlp_reads[i]; ++j) read_ovlp[chunk->up_ovlp_read_i[i][j]] |= 1;
+        for (int j = 0; j < chunk->n_down_ovlp_reads[i]; ++j) read_ovlp[chunk->down_ovlp_read_i[i][j]] |= 2;
+    }
     for (int i = 0; i < chunk->n_reads; ++i) {
         int read_i = chunk->ordered_read_ids[i];
-        bam1_t *read = chunk->reads[read_i];
-        if (LONGCALLD_VERBOSE >= 3) fprintf(stderr, "%d: qname: %s, flag: %d, pos: %" PRId64 ", end: %" PRId64 "\n", i, bam_get_qname(read), read->core.flag, read->core.pos+1, bam_endpos(read));
-        if (chunk->is_skipped[read_i]) continue;
-        int ret;
-        if (has_equal_X_in_bam_cigar(read)) {
-            ret = collect_digar_from_eqx_cigar(chunk, read_i, opt, chunk->digars+read_i);
-        } else if (has_cs_in_bam(read)) {
-            ret = collect_digar_from_cs_tag(chunk, read_i, opt, chunk->digars+read_i);
-        } else if (has_MD_in_bam(read)) {
-            ret = collect_digar_from_MD_tag(chunk, read_i, opt, chunk->digars+read_i);
-        } else { // no =/X in cigar and no cs/MD tag, compare bases with ref_seq
-            ret = collect_digar_from_ref_seq(chunk, read_i, opt, chunk->digars+read_i);
-        }
-        if (ret < 0) chunk->is_skipped[read_i] = BAM_RECORD_WRONG_MAP;
+        if (read_ovlp[read_i] != 2) continue;
+        chunk->digar_is_shared[read_i] = 1; // seq/qual are not allocated from the chunk's arena
+        collect_digar1_from_bam(chunk, read_i, opt);
     }
+    read_handoff_put(pl, chunk);
+    for (int i = 0; i < chunk->n_reads; ++i) {
+        int read_i = chunk->ordered_read_ids[i];
+        if (read_ovlp[read_i] == 0) collect_digar1_from_bam(chunk, read_i, opt);
+    }
+    chunk->up_handoff = read_handoff_get(pl, chunk);
+    int n_reused = 0;
+    for (int i = 0; i < chunk->n_bam; ++i) {
+        for (int j = 0; j < chunk->n_up_ovlp_reads[i]; ++j) {
+            int read_i = chunk->up_ovlp_read_i[i][j];
+            if (reuse_digar_from_handoff(chunk, read_i, chunk->up_handoff, i, j)) n_reused++;
+            else collect_digar1_from_bam(chunk, read_i, opt);
+        }
+    }
+    chunk->stats.cnt[LONGCALLD_CNT_REUSED_READS] = n_reused;
+    for (int i = 0; i < chunk->n_reads; ++i) {
+        int read_i = chunk->ordered_read_ids[i];
+        if (chunk->is_skipped[read_i] == 0) add_digar_noisy_regs_to_chunk(chunk, read_i);
+    }
+    free(read_ovlp);
     // print chunk->qual_counts
     int n_all_quals = 256;
     int valid_quals[256], n_valid_quals = 0; // XXX MAX_QUAL = 255
@@ -1103,10 +1114,7 @@ void collect_digars_from_bam(bam_chunk_t *chunk, const struct call_var_pl_t *pl)
         chunk->max_qual = valid_quals[n_valid_quals-1];
     }
     // fprintf(stderr, "n_valid: %d, min: %d, 1st quartile: %d, median: %d, 3rd quartile: %d, max: %d\n", n_valid_quals, chunk->min_qual, chunk->first_quar_qual, chunk->median_qual, chunk->third_quar_qual, chunk->max_qual);
-    if (LONGCALLD_VERBOSE < 2) {
-        for (int i = 0; i < chunk->m_reads; ++i) bam_destroy1(chunk->reads[i]);
-        free(chunk->reads);
-    }
+    if (chunk->reads_are_lent) chunk->reads = NULL; // read records are owned by the worker (io_aux), re-used for the next chunk
 }
 
 // XXX should be digar->pos-1 for INS/DEL
@@ -1220,7 +1228,7 @@ int collect_all_cand_var_sites(const call_var_opt_t *opt, bam_chunk_t *chunk, va
     }
     if (max_var_sites == 0) return 0;
 
-    *var_sites = (var_site_t*)malloc((size_t)max_var_sites * sizeof(var_site_t));
+    *var_sites = (var_site_t*)kmalloc(chunk->km, (size_t)max_var_sites * sizeof(var_site_t));
     for (int i = 0; i < chunk->n_reads; ++i) {
         int read_i = chunk->ordered_read_ids[i];
         if (chunk->is_skipped[read_i]) continue;
@@ -1258,132 +1266,170 @@ int exact_comp_cand_var(const call_var_opt_t *opt, cand_var_t *var1, cand_var_t
     return exact_comp_var_site(opt, &var_site1, &var_site2);
 }
 
-static void merge_read_var_profile_entries(const read_var_profile_t *old_p1, const int *old_to_merged,
-                                           const read_var_profile_t *new_p1, const int *new_to_merged,
-                                           read_var_profile_t *merged_p1, int merged_var_limit) {
-    int old_var_i = (old_p1 != NULL ? old_p1->start_var_idx : 1);
-    int old_end_var_i = (old_p1 != NULL ? old_p1->end_var_idx : 0);
-    int new_var_i = (new_p1 != NULL ? new_p1->start_var_idx : 1);
-    int new_end_var_i = (new_p1 != NULL ? new_p1->end_var_idx : 0);
-
-    if (old_p1 == NULL || old_to_merged == NULL || old_var_i < 0 || old_end_var_i < old_var_i) {
-        old_var_i = 1;
-        old_end_var_i = 0;
-    }
-    if (new_p1 == NULL || new_to_merged == NULL || new_var_i < 0 || new_end_var_i < new_var_i) {
-        new_var_i = 1;
-        new_end_var_i = 0;
+// old var index -> merged index, only old vars in [win_beg, win_end) are interleaved with new vars
+static inline int spliced_old_var_i(int var_i, int win_beg, int win_end, int shift, const int *win_old_to_merged) {
+    if (var_i < win_beg) return var_i;
+    if (var_i >= win_end) return var_i + shift;
+    return win_old_to_merged[var_i - win_beg];
+}
+
+// re-write read's band with old+new entries in merged variant order
+// old entries only move towards the band end, so the band is filled backward in place
+static void splice_read_var_profile1(read_var_profile_t *p1, const read_var_profile_t *new_p1, const int *new_to_merged,
+                                     int win_beg, int win_end, int shift, const int *win_old_to_merged) {
+    int old_beg = p1->start_var_idx, old_end = p1->end_var_idx;
+    int new_start = new_p1->start_var_idx, new_beg = new_p1->start_var_idx, new_end = new_p1->end_var_idx;
+    int merged_beg = INT_MAX, merged_end = -1;
+
+    if (old_beg < 0 || old_end < old_beg) { old_beg = 0; old_end = -1; }
+    if (new_beg < 0 || new_end < new_beg) { new_beg = 0; new_end = -1; }
+    while (new_beg <= new_end && new_to_merged[new_beg] < 0) new_beg++; // skip new vars that are identical to old ones
+    while (new_end >= new_beg && new_to_merged[new_end] < 0) new_end--;
+    if (old_beg <= old_end) {
+        merged_beg = spliced_old_var_i(old_beg, win_beg, win_end, shift, win_old_to_merged);
+        merged_end = spliced_old_var_i(old_end, win_beg, win_end, shift, win_old_to_merged);
+    }
+    if (new_beg <= new_end) {
+        if (new_to_merged[new_beg] < merged_beg) merged_beg = new_to_merged[new_beg];
+        if (new_to_merged[new_end] > merged_end) merged_end = new_to_merged[new_end];
+    }
+    if (merged_end < 0) return;
+
+    reserve_read_var_profile_band(p1, merged_end - merged_beg + 1);
+    int old_i = old_end, new_i = new_end;
+    for (int var_i = merged_end; var_i >= merged_beg; --var_i) {
+        int8_t allele = -1; int32_t alt_qi = -1;
+        if (old_i >= old_beg && spliced_old_var_i(old_i, win_beg, win_end, shift, win_old_to_merged) == var_i) {
+            allele = p1->alleles[old_i - old_beg]; alt_qi = p1->alt_qi[old_i - old_beg];
+            old_i--;
+        } else if (new_i >= new_beg && new_to_merged[new_i] == var_i) {
+            allele = new_p1->alleles[new_i - new_start]; alt_qi = new_p1->alt_qi[new_i - new_start];
+            do new_i--; while (new_i >= new_beg && new_to_merged[new_i] < 0);
+        }
+        p1->alleles[var_i - merged_beg] = allele; p1->alt_qi[var_i - merged_beg] = alt_qi;
+    }
+    p1->start_var_idx = merged_beg; p1->end_var_idx = merged_end;
+}
+
+// re-collect read_var_cr from read bands in read order, the interval buffer is re-used
+static void update_read_var_cr(bam_chunk_t *chunk) {
+    if (chunk->read_var_cr == NULL) chunk->read_var_cr = cr_init();
+    cgranges_t *read_var_cr = chunk->read_var_cr; read_var_profile_t *p = chunk->read_var_profile;
+    read_var_cr->n_r = 0;
+    for (int i = 0; i < read_var_cr->n_ctg; ++i) read_var_cr->ctg[i].n = 0;
+    for (int i = 0; i < chunk->n_reads; ++i) {
+        int read_i = chunk->ordered_read_ids[i];
+        if (chunk->is_skipped[read_i]) continue;
+        if (p[read_i].start_var_idx < 0 || p[read_i].end_var_idx < 0) continue;
+        cr_add(read_var_cr, "cr", p[read_i].start_var_idx, p[read_i].end_var_idx+1, read_i);
     }
+    cr_index(read_var_cr);
+}
 
-    while (1) {
-        while (old_var_i <= old_end_var_i && old_to_merged[old_var_i] < 0) old_var_i++;
-        while (new_var_i <= new_end_var_i && new_to_merged[new_var_i] < 0) new_var_i++;
-
-        int old_merged_i = (old_var_i <= old_end_var_i ? old_to_merged[old_var_i] : merged_var_limit);
-        int new_merged_i = (new_var_i <= new_end_var_i ? new_to_merged[new_var_i] : merged_var_limit);
-        if (old_merged_i == merged_var_limit && new_merged_i == merged_var_limit) break;
-
-        if (old_merged_i <= new_merged_i) {
-            int old_profile_i = old_var_i - old_p1->start_var_idx;
-            update_read_var_profile_with_allele(old_merged_i, old_p1->alleles[old_profile_i], old_p1->alt_qi[old_profile_i], merged_p1);
-            old_var_i++;
-        } else {
-            int new_profile_i = new_var_i - new_p1->start_var_idx;
-            update_read_var_profile_with_allele(new_merged_i, new_p1->alleles[new_profile_i], new_p1->alt_qi[new_profile_i], merged_p1);
-            new_var_i++;
-        }
-    }
+static inline hts_pos_t cand_var_cmp_pos(const cand_var_t *var) {
+    return var->var_type == BAM_CDIFF ? var->pos : var->pos-1;
 }
 
+// splice new (noisy-region) vars into chunk->cand_vars, both are sorted by position
+// only the window of old vars interleaved with new vars is re-ordered, vars after it are shifted,
+// and only bands of reads touching the window are re-written
 int merge_var_profile(const call_var_opt_t *opt, bam_chunk_t *chunk, int n_new_vars, cand_var_t *new_vars, int *new_var_cate, read_var_profile_t *new_p) {
     if (n_new_vars <= 0) return 0;
-    cand_var_t *old_vars = chunk->cand_vars;
-    read_var_profile_t *old_p = chunk->read_var_profile;
-    cand_var_t *merged_vars = (cand_var_t *)malloc((chunk->n_cand_vars + n_new_vars) * sizeof(cand_var_t)); 
-    read_var_profile_t *merged_p = init_read_var_profile(chunk->n_reads, chunk->n_cand_vars + n_new_vars);
-    int *merged_var_i_to_cate = (int*)malloc((chunk->n_cand_vars + n_new_vars) * sizeof(int));
-    int *old_to_merged = NULL, *new_to_merged = NULL;
-    int old_var_i = 0, new_var_i = 0, merged_var_i = 0;
-
-    if (chunk->n_cand_vars > 0) {
-        old_to_merged = (int*)malloc((size_t)chunk->n_cand_vars * sizeof(int));
-        for (int i = 0; i < chunk->n_cand_vars; ++i) old_to_merged[i] = -1;
-    }
-    new_to_merged = (int*)malloc((size_t)n_new_vars * sizeof(int));
-    for (int i = 0; i < n_new_vars; ++i) new_to_merged[i] = -1;
-
-    for (; old_var_i < chunk->n_cand_vars && new_var_i < n_new_vars; ) {
-        int ret = exact_comp_cand_var(opt, old_vars+old_var_i, new_vars+new_var_i);
-        // fprintf(stderr, "old: %s:%" PRId64 " %d-%c-%d vs new: %s:%" PRId64 " %d-%c-%d => ret=%d\n",
-                // chunk->tname, old_vars[old_var_i].pos, old_vars[old_var_i].ref_len, BAM_CIGAR_STR[old_vars[old_var_i].var_type], old_vars[old_var_i].alt_len,
-                // chunk->tname, new_vars[new_var_i].pos, new_vars[new_var_i].ref_len, BAM_CIGAR_STR[new_vars[new_var_i].var_type], new_vars[new_var_i].alt_len,
-                // ret);
-        if (ret < 0) { // add old_var to merged_vars, updated read_profile
-            old_to_merged[old_var_i] = merged_var_i;
-            merged_var_i_to_cate[merged_var_i] = chunk->var_i_to_cate[old_var_i];
-            merged_vars[merged_var_i++] = old_vars[old_var_i++];
-        } else if (ret > 0) { // add new_var to merged vars, update read_profile
-            new_to_merged[new_var_i] = merged_var_i;
-            merged_var_i_to_cate[merged_var_i] = new_var_cate[new_var_i]; //
-            merged_vars[merged_var_i++] = new_vars[new_var_i++];
-        } else { // ret == 0
-            // always use old_var
-            old_to_merged[old_var_i] = merged_var_i;
-            merged_var_i_to_cate[merged_var_i] = chunk->var_i_to_cate[old_var_i];
-            merged_vars[merged_var_i++] = old_vars[old_var_i++];
-            // free new_vars
+    if (chunk->n_cand_vars == 0) { // no old vars: take new vars as they are
+        free(chunk->cand_vars); free(chunk->var_i_to_cate); free_read_var_profile(chunk->read_var_profile, chunk->n_reads);
+        chunk->cand_vars = new_vars; chunk->var_i_to_cate = new_var_cate; chunk->read_var_profile = new_p;
+        chunk->n_cand_vars = chunk->m_cand_vars = n_new_vars;
+        update_read_var_cr(chunk);
+        return n_new_vars;
+    }
+    int n_old_vars = chunk->n_cand_vars;
+    // 1. window [win_beg, win_end) of old vars: same as a linear merge, old vars before win_beg are all smaller than new_vars[0]
+    int win_beg = 0, win_end, n_win_vars = 0;
+    hts_pos_t first_pos = cand_var_cmp_pos(new_vars);
+    for (int right = n_old_vars; win_beg < right; ) {
+        int mid = win_beg + ((right - win_beg) >> 1);
+        if (cand_var_cmp_pos(chunk->cand_vars+mid) < first_pos) win_beg = mid + 1;
+        else right = mid;
+    }
+    while (win_beg < n_old_vars && exact_comp_cand_var(opt, chunk->cand_vars+win_beg, new_vars) < 0) win_beg++;
+    int *new_to_merged = (int*)malloc((size_t)n_new_vars * sizeof(int));
+    int old_var_i = win_beg, new_var_i = 0;
+    while (new_var_i < n_new_vars) {
+        int ret = old_var_i < n_old_vars ? exact_comp_cand_var(opt, chunk->cand_vars+old_var_i, new_vars+new_var_i) : 1;
+        if (ret < 0) old_var_i++;
+        else if (ret > 0) new_to_merged[new_var_i++] = win_beg + n_win_vars;
+        else { // always use old_var
+            old_var_i++; new_to_merged[new_var_i] = -1;
             free_cand_vars1(new_vars+new_var_i); new_var_i++;
         }
+        n_win_vars++;
+    }
+    win_end = old_var_i;
+    int shift = n_win_vars - (win_end - win_beg);
+    int *win_old_to_merged = (int*)malloc((size_t)MAX_OF_TWO(1, win_end - win_beg) * sizeof(int));
+    for (int i = win_beg, merged_i = win_beg, j = 0; i < win_end; ++merged_i) {
+        while (j < n_new_vars && new_to_merged[j] < 0) j++;
+        if (j < n_new_vars && new_to_merged[j] == merged_i) j++;
+        else win_old_to_merged[(i++) - win_beg] = merged_i;
+    }
+
+    // 2. shift the tail, then fill the window backward
+    if (n_old_vars + shift > chunk->m_cand_vars) {
+        chunk->m_cand_vars = n_old_vars + shift; LC_kroundup32(chunk->m_cand_vars);
+        chunk->cand_vars = (cand_var_t*)_err_realloc(chunk->cand_vars, chunk->m_cand_vars * sizeof(cand_var_t));
+        chunk->var_i_to_cate = (int*)_err_realloc(chunk->var_i_to_cate, chunk->m_cand_vars * sizeof(int));
+    }
+    cand_var_t *vars = chunk->cand_vars; int *var_i_to_cate = chunk->var_i_to_cate;
+    if (shift > 0 && win_end < n_old_vars) {
+        memmove(vars+win_end+shift, vars+win_end, (n_old_vars - win_end) * sizeof(cand_var_t));
+        memmove(var_i_to_cate+win_end+shift, var_i_to_cate+win_end, (n_old_vars - win_end) * sizeof(int));
+    }
+    old_var_i = win_end - 1; new_var_i = n_new_vars - 1;
+    for (int merged_i = win_beg + n_win_vars - 1; merged_i >= win_beg; --merged_i) {
+        while (new_var_i >= 0 && new_to_merged[new_var_i] < 0) new_var_i--;
+        if (new_var_i >= 0 && new_to_merged[new_var_i] == merged_i) {
+            vars[merged_i] = new_vars[new_var_i]; var_i_to_cate[merged_i] = new_var_cate[new_var_i];
+            new_var_i--;
+        } else {
+            vars[merged_i] = vars[old_var_i]; var_i_to_cate[merged_i] = var_i_to_cate[old_var_i];
+            old_var_i--;
+        }
     }
-    for (; old_var_i < chunk->n_cand_vars; ++old_var_i) {
-        old_to_merged[old_var_i] = merged_var_i;
-        merged_var_i_to_cate[merged_var_i] = chunk->var_i_to_cate[old_var_i];
-        merged_vars[merged_var_i++] = old_vars[old_var_i];
-    }
-    for (; new_var_i < n_new_vars; ++new_var_i) {
-        new_to_merged[new_var_i] = merged_var_i;
-        merged_var_i_to_cate[merged_var_i] = new_var_cate[new_var_i];
-        merged_vars[merged_var_i++] = new_vars[new_var_i];
-    }
-
-    // Copy each read profile once, merging old/new alleles in final variant order.
-    for (int i = 0; i < chunk->n_reads; ++i) {
-        int read_i = chunk->ordered_read_ids[i];
-        if (chunk->is_skipped[read_i]) continue;
-        merge_read_var_profile_entries(old_p != NULL ? old_p + read_i : NULL, old_to_merged,
-                                       new_p + read_i, new_to_merged,
-                                       merged_p + read_i, merged_var_i);
-    }
+    chunk->n_cand_vars = n_old_vars + shift;
 
-    cgranges_t *merged_read_var_cr = cr_init();
+    // 3. read bands: untouched before the window, shifted after it, re-written if overlapping it
+    read_var_profile_t *p = chunk->read_var_profile;
     for (int i = 0; i < chunk->n_reads; ++i) {
         int read_i = chunk->ordered_read_ids[i];
         if (chunk->is_skipped[read_i]) continue;
-        if (merged_p[read_i].start_var_idx < 0 || merged_p[read_i].end_var_idx < 0) continue;
-        cr_add(merged_read_var_cr, "cr", merged_p[read_i].start_var_idx, merged_p[read_i].end_var_idx+1, read_i);
+        read_var_profile_t *p1 = p + read_i, *new_p1 = new_p + read_i;
+        if (new_p1->start_var_idx < 0 || new_p1->end_var_idx < new_p1->start_var_idx) {
+            if (p1->start_var_idx < 0 || p1->end_var_idx < win_beg) continue;
+            if (p1->start_var_idx >= win_end) {
+                p1->start_var_idx += shift; p1->end_var_idx += shift;
+                continue;
+            }
+        }
+        splice_read_var_profile1(p1, new_p1, new_to_merged, win_beg, win_end, shift, win_old_to_merged);
     }
-    cr_index(merged_read_var_cr);
+    update_read_var_cr(chunk);
 
-    free(old_to_merged);
-    free(new_to_merged);
-    if (chunk->n_cand_vars > 0) free_read_var_profile(chunk->read_var_profile, chunk->n_reads); 
-    free_read_var_profile(new_p, chunk->n_reads); free(chunk->var_i_to_cate);
-    free(chunk->cand_vars); free(new_vars); free(new_var_cate); cr_destroy(chunk->read_var_cr);
-    chunk->read_var_profile = merged_p; chunk->cand_vars = merged_vars; chunk->n_cand_vars = merged_var_i; chunk->var_i_to_cate = merged_var_i_to_cate; chunk->read_var_cr = merged_read_var_cr;
+    free(new_to_merged); free(win_old_to_merged);
+    free_read_var_profile(new_p, chunk->n_reads); free(new_vars); free(new_var_cate);
 
     if (LONGCALLD_VERBOSE >= 2) {
         for (int i = 0; i < chunk->n_reads; ++i) {
             int read_id = chunk->ordered_read_ids[i];
-            read_var_profile_t *p1 = merged_p + read_id;
+            read_var_profile_t *p1 = p + read_id;
             if (chunk->is_skipped[read_id]) continue;
             fprintf(stderr, "MergedProfile: %s start_var_i: %d, end_var_i: %d\n", bam_get_qname(chunk->reads[read_id]), p1->start_var_idx, p1->end_var_idx);
             for (int k = 0; k <= p1->end_var_idx-p1->start_var_idx; ++k) {
-                fprintf(stderr, "P\tVar: (%d) %" PRId64 "", k, merged_vars[k+p1->start_var_idx].pos);
-                fprintf(stderr, " %d-%c-%d, allele: %d\n", merged_vars[k+p1->start_var_idx].ref_len, BAM_CIGAR_STR[merged_vars[k+p1->start_var_idx].var_type], merged_vars[k+p1->start_var_idx].alt_len, p1->alleles[k]);
+                fprintf(stderr, "P\tVar: (%d) %" PRId64 "", k, vars[k+p1->start_var_idx].pos);
+                fprintf(stderr, " %d-%c-%d, allele: %d\n", vars[k+p1->start_var_idx].ref_len, BAM_CIGAR_STR[vars[k+p1->start_var_idx].var_type], vars[k+p1->start_var_idx].alt_len, p1->alleles[k]);
             }
         }
     }
-    return new_var_i; // n_vars
+    return n_new_vars; // n_vars
 }
 
 read_var_profile_t *collect_read_var_profile(const call_var_opt_t *opt, bam_chunk_t *chunk) {
@@ -1465,7 +1511,7 @@ int cal_var_QUAL1(int ref_depth, int alt_depth, double logp, double log1p, int m
 int make_variants(const call_var_opt_t *opt, bam_chunk_t *chunk, var_t **_var) {
     int n_cand_vars = chunk->n_cand_vars;
     if (n_cand_vars <= 0) return 0;
-    char *ref_seq = chunk->ref_seq; hts_pos_t ref_beg = chunk->ref_beg;
+    hts_pos_t ref_beg = chunk->ref_beg;
     hts_pos_t active_reg_beg = chunk->reg_beg, active_reg_end = chunk->reg_end;
     cand_var_t *cand_vars = chunk->cand_vars; read_var_profile_t *p = chunk->read_var_profile;
     (*_var) = (var_t*)malloc(sizeof(var_t));
@@ -1519,7 +1565,8 @@ int make_variants(const call_var_opt_t *opt, bam_chunk_t *chunk, var_t **_var) {
             var->vars[i].te_is_rev = cand_vars[cand_i].te_is_rev;
         } else var->vars[i].te_seq_i = -1;
         var->vars[i].PS = cand_vars[cand_i].phase_set;
-        var->vars[i].ref_bases = get_bseq(ref_seq+var->vars[i].pos-ref_beg, var->vars[i].ref_len);
+        var->vars[i].ref_bases = (uint8_t*)malloc(var->vars[i].ref_len * sizeof(uint8_t));
+        memcpy(var->vars[i].ref_bases, chunk->ref_bseq+var->vars[i].pos-ref_beg, var->vars[i].ref_len);
         if (is_hom) {
             var->vars[i].alt_len = (int*)malloc(1 * sizeof(int));
             var->vars[i].alt_bases = (uint8_t**)malloc(1 * sizeof(uint8_t*));
@@ -1542,7 +1589,7 @@ int make_variants(const call_var_opt_t *opt, bam_chunk_t *chunk, var_t **_var) {
                 if (var->vars[i].type == BAM_CDEL || var->vars[i].type == BAM_CINS) {
                     alt_len += 1;
                     if (cand_vars[cand_i].alt_ref_base != 4) var->vars[i].alt_bases[var->vars[i].n_alt_allele][0] = cand_vars[cand_i].alt_ref_base;
-                    else var->vars[i].alt_bases[var->vars[i].n_alt_allele][0] = nst_nt4_table[(int)ref_seq[var->vars[i].pos - ref_beg]];
+                    else var->vars[i].alt_bases[var->vars[i].n_alt_allele][0] = chunk->ref_bseq[var->vars[i].pos - ref_beg];
                     for (int j = 1; j < alt_len; ++j) {
                         var->vars[i].alt_bases[var->vars[i].n_alt_allele][j] = cand_vars[cand_i].alt_seq[j-1];
                     }
@@ -1634,10 +1681,30 @@ static void update_chunk_var_hap_phase_set1(bam_chunk_t *chunk) {
     }
 }
 
+// same flip as update_chunk_var_hap_phase_set1, applied to variants already made by the worker
+static void update_chunk_var_GT_phase_set1(bam_chunk_t *chunk, var_t *var) {
+    if (var == NULL) return;
+    if (chunk->flip_hap && chunk->flip_cur_PS != -1) {
+        for (int i = 0; i < var->n; ++i) {
+            var1_t *v = var->vars + i;
+            // 1|2 has the same alt allele on both haps, only 0|1 <-> 1|0 changes
+            if (v->PS != chunk->flip_cur_PS || (v->GT[0] != 0 && v->GT[1] != 0)) continue;
+            int tmp = v->GT[0]; v->GT[0] = v->GT[1]; v->GT[1] = tmp;
+        }
+    }
+    hts_pos_t flip_pre_chunk_PS = chunk->flip_pre_PS, flip_cur_chunk_PS = chunk->flip_cur_PS;
+    if (flip_pre_chunk_PS != -1 && flip_cur_chunk_PS != INT64_MAX) {
+        for (int i = 0; i < var->n; ++i) {
+            if (var->vars[i].PS == -1) continue;
+            if (var->vars[i].PS == flip_cur_chunk_PS) var->vars[i].PS = flip_pre_chunk_PS;
+        }
+    }
+}
+
 // XXX use overlapping reads to extend phase blocks
 // 1. check if haplotype of variants in bam_chunk is inconsistent with the previous bam_chunk
 // 2. extend phase blocks if possible (e.g., if ≥ 1 read supports the longer phase block)
-void flip_variant_hap(call_var_opt_t *opt, bam_chunk_t *pre_chunk, bam_chunk_t *cur_chunk) {
+void flip_variant_hap(call_var_opt_t *opt, bam_chunk_t *pre_chunk, bam_chunk_t *cur_chunk, var_t *cur_var) {
     if (cur_chunk->tid != pre_chunk->tid) return;
     int n_cur_ovlp_reads = 0, n_pre_ovlp_reads = 0;
     for (int i = 0; i < opt->n_in_bam_fn; ++i) {
@@ -1691,7 +1758,8 @@ void flip_variant_hap(call_var_opt_t *opt, bam_chunk_t *pre_chunk, bam_chunk_t *
     if (LONGCALLD_VERBOSE >= 2)
         fprintf(stderr, "Region: %s:%" PRIi64 "-%" PRIi64 ", flip_hap: %d (%d) pre_PS: %" PRIi64 ", cur_PS: %" PRIi64 "\n", cur_chunk->tname, cur_chunk->reg_beg, cur_chunk->reg_end, cur_chunk->flip_hap, flip_hap_score, max_pre_read_PS, min_cur_read_PS);
     update_chunk_var_hap_phase_set1(cur_chunk);
-    if (opt->out_aln_fp != NULL) update_chunk_read_hap_phase_set1(cur_chunk);
+    update_chunk_var_GT_phase_set1(cur_chunk, cur_var);
+    if (opt->out_aln_fp != NULL || opt->out_hap_tag_fp != NULL) update_chunk_read_hap_phase_set1(cur_chunk);
 }
 
 void print_var_seqs(digar1_t *digars, uint8_t **reg_var_seqs, int reg_n_digar, FILE *fp) {
@@ -1748,8 +1816,8 @@ void make_cand_vars0(cand_var_t *var, int tid, hts_pos_t ref_pos, int var_type,
     memset(var, 0, sizeof(cand_var_t));
     var->tid = tid; var->pos = ref_pos;
     var->var_type = var_type;
+    if (n_alle > LONGCALLD_MAX_N_ALLES) _err_error_exit("Too many alleles for one candidate variant: %d\n", n_alle);
     var->n_uniq_alles = n_alle;
-    var->alle_covs = (int*)calloc(n_alle, sizeof(int));
     var->ref_len = ref_len;
     var->is_homopolymer_indel = is_homopolymer_indel;
     if (var_type == BAM_CDIFF) var->ref_base = ref_base;
@@ -1850,7 +1918,7 @@ int make_cand_vars_from_baln0(const call_var_opt_t *opt, bam_chunk_t *chunk, hts
         }
     }
     for (int i = 0; i < n_vars; ++i) {
-        (*cand_vars)[i].hap_to_alle_profile = NULL; (*cand_vars)[i].hap_to_cons_alle = NULL;
+        (*cand_vars)[i].has_hap_profile = 0;
         (*var_cate)[i] = LONGCALLD_NOISY_CAND_HOM_VAR;
     }
     return n_vars;
@@ -2636,57 +2704,141 @@ int merge_vars(var_t *old_vars, var_t *add_vars) {
     return new_i;
 }
 
-// XXX ignore regions without fully-spanning reads
-// re-alignment of specific regions within each haplotyp, and collect candidate variants
-// 1. consensus calling within each haplotype
-// 2. re-align clipping reads (if exist) to the consensus sequence
-// 3. re-align unphased reads (if exist) to the consensus sequence
-// 4. (*optional*) re-generate consensus sequence using all reads
-// 5. collect candidate variants based on MSA of ref + cons1 + cons2
-// 6. update cand_var & read_var_profile
-// call variant for noisy_reg_i, return 0 if no variant is called
-int collect_noisy_vars1(bam_chunk_t *chunk, const call_var_opt_t *opt, int noisy_reg_i) {
-    cgranges_t *noisy_regs = chunk->chunk_noisy_regs;
-    hts_pos_t noisy_reg_beg = cr_start(noisy_regs, noisy_reg_i), noisy_reg_end = cr_end(noisy_regs, noisy_reg_i);
-    uint8_t *ref_seq = NULL; int ref_seq_len = collect_reg_ref_bseq(chunk, &noisy_reg_beg, &noisy_reg_end, &ref_seq);
+// one line per attempt of a noisy region, see --noisy-reg-log
+static void log_noisy_reg(bam_chunk_t *chunk, hts_pos_t noisy_reg_beg, hts_pos_t noisy_reg_end, int n_noisy_reads, int n_cons,
+                          const noisy_aln_prof_t *prof, double real_time, const char *outcome) {
+    static const char *aln_modes[3] = {"none", "hap", "no-hap"}, *fallbacks[3] = {"subsample", "heuristic", "truncated"};
+    ksprintf(&chunk->noisy_reg_log, "%s\t%" PRIi64 "\t%" PRIi64 "\t%" PRIi64 "\t%d\t%d\t%s\t%d\t%.6f\t%.6f\t%.6f\t%" PRIi64 "\t%" PRIu64 "\t%" PRIu64 "\t%s\t",
+             chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, n_noisy_reads, prof->sampling_reads, aln_modes[prof->aln_mode], n_cons,
+             prof->poa_time, prof->wfa_time, real_time, prof->poa_cells, prof->poa_peak_bytes, prof->wfa_peak_bytes, outcome);
+    if (prof->fallbacks == 0) kputc('.', &chunk->noisy_reg_log);
+    for (int i = 0, n = 0; i < 3; ++i) {
+        if (!(prof->fallbacks >> i & 1)) continue;
+        if (n++ > 0) kputc(',', &chunk->noisy_reg_log);
+        kputs(fallbacks[i], &chunk->noisy_reg_log);
+    }
+    kputc('\n', &chunk->noisy_reg_log);
+}
+
+// skipped noisy regions starting in the chunk region are output as filtered VCF records, see write_var_to_vcf()
+static void add_skip_noisy_reg(bam_chunk_t *chunk, hts_pos_t beg, hts_pos_t end, const char *skipped) {
+    if (beg < chunk->reg_beg || beg > chunk->reg_end) return;
+    if (chunk->n_skip_noisy_regs == chunk->m_skip_noisy_regs) {
+        chunk->m_skip_noisy_regs = chunk->m_skip_noisy_regs == 0 ? 16 : chunk->m_skip_noisy_regs * 2;
+        chunk->skip_noisy_regs = (noisy_skip_reg_t*)realloc(chunk->skip_noisy_regs, chunk->m_skip_noisy_regs * sizeof(noisy_skip_reg_t));
+    }
+    noisy_skip_reg_t *r = chunk->skip_noisy_regs + chunk->n_skip_noisy_regs++;
+    r->beg = beg; r->end = end; r->reason = skipped + strlen("skipped-"); // outcome of --noisy-reg-log
+}
+
+// one noisy region of a wave: aligned by align_noisy_reg1() in parallel, then called by collect_noisy_vars1() in order
+typedef struct {
+    int noisy_reg_i; hts_pos_t noisy_reg_beg, noisy_reg_end;
+    int n_noisy_reads, *noisy_reads, wave;
+    const char *skipped; uint8_t over_budget; // skipped: NULL: aligned, otherwise outcome in --noisy-reg-log
+    int n_cons, *clu_n_seqs, **clu_read_ids; aln_str_t **aln_strs;
+    noisy_aln_prof_t prof; double aln_time;
+} noisy_reg_aln_t;
+
+// MSA and consensus calling of one noisy region
+// only touches the digars of r->noisy_reads & the given pools, chunk-wide variants/profiles are updated later by collect_noisy_vars1()
+static void align_noisy_reg1(bam_chunk_t *chunk, const call_var_opt_t *opt, wfa_pool_t *wfa_pool, abpoa_pool_t *poa_pool, void *km, noisy_reg_aln_t *r) {
+    hts_pos_t noisy_reg_beg = r->noisy_reg_beg, noisy_reg_end = r->noisy_reg_end; int n_noisy_reads = r->n_noisy_reads;
     int max_noisy_reg_len = opt->max_noisy_reg_len, max_noisy_reg_cov = opt->max_noisy_reg_cov;
+    // regions that may be anchor-split are attempted up to LONGCALLD_MAX_ANCHOR_SPLIT_REG_LEN,
+    // they are still skipped as too long if they are not phased or no anchors are found, see collect_noisy_reg_aln_strs()
+    if (opt->anchor_split_len > 0 && noisy_reg_end - noisy_reg_beg + 1 >= opt->anchor_split_len)
+        max_noisy_reg_len = MAX_OF_TWO(max_noisy_reg_len, LONGCALLD_MAX_ANCHOR_SPLIT_REG_LEN);
+    memset(&r->prof, 0, sizeof(noisy_aln_prof_t)); r->n_cons = 0; r->aln_time = 0; r->over_budget = 0;
     if (noisy_reg_end - noisy_reg_beg + 1 > max_noisy_reg_len) {
         if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "Skipped long region: %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " (>%d)\n", chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, max_noisy_reg_len);
-        free(ref_seq);
-        return 0;
+        r->skipped = "skipped-long"; return;
     }
-    int *noisy_reads; int n_noisy_reads = collect_noisy_reg_reads1(chunk, noisy_reg_beg, noisy_reg_end, noisy_reg_i, &noisy_reads);
     if (n_noisy_reads > max_noisy_reg_cov) {
         if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "Skipped deep region: %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " %d reads\n", chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, n_noisy_reads);
-        free(noisy_reads); free(ref_seq);
-        return 0;
-    }
-
+        r->skipped = "skipped-deep"; return;
+    }
+    // per-region budgets, estimated before any alignment: one POA DP matrix has to fit --noisy-max-mem,
+    // reads are evenly subsampled to fit --noisy-max-cells, --noisy-max-time is checked during the alignment
+    // long regions are assumed to be anchor-split here, a whole-region POA is re-checked in collect_noisy_reg_aln_strs()
+    int64_t reg_len = noisy_reg_end - noisy_reg_beg + 1, graph_len = reg_len;
+    if (opt->anchor_split_len > 0 && reg_len >= opt->anchor_split_len) graph_len = MIN_OF_TWO(reg_len, LONGCALLD_ANCHOR_WIN_LEN);
+    if (opt->noisy_max_bytes > 0 && (graph_len+1) * (graph_len+1) * LONGCALLD_POA_CELL_BYTES > opt->noisy_max_bytes) {
+        if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "Skipped region over memory budget: %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 "\n", chunk->tname, noisy_reg_beg, noisy_reg_end, reg_len);
+        r->skipped = "skipped-mem"; r->over_budget = 1; return;
+    }
+    if (opt->noisy_max_cells > 0 && n_noisy_reads * reg_len * graph_len > opt->noisy_max_cells) {
+        int n_keep = (int)(opt->noisy_max_cells / (reg_len * graph_len));
+        if (n_keep < LONGCALLD_NOISY_MIN_SUBSAMPLE_READS) {
+            if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "Skipped region over POA cell budget: %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " %d reads\n", chunk->tname, noisy_reg_beg, noisy_reg_end, reg_len, n_noisy_reads);
+            r->skipped = "skipped-cells"; r->over_budget = 1; return;
+        }
+        for (int i = 0; i < n_keep; ++i) r->noisy_reads[i] = r->noisy_reads[(int64_t)i * n_noisy_reads / n_keep];
+        if (LONGCALLD_VERBOSE >= 1) fprintf(stderr, "Subsampled %d/%d reads: %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 "\n", n_keep, n_noisy_reads, chunk->tname, noisy_reg_beg, noisy_reg_end, reg_len);
+        r->n_noisy_reads = n_noisy_reads = n_keep; r->prof.fallbacks |= LONGCALLD_NOISY_FB_SUBSAMPLE;
+    }
+    r->skipped = NULL;
     double realtime0 = realtime();
+    if (opt->noisy_max_time > 0) {
+        r->prof.heuristic_time = realtime0 + opt->noisy_max_time / 2;
+        r->prof.deadline = realtime0 + opt->noisy_max_time;
+    }
+    uint8_t *ref_seq = NULL; int ref_seq_len = collect_reg_ref_bseq(chunk, &noisy_reg_beg, &noisy_reg_end, &ref_seq);
 
     if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "NoisyReg: chunk_reg: %s:%" PRIi64 "-%" PRIi64 ", reg: %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " (%d)\n", chunk->tname, chunk->reg_beg, chunk->reg_end, 
                                         chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, n_noisy_reads);
-    // MSA and consensus calling
-    int n_cons = 0; int *clu_n_seqs = (int*)calloc(2, sizeof(int)); int **clu_read_ids = (int**)malloc(2 * sizeof(int*));
+    r->clu_n_seqs = (int*)calloc(2, sizeof(int)); r->clu_read_ids = (int**)malloc(2 * sizeof(int*));
     // for alignment of cons vs ref, read vs cons, read vs ref
-    aln_str_t **aln_strs = (aln_str_t**)malloc(2 * sizeof(aln_str_t*));
+    r->aln_strs = (aln_str_t**)malloc(2 * sizeof(aln_str_t*));
     for (int i = 0; i < 2; ++i) {
-        clu_read_ids[i] = NULL;
-        aln_strs[i] = (aln_str_t*)malloc((1 + n_noisy_reads * 2) * sizeof(aln_str_t));
+        r->clu_read_ids[i] = NULL;
+        r->aln_strs[i] = (aln_str_t*)malloc((1 + n_noisy_reads * 2) * sizeof(aln_str_t));
         for (int j = 0; j < 1+n_noisy_reads*2; ++j) {
-            aln_strs[i][j].target_aln = NULL; aln_strs[i][j].query_aln = NULL; aln_strs[i][j].aln_len = 0;
+            r->aln_strs[i][j].target_aln = NULL; r->aln_strs[i][j].query_aln = NULL; r->aln_strs[i][j].aln_len = 0;
         }
     }
-    n_cons = collect_noisy_reg_aln_strs(opt, chunk, noisy_reg_beg, noisy_reg_end, noisy_reg_i, n_noisy_reads, noisy_reads, ref_seq, ref_seq_len, // both cons_seqs and msa_seqs are separated for n_cons==2
-                                        clu_n_seqs, clu_read_ids, aln_strs);
-    if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "n_cons: %d\n", n_cons);
+    r->n_cons = collect_noisy_reg_aln_strs(opt, chunk, wfa_pool, poa_pool, km, noisy_reg_beg, noisy_reg_end, r->noisy_reg_i, n_noisy_reads, r->noisy_reads, ref_seq, ref_seq_len, // both cons_seqs and msa_seqs are separated for n_cons==2
+                                           r->clu_n_seqs, r->clu_read_ids, r->aln_strs, &r->prof);
+    if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "n_cons: %d\n", r->n_cons);
     free(ref_seq);
+    r->aln_time = realtime() - realtime0;
+}
+
+// XXX ignore regions without fully-spanning reads
+// re-alignment of specific regions within each haplotyp, and collect candidate variants
+// 1. consensus calling within each haplotype
+// 2. re-align clipping reads (if exist) to the consensus sequence
+// 3. re-align unphased reads (if exist) to the consensus sequence
+// 4. (*optional*) re-generate consensus sequence using all reads
+// 5. collect candidate variants based on MSA of ref + cons1 + cons2
+// 6. update cand_var & read_var_profile
+// call variant for the aligned noisy region r (1-4 are done by align_noisy_reg1), return 0 if no variant is called
+// skipped (too long/deep, over budget) regions also return 0, regions without consensus return -1
+static int collect_noisy_vars1(bam_chunk_t *chunk, const call_var_opt_t *opt, noisy_reg_aln_t *r) {
+    hts_pos_t noisy_reg_beg = r->noisy_reg_beg, noisy_reg_end = r->noisy_reg_end;
+    int n_noisy_reads = r->n_noisy_reads, *noisy_reads = r->noisy_reads;
+    if (r->skipped != NULL) {
+        chunk->stats.cnt[LONGCALLD_CNT_NOISY_SKIPPED]++; chunk->stats.cnt[LONGCALLD_CNT_NOISY_OVER_BUDGET] += r->over_budget;
+        add_skip_noisy_reg(chunk, noisy_reg_beg, noisy_reg_end, r->skipped);
+        if (opt->noisy_reg_log_fp != NULL) log_noisy_reg(chunk, noisy_reg_beg, noisy_reg_end, n_noisy_reads, 0, &r->prof, 0, r->skipped);
+        return 0;
+    }
+    double realtime0 = realtime();
+    int n_cons = r->n_cons, *clu_n_seqs = r->clu_n_seqs, **clu_read_ids = r->clu_read_ids; aln_str_t **aln_strs = r->aln_strs;
+    chunk->stats.cnt[LONGCALLD_CNT_POA_CELLS] += r->prof.poa_cells;
+    chunk->stats.cnt[LONGCALLD_CNT_NOISY_SUBSAMPLED] += (r->prof.fallbacks & LONGCALLD_NOISY_FB_SUBSAMPLE) != 0;
+    chunk->stats.cnt[LONGCALLD_CNT_NOISY_HEURISTIC] += (r->prof.fallbacks & LONGCALLD_NOISY_FB_HEURISTIC) != 0;
+    chunk->stats.cnt[LONGCALLD_CNT_NOISY_TRUNCATED] += (r->prof.fallbacks & LONGCALLD_NOISY_FB_TRUNCATED) != 0;
 
     int n_noisy_vars = 0;
     if (n_cons == 0) {
         if (LONGCALLD_VERBOSE >= 2)
             fprintf(stderr, "Skipped region: %s:%" PRIi64 "-%" PRIi64 " %" PRIi64 " %d reads\n", chunk->tname, noisy_reg_beg, noisy_reg_end, noisy_reg_end-noisy_reg_beg+1, n_noisy_reads);
-        n_noisy_vars = -1;
+        if (r->prof.skipped != NULL || (r->prof.fallbacks & LONGCALLD_NOISY_FB_TRUNCATED)) { // too long or out of time: not retried in the next pass
+            r->skipped = r->prof.skipped != NULL ? r->prof.skipped : "skipped-time"; n_noisy_vars = 0;
+            chunk->stats.cnt[LONGCALLD_CNT_NOISY_SKIPPED]++; chunk->stats.cnt[LONGCALLD_CNT_NOISY_OVER_BUDGET] += strcmp(r->skipped, "skipped-long") != 0;
+            add_skip_noisy_reg(chunk, noisy_reg_beg, noisy_reg_end, r->skipped);
+        } else n_noisy_vars = -1;
         goto collect_noisy_vars1_end;
     }
 
@@ -2715,6 +2867,7 @@ int collect_noisy_vars1(bam_chunk_t *chunk, const call_var_opt_t *opt, int noisy
         fprintf(stderr, "Real time: %.3f sec.\n", realtime() - realtime0);
     }
 collect_noisy_vars1_end:
+    if (opt->noisy_reg_log_fp != NULL) log_noisy_reg(chunk, noisy_reg_beg, noisy_reg_end, n_noisy_reads, n_cons, &r->prof, r->aln_time + realtime() - realtime0, r->skipped != NULL ? r->skipped : (n_cons == 0 ? "no-cons" : "resolved"));
     for (int i = 0; i < 2; ++i) {
         if (clu_read_ids[i] != NULL) free(clu_read_ids[i]);
         for (int j = 0; j < 1+n_noisy_reads*2; ++j) {
@@ -2736,10 +2889,56 @@ collect_noisy_vars1_end:
             }
         }
     } 
-    free(clu_n_seqs); free(clu_read_ids); free(aln_strs); free(noisy_reads);
+    free(clu_n_seqs); free(clu_read_ids); free(aln_strs);
     return n_noisy_vars;
 }
 
+// noisy regions that share reads are aligned in different waves, in the order of sorted_noisy_regs:
+// wave of a region = 1 + max. wave of the earlier pending regions sharing any read with it
+// regions of one wave are read-disjoint and aligned in parallel, then their variants are merged one by one in the same order,
+// so the output does not depend on --noisy-threads
+// return number of pending regions, regs are sorted by wave, then by the order in sorted_noisy_regs
+static int collect_noisy_reg_waves(bam_chunk_t *chunk, int *sorted_noisy_regs, int *noisy_reg_is_done, noisy_reg_aln_t *regs) {
+    cgranges_t *noisy_regs = chunk->chunk_noisy_regs;
+    int n_regs = 0, max_wave = 0, *read_waves = (int*)calloc(chunk->n_reads, sizeof(int));
+    noisy_reg_aln_t *tmp_regs = (noisy_reg_aln_t*)malloc(noisy_regs->n_r * sizeof(noisy_reg_aln_t));
+    for (int i = 0; i < noisy_regs->n_r; ++i) {
+        int noisy_reg_i = sorted_noisy_regs[i];
+        if (noisy_reg_is_done[noisy_reg_i]) continue;
+        noisy_reg_aln_t *r = tmp_regs + n_regs++;
+        r->noisy_reg_i = noisy_reg_i;
+        // same as collect_reg_ref_bseq()
+        r->noisy_reg_beg = MAX_OF_TWO(cr_start(noisy_regs, noisy_reg_i), chunk->ref_beg);
+        r->noisy_reg_end = MIN_OF_TWO(cr_end(noisy_regs, noisy_reg_i), chunk->ref_end);
+        r->n_noisy_reads = collect_noisy_reg_reads1(chunk, r->noisy_reg_beg, r->noisy_reg_end, noisy_reg_i, &r->noisy_reads);
+        int wave = 0;
+        for (int j = 0; j < r->n_noisy_reads; ++j) wave = MAX_OF_TWO(wave, read_waves[r->noisy_reads[j]]);
+        r->wave = ++wave; max_wave = MAX_OF_TWO(max_wave, wave);
+        for (int j = 0; j < r->n_noisy_reads; ++j) read_waves[r->noisy_reads[j]] = wave;
+    }
+    // stable counting sort by wave
+    int *wave_begs = (int*)calloc(max_wave+2, sizeof(int));
+    for (int i = 0; i < n_regs; ++i) wave_begs[tmp_regs[i].wave+1]++;
+    for (int i = 1; i <= max_wave+1; ++i) wave_begs[i] += wave_begs[i-1];
+    for (int i = 0; i < n_regs; ++i) regs[wave_begs[tmp_regs[i].wave]++] = tmp_regs[i];
+    free(wave_begs); free(tmp_regs); free(read_waves);
+    return n_regs;
+}
+
+typedef struct {
+    bam_chunk_t *chunk; const call_var_opt_t *opt;
+    noisy_reg_aln_t *regs; // regions of one wave
+} noisy_reg_wave_t;
+
+// kt_forpool() callback: the calling worker's pools are used by tid 0, the extra --noisy-threads use their own
+static void align_noisy_reg_for(void *data, long i, int tid) {
+    noisy_reg_wave_t *w = (noisy_reg_wave_t*)data; bam_chunk_t *chunk = w->chunk;
+    wfa_pool_t *wfa_pool = tid == 0 ? chunk->wfa_pool : chunk->noisy_wfa_pools[tid-1];
+    abpoa_pool_t *poa_pool = tid == 0 ? chunk->poa_pool : chunk->noisy_poa_pools[tid-1];
+    void *km = tid == 0 ? chunk->noisy_km : chunk->noisy_kms[tid-1];
+    align_noisy_reg1(chunk, w->opt, wfa_pool, poa_pool, km, w->regs + i);
+}
+
 // XXX
 // sort noisy regions by length, full-cover & phased read counts, from short to long
 int *sort_noisy_regs(bam_chunk_t *chunk) {
@@ -2880,7 +3079,7 @@ void collect_somatic_var(bam_chunk_t *chunk, const call_var_opt_t *opt) {
             }
         }
         if (var_cate & LONGCALLD_CAND_GERMLINE_VAR_CATE) {
-            if (var->hap_to_alle_profile != NULL) {
+            if (var->has_hap_profile) {
                 if (var->hap_to_cons_alle[1] == 0 && var->hap_to_cons_alle[2] == 0 // refCall
                     && var_is_cand_somatic(chunk, opt, var))
                 chunk->var_i_to_cate[var_i] = LONGCALLD_CAND_SOMATIC_VAR;
@@ -2896,9 +3095,11 @@ void collect_somatic_var(bam_chunk_t *chunk, const call_var_opt_t *opt) {
 
 void collect_var_main(const call_var_pl_t *pl, bam_chunk_t *chunk) {
     call_var_opt_t *opt = pl->opt;
+    call_var_stats_t *stats = &chunk->stats; double t = realtime(), t1;
     // first round: easy-to-call SNPs (+indels)
     // 1.1 collect X/I/D sites from BAM
     collect_digars_from_bam(chunk, pl);
+    t1 = realtime(); stats->time[LONGCALLD_STAGE_DIGAR] += t1 - t; t = t1;
 
     // 1.2. merge all var sites from all reads, including low-depth ones, but not including nosiy-region ones
     var_site_t *var_sites = NULL; int n_var_sites;
@@ -2910,7 +3111,7 @@ void collect_var_main(const call_var_pl_t *pl, bam_chunk_t *chunk) {
         // all cand vars, including true/false germline/somatic variants
         // XXX for noisy/repeat regions, we need to carefully pick the candidate variants, based on supporting counts & re-alignments
         collect_cand_vars(opt, chunk, n_var_sites, var_sites);
-    } free(var_sites);
+    } kfree(chunk->km, var_sites);
 
     // 2.1. pre-process noisy regions (>5 XIDs in 100 win), not including low-complexity regions
     // current noisy regs are directly from BAM (large indels, VNTRs)
@@ -2922,6 +3123,8 @@ void collect_var_main(const call_var_pl_t *pl, bam_chunk_t *chunk) {
     // NOTE: after _classify_, n_cand_vars & cand_vars: only include clean region vars (may contain somatic vars)
     if (n_var_sites > 0)
         classify_cand_vars(chunk, n_var_sites, opt);
+    stats->cnt[LONGCALLD_CNT_CAND_SITES] = n_var_sites; stats->cnt[LONGCALLD_CNT_CLEAN_CAND_VARS] = chunk->n_cand_vars;
+    t1 = realtime(); stats->time[LONGCALLD_STAGE_CLASSIFY] += t1 - t; t = t1;
 
     if (LONGCALLD_VERBOSE >= 2) {
         fprintf(stderr, "AllNoisyRegions: %s:%" PRIi64 "-%" PRIi64 " (%ld)\n", chunk->tname, chunk->reg_beg, chunk->reg_end, chunk->chunk_noisy_regs ? chunk->chunk_noisy_regs->n_r : 0);
@@ -2942,50 +3145,67 @@ void collect_var_main(const call_var_pl_t *pl, bam_chunk_t *chunk) {
         //   3. LONGCALLD_CAND_SOMATIC_VAR
         // 3.2. co-phasing and variant calling using clean region SNPs + indels
         assign_hap_based_on_germline_het_vars_kmeans(opt, chunk, LONGCALLD_CLEAN_HET_SNP | LONGCALLD_CLEAN_HET_INDEL | LONGCALLD_CLEAN_HOM_VAR);
+        t1 = realtime(); stats->time[LONGCALLD_STAGE_KMEANS] += t1 - t; t = t1;
     }
     // 4. iteratively call variants in noisy regions and variant/read phasing
     if (chunk->chunk_noisy_regs != NULL && chunk->chunk_noisy_regs->n_r > 0) {
         // sort noisy regions by type, length, full-cover & phased read counts, from short to long
         int *sorted_noisy_regs = sort_noisy_regs(chunk);
         // for each noisy region, call variants and update read_var_profile, then update phasing/haplotype information
-        int *noisy_reg_is_done = (int*)calloc(chunk->chunk_noisy_regs->n_r, sizeof(int));
+        int *noisy_reg_is_done = (int*)calloc(chunk->chunk_noisy_regs->n_r, sizeof(int)), n_done = 0;
+        noisy_reg_aln_t *regs = (noisy_reg_aln_t*)malloc(chunk->chunk_noisy_regs->n_r * sizeof(noisy_reg_aln_t));
+        // noisy regions with new variants in the current pass, only reads/phase sets around them are re-phased
+        hts_pos_t *new_var_reg_begs = (hts_pos_t*)malloc(chunk->chunk_noisy_regs->n_r * sizeof(hts_pos_t));
+        hts_pos_t *new_var_reg_ends = (hts_pos_t*)malloc(chunk->chunk_noisy_regs->n_r * sizeof(hts_pos_t));
         while (1) {
             int new_region_is_done = 0, new_var = 0;
-            for (int i = 0; i < chunk->chunk_noisy_regs->n_r; ++i) {
-                int noisy_reg_i = sorted_noisy_regs[i];
-                if (noisy_reg_is_done[noisy_reg_i]) continue;
-                int ret = collect_noisy_vars1(chunk, pl->opt, noisy_reg_i);
-                if (ret >= 0) {
-                    noisy_reg_is_done[noisy_reg_i] = 1; new_region_is_done = 1;
-                    if (ret > 0) {
-                        new_var = 1;
-                        // update phasing/haplotype information every time a noisy region is processed
-                        // assign_hap_based_on_het_vars(chunk, LONGCALLD_CLEAN_HET_SNP | LONGCALLD_CLEAN_HET_INDEL | LONGCALLD_CLEAN_HOM_VAR | LONGCALLD_NOISY_CAND_HET_VAR | LONGCALLD_NOISY_CAND_HOM_VAR, pl->opt);
-                        // assign_hap_based_on_germline_het_vars_kmeans(chunk, LONGCALLD_CLEAN_HET_SNP | LONGCALLD_CLEAN_HET_INDEL | LONGCALLD_CLEAN_HOM_VAR | LONGCALLD_NOISY_CAND_HET_VAR | LONGCALLD_NOISY_CAND_HOM_VAR, pl->opt);
-                    } else {
-                        if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "No var: %s:%d-%d\n", chunk->tname, cr_start(chunk->chunk_noisy_regs, noisy_reg_i), cr_end(chunk->chunk_noisy_regs, noisy_reg_i));
-                    }
-                } // unable to resolve the region
+            int n_regs = collect_noisy_reg_waves(chunk, sorted_noisy_regs, noisy_reg_is_done, regs);
+            for (int wave_beg = 0, wave_end; wave_beg < n_regs; wave_beg = wave_end) {
+                for (wave_end = wave_beg+1; wave_end < n_regs && regs[wave_end].wave == regs[wave_beg].wave; ++wave_end);
+                noisy_reg_wave_t w = {chunk, opt, regs + wave_beg};
+                kt_forpool(chunk->noisy_fp, align_noisy_reg_for, &w, wave_end - wave_beg);
+                for (int i = wave_beg; i < wave_end; ++i) {
+                    int noisy_reg_i = regs[i].noisy_reg_i;
+                    int ret = collect_noisy_vars1(chunk, opt, regs + i);
+                    free(regs[i].noisy_reads);
+                    if (ret >= 0) {
+                        noisy_reg_is_done[noisy_reg_i] = 1; new_region_is_done = 1; n_done++;
+                        if (ret > 0) {
+                            new_var_reg_begs[new_var] = regs[i].noisy_reg_beg; new_var_reg_ends[new_var++] = regs[i].noisy_reg_end;
+                            // update phasing/haplotype information every time a noisy region is processed
+                            // assign_hap_based_on_het_vars(chunk, LONGCALLD_CLEAN_HET_SNP | LONGCALLD_CLEAN_HET_INDEL | LONGCALLD_CLEAN_HOM_VAR | LONGCALLD_NOISY_CAND_HET_VAR | LONGCALLD_NOISY_CAND_HOM_VAR, pl->opt);
+                            // assign_hap_based_on_germline_het_vars_kmeans(chunk, LONGCALLD_CLEAN_HET_SNP | LONGCALLD_CLEAN_HET_INDEL | LONGCALLD_CLEAN_HOM_VAR | LONGCALLD_NOISY_CAND_HET_VAR | LONGCALLD_NOISY_CAND_HOM_VAR, pl->opt);
+                        } else {
+                            if (LONGCALLD_VERBOSE >= 2) fprintf(stderr, "No var: %s:%d-%d\n", chunk->tname, cr_start(chunk->chunk_noisy_regs, noisy_reg_i), cr_end(chunk->chunk_noisy_regs, noisy_reg_i));
+                        }
+                    } // unable to resolve the region
+                }
             }
             if (new_var) {
-                // re-assign haplotype information based on the all(old+newly) called variants
-                assign_hap_based_on_germline_het_vars_kmeans(opt, chunk, LONGCALLD_CAND_GERMLINE_VAR_CATE);
+                // re-assign haplotype information based on the all(old+newly) called variants around the new ones
+                assign_hap_based_on_germline_het_vars_kmeans_local(opt, chunk, LONGCALLD_CAND_GERMLINE_VAR_CATE, new_var, new_var_reg_begs, new_var_reg_ends);
             }
             if (new_region_is_done == 0) break;
         }
-        free(sorted_noisy_regs); free(noisy_reg_is_done);
+        // skipped (too long/deep) regions are also marked as done
+        stats->cnt[LONGCALLD_CNT_NOISY_REGS] = chunk->chunk_noisy_regs->n_r;
+        stats->cnt[LONGCALLD_CNT_NOISY_RESOLVED] = n_done - stats->cnt[LONGCALLD_CNT_NOISY_SKIPPED];
+        stats->cnt[LONGCALLD_CNT_NOISY_UNRESOLVED] = chunk->chunk_noisy_regs->n_r - n_done;
+        free(sorted_noisy_regs); free(noisy_reg_is_done); free(regs); free(new_var_reg_begs); free(new_var_reg_ends);
+        t1 = realtime(); stats->time[LONGCALLD_STAGE_NOISY_MSA] += t1 - t; t = t1;
     }
     // 5. call somatic variants based on phased reads
-    if (opt->out_somatic == 1) collect_somatic_var(chunk, opt);
+    if (opt->out_somatic == 1) {
+        collect_somatic_var(chunk, opt);
+        stats->time[LONGCALLD_STAGE_SOMATIC] += realtime() - t;
+    }
 }
 
-// stitch ii-1 and ii
-void stitch_var_main(call_var_step_t *step, bam_chunk_t *chunk) {
+// stitch ii-1 and ii, cur_var: variants of ii, already made by the worker
+void stitch_var_main(call_var_step_t *step, bam_chunk_t *pre_chunk, bam_chunk_t *cur_chunk, var_t *cur_var) {
     call_var_pl_t *pl = step->pl; call_var_opt_t *opt = pl->opt;
-    // extend phase set between two adjacent bam chunks
-    for (int ii = 1; ii < step->n_chunks; ++ii) {
-        flip_variant_hap(opt, chunk+ii-1, chunk+ii);
-    }
+    // extend phase set between two adjacent bam chunks, pre_chunk has already been stitched
+    flip_variant_hap(opt, pre_chunk, cur_chunk, cur_var);
 }
 
 void make_var_main(call_var_step_t *step, bam_chunk_t *chunk, var_t *var, long ii) {
@@ -36,6 +36,10 @@
 // #define LONGCALLD_CONS_READ_ALN_STR(clu_aln_strs, read_i) clu_aln_strs+(read_i+1)*2-1
 // #define LONGCALLD_REF_READ_ALN_STR(clu_aln_strs, read_i) clu_aln_strs+(read_i+1)*2
 
+// allele/haplotype counters are kept inline in cand_var_t, so moving/copying a var is a plain struct copy
+#define LONGCALLD_MAX_N_ALLES 4 // ref, alt1, alt2, minor_alt
+#define LONGCALLD_N_HAP_PROFILE 3 // 0:HOM/1:H1/2:H2, i.e., LONGCALLD_DEF_PLOID+1
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -77,8 +81,8 @@ typedef struct cand_var_t {
     int n_uniq_alles; // up ot 4: ref, alt1, alt2, minor_alt
                       // snp/ins: could be >2, del: ≤2
                       // minor_alt: not ref and not main alt alleles (mostly sequencing errors)
-    int *alle_covs; // size: n_uniq_alles
-    int **strand_to_alle_covs; // strand-wise: 1:forward/2:reverse -> alle_i -> read count, used for strand bias
+    int alle_covs[LONGCALLD_MAX_N_ALLES]; // first n_uniq_alles are used
+    int strand_to_alle_covs[2][LONGCALLD_MAX_N_ALLES]; // strand-wise: 0:forward/1:reverse -> alle_i -> read count, used for strand bias
     int ref_len; uint8_t ref_base; // 1-base ref_base, only used for X
     int alt_len; uint8_t *alt_seq, alt_ref_base; // only used for mismatch/insertion, deletion:NULL
                                                  // ref_alt_base: only for indels, the first base of alt_seq, which maps to the ref_base
@@ -90,17 +94,32 @@ typedef struct cand_var_t {
     // char *rep_name, *rep_family, *rep_class; 
 
     // dynamic information, update during haplotype assignment
-    int **hap_to_alle_profile; // read-wise: 1:H1/2:H2 -> alle_i -> read count
-    int *hap_to_cons_alle; // HAP-wise (hap_to_cons_alle_i): 1:H1/2:H2 -> alle_i
+    int has_hap_profile; // hap_to_alle_profile & hap_to_cons_alle are initialized
+    int hap_to_alle_profile[LONGCALLD_N_HAP_PROFILE][LONGCALLD_MAX_N_ALLES]; // read-wise: 1:H1/2:H2 -> alle_i -> read count
+    int hap_to_cons_alle[LONGCALLD_N_HAP_PROFILE]; // HAP-wise (hap_to_cons_alle_i): 1:H1/2:H2 -> alle_i
 } cand_var_t;
 
+// shared storage of all reads' allele bands in one read_var_profile_t array
+// blocks are never moved, so bands handed out to reads stay valid until the profile is freed
+#define LONGCALLD_READ_VAR_POOL_BLOCK_SIZE 65536 // entries per block
+
+typedef struct read_var_pool_t {
+    int n_blocks, m_blocks;
+    uint8_t **blocks; // each block: int32_t alt_qi[m] + int8_t alleles[m]
+    size_t *block_n, *block_m; // used/allocated entries in each block
+    size_t block_size; // size of newly added blocks, bounded by n_reads * n_total_vars
+} read_var_pool_t;
+
 // read X var
+// banded layout: each read only stores [start_var_idx, end_var_idx] inside a shared pool
 typedef struct read_var_profile_t {
     int read_id; // 0 .. bam_chunk->n_read-1 XXX for noisy region
     int start_var_idx, end_var_idx; // 0 .. n_total_cand_vars-1
-    int *alleles; // 0:ref, 1:alt, -1:non-ref/alt, -2: alt & low_qual
-    int *alt_qi; // 0-based query position (for =XI); for DEL, qi is the first read base after the deletion; -1 for non-alt
+    int band_cap; // allocated entries of alleles/alt_qi, >= end_var_idx-start_var_idx+1
+    int8_t *alleles; // 0:ref, 1:alt, -1:non-ref/alt, -2: alt & low_qual
+    int32_t *alt_qi; // 0-based query position (for =XI); for DEL, qi is the first read base after the deletion; -1 for non-alt
     // int *alt_base_pos, *digar_i; // alt_base position in read, size: end_var_idx-start_var_idx+1
+    read_var_pool_t *pool;
 } read_var_profile_t;
 
 typedef struct aln_str_t {
@@ -128,7 +147,7 @@ var_site_t make_var_site_from_digar(int tid, struct digar1_t *digar);
 var_site_t make_var_site_from_cand_var(struct cand_var_t *cand_var);
 void collect_var_main(const struct call_var_pl_t *pl, struct bam_chunk_t *bam_chunk);
 void make_var_main(struct call_var_step_t *step, struct bam_chunk_t *chunk, struct var_t *var, long ii);
-void stitch_var_main(struct call_var_step_t *step, struct bam_chunk_t *bam_chunk);
+void stitch_var_main(struct call_var_step_t *step, struct bam_chunk_t *pre_chunk, struct bam_chunk_t *cur_chunk, struct var_t *cur_var);
 void free_cand_vars(struct cand_var_t *cand_vars, int m);
 
 #ifdef __cplusplus
@@ -3,6 +3,8 @@
 #include <getopt.h>
 #include <string.h>
 #include "call_var_main.h"
+#include "tag_main.h"
+#include "mask_main.h"
 #include "utils.h"
 #include "htslib/kstring.h"
 
@@ -24,6 +26,8 @@ static int usage(void) {//main usage
 
     fprintf(stderr, "Command: \n");
     fprintf(stderr, "         call          call variants from long-read BAM/CRAM, single normal sample\n");
+    fprintf(stderr, "         tag           apply HP/PS tags from 'call --out-hap-tags' to BAM/CRAM\n");
+    fprintf(stderr, "         mask          output low-complexity regions of reference for \'call --low-comp-bed\'\n");
     // fprintf(stderr, "         trio          call variants from long-read BAM/CRAM, trio normal samples\n");
     // fprintf(stderr, "         joint         joint variant calling for multiple samples\n");
     // fprintf(stderr, "         genotype      call genotype for given VCF\n");
@@ -46,6 +50,8 @@ int main(int argc, char *argv[]) {
         ret = 1; usage();
     } else {
         if (strcmp(argv[1], "call") == 0) ret = call_var_main(argc-1, argv+1);
+        else if (strcmp(argv[1], "tag") == 0) ret = tag_main(argc-1, argv+1);
+        else if (strcmp(argv[1], "mask") == 0) ret = mask_main(argc-1, argv+1);
         else {
             _err_error("Unrecognized command '%s'\n", argv[1]);
             ret = 1; usage();
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include "main.h"
+#include "mask_main.h"
+#include "call_var_main.h"
+#include "utils.h"
+#include "sdust.h"
+#include "htslib/faidx.h"
+
+extern int LONGCALLD_VERBOSE;
+
+// genome-wide low-complexity (sdust) mask, used by 'call --low-comp-bed' instead of running sdust for each chunk
+
+const struct option mask_opt [] = {
+    { "out", 1, NULL, 'o' },
+    { "sdust-T", 1, NULL, 'T' },
+    { "sdust-W", 1, NULL, 'W' },
+    { "help", 0, NULL, 'h' },
+    { "version", 0, NULL, 'v' },
+    { 0, 0, 0, 0}
+};
+
+// sdust takes int lengths & 32-bit positions, so long contigs are masked in blocks with W-bp flanks
+#define LONGCALLD_MASK_BLOCK_SIZE (1 << 30)
+
+static void mask_flush_intv(FILE *out_fp, const char *tname, hts_pos_t beg, hts_pos_t end, int64_t *n_intvs) {
+    if (beg >= end) return;
+    fprintf(out_fp, "%s\t%" PRIi64 "\t%" PRIi64 "\n", tname, beg, end); // 0-based, [beg, end)
+    (*n_intvs)++;
+}
+
+static void mask_usage(void) {
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s mask [options] <ref.fa> > ref.low_comp.bed\n", PROG);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Note: output BED can be used by \'%s call --low-comp-bed\'\n", PROG);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -o --out        FILE  output BED file [stdout]\n");
+    fprintf(stderr, "    -T --sdust-T     INT  sdust score threshold, should be the same as \'call\' [%d]\n", LONGCALLD_SDUST_T);
+    fprintf(stderr, "    -W --sdust-W     INT  sdust window size, should be the same as \'call\' [%d]\n", LONGCALLD_SDUST_W);
+    fprintf(stderr, "    -v --version          print version number\n");
+    exit(1);
+}
+
+int mask_main(int argc, char *argv[]) {
+    const char *opt_str = "o:T:W:hv";
+    int c, op_idx, T = LONGCALLD_SDUST_T, W = LONGCALLD_SDUST_W; char *out_fn = NULL;
+    double realtime0 = realtime();
+    while ((c = getopt_long(argc, argv, opt_str, mask_opt, &op_idx)) >= 0) {
+        switch(c) {
+            case 'o': out_fn = optarg; break;
+            case 'T': T = atoi(optarg); break;
+            case 'W': W = atoi(optarg); break;
+            case 'h': mask_usage();
+            case 'v': fprintf(stdout, "%s\n", LONGCALLD_VERSION); return 0;
+            default: return 0;
+        }
+    }
+    if (argc - optind < 1) mask_usage();
+    const char *ref_fn = argv[optind];
+    faidx_t *fai = fai_load3(ref_fn, NULL, NULL, FAI_CREATE);
+    if (fai == NULL) _err_error_exit("Failed to load/build reference fasta index: %s\n", ref_fn);
+    FILE *out_fp = out_fn == NULL ? stdout : fopen(out_fn, "w");
+    if (out_fp == NULL) _err_error_exit("Failed to open output file \'%s\'\n", out_fn);
+
+    fprintf(out_fp, "#%s T=%d W=%d\n", LONGCALLD_LOW_COMP_BED_HEADER, T, W);
+    int64_t n_intvs = 0;
+    for (int i = 0; i < faidx_nseq(fai); ++i) {
+        const char *tname = faidx_iseq(fai, i); hts_pos_t len = 0;
+        char *seq = faidx_fetch_seq64(fai, tname, 0, faidx_seq_len64(fai, tname)-1, &len);
+        if (seq == NULL || len <= 0) _err_error_exit("Failed to fetch reference sequence for %s from the fasta file.\n", tname);
+        hts_pos_t pre_beg = 0, pre_end = 0; // last interval, may be extended by the next block
+        for (hts_pos_t blk_beg = 0; blk_beg < len; blk_beg += LONGCALLD_MASK_BLOCK_SIZE) {
+            hts_pos_t blk_end = MIN_OF_TWO(len, blk_beg + LONGCALLD_MASK_BLOCK_SIZE);
+            hts_pos_t beg = MAX_OF_TWO(0, blk_beg - W), end = MIN_OF_TWO(len, blk_end + W);
+            uint64_t *r; int n = 0;
+            r = sdust(0, (uint8_t*)seq+beg, (int)(end-beg), T, W, &n);
+            for (int j = 0; j < n; ++j) {
+                hts_pos_t b = MAX_OF_TWO(blk_beg, beg + (hts_pos_t)(r[j]>>32)), e = MIN_OF_TWO(blk_end, beg + (hts_pos_t)(uint32_t)r[j]);
+                if (b >= e) continue;
+                if (blk_beg > 0 && b == blk_beg && pre_end == blk_beg) { // continued from the previous block
+                    pre_end = e;
+                    continue;
+                }
+                mask_flush_intv(out_fp, tname, pre_beg, pre_end, &n_intvs);
+                pre_beg = b; pre_end = e;
+            }
+            free(r);
+        }
+        mask_flush_intv(out_fp, tname, pre_beg, pre_end, &n_intvs);
+        free(seq);
+    }
+    if (out_fp != stdout) fclose(out_fp);
+    fai_destroy(fai);
+    _err_info("Output %" PRIi64 " low-complexity regions\n", n_intvs);
+    _err_info("Real time: %.3f sec; CPU: %.3f sec; Peak RSS: %.3f GB.\n", realtime() - realtime0, cputime(), peakrss() / 1024.0 / 1024.0 / 1024.0);
+    _err_success("%s\n", CMD);
+    return 0;
+}
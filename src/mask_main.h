@@ -0,0 +1,14 @@
+#ifndef LONGCALLD_MASK_MAIN_H
+#define LONGCALLD_MASK_MAIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int mask_main(int argc, char *argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // end of LONGCALLD_MASK_MAIN_H
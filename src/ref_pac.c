@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ref_pac.h"
+#include "seq.h"
+#include "utils.h"
+#include "htslib/faidx.h"
+
+#define ref_pac_round8(x) (((x) + 7) & ~(int64_t)7)
+
+typedef struct {
+    int64_t n, m; int64_t *a; // [beg, end) pairs
+} ref_pac_amb_t;
+
+static void ref_pac_amb_add(ref_pac_amb_t *amb, int64_t pos) {
+    if (amb->n > 0 && amb->a[amb->n*2-1] == pos) { // extend the last interval
+        amb->a[amb->n*2-1] = pos+1;
+        return;
+    }
+    if (amb->n == amb->m) {
+        amb->m = amb->m == 0 ? 16 : amb->m * 2;
+        amb->a = (int64_t*)_err_realloc(amb->a, amb->m * 2 * sizeof(int64_t));
+    }
+    amb->a[amb->n*2] = pos; amb->a[amb->n*2+1] = pos+1; amb->n++;
+}
+
+// write to a temporary file first, so a partially written file is never loaded
+static int ref_pac_build(const char *fa_fn, const char *fai_fn, const char *pac_fn, const struct stat *fa_st) {
+    faidx_t *fai = fai_load3(fa_fn, fai_fn, NULL, FAI_CREATE);
+    if (fai == NULL) return -1;
+    int n_seqs = faidx_nseq(fai);
+    char *tmp_fn = (char*)malloc(strlen(pac_fn) + 32);
+    sprintf(tmp_fn, "%s.tmp.%d", pac_fn, (int)getpid());
+    FILE *fp = fopen(tmp_fn, "wb");
+    if (fp == NULL) {
+        free(tmp_fn); fai_destroy(fai);
+        return -1;
+    }
+    ref_pac_hdr_t hdr; memset(&hdr, 0, sizeof(ref_pac_hdr_t));
+    memcpy(hdr.magic, LONGCALLD_REF_PAC_MAGIC, strlen(LONGCALLD_REF_PAC_MAGIC)+1);
+    hdr.n_seqs = n_seqs; hdr.fa_size = fa_st->st_size; hdr.fa_mtime = fa_st->st_mtime;
+    ref_pac_seq_t *seqs = (ref_pac_seq_t*)_err_calloc(n_seqs, sizeof(ref_pac_seq_t));
+    ref_pac_amb_t *ambs = (ref_pac_amb_t*)_err_calloc(n_seqs, sizeof(ref_pac_amb_t));
+    int64_t off = sizeof(ref_pac_hdr_t) + n_seqs * sizeof(ref_pac_seq_t);
+    for (int i = 0; i < n_seqs; ++i) {
+        seqs[i].name_off = off; off += strlen(faidx_iseq(fai, i)) + 1;
+        seqs[i].len = faidx_seq_len64(fai, faidx_iseq(fai, i));
+    }
+    for (int i = 0; i < n_seqs; ++i) {
+        off = ref_pac_round8(off);
+        seqs[i].pac_off = off; off += (seqs[i].len + 3) / 4;
+    }
+    int ret = 0; uint8_t zeros[8] = {0};
+    // header & names, seqs are re-written after pac/amb offsets are known
+    if (fwrite(&hdr, sizeof(ref_pac_hdr_t), 1, fp) != 1 || fwrite(seqs, sizeof(ref_pac_seq_t), n_seqs, fp) != (size_t)n_seqs) ret = -1;
+    for (int i = 0; i < n_seqs && ret == 0; ++i) {
+        const char *name = faidx_iseq(fai, i);
+        if (fwrite(name, 1, strlen(name)+1, fp) != strlen(name)+1) ret = -1;
+    }
+    uint8_t *pac = NULL; int64_t m_pac = 0; off = ftell(fp);
+    for (int i = 0; i < n_seqs && ret == 0; ++i) {
+        if (off < seqs[i].pac_off && fwrite(zeros, 1, seqs[i].pac_off - off, fp) != (size_t)(seqs[i].pac_off - off)) { ret = -1; break; }
+        hts_pos_t len = 0;
+        char *seq = faidx_fetch_seq64(fai, faidx_iseq(fai, i), 0, seqs[i].len-1, &len);
+        if (seq == NULL || len != seqs[i].len) {
+            _err_error("Failed to fetch %s from the fasta file.\n", faidx_iseq(fai, i));
+            free(seq); ret = -1; break;
+        }
+        int64_t l_pac = (len + 3) / 4;
+        if (l_pac > m_pac) {
+            m_pac = l_pac; free(pac);
+            pac = (uint8_t*)_err_malloc(m_pac);
+        }
+        memset(pac, 0, l_pac);
+        for (hts_pos_t j = 0; j < len; ++j) {
+            uint8_t b = nst_nt4_table[(int)seq[j]];
+            if (b > 3) ref_pac_amb_add(ambs+i, j);
+            else pac[j>>2] |= b << ((j&3)<<1);
+        }
+        free(seq);
+        if (fwrite(pac, 1, l_pac, fp) != (size_t)l_pac) ret = -1;
+        off = seqs[i].pac_off + l_pac;
+    }
+    for (int i = 0; i < n_seqs && ret == 0; ++i) {
+        int64_t pad = ref_pac_round8(off) - off;
+        if (pad > 0 && fwrite(zeros, 1, pad, fp) != (size_t)pad) { ret = -1; break; }
+        off += pad;
+        seqs[i].n_amb = ambs[i].n; seqs[i].amb_off = off;
+        if (ambs[i].n > 0 && fwrite(ambs[i].a, sizeof(int64_t), ambs[i].n*2, fp) != (size_t)ambs[i].n*2) ret = -1;
+        off += ambs[i].n * 2 * sizeof(int64_t);
+    }
+    if (ret == 0 && (fseek(fp, sizeof(ref_pac_hdr_t), SEEK_SET) != 0 || fwrite(seqs, sizeof(ref_pac_seq_t), n_seqs, fp) != (size_t)n_seqs)) ret = -1;
+    if (fclose(fp) != 0) ret = -1;
+    if (ret == 0 && rename(tmp_fn, pac_fn) != 0) ret = -1;
+    if (ret != 0) unlink(tmp_fn);
+    for (int i = 0; i < n_seqs; ++i) free(ambs[i].a);
+    free(ambs); free(seqs); free(pac); free(tmp_fn); fai_destroy(fai);
+    return ret;
+}
+
+static ref_pac_t *ref_pac_mmap(const char *pac_fn, const struct stat *fa_st) {
+    int fd = open(pac_fn, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ref_pac_hdr_t)) {
+        close(fd); return NULL;
+    }
+    uint8_t *base = (uint8_t*)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+    const ref_pac_hdr_t *hdr = (const ref_pac_hdr_t*)base;
+    if (strcmp(hdr->magic, LONGCALLD_REF_PAC_MAGIC) != 0 || hdr->fa_size != fa_st->st_size || hdr->fa_mtime != fa_st->st_mtime
+        || hdr->n_seqs <= 0 || (int64_t)sizeof(ref_pac_hdr_t) + hdr->n_seqs * (int64_t)sizeof(ref_pac_seq_t) > st.st_size) {
+        munmap(base, st.st_size); return NULL; // stale or truncated
+    }
+    ref_pac_t *pac = (ref_pac_t*)_err_calloc(1, sizeof(ref_pac_t));
+    pac->base = base; pac->size = st.st_size; pac->n_seqs = hdr->n_seqs;
+    pac->seqs = (const ref_pac_seq_t*)(base + sizeof(ref_pac_hdr_t));
+    khash_t(str) *h = kh_init(str); int absent;
+    for (int64_t i = 0; i < pac->n_seqs; ++i) {
+        const ref_pac_seq_t *s = pac->seqs + i;
+        if (s->pac_off + (s->len+3)/4 > st.st_size || s->amb_off + s->n_amb * 2 * (int64_t)sizeof(int64_t) > st.st_size) {
+            kh_destroy(str, h); munmap(base, st.st_size); free(pac);
+            return NULL;
+        }
+        khint_t k = kh_put(str, h, (const char*)base + s->name_off, &absent);
+        kh_val(h, k) = i;
+    }
+    pac->name2id = h;
+    return pac;
+}
+
+// returns NULL if the FASTA is remote or the packed file can not be built, then faidx is used instead
+ref_pac_t *ref_pac_load(const char *fa_fn, const char *fai_fn, const char *pac_fn) {
+    struct stat fa_st;
+    if (stat(fa_fn, &fa_st) != 0) {
+        _err_warning("Packed reference \'%s\' is not used for remote FASTA \'%s\'.\n", pac_fn, fa_fn);
+        return NULL;
+    }
+    ref_pac_t *pac = ref_pac_mmap(pac_fn, &fa_st);
+    if (pac == NULL) {
+        _err_info("Building packed reference: %s\n", pac_fn);
+        if (ref_pac_build(fa_fn, fai_fn, pac_fn, &fa_st) == 0) pac = ref_pac_mmap(pac_fn, &fa_st);
+        if (pac == NULL) _err_warning("Failed to build packed reference \'%s\', fetching reference sequence from FASTA instead.\n", pac_fn);
+    }
+    return pac;
+}
+
+void ref_pac_destroy(ref_pac_t *pac) {
+    if (pac == NULL) return;
+    kh_destroy(str, (khash_t(str)*)pac->name2id);
+    munmap(pac->base, pac->size);
+    free(pac);
+}
+
+int ref_pac_name2id(const ref_pac_t *pac, const char *name) {
+    khash_t(str) *h = (khash_t(str)*)pac->name2id;
+    khint_t k = kh_get(str, h, name);
+    return k == kh_end(h) ? -1 : (int)kh_val(h, k);
+}
+
+void ref_pac_fetch(const ref_pac_t *pac, int id, hts_pos_t beg, hts_pos_t end, char *seq, uint8_t *bseq) {
+    const ref_pac_seq_t *s = pac->seqs + id;
+    const uint8_t *p = pac->base + s->pac_off;
+    for (hts_pos_t i = beg; i < end; ++i) {
+        uint8_t b = p[i>>2] >> ((i&3)<<1) & 3;
+        if (seq != NULL) seq[i-beg] = "ACGT"[b];
+        if (bseq != NULL) bseq[i-beg] = b;
+    }
+    // mask N intervals overlapping with [beg, end)
+    const int64_t *amb = (const int64_t*)(pac->base + s->amb_off);
+    int64_t lo = 0, hi = s->n_amb;
+    while (lo < hi) { // first interval with amb_end > beg
+        int64_t mid = (lo + hi) / 2;
+        if (amb[mid*2+1] <= beg) lo = mid + 1; else hi = mid;
+    }
+    for (int64_t i = lo; i < s->n_amb && amb[i*2] < end; ++i) {
+        hts_pos_t b = MAX_OF_TWO(amb[i*2], beg), e = MIN_OF_TWO(amb[i*2+1], end);
+        if (seq != NULL) memset(seq+b-beg, 'N', e-b);
+        if (bseq != NULL) memset(bseq+b-beg, 4, e-b);
+    }
+}
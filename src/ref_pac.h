@@ -0,0 +1,48 @@
+#ifndef LONGCALLD_REF_PAC_H
+#define LONGCALLD_REF_PAC_H
+
+#include <stdint.h>
+#include "htslib/hts.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 2-bit packed reference with N-mask, built once at 'call --ref-pac FILE' and mmap'ed by all threads
+// file layout (all offsets are from the beginning of the file):
+//   ref_pac_hdr_t | ref_pac_seq_t[n_seqs] | names | pac (4 bases/byte, per seq) | N intervals (int64 pairs, [beg, end), per seq)
+#define LONGCALLD_REF_PAC_MAGIC "LCDPAC1"
+
+typedef struct {
+    char magic[8];
+    int64_t n_seqs;
+    int64_t fa_size, fa_mtime; // to detect a modified FASTA
+} ref_pac_hdr_t;
+
+typedef struct {
+    int64_t len;
+    int64_t name_off, pac_off;
+    int64_t n_amb, amb_off; // non-ACGT intervals, decoded as N
+} ref_pac_seq_t;
+
+typedef struct ref_pac_t {
+    uint8_t *base; int64_t size; // mmap'ed file
+    int64_t n_seqs; const ref_pac_seq_t *seqs;
+    void *name2id; // khash_t(str)
+} ref_pac_t;
+
+ref_pac_t *ref_pac_load(const char *fa_fn, const char *fai_fn, const char *pac_fn);
+void ref_pac_destroy(ref_pac_t *pac);
+int ref_pac_name2id(const ref_pac_t *pac, const char *name);
+// [beg, end): 0-based, seq: upper-case ACGTN, bseq: 0-4, either can be NULL
+void ref_pac_fetch(const ref_pac_t *pac, int id, hts_pos_t beg, hts_pos_t end, char *seq, uint8_t *bseq);
+
+static inline hts_pos_t ref_pac_seq_len(const ref_pac_t *pac, int id) {
+    return pac->seqs[id].len;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // end of LONGCALLD_REF_PAC_H
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include "main.h"
+#include "tag_main.h"
+#include "bam_utils.h"
+#include "utils.h"
+#include "htslib/sam.h"
+#include "htslib/bgzf.h"
+#include "htslib/kstring.h"
+#include "htslib/thread_pool.h"
+
+extern int LONGCALLD_VERBOSE;
+
+// apply the haplotag sidecar (call --out-hap-tags) to a sorted BAM/CRAM in one streaming pass over the alignments
+// the sidecar itself is loaded into memory first: ~50 bytes + read name per haplotagged read
+
+const struct option tag_opt [] = {
+    { "out", 1, NULL, 'o' },
+    { "out-type", 1, NULL, 'O' },
+    { "ref", 1, NULL, 'r' },
+    { "threads", 1, NULL, 't' },
+    { "help", 0, NULL, 'h' },
+    { "version", 0, NULL, 'v' },
+    { 0, 0, 0, 0}
+};
+
+typedef struct {
+    int tid; hts_pos_t pos; // 0-based
+    char *qname; int hap; hts_pos_t ps;
+    uint8_t is_used;
+} hap_tag_t;
+
+// sidecar records may come in any contig order (e.g. call --region-file), so they are loaded and indexed by tid
+typedef struct {
+    char *fn; bam_hdr_t *header;
+    int64_t n, m; hap_tag_t *tags; // all records, sorted by (tid, pos)
+    int64_t *tid_off; // size: n_targets+1, records of tid: [tid_off[tid], tid_off[tid+1])
+    int tid; hts_pos_t pos; int64_t beg, end; // records at the current (tid, pos): [beg, end)
+} hap_tag_reader_t;
+
+static int hap_tag_cmp(const void *a, const void *b) {
+    const hap_tag_t *t1 = (const hap_tag_t*)a, *t2 = (const hap_tag_t*)b;
+    if (t1->tid != t2->tid) return t1->tid < t2->tid ? -1 : 1;
+    if (t1->pos != t2->pos) return t1->pos < t2->pos ? -1 : 1;
+    return 0;
+}
+
+static void hap_tag_reader_load(hap_tag_reader_t *r) {
+    BGZF *fp = bgzf_open(r->fn, "r"); kstring_t line = {0, 0, NULL};
+    if (fp == NULL) _err_error_exit("Failed to open haplotag file \'%s\'\n", r->fn);
+    while (bgzf_getline(fp, '\n', &line) >= 0) {
+        if (line.l == 0 || line.s[0] == '#') continue;
+        char *fields[5]; int n_fields = 0; char *p = line.s;
+        fields[n_fields++] = p;
+        for (; *p && n_fields < 5; ++p) {
+            if (*p == '\t') { *p = '\0'; fields[n_fields++] = p+1; }
+        }
+        if (n_fields < 5) _err_error_exit("Invalid line in haplotag file %s: %s\n", r->fn, line.s);
+        int tid = sam_hdr_name2tid(r->header, fields[0]);
+        if (tid < 0) _err_error_exit("Contig \'%s\' in haplotag file %s is not in the alignment file header.\n", fields[0], r->fn);
+        if (r->n == r->m) {
+            r->m = r->m == 0 ? 1024 : r->m * 2;
+            r->tags = (hap_tag_t*)realloc(r->tags, r->m * sizeof(hap_tag_t));
+        }
+        hap_tag_t *t = r->tags + r->n++;
+        t->tid = tid; t->pos = strtoll(fields[1], NULL, 10) - 1;
+        t->qname = strdup(fields[2]); t->hap = atoi(fields[3]); t->ps = strtoll(fields[4], NULL, 10);
+        t->is_used = 0;
+    }
+    free(line.s); bgzf_close(fp);
+    qsort(r->tags, r->n, sizeof(hap_tag_t), hap_tag_cmp);
+    int n_targets = r->header->n_targets;
+    r->tid_off = (int64_t*)calloc(n_targets+1, sizeof(int64_t));
+    for (int64_t i = 0; i < r->n; ++i) r->tid_off[r->tags[i].tid+1]++;
+    for (int i = 0; i < n_targets; ++i) r->tid_off[i+1] += r->tid_off[i];
+}
+
+// return the sidecar record of read (tid, pos, qname), NULL if not found
+static hap_tag_t *hap_tag_reader_get(hap_tag_reader_t *r, int tid, hts_pos_t pos, const char *qname) {
+    if (r->tid != tid || r->pos != pos) {
+        r->tid = tid; r->pos = pos;
+        int64_t lo = r->tid_off[tid], hi = r->tid_off[tid+1];
+        while (lo < hi) { // first record with pos >= pos
+            int64_t mid = lo + (hi - lo) / 2;
+            if (r->tags[mid].pos < pos) lo = mid + 1;
+            else hi = mid;
+        }
+        r->beg = r->end = lo;
+        while (r->end < r->tid_off[tid+1] && r->tags[r->end].pos == pos) r->end++;
+    }
+    for (int64_t i = r->beg; i < r->end; ++i) {
+        if (r->tags[i].is_used == 0 && strcmp(r->tags[i].qname, qname) == 0) {
+            r->tags[i].is_used = 1;
+            return r->tags + i;
+        }
+    }
+    return NULL;
+}
+
+static void hap_tag_reader_free(hap_tag_reader_t *r) {
+    for (int64_t i = 0; i < r->n; ++i) free(r->tags[i].qname);
+    free(r->tags); free(r->tid_off);
+}
+
+static void tag_usage(void) {
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s tag [options] <input.bam/cram> <hap_tags.gz> > phased.bam\n", PROG);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Note: \'hap_tags.gz\' is generated by \'%s call --out-hap-tags\'\n", PROG);
+    fprintf(stderr, "      \'input.bam/cram\' should be sorted, HP/PS tags of reads not in \'hap_tags.gz\' are removed\n");
+    fprintf(stderr, "      \'hap_tags.gz\' can be in any contig order, it is loaded into memory\n");
+    fprintf(stderr, "      (~50 bytes + read name per read, i.e., a few GB for a 30x whole-genome long-read BAM)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -o --out        FILE  output phased SAM/BAM/CRAM file [stdout]\n");
+    fprintf(stderr, "    -O --out-type    STR  s/b/c: SAM/BAM/CRAM [b]\n");
+    fprintf(stderr, "    -r --ref        FILE  reference FASTA file, required for CRAM input/output []\n");
+    fprintf(stderr, "    -t --threads     INT  number of threads for BAM/CRAM compression [%d]\n", 1);
+    fprintf(stderr, "    -v --version          print version number\n");
+    exit(1);
+}
+
+int tag_main(int argc, char *argv[]) {
+    const char *opt_str = "o:O:r:t:hv";
+    int c, op_idx, n_threads = 1; char out_type = 'b', *out_fn = NULL, *ref_fn = NULL;
+    double realtime0 = realtime();
+    while ((c = getopt_long(argc, argv, opt_str, tag_opt, &op_idx)) >= 0) {
+        switch(c) {
+            case 'o': out_fn = optarg; break;
+            case 'O': if (strcmp(optarg, "s") == 0 || strcmp(optarg, "b") == 0 || strcmp(optarg, "c") == 0) out_type = optarg[0];
+                      else _err_error_exit("\'-O/--out-type\' can only be \'s\', \'b\' or \'c\'\n");
+                      break;
+            case 'r': ref_fn = optarg; break;
+            case 't': n_threads = atoi(optarg); break;
+            case 'h': tag_usage();
+            case 'v': fprintf(stdout, "%s\n", LONGCALLD_VERSION); return 0;
+            default: return 0;
+        }
+    }
+    if (argc - optind < 2) tag_usage();
+    const char *in_fn = argv[optind], *tag_fn = argv[optind+1];
+    if (out_fn == NULL) out_fn = "-";
+    if (n_threads < 1) n_threads = 1;
+
+    samFile *in = sam_open(in_fn, "r"); if (in == NULL) _err_error_exit("Failed to open alignment file \'%s\'\n", in_fn);
+    if (ref_fn != NULL && hts_set_fai_filename(in, ref_fn) != 0) _err_error_exit("Failed to set reference file for CRAM decoding: %s %s\n", in_fn, ref_fn);
+    htsThreadPool tpool = {NULL, 0}; // shared by input and output
+    if (n_threads > 1) {
+        if ((tpool.pool = hts_tpool_init(n_threads)) == NULL) _err_error_exit("Failed to create thread pool with %d threads\n", n_threads);
+        hts_set_thread_pool(in, &tpool);
+    }
+    bam_hdr_t *header = sam_hdr_read(in); if (header == NULL) _err_error_exit("Failed to read alignment file header \'%s\'\n", in_fn);
+
+    hap_tag_reader_t r; memset(&r, 0, sizeof(hap_tag_reader_t));
+    r.fn = (char*)tag_fn; r.header = header; r.tid = -1; r.pos = -1;
+    hap_tag_reader_load(&r);
+
+    samFile *out = sam_open(out_fn, out_type == 'b' ? "wb" : (out_type == 'c' ? "wc" : "w"));
+    if (out == NULL) _err_error_exit("Failed to open output file \'%s\'\n", out_fn);
+    if (out_type == 'c') {
+        if (ref_fn == NULL) _err_error_exit("Reference FASTA file (-r) is required for CRAM output.\n");
+        if (hts_set_fai_filename(out, ref_fn) != 0) _err_error_exit("Failed to set reference file for output CRAM encoding: %s\n", ref_fn);
+    }
+    if (tpool.pool != NULL) hts_set_thread_pool(out, &tpool);
+    if (sam_hdr_add_pg(header, PROG, "VN", LONGCALLD_VERSION, "CL", CMD, NULL) < 0) _err_error_exit("Fail to add PG line to bam header.\n");
+    if (sam_hdr_write(out, header) < 0) _err_error_exit("Failed to write BAM header.\n");
+
+    bam1_t *read = bam_init1(); int ret; int64_t n_reads = 0, n_tagged_reads = 0;
+    while ((ret = sam_read1(in, header, read)) >= 0) {
+        int hap = 0; hts_pos_t ps = 0;
+        // only primary alignments are phased, see collect_ref_seq_bam_main
+        if (read->core.tid >= 0 && !(read->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FSUPPLEMENTARY))) {
+            hap_tag_t *t = hap_tag_reader_get(&r, read->core.tid, read->core.pos, bam_get_qname(read));
+            if (t != NULL) {
+                hap = t->hap; ps = t->ps; n_tagged_reads++;
+            }
+        }
+        bam1_set_hap_tags(read, hap, ps);
+        if (sam_write1(out, header, read) < 0) _err_error_exit("Failed to write BAM record. %s\n", bam_get_qname(read));
+        n_reads++;
+    }
+    if (ret < -1) _err_error_exit("Failed to read alignment file \'%s\'\n", in_fn);
+    int64_t n_unused = 0;
+    for (int64_t i = 0; i < r.n; ++i) n_unused += r.tags[i].is_used == 0;
+    if (n_unused > 0) _err_warning("%" PRIi64 " reads in \'%s\' are not found in \'%s\'\n", n_unused, tag_fn, in_fn);
+    _err_info("Output %" PRIi64 " reads, %" PRIi64 " haplotagged\n", n_reads, n_tagged_reads);
+
+    bam_destroy1(read); hap_tag_reader_free(&r);
+    if (sam_close(out) < 0) _err_error_exit("Failed to close output file \'%s\'\n", out_fn);
+    bam_hdr_destroy(header); sam_close(in);
+    if (tpool.pool != NULL) hts_tpool_destroy(tpool.pool);
+    _err_info("Real time: %.3f sec; CPU: %.3f sec; Peak RSS: %.3f GB.\n", realtime() - realtime0, cputime(), peakrss() / 1024.0 / 1024.0 / 1024.0);
+    _err_success("%s\n", CMD);
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef LONGCALLD_TAG_MAIN_H
+#define LONGCALLD_TAG_MAIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int tag_main(int argc, char *argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // end of LONGCALLD_TAG_MAIN_H
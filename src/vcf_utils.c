@@ -11,6 +11,7 @@
 #include "call_var_main.h"
 #include "htslib/vcf.h"
 #include "htslib/sam.h"
+#include "htslib/kstring.h"
 
 extern int LONGCALLD_VERBOSE;
 
@@ -54,12 +55,14 @@ void write_vcf_header(bam_hdr_t *hdr, struct call_var_opt_t *opt) {
     bcf_hdr_append(vcf_hdr, "##FILTER=<ID=LowQual,Description=\"Low quality variant\">");
     bcf_hdr_append(vcf_hdr, "##FILTER=<ID=RefCall,Description=\"Reference call\">");
     bcf_hdr_append(vcf_hdr, "##FILTER=<ID=NoCall,Description=\"Site has depth=0 resulting in no call\">");
+    bcf_hdr_append(vcf_hdr, "##FILTER=<ID=NoisySkip,Description=\"Noisy region [POS, END] was not called, see INFO/SKIPREASON\">");
 
     // INFO fields
     bcf_hdr_append(vcf_hdr, "##INFO=<ID=END,Number=1,Type=Integer,Description=\"End position of the variant described in this record\">");
     bcf_hdr_append(vcf_hdr, "##INFO=<ID=SOMATIC,Number=0,Type=Flag,Description=\"Somatic/mosaic variant\">");
     bcf_hdr_append(vcf_hdr, "##INFO=<ID=CLEAN,Number=0,Type=Flag,Description=\"Clean-region variant (SNP or simple indel in non-repetitive region)\">");
     bcf_hdr_append(vcf_hdr, "##INFO=<ID=SVTYPE,Number=1,Type=String,Description=\"Type of structural variant\">");
+    bcf_hdr_append(vcf_hdr, "##INFO=<ID=SKIPREASON,Number=1,Type=String,Description=\"Why the noisy region was skipped: long, deep, or over its per-region budget (cells, mem, time)\">");
     bcf_hdr_append(vcf_hdr, "##INFO=<ID=SVLEN,Number=A,Type=Integer,Description=\"Difference in length between REF and ALT alleles\">");
     // TSD info
     bcf_hdr_append(vcf_hdr, "##INFO=<ID=TSD,Number=A,Type=String,Description=\"Target site duplication sequence\">");
@@ -94,177 +97,261 @@ void write_vcf_header(bam_hdr_t *hdr, struct call_var_opt_t *opt) {
     opt->vcf_hdr = vcf_hdr;
 }
 
-int write_var_to_vcf(var_t *vars, const struct call_var_opt_t *opt, bam_chunk_t *chunk) {
-    char *chrom = chunk->tname;
-    htsFile *out_vcf = opt->out_vcf;  // htsFile pointer
-    int n_vars = vars->n;
-    int n_output_vars = 0;
-    int buf_m = 50000; char *buffer = (char*)malloc(buf_m * sizeof(char));  // Buffer for output string
-    int len = 0;        // Length of the output string
-
-    for (int var_i = 0; var_i < n_vars; var_i++) {
-        var1_t var = vars->vars[var_i];
-        if (var.n_alt_allele == 0) continue;
-        if (var.DP < opt->min_dp) continue;
-        if (opt->out_somatic && var.is_somatic) {
-            if (var.AD[1] < opt->min_somatic_te_dp) continue;
-            else if (var.AD[1] < opt->min_alt_dp && var.tsd_len <= 0) continue; 
-        } else {
-            if (var.AD[1] < opt->min_alt_dp) continue;
-        }
-
-        // Validate bases
-        if (opt->out_amb_base == 0) {
-            uint8_t skip = 0;
-            for (int j = 0; j < var.ref_len; j++) {
-                if (var.ref_bases[j] >= 4) {
-                    if (LONGCALLD_VERBOSE >= 2) 
-                        fprintf(stderr, "Invalid ref base: %s %" PRId64 " %d\n", chrom, var.pos + j, var.ref_bases[j]);
-                    skip = 1; break;
-                }
+static int var_is_output(const var1_t *var, const struct call_var_opt_t *opt, const char *chrom) {
+    if (var->n_alt_allele == 0) return 0;
+    if (var->DP < opt->min_dp) return 0;
+    if (opt->out_somatic && var->is_somatic) {
+        if (var->AD[1] < opt->min_somatic_te_dp) return 0;
+        else if (var->AD[1] < opt->min_alt_dp && var->tsd_len <= 0) return 0;
+    } else {
+        if (var->AD[1] < opt->min_alt_dp) return 0;
+    }
+    // Validate bases
+    if (opt->out_amb_base == 0) {
+        for (int j = 0; j < var->ref_len; j++) {
+            if (var->ref_bases[j] >= 4) {
+                if (LONGCALLD_VERBOSE >= 2)
+                    fprintf(stderr, "Invalid ref base: %s %" PRId64 " %d\n", chrom, var->pos + j, var->ref_bases[j]);
+                return 0;
             }
-            if (skip) continue;
-
-            for (int j = 0; j < var.n_alt_allele; j++) {
-                for (int k = 0; k < var.alt_len[j]; k++) {
-                    if (var.alt_bases[j][k] >= 4) {
-                        if (LONGCALLD_VERBOSE >= 2) 
-                            fprintf(stderr, "Invalid alt base: %s %" PRId64 " %d\n", chrom, var.pos, var.alt_bases[j][k]);
-                        skip = 1; break;
-                    }
+        }
+        for (int j = 0; j < var->n_alt_allele; j++) {
+            for (int k = 0; k < var->alt_len[j]; k++) {
+                if (var->alt_bases[j][k] >= 4) {
+                    if (LONGCALLD_VERBOSE >= 2)
+                        fprintf(stderr, "Invalid alt base: %s %" PRId64 " %d\n", chrom, var->pos, var->alt_bases[j][k]);
+                    return 0;
                 }
-                if (skip) break;
             }
-            if (skip) continue;
         }
+    }
+    return 1;
+}
 
-        // Write to buffer
-        len = snprintf(buffer, buf_m, "%s\t%" PRId64 "\t.\t", chrom, var.pos);
+static inline int var_out_rnames(const var1_t *var, const struct call_var_opt_t *opt) {
+    // ALTREADS: output_var_rnames for all variants, output_sv_rnames for SVs, output_somatic_var_rnames for somatic SVs
+    return opt->output_var_rnames || (var->is_sv && (opt->output_sv_rnames)) || (var->is_somatic && opt->output_somatic_var_rnames);
+}
 
-        // Write REF
-        int base_len = var.ref_len;
-        for (int j = 0; j < var.n_alt_allele; j++) base_len += var.alt_len[j];
-        if (base_len > buf_m) {
-            buf_m = base_len + 10000;
-            buffer = (char*)realloc(buffer, buf_m * sizeof(char));
-        }
-        for (int j = 0; j < var.ref_len; j++) 
-            len += snprintf(buffer + len, buf_m - len, "%c", "ACGTN"[var.ref_bases[j]]);
+static inline void kput_bases(const uint8_t *bases, int len, kstring_t *s) {
+    ks_resize(s, s->l + len + 1);
+    for (int j = 0; j < len; j++) s->s[s->l++] = "ACGTN"[bases[j]];
+    s->s[s->l] = 0;
+}
 
-        // Write ALT
-        len += snprintf(buffer + len, buf_m - len, "\t");
-        for (int j = 0; j < var.n_alt_allele; j++) {
-            for (int k = 0; k < var.alt_len[j]; k++) 
-                len += snprintf(buffer + len, buf_m - len, "%c", "ACGTN"[var.alt_bases[j][k]]);
-            if (j < var.n_alt_allele - 1) len += snprintf(buffer + len, buf_m - len, ",");
-        }
+// REF,ALT1,ALT2,... for bcf_update_alleles_str
+static void kput_alleles(const var1_t *var, kstring_t *s) {
+    kput_bases(var->ref_bases, var->ref_len, s);
+    for (int j = 0; j < var->n_alt_allele; j++) {
+        kputc(',', s); kput_bases(var->alt_bases[j], var->alt_len[j], s);
+    }
+}
 
-        // Structural Variant (SV) annotation
-        int k = 0;
-        char SVLEN[1024] = "SVLEN=", tmp[1024];
-        char SVTYPE[1024] = "SVTYPE=";
-        for (int i = 0; i < var.n_alt_allele; i++) { // assert(var.n_alt_allele == 1)
-            if (var.is_sv) { 
-                if (k > 0) {
-                    strcat(SVLEN, ",");
-                    strcat(SVTYPE, ",");
-                }
-                sprintf(tmp, "%d", var.alt_len[i] - var.ref_len);
-                strcat(SVLEN, tmp);
-                sprintf(tmp, "%s", var.alt_len[i] > var.ref_len ? "INS" : "DEL");
-                strcat(SVTYPE, tmp);
-                k++;
-            }
-        }
-        
-        // Write QUAL, FILTER, INFO
-        len += snprintf(buffer + len, buf_m - len, "\t%d\tPASS\t", var.QUAL);
-        if (var.is_clean) len += snprintf(buffer + len, buf_m - len, "CLEAN;");
-        if (var.is_somatic) len += snprintf(buffer + len, buf_m - len, "SOMATIC;");
-        if (var.te_seq_i >= 0) len += snprintf(buffer + len, buf_m - len, "MEI;");
-        len += snprintf(buffer + len, buf_m - len, "END=%" PRId64 "", var.pos + var.ref_len - 1);
-        if (var.is_sv) { 
-            len += snprintf(buffer + len, buf_m - len, ";%s;%s", SVTYPE, SVLEN);
-            if (var.tsd_len > 0) {
-                len += snprintf(buffer + len, buf_m - len, ";TSD=");
-                for (int i = 0; i < var.tsd_len; ++i) len += snprintf(buffer + len, buf_m - len, "%c", "ACGTN"[var.tsd_seq[i]]);
-                len += snprintf(buffer + len, buf_m - len, ";TSDLEN=%d;POLYALEN=%d;TSDPOS1=%" PRId64 "", var.tsd_len, var.polya_len, var.tsd_pos1);
-                if (var.tsd_pos2 > 0) len += snprintf(buffer + len, buf_m - len, ";TSDPOS2=%" PRId64 "", var.tsd_pos2);
-            }
-            if (var.te_seq_i >= 0) len += snprintf(buffer + len, buf_m - len, ";REPNAME=%c%s", "+-"[var.te_is_rev], opt->te_seq_names[var.te_seq_i]);
+// one VCF line, appended to s
+static void var_to_vcf_line(const var1_t *var, const struct call_var_opt_t *opt, bam_chunk_t *chunk, kstring_t *s) {
+    kputs(chunk->tname, s); kputc('\t', s); kputll(var->pos, s); kputsn("\t.\t", 3, s);
+    // REF, ALT
+    kput_bases(var->ref_bases, var->ref_len, s); kputc('\t', s);
+    for (int j = 0; j < var->n_alt_allele; j++) {
+        if (j > 0) kputc(',', s);
+        kput_bases(var->alt_bases[j], var->alt_len[j], s);
+    }
+    // QUAL, FILTER, INFO
+    kputc('\t', s); kputw(var->QUAL, s); kputsn("\tPASS\t", 6, s);
+    if (var->is_clean) kputs("CLEAN;", s);
+    if (var->is_somatic) kputs("SOMATIC;", s);
+    if (var->te_seq_i >= 0) kputs("MEI;", s);
+    kputs("END=", s); kputll(var->pos + var->ref_len - 1, s);
+    if (var->is_sv) { // Structural Variant (SV) annotation, assert(var->n_alt_allele == 1)
+        kputs(";SVTYPE=", s);
+        for (int i = 0; i < var->n_alt_allele; i++) {
+            if (i > 0) kputc(',', s);
+            kputs(var->alt_len[i] > var->ref_len ? "INS" : "DEL", s);
         }
-        len += snprintf(buffer + len, buf_m - len, "\t");
-
-        // Write FORMAT and Genotype Data
-        int gt1 = var.GT[0], gt2 = var.GT[1];
-        int is_hom = gt1 == gt2; int gt_seperator = '|';
-        if (var.PS == 0) {
-            gt_seperator = '/';
-            if (gt1 > gt2) { int tmp = gt1; gt1 = gt2; gt2 = tmp;  }
+        kputs(";SVLEN=", s);
+        for (int i = 0; i < var->n_alt_allele; i++) {
+            if (i > 0) kputc(',', s);
+            kputw(var->alt_len[i] - var->ref_len, s);
         }
-        // add SVREADS to FORMAT if outputting supporting read names for SVs
-        len += snprintf(buffer + len, buf_m - len, "GT:DP:AD:VAF:GQ");
-        if (is_hom == 0 && var.PS != 0) len += snprintf(buffer + len, buf_m - len, ":PS");
-        if (opt->output_var_rnames || (var.is_sv && (opt->output_sv_rnames)) || (var.is_somatic && opt->output_somatic_var_rnames)) {
-            len += snprintf(buffer + len, buf_m - len, ":ALTREADS");
+        if (var->tsd_len > 0) {
+            kputs(";TSD=", s); kput_bases(var->tsd_seq, var->tsd_len, s);
+            kputs(";TSDLEN=", s); kputw(var->tsd_len, s);
+            kputs(";POLYALEN=", s); kputw(var->polya_len, s);
+            kputs(";TSDPOS1=", s); kputll(var->tsd_pos1, s);
+            if (var->tsd_pos2 > 0) { kputs(";TSDPOS2=", s); kputll(var->tsd_pos2, s); }
         }
-        len += snprintf(buffer + len, buf_m - len, "\t");
+        if (var->te_seq_i >= 0) { kputs(";REPNAME=", s); kputc("+-"[var->te_is_rev], s); kputs(opt->te_seq_names[var->te_seq_i], s); }
+    }
+    // FORMAT and Genotype Data
+    int gt1 = var->GT[0], gt2 = var->GT[1];
+    int is_hom = gt1 == gt2; int gt_seperator = '|';
+    if (var->PS == 0) {
+        gt_seperator = '/';
+        if (gt1 > gt2) { int tmp = gt1; gt1 = gt2; gt2 = tmp; }
+    }
+    int out_rnames = var_out_rnames(var, opt);
+    kputs("\tGT:DP:AD:VAF:GQ", s);
+    if (is_hom == 0 && var->PS != 0) kputs(":PS", s);
+    if (out_rnames) kputs(":ALTREADS", s);
+    kputc('\t', s);
+    // GT:DP:AD:VAF:GQ
+    kputw(gt1, s); kputc(gt_seperator, s); kputw(gt2, s); kputc(':', s); kputw(var->DP, s); kputc(':', s);
+    for (int j = 0; j < 1 + var->n_alt_allele; j++) {
+        if (j > 0) kputc(',', s);
+        kputw(var->AD[j], s);
+    }
+    for (int j = 0; j < var->n_alt_allele; j++) {
+        kputc(j == 0 ? ':' : ',', s);
+        ksprintf(s, "%.3f", (float)var->AD[j+1] / var->DP);
+    }
+    kputc(':', s); kputw(var->GQ, s);
+    if (is_hom == 0 && var->PS != 0) { kputc(':', s); kputll(var->PS, s); }
+    if (out_rnames) {
+        kputc(':', s);
+        if (var->AD[1] > 0) {
+            for (int i = 0; i < var->AD[1]; ++i) {
+                if (i > 0) kputc(',', s);
+                kputs(chunk->read_names[var->alt_read_i[i]], s);
+            }
+        } else kputc('.', s); // for SVs without read support, output "." for ALTREADS
+    }
+    kputc('\n', s);
+}
 
-        // GT:DP
-        len += snprintf(buffer + len, buf_m - len, "%d%c%d:%d:", gt1, gt_seperator, gt2, var.DP);
-        // AD
-        for (int j = 0; j < 1 + var.n_alt_allele; j++) {
-            if (j > 0) len += snprintf(buffer + len, buf_m - len, ",");
-            len += snprintf(buffer + len, buf_m - len, "%d", var.AD[j]);
+// one BCF record, same fields as var_to_vcf_line
+static void var_to_bcf1(const var1_t *var, const struct call_var_opt_t *opt, bam_chunk_t *chunk, bcf1_t *rec, kstring_t *tmp) {
+    bcf_hdr_t *hdr = opt->vcf_hdr;
+    bcf_clear(rec);
+    rec->rid = bcf_hdr_name2id(hdr, chunk->tname); rec->pos = var->pos - 1;
+    tmp->l = 0; kput_alleles(var, tmp);
+    bcf_update_alleles_str(hdr, rec, tmp->s);
+    rec->qual = var->QUAL;
+    int pass_id = bcf_hdr_id2int(hdr, BCF_DT_ID, "PASS"); bcf_update_filter(hdr, rec, &pass_id, 1);
+    if (var->is_clean) bcf_update_info_flag(hdr, rec, "CLEAN", NULL, 1);
+    if (var->is_somatic) bcf_update_info_flag(hdr, rec, "SOMATIC", NULL, 1);
+    if (var->te_seq_i >= 0) bcf_update_info_flag(hdr, rec, "MEI", NULL, 1);
+    int32_t end = var->pos + var->ref_len - 1; bcf_update_info_int32(hdr, rec, "END", &end, 1);
+    if (var->is_sv) {
+        int32_t svlen[2]; tmp->l = 0;
+        for (int i = 0; i < var->n_alt_allele; i++) {
+            if (i > 0) kputc(',', tmp);
+            kputs(var->alt_len[i] > var->ref_len ? "INS" : "DEL", tmp);
+            svlen[i] = var->alt_len[i] - var->ref_len;
         }
-        // VAF
-        for (int j = 0; j < var.n_alt_allele; j++) {
-            if (j == 0) len += snprintf(buffer + len, buf_m - len, ":");
-            if (j > 0) len += snprintf(buffer + len, buf_m - len, ",");
-            float vaf = (float)var.AD[j+1] / var.DP;
-            len += snprintf(buffer + len, buf_m - len, "%.3f", vaf);
+        bcf_update_info_string(hdr, rec, "SVTYPE", tmp->s);
+        bcf_update_info_int32(hdr, rec, "SVLEN", svlen, var->n_alt_allele);
+        if (var->tsd_len > 0) {
+            tmp->l = 0; kput_bases(var->tsd_seq, var->tsd_len, tmp);
+            bcf_update_info_string(hdr, rec, "TSD", tmp->s);
+            int32_t v = var->tsd_len; bcf_update_info_int32(hdr, rec, "TSDLEN", &v, 1);
+            v = var->polya_len; bcf_update_info_int32(hdr, rec, "POLYALEN", &v, 1);
+            v = var->tsd_pos1; bcf_update_info_int32(hdr, rec, "TSDPOS1", &v, 1);
+            if (var->tsd_pos2 > 0) { v = var->tsd_pos2; bcf_update_info_int32(hdr, rec, "TSDPOS2", &v, 1); }
         }
-        // GQ
-        len += snprintf(buffer + len, buf_m - len, ":%d", var.GQ);
-        // PS
-        if (is_hom == 0 && var.PS != 0) 
-            len += snprintf(buffer + len, buf_m - len, ":%" PRId64 "", var.PS);
-        // ALTREADS: output_var_rnames for all variants, output_sv_rnames for SVs, output_somatic_var_rnames for somatic SVs
-        // if (var.is_sv && (opt->output_sv_rnames || (opt->output_somatic_var_rnames && var.is_somatic))) {
-        if (opt->output_var_rnames || (var.is_sv && (opt->output_sv_rnames)) || (var.is_somatic && opt->output_somatic_var_rnames)) {
-            // check if the buffer is large enough for read names
-            int n_reads_needed = 0; // 
-            for (int i = 0; i < var.AD[1]; ++i)
-                n_reads_needed += strlen(chunk->read_names[var.alt_read_i[i]]) + 1;
-            if (len + n_reads_needed >= buf_m) {
-                buf_m = len + n_reads_needed + 1024;
-                buffer = (char*)realloc(buffer, buf_m);
-            }
-            len += snprintf(buffer + len, buf_m - len, ":");
-            if (var.AD[1] > 0) {
-                for (int i = 0; i < var.AD[1]; ++i) {
-                    if (i > 0) len += snprintf(buffer + len, buf_m - len, ",");
-                    int alt_read_i = var.alt_read_i[i];
-                    len += snprintf(buffer + len, buf_m - len, "%s", chunk->read_names[alt_read_i]);
-                }
-            } else { // for SVs without read support, output "." for SVREADS
-                len += snprintf(buffer + len, buf_m - len, ".");
-            }
+        if (var->te_seq_i >= 0) {
+            tmp->l = 0; kputc("+-"[var->te_is_rev], tmp); kputs(opt->te_seq_names[var->te_seq_i], tmp);
+            bcf_update_info_string(hdr, rec, "REPNAME", tmp->s);
         }
-        len += snprintf(buffer + len, buf_m - len, "\n");
+    }
+    int gt1 = var->GT[0], gt2 = var->GT[1], is_hom = gt1 == gt2;
+    int32_t gts[2];
+    if (var->PS == 0) {
+        if (gt1 > gt2) { int t = gt1; gt1 = gt2; gt2 = t; }
+        gts[0] = bcf_gt_unphased(gt1); gts[1] = bcf_gt_unphased(gt2);
+    } else {
+        gts[0] = bcf_gt_unphased(gt1); gts[1] = bcf_gt_phased(gt2);
+    }
+    bcf_update_genotypes(hdr, rec, gts, 2);
+    int32_t v = var->DP; bcf_update_format_int32(hdr, rec, "DP", &v, 1);
+    int32_t ad[3]; float vaf[2];
+    for (int j = 0; j < 1 + var->n_alt_allele; j++) ad[j] = var->AD[j];
+    for (int j = 0; j < var->n_alt_allele; j++) vaf[j] = (float)var->AD[j+1] / var->DP;
+    bcf_update_format_int32(hdr, rec, "AD", ad, 1 + var->n_alt_allele);
+    bcf_update_format_float(hdr, rec, "VAF", vaf, var->n_alt_allele);
+    v = var->GQ; bcf_update_format_int32(hdr, rec, "GQ", &v, 1);
+    if (is_hom == 0 && var->PS != 0) { v = var->PS; bcf_update_format_int32(hdr, rec, "PS", &v, 1); }
+    if (var_out_rnames(var, opt)) {
+        tmp->l = 0;
+        for (int i = 0; i < var->AD[1]; ++i) {
+            if (i > 0) kputc(',', tmp);
+            kputs(chunk->read_names[var->alt_read_i[i]], tmp);
+        }
+        if (var->AD[1] <= 0) kputc('.', tmp);
+        const char *rnames = tmp->s;
+        bcf_update_format_string(hdr, rec, "ALTREADS", &rnames, 1);
+    }
+}
 
-        // Write to htsFile
-        if (out_vcf->format.compression!=no_compression) {
-            if (bgzf_write(out_vcf->fp.bgzf, buffer, len) < 0) {
-                _err_error_exit("Could not write to VCF file.\n");
-            }
-        } else {
-            if (hwrite(out_vcf->fp.hfile, buffer, len) < 0) {
-                _err_error_exit("Could not write to VCF file.\n");
-            }
+// skipped noisy region: REF base at beg, no ALT, no genotype
+// REF is from ref_bseq, as for other records: ref_seq may be soft-masked or contain IUPAC codes
+static void skip_reg_to_vcf_line(const noisy_skip_reg_t *r, bam_chunk_t *chunk, kstring_t *s) {
+    kputs(chunk->tname, s); kputc('\t', s); kputll(r->beg, s); kputsn("\t.\t", 3, s);
+    kputc("ACGTN"[chunk->ref_bseq[r->beg - chunk->ref_beg]], s);
+    kputs("\t.\t.\tNoisySkip\tEND=", s); kputll(r->end, s);
+    kputs(";SKIPREASON=", s); kputs(r->reason, s);
+    kputs("\tGT\t./.\n", s);
+}
+
+static void skip_reg_to_bcf1(const noisy_skip_reg_t *r, const struct call_var_opt_t *opt, bam_chunk_t *chunk, bcf1_t *rec) {
+    bcf_hdr_t *hdr = opt->vcf_hdr;
+    bcf_clear(rec);
+    rec->rid = bcf_hdr_name2id(hdr, chunk->tname); rec->pos = r->beg - 1;
+    char ref[2] = {"ACGTN"[chunk->ref_bseq[r->beg - chunk->ref_beg]], 0};
+    bcf_update_alleles_str(hdr, rec, ref);
+    bcf_float_set_missing(rec->qual);
+    int filter_id = bcf_hdr_id2int(hdr, BCF_DT_ID, "NoisySkip"); bcf_update_filter(hdr, rec, &filter_id, 1);
+    int32_t end = r->end; bcf_update_info_int32(hdr, rec, "END", &end, 1);
+    bcf_update_info_string(hdr, rec, "SKIPREASON", r->reason);
+    int32_t gts[2] = {bcf_gt_missing, bcf_gt_missing};
+    bcf_update_genotypes(hdr, rec, gts, 2);
+}
+
+static int skip_reg_cmp(const void *a, const void *b) {
+    const noisy_skip_reg_t *r1 = (const noisy_skip_reg_t*)a, *r2 = (const noisy_skip_reg_t*)b;
+    if (r1->beg != r2->beg) return r1->beg < r2->beg ? -1 : 1;
+    return (r1->end > r2->end) - (r1->end < r2->end);
+}
+
+static void write_vcf_text(htsFile *out_vcf, kstring_t *s) {
+    if (s->l == 0) return;
+    if (out_vcf->format.compression != no_compression) {
+        if (bgzf_write(out_vcf->fp.bgzf, s->s, s->l) < 0) _err_error_exit("Could not write to VCF file.\n");
+    } else {
+        if (hwrite(out_vcf->fp.hfile, s->s, s->l) < 0) _err_error_exit("Could not write to VCF file.\n");
+    }
+    s->l = 0;
+}
+
+// VCF: records of a chunk are formatted into one buffer and written together
+// BCF, or VCF indexed while writing (bcf_idx_init): records are encoded with bcf1_t, bcf_write() adds them to the index
+int write_var_to_vcf(var_t *vars, const struct call_var_opt_t *opt, bam_chunk_t *chunk) {
+    char *chrom = chunk->tname;
+    htsFile *out_vcf = opt->out_vcf;
+    int n_output_vars = 0, use_rec = opt->out_vcf_type == 'b' || opt->out_vcf_type == 'u' || out_vcf->idx != NULL;
+    kstring_t s = {0, 0, NULL};
+    bcf1_t *rec = use_rec ? bcf_init() : NULL;
+
+    // skipped noisy regions are merged into the variants by position, they are not counted in n_output_vars
+    qsort(chunk->skip_noisy_regs, chunk->n_skip_noisy_regs, sizeof(noisy_skip_reg_t), skip_reg_cmp);
+    for (int var_i = 0, skip_i = 0; var_i < vars->n || skip_i < chunk->n_skip_noisy_regs; ) {
+        if (skip_i < chunk->n_skip_noisy_regs && (var_i == vars->n || chunk->skip_noisy_regs[skip_i].beg <= vars->vars[var_i].pos)) {
+            noisy_skip_reg_t *r = chunk->skip_noisy_regs + skip_i++;
+            if (use_rec) {
+                skip_reg_to_bcf1(r, opt, chunk, rec);
+                if (bcf_write(out_vcf, opt->vcf_hdr, rec) < 0) _err_error_exit("Could not write to VCF/BCF file.\n");
+            } else skip_reg_to_vcf_line(r, chunk, &s);
+            continue;
         }
+        var1_t *var = vars->vars + var_i++;
+        if (var_is_output(var, opt, chrom) == 0) continue;
+        if (use_rec) {
+            var_to_bcf1(var, opt, chunk, rec, &s);
+            if (bcf_write(out_vcf, opt->vcf_hdr, rec) < 0) _err_error_exit("Could not write to VCF/BCF file.\n");
+        } else var_to_vcf_line(var, opt, chunk, &s);
         n_output_vars++;
     }
-    free(buffer);
+    if (!use_rec) write_vcf_text(out_vcf, &s);
+    if (rec != NULL) bcf_destroy(rec);
+    free(s.s);
     return n_output_vars;
 }
@@ -0,0 +1,119 @@
+// packed reference (--ref-pac) vs. faidx parity test, run with: make test
+// usage: ref_pac_test TMP_DIR
+// writes a FASTA with soft-masked bases, N runs, IUPAC codes and contigs of length 1-5,
+// then checks ref_pac_fetch() against faidx_fetch_seq64() for windows covering both contig ends
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include "ref_pac.h"
+#include "seq.h"
+#include "htslib/faidx.h"
+
+int LONGCALLD_VERBOSE = 0;
+
+static const char *iupac = "RYKMSWBDHVNrykmswbdhvn";
+
+static void write_contig(FILE *fp, const char *name, const char *seq, int line_len) {
+    int len = strlen(seq);
+    fprintf(fp, ">%s\n", name);
+    for (int i = 0; i < len; i += line_len) fprintf(fp, "%.*s\n", line_len, seq + i);
+}
+
+static int write_fasta(const char *fa_fn) {
+    FILE *fp = fopen(fa_fn, "w");
+    if (fp == NULL) return -1;
+    // c1: N runs at both ends and in the middle, soft-masked runs & single IUPAC codes
+    int len = 10007; char *s = (char*)malloc(len+1); uint32_t x = 11;
+    for (int i = 0; i < len; ++i) {
+        x = x * 1103515245 + 12345;
+        s[i] = "ACGT"[x >> 16 & 3];
+        if ((i / 97) & 1) s[i] = tolower(s[i]);
+        if ((x >> 8) % 53 == 0) s[i] = iupac[(x >> 20) % strlen(iupac)];
+    }
+    memset(s, 'N', 13); memset(s + 4000, 'N', 1000); memset(s + 5001, 'n', 3); memset(s + len - 9, 'N', 9);
+    s[len] = 0;
+    write_contig(fp, "c1", s, 60);
+    // c2-c5: short contigs, not a multiple of 4 bases, ACGT/IUPAC/N at both ends
+    write_contig(fp, "c2", "A", 60);
+    write_contig(fp, "c3", "gTc", 2);
+    write_contig(fp, "c4", "NNNNN", 60);
+    write_contig(fp, "c5", "RacgY", 60);
+    free(s);
+    return fclose(fp);
+}
+
+// [beg, end), compare both upper-case seq & 0-4 bseq
+static int check_window(const ref_pac_t *pac, const faidx_t *fai, int id, hts_pos_t beg, hts_pos_t end) {
+    const char *name = faidx_iseq(fai, id); hts_pos_t fai_len;
+    char *fai_seq = faidx_fetch_seq64(fai, name, beg, end-1, &fai_len);
+    char *pac_seq = (char*)malloc(end - beg); uint8_t *pac_bseq = (uint8_t*)malloc(end - beg);
+    ref_pac_fetch(pac, ref_pac_name2id(pac, name), beg, end, pac_seq, pac_bseq);
+    int ret = 0;
+    if (fai_seq == NULL || fai_len != end - beg) ret = -1;
+    for (hts_pos_t i = 0; ret == 0 && i < end - beg; ++i) {
+        uint8_t b = nst_nt4_table[(uint8_t)fai_seq[i]];
+        if (pac_bseq[i] != b || pac_seq[i] != "ACGTN"[b]) {
+            fprintf(stderr, "%s:%" PRId64 "-%" PRId64 ": base %" PRId64 " faidx %c, packed %c/%d\n", name, beg, end, beg+i, fai_seq[i], pac_seq[i], pac_bseq[i]);
+            ret = -1;
+        }
+    }
+    if (fai_seq == NULL || fai_len != end - beg) fprintf(stderr, "%s:%" PRId64 "-%" PRId64 ": faidx fetch failed\n", name, beg, end);
+    free(fai_seq); free(pac_seq); free(pac_bseq);
+    return ret;
+}
+
+static int check_pac(const ref_pac_t *pac, const faidx_t *fai) {
+    int n_err = 0;
+    if (pac->n_seqs != faidx_nseq(fai)) {
+        fprintf(stderr, "%" PRId64 " packed vs. %d faidx contigs\n", pac->n_seqs, faidx_nseq(fai));
+        return 1;
+    }
+    for (int i = 0; i < faidx_nseq(fai); ++i) {
+        const char *name = faidx_iseq(fai, i); int id = ref_pac_name2id(pac, name);
+        hts_pos_t len = faidx_seq_len64(fai, name);
+        if (id < 0 || ref_pac_seq_len(pac, id) != len) {
+            fprintf(stderr, "%s: contig length differs\n", name); ++n_err;
+            continue;
+        }
+        const int w[] = {1, 2, 3, 4, 5, 7, 64, 1001};
+        for (size_t j = 0; j < sizeof(w)/sizeof(w[0]); ++j) {
+            if (w[j] > len) break;
+            for (hts_pos_t beg = 0; beg + w[j] <= len; beg += (beg < 16 || beg + w[j] + 16 > len) ? 1 : 37)
+                if (check_window(pac, fai, i, beg, beg + w[j]) != 0) ++n_err;
+        }
+        if (check_window(pac, fai, i, 0, len) != 0) ++n_err;
+    }
+    return n_err;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s TMP_DIR\n", argv[0]);
+        return 1;
+    }
+    char fa_fn[4096], pac_fn[4096];
+    snprintf(fa_fn, sizeof(fa_fn), "%s/ref_pac_test.fa", argv[1]);
+    snprintf(pac_fn, sizeof(pac_fn), "%s/ref_pac_test.fa.lpac", argv[1]);
+    if (write_fasta(fa_fn) != 0) {
+        fprintf(stderr, "Failed to write %s\n", fa_fn);
+        return 1;
+    }
+    faidx_t *fai = fai_load3(fa_fn, NULL, NULL, FAI_CREATE);
+    if (fai == NULL) return 1;
+    int n_err = 0;
+    // 1st load builds the packed file, 2nd one mmaps the existing file
+    for (int round = 0; round < 2; ++round) {
+        ref_pac_t *pac = ref_pac_load(fa_fn, NULL, pac_fn);
+        if (pac == NULL) {
+            fprintf(stderr, "Failed to load %s\n", pac_fn); ++n_err;
+            break;
+        }
+        n_err += check_pac(pac, fai);
+        ref_pac_destroy(pac);
+    }
+    fai_destroy(fai);
+    if (n_err > 0) fprintf(stderr, "%d packed reference windows differ from faidx\n", n_err);
+    return n_err > 0;
+}
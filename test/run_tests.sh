@@ -0,0 +1,161 @@
+#!/usr/bin/env bash
+# regression tests on ./test_data, run with: make test
+# usage: bash test/run_tests.sh [path/to/longcallD]
+set -u
+
+BIN=${1:-./bin/longcallD}
+DATA=$(dirname "$0")/../test_data
+REF=$DATA/chr11_2M.fa
+BAM=$DATA/HG002_chr11_hifi_test.bam
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+n_pass=0; n_fail=0
+pass() { echo "[PASS] $1"; n_pass=$((n_pass+1)); }
+fail() { echo "[FAIL] $1: $2"; n_fail=$((n_fail+1)); }
+
+# VCF body without the header lines
+vcf_body() { grep -v '^#' "$1"; }
+
+# CHROM, POS, REF, ALT, FILTER & GT of all VCF records
+vcf_calls() {
+    awk -F'\t' '!/^#/ { split($10, v, ":"); print $1 "\t" $2 "\t" $4 "\t" $5 "\t" $7 "\t" v[1] }' "$1"
+}
+
+# (contig, PS) of all phased VCF records
+vcf_ps() {
+    awk -F'\t' '!/^#/ { n = split($9, f, ":"); split($10, v, ":"); for (i = 1; i <= n; ++i) if (f[i] == "PS" && v[i] != ".") print $1 "\t" v[i] }' "$1" | sort -u
+}
+
+# soft-masked copy of the reference: every other FASTA line in lower case
+soft_masked_ref() {
+    [ -s "$TMP/soft.fa" ] || awk '/^>/ || NR % 2 { print; next } { print tolower($0) }' "$REF" > "$TMP/soft.fa"
+    echo "$TMP/soft.fa"
+}
+
+# number of VCF records whose REF is not the reference sequence at POS (upper-case, IUPAC as N)
+vcf_ref_mismatches() {
+    awk -F'\t' 'FNR == NR { if (/^>/) { c = substr($1, 2); n[c] = 0 } else { L[c, n[c]++] = toupper($0); if (!(c in W)) W[c] = length($0) } next }
+        function ref(c, p, l,   s, i) { # 1-based
+            for (i = int((p-1) / W[c]); length(s) < (p-1) % W[c] + l && i < n[c]; ++i) s = s L[c, i]
+            s = substr(s, (p-1) % W[c] + 1, l); gsub(/[^ACGT]/, "N", s); return s
+        }
+        !/^#/ && ref($1, $2, length($4)) != $4' "$REF" "$1" | wc -l
+}
+
+# copy of the reference with soft-masked lines, IUPAC codes & a 1470-bp N run
+iupac_ref() {
+    [ -s "$TMP/iupac.fa" ] || awk '/^>/ { print; next }
+        NR >= 14000 && NR < 14021 { gsub(/./, "N") }
+        NR % 97 == 0 { $0 = substr($0, 1, 34) (NR % 2 ? "R" : "y") substr($0, 36) }
+        NR % 2 { print; next } { print tolower($0) }' "$REF" > "$TMP/iupac.fa"
+    echo "$TMP/iupac.fa"
+}
+
+# run "call" once on the test data, shared by the tests below
+run_call() { # out_prefix [options]
+    local out=$1; shift
+    "$BIN" call "$@" "$REF" "$BAM" --hifi > "$out.vcf" 2> "$out.log"
+}
+
+# read HP/PS in the --out-hap-tags sidecar have to agree with the stitched VCF PS,
+# including the phase blocks flipped/merged at region chunk boundaries
+test_hap_tag_ps() {
+    run_call "$TMP/tag" -t4 --out-hap-tags "$TMP/tag.hap_tags.gz" || { fail hap_tag_ps "call failed"; return; }
+    vcf_ps "$TMP/tag.vcf" > "$TMP/tag.vcf_ps"
+    gzip -dc "$TMP/tag.hap_tags.gz" | awk -F'\t' '!/^#/ && $5 > 0 { print $1 "\t" $5 }' | sort -u > "$TMP/tag.read_ps"
+    if [ ! -s "$TMP/tag.read_ps" ]; then fail hap_tag_ps "no phased reads in sidecar"; return; fi
+    local n_bad; n_bad=$(comm -23 "$TMP/tag.read_ps" "$TMP/tag.vcf_ps" | wc -l)
+    if [ "$n_bad" -eq 0 ]; then pass hap_tag_ps; else fail hap_tag_ps "$n_bad read PS not found in VCF PS"; fi
+}
+
+# -Oz -o FILE writes FILE.tbi while writing, with the same records as -Ov (floats may be formatted by htslib)
+test_vcf_index() {
+    run_call "$TMP/plain" || { fail vcf_index "call failed"; return; }
+    "$BIN" call "$REF" "$BAM" --hifi -Oz -o "$TMP/idx.vcf.gz" 2> "$TMP/idx.log" || { fail vcf_index "call -Oz failed"; return; }
+    if [ ! -s "$TMP/idx.vcf.gz.tbi" ]; then fail vcf_index "no .tbi"; return; fi
+    if [ "$(gzip -dc "$TMP/idx.vcf.gz.tbi" | head -c 3)" != "TBI" ]; then fail vcf_index "invalid .tbi"; return; fi
+    if ! cmp -s <(vcf_body "$TMP/plain.vcf" | cut -f1-5,7) <(gzip -dc "$TMP/idx.vcf.gz" | vcf_body /dev/stdin | cut -f1-5,7); then
+        fail vcf_index "records differ from -Ov"; return
+    fi
+    pass vcf_index
+}
+
+# intervals of an unsorted --region-file are split by index density the same way as the sorted ones
+test_unsorted_region_file() {
+    printf 'chr11\t0\t1000000\nchr11\t1000000\t2000000\n' > "$TMP/sorted.bed"
+    printf 'chr11\t1000000\t2000000\nchr11\t0\t1000000\n' > "$TMP/unsorted.bed"
+    run_call "$TMP/sorted" -V1 --region-file "$TMP/sorted.bed" || { fail unsorted_region_file "call failed"; return; }
+    run_call "$TMP/unsorted" -V1 --region-file "$TMP/unsorted.bed" || { fail unsorted_region_file "call failed"; return; }
+    local n1 n2
+    n1=$(grep -o 'into [0-9]* region(s) by index density' "$TMP/sorted.log" | awk '{print $2}')
+    n2=$(grep -o 'into [0-9]* region(s) by index density' "$TMP/unsorted.log" | awk '{print $2}')
+    if [ -z "$n1" ] || [ "$n1" != "$n2" ]; then fail unsorted_region_file "regions: sorted ${n1:-NA}, unsorted ${n2:-NA}"; return; fi
+    pass unsorted_region_file
+}
+
+# REF of all records, including NoisySkip ones, is upper-case ACGTN with a soft-masked reference
+test_soft_masked_ref() {
+    local soft; soft=$(soft_masked_ref)
+    # --noisy-max-cells 1: every noisy region is skipped and written as a NoisySkip record
+    "$BIN" call "$soft" "$BAM" --hifi --noisy-max-cells 1 > "$TMP/soft.vcf" 2> "$TMP/soft.log" || { fail soft_masked_ref "call failed"; return; }
+    if ! vcf_body "$TMP/soft.vcf" | grep -q 'NoisySkip'; then fail soft_masked_ref "no NoisySkip records"; return; fi
+    local n_bad; n_bad=$(vcf_body "$TMP/soft.vcf" | awk -F'\t' '$4 !~ /^[ACGTN]+$/' | wc -l)
+    if [ "$n_bad" -eq 0 ]; then pass soft_masked_ref; else fail soft_masked_ref "$n_bad records with non-ACGTN REF"; fi
+}
+
+# identical noisy-region reads collapsed into one weighted POA input give the same calls as aligning them one by one
+test_read_collapse() {
+    [ -s "$TMP/plain.vcf" ] || run_call "$TMP/plain" || { fail read_collapse "call failed"; return; }
+    run_call "$TMP/no_collapse" --no-read-collapse || { fail read_collapse "call --no-read-collapse failed"; return; }
+    if cmp -s <(vcf_calls "$TMP/plain.vcf") <(vcf_calls "$TMP/no_collapse.vcf"); then pass read_collapse
+    else fail read_collapse "$(diff <(vcf_calls "$TMP/plain.vcf") <(vcf_calls "$TMP/no_collapse.vcf") | grep -c '^[<>]') differing records"; fi
+}
+
+# ref_pac_fetch gives the same bases as faidx for N runs, IUPAC codes & contig ends (test/ref_pac_test.c),
+# and "call --ref-pac" gives the same records as "call" without it
+test_ref_pac() {
+    local unit; unit=$(dirname "$0")/ref_pac_test
+    if [ ! -x "$unit" ]; then fail ref_pac "$unit not found"; return; fi
+    "$unit" "$TMP" 2> "$TMP/ref_pac_test.log" || { fail ref_pac "packed vs. faidx bases differ, see below"; cat "$TMP/ref_pac_test.log"; return; }
+    local ref; ref=$(iupac_ref)
+    "$BIN" call -t4 "$ref" "$BAM" --hifi > "$TMP/fai.vcf" 2> "$TMP/fai.log" || { fail ref_pac "call failed"; return; }
+    "$BIN" call -t4 --ref-pac "$TMP/iupac.fa.lpac" "$ref" "$BAM" --hifi > "$TMP/pac.vcf" 2> "$TMP/pac.log" || { fail ref_pac "call --ref-pac failed"; return; }
+    if [ ! -s "$TMP/iupac.fa.lpac" ]; then fail ref_pac "packed reference not built"; return; fi
+    if cmp -s <(vcf_body "$TMP/fai.vcf") <(vcf_body "$TMP/pac.vcf"); then pass ref_pac
+    else fail ref_pac "$(diff <(vcf_body "$TMP/fai.vcf") <(vcf_body "$TMP/pac.vcf") | grep -c '^[<>]') differing records with --ref-pac"; fi
+}
+
+# with --anchor-split, phased noisy regions are aligned window by window and the consensus/alignments are
+# stitched back together: all records still have to carry the reference bases at POS
+test_anchor_split() {
+    run_call "$TMP/anchor" -V2 --anchor-split 1 || { fail anchor_split "call failed"; return; }
+    if ! grep -q '^AnchorSplit ' "$TMP/anchor.log"; then fail anchor_split "no noisy region went through anchor-split"; return; fi
+    if [ -z "$(vcf_body "$TMP/anchor.vcf")" ]; then fail anchor_split "no records"; return; fi
+    local n_bad; n_bad=$(vcf_ref_mismatches "$TMP/anchor.vcf")
+    if [ "$n_bad" -eq 0 ]; then pass anchor_split; else fail anchor_split "$n_bad records with REF not matching the reference"; fi
+}
+
+# reads spanning a region boundary are decoded once and handed over to the downstream chunk,
+# the records do not depend on whether the handoff was ready (-t1) or not (-t8)
+test_read_handoff() {
+    run_call "$TMP/t1" -t1 --stats "$TMP/t1.json" || { fail read_handoff "call -t1 failed"; return; }
+    run_call "$TMP/t8" -t8 || { fail read_handoff "call -t8 failed"; return; }
+    local n_reused; n_reused=$(grep '"total"' -A3 "$TMP/t1.json" | grep -o '"reused_reads": [0-9]*' | head -1 | awk '{print $2}')
+    if [ "${n_reused:-0}" -eq 0 ]; then fail read_handoff "no boundary reads handed over with -t1"; return; fi
+    if cmp -s <(vcf_body "$TMP/t1.vcf") <(vcf_body "$TMP/t8.vcf"); then pass read_handoff
+    else fail read_handoff "$(diff <(vcf_body "$TMP/t1.vcf") <(vcf_body "$TMP/t8.vcf") | grep -c '^[<>]') differing records between -t1 and -t8"; fi
+}
+
+if [ ! -x "$BIN" ]; then echo "longcallD binary not found: $BIN" >&2; exit 1; fi
+test_hap_tag_ps
+test_vcf_index
+test_unsorted_region_file
+test_soft_masked_ref
+test_read_collapse
+test_ref_pac
+test_anchor_split
+test_read_handoff
+
+echo "$n_pass passed, $n_fail failed"
+[ "$n_fail" -eq 0 ]